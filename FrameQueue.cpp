@@ -11,55 +11,125 @@
 
 #include "FrameQueue.h"
 #include <assert.h>
+#include <chrono>
+
+typedef std::chrono::steady_clock WaitClock;
+
+// Slow path shared by all blocking calls: registers as a waiter, then sleeps
+// on oCond until bReady() holds. nTimeoutMs < 0 waits forever. The time spent
+// blocked is added to *pWaitUs and counted in *pWaits.
+//
+// Registering in nWaiters before re-checking bReady() pairs with the fence
+// in wakeWaiters(): either the waker sees the waiter, or the waiter sees the
+// state change, so no wake-up is lost without the fast path taking the lock.
+template<class Predicate>
+static bool waitFor(std::mutex &oMutex, std::condition_variable &oCond, std::atomic<int> &nWaiters,
+                    int nTimeoutMs, Predicate bReady,
+                    unsigned long long *pWaits, unsigned long long *pWaitUs)
+{
+    if (nTimeoutMs == 0)
+        return bReady();
+
+    std::unique_lock<std::mutex> lock(oMutex);
+    nWaiters.fetch_add(1, std::memory_order_seq_cst);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    WaitClock::time_point tStart = WaitClock::now();
+    bool bResult;
+    if (nTimeoutMs < 0)
+    {
+        oCond.wait(lock, bReady);
+        bResult = true;
+    }
+    else
+    {
+        bResult = oCond.wait_for(lock, std::chrono::milliseconds(nTimeoutMs), bReady);
+    }
+
+    nWaiters.fetch_sub(1, std::memory_order_relaxed);
+    *pWaits  += 1;
+    *pWaitUs += std::chrono::duration_cast<std::chrono::microseconds>(WaitClock::now() - tStart).count();
+    return bResult;
+}
 
 FrameQueue::FrameQueue():
-    nReadPosition_(0)
-    , nFramesInQueue_(0)
-    , bEndOfDecode_(0)
+    bEndOfDecode_(false)
+    , nProducerWaiters_(0)
+    , nConsumerWaiters_(0)
+    , nSurfaceWaiters_(0)
 {
-    memset(aDisplayQueue_, 0, cnMaximumSize * sizeof(CUVIDPARSERDISPINFO));
-    memset((void *)aIsFrameInUse_, 0, cnMaximumSize * sizeof(int));
+    static_assert(decltype(oDisplayQueue_)::cnCapacity >= cnMaximumSize, "display ring too small");
+
+    for (unsigned int i = 0; i < cnMaximumSize; i++)
+    {
+        aIsFrameInUse_[i].store(0, std::memory_order_relaxed);
+    }
+    memset(&oStats_, 0, sizeof(oStats_));
+}
+
+void FrameQueue::wakeWaiters(std::condition_variable &oCond, const std::atomic<int> &nWaiters, bool bAll)
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (nWaiters.load(std::memory_order_relaxed) == 0)
+        return;
+
+    // Taking the lock orders this notify after the waiter has gone to sleep.
+    {
+        std::lock_guard<std::mutex> lock(oMutex_);
+    }
+    if (bAll)
+        oCond.notify_all();
+    else
+        oCond.notify_one();
 }
 
-void FrameQueue::enqueue(const CUVIDPARSERDISPINFO *pPicParams)
+bool FrameQueue::enqueue(const CUVIDPARSERDISPINFO *pPicParams, int nTimeoutMs)
 {
-    aIsFrameInUse_[pPicParams->picture_index] = true;
+    aIsFrameInUse_[pPicParams->picture_index].store(1, std::memory_order_release);
 
-    do
+    // Only this thread pushes, so the queue can only have shrunk between
+    // the check and the push.
+    while (isDisplayQueueFull() || !oDisplayQueue_.Push(*pPicParams))
     {
-        if (nFramesInQueue_ < (int)FrameQueue::cnMaximumSize)
-        {
-            int iWritePosition = (nReadPosition_ + nFramesInQueue_) % cnMaximumSize;
-            aDisplayQueue_[iWritePosition] = *pPicParams;
-            nFramesInQueue_++;
-            break;
-        }
+        bool bReady = waitFor(oMutex_, oNotFull_, nProducerWaiters_, nTimeoutMs,
+                              [this] { return !isDisplayQueueFull() || bEndOfDecode_.load(); },
+                              &oStats_.nProducerWaits, &oStats_.nProducerWaitUs);
 
-        sleep(1);
-    } while (!bEndOfDecode_);
+        if (!bReady || isDisplayQueueFull())
+            return false;
+    }
 
+    wakeWaiters(oNotEmpty_, nConsumerWaiters_, false);
+    return true;
 }
 
-bool FrameQueue::dequeue(CUVIDPARSERDISPINFO *pDisplayInfo)
+bool FrameQueue::dequeue(CUVIDPARSERDISPINFO *pDisplayInfo, int nTimeoutMs)
 {
     pDisplayInfo->picture_index = -1;
 
-    if (nFramesInQueue_ > 0)
+    while (!oDisplayQueue_.Pop(pDisplayInfo))
     {
-        int iEntry = nReadPosition_;
-        *pDisplayInfo = aDisplayQueue_[iEntry];
-        nReadPosition_ = (iEntry+1) % cnMaximumSize;
-        nFramesInQueue_--;
-        
-        return true;
+        bool bReady = waitFor(oMutex_, oNotEmpty_, nConsumerWaiters_, nTimeoutMs,
+                              [this] { return !oDisplayQueue_.Empty() || bEndOfDecode_.load(); },
+                              &oStats_.nConsumerWaits, &oStats_.nConsumerWaitUs);
+
+        if (!bReady || oDisplayQueue_.Empty())
+            return false;
     }
 
-    return false;
+    wakeWaiters(oNotFull_, nProducerWaiters_, false);
+    return true;
 }
 
 void FrameQueue::releaseFrame(const CUVIDPARSERDISPINFO *pPicParams)
 {
-    aIsFrameInUse_[pPicParams->picture_index] = false;
+    aIsFrameInUse_[pPicParams->picture_index].store(0, std::memory_order_release);
+    wakeWaiters(oFrameReleased_, nSurfaceWaiters_, true);
+}
+
+bool FrameQueue::isDisplayQueueFull() const
+{
+    return oDisplayQueue_.Size() >= cnMaximumSize;
 }
 
 bool FrameQueue::isInUse(int nPictureIndex) const
@@ -67,31 +137,38 @@ bool FrameQueue::isInUse(int nPictureIndex) const
     assert(nPictureIndex >= 0);
     assert(nPictureIndex < (int)cnMaximumSize);
 
-    return (0 != aIsFrameInUse_[nPictureIndex]);
+    return (0 != aIsFrameInUse_[nPictureIndex].load(std::memory_order_acquire));
 }
 
 bool FrameQueue::isDecodeFinished() const
 {
-    return (!nFramesInQueue_ && bEndOfDecode_);
+    return (!oDisplayQueue_.Size() && bEndOfDecode_.load(std::memory_order_acquire));
 }
 
 void FrameQueue::endDecode()
 {
-    bEndOfDecode_ = true;
+    bEndOfDecode_.store(true, std::memory_order_release);
+
+    wakeWaiters(oNotFull_, nProducerWaiters_, true);
+    wakeWaiters(oNotEmpty_, nConsumerWaiters_, true);
+    wakeWaiters(oFrameReleased_, nSurfaceWaiters_, true);
 }
 
 
-bool FrameQueue::waitUntilFrameAvailable(int nPictureIndex)
+bool FrameQueue::waitUntilFrameAvailable(int nPictureIndex, int nTimeoutMs)
 {
-    while (isInUse(nPictureIndex))
-    {
-        sleep(1);   
+    if (!isInUse(nPictureIndex))
+        return true;
 
-        if (bEndOfDecode_){
-            return false;
-        }
-    }
+    waitFor(oMutex_, oFrameReleased_, nSurfaceWaiters_, nTimeoutMs,
+            [this, nPictureIndex] { return !isInUse(nPictureIndex) || bEndOfDecode_.load(); },
+            &oStats_.nSurfaceWaits, &oStats_.nSurfaceWaitUs);
 
-    return true;
+    return !isInUse(nPictureIndex);
 }
 
+void FrameQueue::getStatistics(FrameQueueStats *pStats) const
+{
+    std::lock_guard<std::mutex> lock(oMutex_);
+    *pStats = oStats_;
+}
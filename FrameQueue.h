@@ -16,18 +16,43 @@
 #include <nvcuvid.h>
 #include <unistd.h>
 #include <string.h>
+#include <assert.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include "SpscRing.h"
 #include "NvHWEncoder.h"
 
+// Time spent blocked inside the FrameQueue, split by side.
+//  - producer: parser callback waiting for a free display slot (enqueue)
+//  - surface:  parser callback waiting for a decode surface to be released
+//  - consumer: render loop waiting for a frame to be queued (dequeue)
+struct FrameQueueStats
+{
+    unsigned long long nProducerWaits;
+    unsigned long long nProducerWaitUs;
+    unsigned long long nSurfaceWaits;
+    unsigned long long nSurfaceWaitUs;
+    unsigned long long nConsumerWaits;
+    unsigned long long nConsumerWaitUs;
+};
+
 class FrameQueue
 {
     public:
         static const unsigned int cnMaximumSize = 20; // MAX_FRM_CNT;
+        static const int          cnInfinite    = -1; // wait without timeout
 
         FrameQueue();
 
-        void enqueue(const CUVIDPARSERDISPINFO *pPicParams);
+        // Blocks while the queue is full. Returns false if the wait timed out
+        // or decoding ended before a slot became free.
+        bool enqueue(const CUVIDPARSERDISPINFO *pPicParams, int nTimeoutMs = cnInfinite);
 
-        bool dequeue(CUVIDPARSERDISPINFO *pDisplayInfo);
+        // nTimeoutMs == 0 polls, otherwise blocks until a frame is queued,
+        // the timeout expires or decoding ends.
+        bool dequeue(CUVIDPARSERDISPINFO *pDisplayInfo, int nTimeoutMs = 0);
 
         void releaseFrame(const CUVIDPARSERDISPINFO *pPicParams);
 
@@ -37,14 +62,36 @@ class FrameQueue
 
         void endDecode();
 
-        bool waitUntilFrameAvailable(int nPictureIndex);
+        // Blocks until nPictureIndex is released by the consumer. Returns
+        // false on timeout or if decoding ended while waiting.
+        bool waitUntilFrameAvailable(int nPictureIndex, int nTimeoutMs = cnInfinite);
+
+        void getStatistics(FrameQueueStats *pStats) const;
 
     private:
-        volatile int        nReadPosition_;
-        volatile int        nFramesInQueue_;
-        CUVIDPARSERDISPINFO aDisplayQueue_[cnMaximumSize];
-        volatile int        aIsFrameInUse_[cnMaximumSize];
-        volatile int        bEndOfDecode_;		
+        void wakeWaiters(std::condition_variable &oCond, const std::atomic<int> &nWaiters, bool bAll);
+
+        // cnMaximumSize frames queued; the ring itself may hold a few more
+        bool isDisplayQueueFull() const;
+
+        // Display order is carried by a lock-free SPSC ring (parser callback
+        // thread -> render thread). The mutex and condition variables are only
+        // touched when one side actually has to sleep. The ring is rounded up
+        // to a power of two, but never holds more than cnMaximumSize frames,
+        // so the decoder sees the same back-pressure as with a plain array.
+        CNvSpscRing<CUVIDPARSERDISPINFO, nvSpscRingCapacity(cnMaximumSize)> oDisplayQueue_;
+        std::atomic<int>        aIsFrameInUse_[cnMaximumSize];
+        std::atomic<bool>       bEndOfDecode_;
+
+        std::atomic<int>        nProducerWaiters_;
+        std::atomic<int>        nConsumerWaiters_;
+        std::atomic<int>        nSurfaceWaiters_;
+
+        mutable std::mutex      oMutex_;
+        std::condition_variable oNotFull_;
+        std::condition_variable oNotEmpty_;
+        std::condition_variable oFrameReleased_;
+        FrameQueueStats         oStats_;
 };
 
 #define MAX_ENCODE_QUEUE 32
@@ -111,4 +158,161 @@ public:
     }
 };
 
+struct NvQueueStats
+{
+    unsigned long long nSubmitted;         // items handed to the pending side
+    unsigned long long nOccupancySum;      // in-flight count summed at each submit
+    unsigned int       uMaxOccupancy;      // high-water mark of in-flight items
+    unsigned long long nAvailableWaits;    // GetAvailable() calls that had to sleep
+    unsigned long long nAvailableWaitUs;
+    unsigned long long nPendingWaits;      // GetPending() calls that had to sleep
+    unsigned long long nPendingWaitUs;
+};
+
+// Thread-safe counterpart of CNvQueue for a split submit/retrieve design:
+// one thread takes buffers with GetAvailable(), fills and submits them and
+// hands them over with PushPending(); another thread takes them in the same
+// order with GetPending() and returns them with ReleasePending() once the
+// output has been consumed. Both Get calls block; after Shutdown() the
+// submitter gets NULL immediately and the retriever drains what is left
+// before getting NULL.
+template<class T>
+class CNvConcurrentQueue {
+    T** m_pBuffer;
+    unsigned int m_uSize;
+    unsigned int m_uInFlightCount;   // taken by GetAvailable, not yet released
+    unsigned int m_uPendingCount;    // pushed, not yet taken by GetPending
+    unsigned int m_uAvailableIdx;
+    unsigned int m_uPendingIndex;
+    bool m_bShutdown;
+    NvQueueStats m_stStats;
+    std::mutex m_mutex;
+    std::condition_variable m_cvAvailable;
+    std::condition_variable m_cvPending;
+
+    static unsigned long long ElapsedUs(std::chrono::steady_clock::time_point tStart)
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - tStart).count();
+    }
+
+public:
+    CNvConcurrentQueue(): m_pBuffer(NULL), m_uSize(0), m_uInFlightCount(0), m_uPendingCount(0),
+                          m_uAvailableIdx(0), m_uPendingIndex(0), m_bShutdown(false)
+    {
+        memset(&m_stStats, 0, sizeof(m_stStats));
+    }
+
+    ~CNvConcurrentQueue()
+    {
+        delete[] m_pBuffer;
+    }
+
+    bool Initialize(T *pItems, unsigned int uSize)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        delete[] m_pBuffer;
+        m_uSize = uSize;
+        m_uInFlightCount = 0;
+        m_uPendingCount = 0;
+        m_uAvailableIdx = 0;
+        m_uPendingIndex = 0;
+        m_bShutdown = false;
+        m_pBuffer = new T *[m_uSize];
+        for (unsigned int i = 0; i < m_uSize; i++)
+        {
+            m_pBuffer[i] = &pItems[i];
+        }
+        return true;
+    }
+
+    T * GetAvailable()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (m_uInFlightCount == m_uSize && !m_bShutdown)
+        {
+            std::chrono::steady_clock::time_point tStart = std::chrono::steady_clock::now();
+            m_cvAvailable.wait(lock, [this] { return m_uInFlightCount < m_uSize || m_bShutdown; });
+            m_stStats.nAvailableWaits += 1;
+            m_stStats.nAvailableWaitUs += ElapsedUs(tStart);
+        }
+
+        if (m_bShutdown)
+        {
+            return NULL;
+        }
+
+        T *pItem = m_pBuffer[m_uAvailableIdx];
+        m_uAvailableIdx = (m_uAvailableIdx+1)%m_uSize;
+        m_uInFlightCount += 1;
+        return pItem;
+    }
+
+    // Items must be pushed in the order GetAvailable() returned them.
+    void PushPending(T *pItem)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            assert(m_pBuffer[(m_uPendingIndex + m_uPendingCount) % m_uSize] == pItem);
+            m_uPendingCount += 1;
+            m_stStats.nSubmitted += 1;
+            m_stStats.nOccupancySum += m_uInFlightCount;
+            if (m_uInFlightCount > m_stStats.uMaxOccupancy)
+            {
+                m_stStats.uMaxOccupancy = m_uInFlightCount;
+            }
+        }
+        m_cvPending.notify_one();
+    }
+
+    T* GetPending()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (m_uPendingCount == 0 && !m_bShutdown)
+        {
+            std::chrono::steady_clock::time_point tStart = std::chrono::steady_clock::now();
+            m_cvPending.wait(lock, [this] { return m_uPendingCount > 0 || m_bShutdown; });
+            m_stStats.nPendingWaits += 1;
+            m_stStats.nPendingWaitUs += ElapsedUs(tStart);
+        }
+
+        if (m_uPendingCount == 0)
+        {
+            return NULL;
+        }
+
+        T *pItem = m_pBuffer[m_uPendingIndex];
+        m_uPendingIndex = (m_uPendingIndex+1)%m_uSize;
+        m_uPendingCount -= 1;
+        return pItem;
+    }
+
+    // Returns the oldest item taken by GetPending() to the available side.
+    void ReleasePending(T *pItem)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            assert(m_uInFlightCount > m_uPendingCount);
+            assert(m_pBuffer[(m_uAvailableIdx + m_uSize - m_uInFlightCount) % m_uSize] == pItem);
+            m_uInFlightCount -= 1;
+        }
+        m_cvAvailable.notify_one();
+    }
+
+    void Shutdown()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_bShutdown = true;
+        }
+        m_cvAvailable.notify_all();
+        m_cvPending.notify_all();
+    }
+
+    void GetStats(NvQueueStats *pStats)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        *pStats = m_stStats;
+    }
+};
+
 #endif // FRAMEQUEUE_H
@@ -0,0 +1,238 @@
+/*
+ * Copyright 1993-2015 NVIDIA Corporation.  All rights reserved.
+ *
+ * Please refer to the NVIDIA end user license agreement (EULA) associated
+ * with this source code for terms and conditions that govern your use of
+ * this software. Any use, reproduction, disclosure, or distribution of
+ * this software and related documentation outside the terms of the EULA
+ * is strictly prohibited.
+ *
+ */
+
+#include "NvAudioQueue.h"
+
+#include <string.h>
+#include <algorithm>
+
+// a header is found and checked with this many bytes
+#define AUDIO_HEADER_BYTES  8
+
+// kbit/s by bitrate_index 1..14 for MPEG-1 layers I, II, III and MPEG-2
+// layer I, layers II and III (ISO/IEC 11172-3 2.4.2.3, 13818-3 2.4.2.3)
+static const unsigned short s_mpegBitrates[5][14] = {
+    { 32, 64, 96, 128, 160, 192, 224, 256, 288, 320, 352, 384, 416, 448 },
+    { 32, 48, 56,  64,  80,  96, 112, 128, 160, 192, 224, 256, 320, 384 },
+    { 32, 40, 48,  56,  64,  80,  96, 112, 128, 160, 192, 224, 256, 320 },
+    { 32, 48, 56,  64,  80,  96, 112, 128, 144, 160, 176, 192, 224, 256 },
+    {  8, 16, 24,  32,  40,  48,  56,  64,  80,  96, 112, 128, 144, 160 },
+};
+
+// kbit/s by frmsizecod / 2 (ATSC A/52 Table 5.18)
+static const unsigned short s_ac3Bitrates[19] = {
+    32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384, 448, 512, 576, 640
+};
+
+static size_t ParseMpegHeader(const unsigned char *p, NvAudioFormat *pFormat)
+{
+    unsigned int uVersion = (p[1] >> 3) & 3;    // 3 = MPEG-1, 2 = MPEG-2, 0 = MPEG-2.5
+    unsigned int uLayer = 4 - ((p[1] >> 1) & 3);
+    unsigned int uBitrateIndex = p[2] >> 4;
+    unsigned int uRateIndex = (p[2] >> 2) & 3;
+    if (uVersion == 1 || uLayer == 4 || uBitrateIndex == 0 || uBitrateIndex == 15 || uRateIndex == 3)
+        return 0;
+
+    static const unsigned int rates[3] = { 44100, 48000, 32000 };
+    bool bMpeg1 = uVersion == 3;
+    unsigned int uTable = bMpeg1 ? uLayer - 1 : (uLayer == 1 ? 3 : 4);
+
+    memset(pFormat, 0, sizeof(*pFormat));
+    pFormat->eCodec        = NV_AUDIO_CODEC_MPEG;
+    pFormat->uSampleRate   = rates[uRateIndex] >> (bMpeg1 ? 0 : (uVersion == 2 ? 1 : 2));
+    pFormat->uChannels     = ((p[3] >> 6) == 3) ? 1 : 2;
+    pFormat->uFrameSamples = (uLayer == 1) ? 384 : ((uLayer == 3 && !bMpeg1) ? 576 : 1152);
+    pFormat->uBitrate      = s_mpegBitrates[uTable][uBitrateIndex - 1] * 1000;
+    pFormat->uMpegVersion  = bMpeg1 ? 1 : 2;
+    pFormat->uLayer        = uLayer;
+
+    unsigned int uPadding = (p[2] >> 1) & 1;
+    if (uLayer == 1)
+        return (12 * pFormat->uBitrate / pFormat->uSampleRate + uPadding) * 4;
+    return pFormat->uFrameSamples / 8 * pFormat->uBitrate / pFormat->uSampleRate + uPadding;
+}
+
+static size_t ParseAc3Header(const unsigned char *p, NvAudioFormat *pFormat)
+{
+    unsigned int uFscod = p[4] >> 6;
+    unsigned int uFrmsizecod = p[4] & 0x3f;
+    unsigned int uBsid = p[5] >> 3;
+    if (uFscod == 3 || uFrmsizecod >= 38 || uBsid > 8)
+        return 0;
+
+    static const unsigned int rates[3] = { 48000, 44100, 32000 };
+    unsigned int uBitrate = s_ac3Bitrates[uFrmsizecod >> 1];
+
+    // acmod, then the mix levels it implies, then lfeon
+    unsigned int uAcmod = p[6] >> 5;
+    unsigned int uBit = 3;
+    if ((uAcmod & 1) && uAcmod != 1)
+        uBit += 2;
+    if (uAcmod & 4)
+        uBit += 2;
+    if (uAcmod == 2)
+        uBit += 2;
+    unsigned int uLfeon = ((p[6 + uBit / 8] << (uBit % 8)) >> 7) & 1;
+
+    static const unsigned int channels[8] = { 2, 1, 2, 3, 3, 4, 4, 5 };
+    memset(pFormat, 0, sizeof(*pFormat));
+    pFormat->eCodec        = NV_AUDIO_CODEC_AC3;
+    pFormat->uSampleRate   = rates[uFscod];
+    pFormat->uChannels     = channels[uAcmod] + uLfeon;
+    pFormat->uFrameSamples = 1536;
+    pFormat->uBitrate      = uBitrate * 1000;
+
+    unsigned int uBsmod = p[5] & 7;
+    unsigned int uBitRateCode = uFrmsizecod >> 1;
+    pFormat->auDac3[0] = (unsigned char)((uFscod << 6) | (uBsid << 1) | (uBsmod >> 2));
+    pFormat->auDac3[1] = (unsigned char)(((uBsmod & 3) << 6) | (uAcmod << 3) | (uLfeon << 2) | (uBitRateCode >> 3));
+    pFormat->auDac3[2] = (unsigned char)((uBitRateCode & 7) << 5);
+
+    // 16-bit words per frame; at 44.1 kHz the odd codes carry one more
+    size_t nWords = (uFscod == 0) ? 2 * uBitrate
+                  : (uFscod == 2) ? 3 * uBitrate
+                  : uBitrate * 1536000 / 705600 + (uFrmsizecod & 1);
+    return nWords * 2;
+}
+
+size_t nvAudioParseHeader(const unsigned char *p, size_t nBytes, NvAudioFormat *pFormat)
+{
+    if (nBytes < AUDIO_HEADER_BYTES)
+        return 0;
+    if (p[0] == 0xff && (p[1] & 0xe0) == 0xe0)
+        return ParseMpegHeader(p, pFormat);
+    if (p[0] == 0x0b && p[1] == 0x77)
+        return ParseAc3Header(p, pFormat);
+    return 0;
+}
+
+// the same stream as the first frame
+static bool SameStream(const NvAudioFormat &a, const NvAudioFormat &b)
+{
+    return a.eCodec == b.eCodec && a.uSampleRate == b.uSampleRate && a.uLayer == b.uLayer;
+}
+
+CNvAudioQueue::CNvAudioQueue(size_t nMaxBytes): m_nMaxBytes(nMaxBytes), m_nRead(0), m_nBase(0), m_bFormat(false),
+                                                m_bTimed(false), m_nLastStamp(0), m_nSinceStamp(0)
+{
+    memset(&m_oFormat, 0, sizeof(m_oFormat));
+    memset(&m_stStats, 0, sizeof(m_stStats));
+}
+
+void CNvAudioQueue::Push(const void *pData, size_t nBytes, bool bTimestamp, long long nTimestamp)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stStats.nPackets++;
+    m_stStats.nBytes += nBytes;
+
+    // the oldest audio goes first; Pop() finds the next frame after the gap
+    size_t nWaiting = m_vBytes.size() - m_nRead;
+    if (nWaiting + nBytes > m_nMaxBytes)
+    {
+        size_t nDrop = std::min(nWaiting, nWaiting + nBytes - m_nMaxBytes);
+        m_nRead += nDrop;
+        m_stStats.nOverflowBytes += nDrop;
+    }
+
+    // keep the buffer from growing: move the waiting bytes to the front
+    // once more than half of it has been read
+    if (m_nRead > m_vBytes.size() / 2)
+    {
+        m_vBytes.erase(m_vBytes.begin(), m_vBytes.begin() + m_nRead);
+        m_nBase += m_nRead;
+        m_nRead = 0;
+    }
+
+    if (bTimestamp)
+    {
+        m_vStamps.push_back(std::make_pair(m_nBase + m_vBytes.size(), nTimestamp));
+    }
+    m_vBytes.insert(m_vBytes.end(), (const unsigned char *)pData, (const unsigned char *)pData + nBytes);
+}
+
+bool CNvAudioQueue::Pop(NvAudioFrame *pFrame)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    for (;;)
+    {
+        const unsigned char *p = m_vBytes.empty() ? NULL : &m_vBytes[m_nRead];
+        size_t nWaiting = m_vBytes.size() - m_nRead;
+        if (nWaiting < AUDIO_HEADER_BYTES)
+            return false;
+
+        NvAudioFormat oFormat;
+        size_t nFrame = nvAudioParseHeader(p, nWaiting, &oFormat);
+        bool bFrame = nFrame && (!m_bFormat || SameStream(oFormat, m_oFormat));
+
+        // the first frame has to be followed by another like it, or a
+        // sync word in the middle of something else would fix the format
+        if (bFrame && !m_bFormat)
+        {
+            if (nWaiting < nFrame + AUDIO_HEADER_BYTES)
+                return false;
+            NvAudioFormat oNext;
+            bFrame = nvAudioParseHeader(p + nFrame, nWaiting - nFrame, &oNext) && SameStream(oFormat, oNext);
+        }
+        if (!bFrame)
+        {
+            m_nRead++;
+            m_stStats.nSkippedBytes++;
+            continue;
+        }
+        if (nWaiting < nFrame)
+            return false;
+
+        // the last chunk that began at or before the frame
+        unsigned long long nOffset = m_nBase + m_nRead;
+        bool bStamp = false;
+        while (!m_vStamps.empty() && m_vStamps.front().first <= nOffset)
+        {
+            m_nLastStamp = m_vStamps.front().second;
+            m_vStamps.pop_front();
+            bStamp = true;
+        }
+        if (bStamp)
+        {
+            m_bTimed = true;
+            m_nSinceStamp = 0;
+        }
+
+        if (!m_bFormat)
+        {
+            m_oFormat = oFormat;
+            m_bFormat = true;
+        }
+
+        pFrame->vData.assign(p, p + nFrame);
+        pFrame->nTimestamp = m_bTimed ? m_nLastStamp + (long long)(m_nSinceStamp * m_oFormat.uFrameSamples *
+                                                                   NV_AUDIO_CLOCK_RATE / m_oFormat.uSampleRate)
+                                      : (long long)(m_stStats.nFrames * m_oFormat.uFrameSamples *
+                                                    NV_AUDIO_CLOCK_RATE / m_oFormat.uSampleRate);
+        m_nSinceStamp++;
+        m_nRead += nFrame;
+        m_stStats.nFrames++;
+        return true;
+    }
+}
+
+bool CNvAudioQueue::GetFormat(NvAudioFormat *pFormat)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    *pFormat = m_oFormat;
+    return m_bFormat;
+}
+
+void CNvAudioQueue::GetStats(NvAudioQueueStats *pStats)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    *pStats = m_stStats;
+}
@@ -0,0 +1,117 @@
+/*
+ * Copyright 1993-2015 NVIDIA Corporation.  All rights reserved.
+ *
+ * Please refer to the NVIDIA end user license agreement (EULA) associated
+ * with this source code for terms and conditions that govern your use of
+ * this software. Any use, reproduction, disclosure, or distribution of
+ * this software and related documentation outside the terms of the EULA
+ * is strictly prohibited.
+ *
+ */
+
+#ifndef NV_AUDIO_QUEUE_H
+#define NV_AUDIO_QUEUE_H
+
+#include <stddef.h>
+#include <deque>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+// Clock of the packet timestamps: nvcuvid's default source clock, which
+// stamps the decoded pictures (CUVIDPARSERDISPINFO::timestamp) as well.
+#define NV_AUDIO_CLOCK_RATE         10000000
+
+// Audio waiting for the muxer; past this the oldest bytes are dropped,
+// so a stalled consumer can't hold up the demuxer. Minutes of MP3 or AC-3.
+#define NV_AUDIO_QUEUE_MAX_BYTES    (16 << 20)
+
+// what nvcuvid demuxes and MP4 can carry unchanged
+enum NvAudioCodec
+{
+    NV_AUDIO_CODEC_NONE = 0,
+    NV_AUDIO_CODEC_MPEG,            // MPEG-1/2 audio layer I, II or III (MP3)
+    NV_AUDIO_CODEC_AC3,
+};
+
+// Format of one frame, from its header
+struct NvAudioFormat
+{
+    NvAudioCodec    eCodec;
+    unsigned int    uSampleRate;
+    unsigned int    uChannels;          // AC-3: including the LFE channel
+    unsigned int    uFrameSamples;      // per channel
+    unsigned int    uBitrate;           // bits per second
+    unsigned int    uMpegVersion;       // 1, or 2 for MPEG-2 and 2.5 (half and quarter rates)
+    unsigned int    uLayer;             // 1..3
+    unsigned char   auDac3[3];          // AC-3: fscod .. bit_rate_code as the dac3 box stores them
+};
+
+struct NvAudioFrame
+{
+    std::vector<unsigned char> vData;   // the frame as it was in the stream, header included
+    long long                  nTimestamp;
+};
+
+struct NvAudioQueueStats
+{
+    unsigned long long nPackets;        // handed to Push()
+    unsigned long long nBytes;
+    unsigned long long nFrames;         // returned by Pop()
+    unsigned long long nSkippedBytes;   // between frames: garbage, or a format change
+    unsigned long long nOverflowBytes;  // dropped because nobody took them
+};
+
+// Length of the frame whose header is at p, filling *pFormat, or 0 if
+// there is no MPEG audio or AC-3 frame header there. Free-format MPEG
+// audio and E-AC-3 aren't recognised.
+size_t nvAudioParseHeader(const unsigned char *p, size_t nBytes, NvAudioFormat *pFormat);
+
+// Audio packets from the demuxer on their way to the muxer.
+//
+// Push() takes the elementary stream the way nvcuvid hands it to
+// pfnAudioDataHandler: chunks of any size, with a timestamp for some of
+// them. Pop() returns it again as whole frames, the unit an MP4 sample
+// holds, each with its timestamp. As in a PES packet, a chunk's timestamp
+// belongs to the first frame that starts in it; frames without one are
+// timed from the frame before. The first frame fixes the codec and sample
+// rate and anything not matching them later is skipped, which also keeps
+// a stray sync word in the data from passing for a frame.
+//
+// One producer thread (the demuxer) and one consumer thread (the encoder
+// output thread); Push() never blocks.
+class CNvAudioQueue
+{
+public:
+    explicit CNvAudioQueue(size_t nMaxBytes = NV_AUDIO_QUEUE_MAX_BYTES);
+
+    void Push(const void *pData, size_t nBytes, bool bTimestamp, long long nTimestamp);
+
+    // The next whole frame, or false if there isn't one yet.
+    bool Pop(NvAudioFrame *pFrame);
+
+    // Format of the first frame; false before Pop() has found one.
+    bool GetFormat(NvAudioFormat *pFormat);
+
+    void GetStats(NvAudioQueueStats *pStats);
+
+private:
+    // non-copyable
+    CNvAudioQueue(const CNvAudioQueue &);
+    CNvAudioQueue &operator=(const CNvAudioQueue &);
+
+    std::mutex                   m_mutex;
+    size_t                       m_nMaxBytes;
+    std::vector<unsigned char>   m_vBytes;          // m_nRead.. are waiting
+    size_t                       m_nRead;
+    unsigned long long           m_nBase;           // stream offset of m_vBytes[0]
+    std::deque<std::pair<unsigned long long, long long> > m_vStamps;   // (stream offset, timestamp) of the chunks
+    bool                         m_bFormat;
+    NvAudioFormat                m_oFormat;
+    bool                         m_bTimed;          // m_nLastStamp is valid
+    long long                    m_nLastStamp;      // of the last frame that came with one
+    unsigned long long           m_nSinceStamp;     // frames since then
+    NvAudioQueueStats            m_stStats;
+};
+
+#endif // NV_AUDIO_QUEUE_H
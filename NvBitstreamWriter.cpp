@@ -0,0 +1,253 @@
+/*
+ * Copyright 1993-2015 NVIDIA Corporation.  All rights reserved.
+ *
+ * Please refer to the NVIDIA end user license agreement (EULA) associated
+ * with this source code for terms and conditions that govern your use of
+ * this software. Any use, reproduction, disclosure, or distribution of
+ * this software and related documentation outside the terms of the EULA
+ * is strictly prohibited.
+ *
+ */
+
+#include "NvBitstreamWriter.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+static unsigned long long ElapsedUs(std::chrono::steady_clock::time_point tStart)
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - tStart).count();
+}
+
+CNvBitstreamWriter::CNvBitstreamWriter(): m_fd(-1), m_pChunks(NULL), m_nChunkBytes(0), m_uChunks(0),
+                                          m_uHead(0), m_uQueued(0), m_bQuit(false), m_bError(false)
+{
+    memset(&m_stStats, 0, sizeof(m_stStats));
+}
+
+CNvBitstreamWriter::~CNvBitstreamWriter()
+{
+    Close();
+}
+
+bool CNvBitstreamWriter::Open(const char *szPath, size_t nChunkBytes, unsigned int uChunks)
+{
+    Close();
+
+    size_t nPage = (size_t)sysconf(_SC_PAGESIZE);
+    if (!uChunks || !nChunkBytes)
+    {
+        return false;
+    }
+    nChunkBytes = (nChunkBytes + nPage - 1) / nPage * nPage;
+
+    if (posix_memalign((void **)&m_pChunks, nPage, nChunkBytes * uChunks))
+    {
+        m_pChunks = NULL;
+        return false;
+    }
+
+    m_fd = open(szPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (m_fd < 0)
+    {
+        printf("CNvBitstreamWriter: cannot open %s: %s\n", szPath, strerror(errno));
+        free(m_pChunks);
+        m_pChunks = NULL;
+        return false;
+    }
+
+    m_nChunkBytes = nChunkBytes;
+    m_uChunks = uChunks;
+    m_vFill.assign(uChunks, 0);
+    m_uHead = 0;
+    m_uQueued = 0;
+    m_bQuit = false;
+    m_bError = false;
+
+    m_thread = std::thread(&CNvBitstreamWriter::WriterThread, this);
+    return true;
+}
+
+// with m_mutex held
+void CNvBitstreamWriter::QueueCurrent()
+{
+    m_uQueued++;
+    m_stStats.nHandoffs++;
+    m_stStats.nQueuedSum += m_uQueued;
+    m_stStats.uMaxQueued = std::max(m_stStats.uMaxQueued, m_uQueued);
+    m_cvQueued.notify_one();
+}
+
+bool CNvBitstreamWriter::Write(const void *pData, size_t nBytes)
+{
+    const unsigned char *pSrc = (const unsigned char *)pData;
+
+    assert(IsOpen());
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_stStats.nBytes += nBytes;
+
+    while (nBytes && !m_bError)
+    {
+        // every chunk queued, including the one we would fill next
+        if (m_uQueued == m_uChunks)
+        {
+            std::chrono::steady_clock::time_point tStart = std::chrono::steady_clock::now();
+            m_cvWritten.wait(lock, [this] { return m_uQueued < m_uChunks; });
+            m_stStats.nBlocked++;
+            m_stStats.nBlockedUs += ElapsedUs(tStart);
+        }
+
+        // The current chunk belongs to this thread alone, so the copy runs
+        // without the lock and the writer can finish a batch meanwhile.
+        unsigned int uCurrent = (m_uHead + m_uQueued) % m_uChunks;
+        size_t nFill = m_vFill[uCurrent];
+        size_t nCopy = std::min(nBytes, m_nChunkBytes - nFill);
+        lock.unlock();
+
+        memcpy(m_pChunks + uCurrent * m_nChunkBytes + nFill, pSrc, nCopy);
+
+        lock.lock();
+        m_vFill[uCurrent] = nFill + nCopy;
+        if (nFill + nCopy == m_nChunkBytes)
+        {
+            QueueCurrent();
+        }
+        pSrc += nCopy;
+        nBytes -= nCopy;
+    }
+    return !m_bError;
+}
+
+bool CNvBitstreamWriter::Flush()
+{
+    if (!IsOpen())
+        return false;
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (m_uQueued < m_uChunks && m_vFill[(m_uHead + m_uQueued) % m_uChunks])
+    {
+        QueueCurrent();
+    }
+    m_cvWritten.wait(lock, [this] { return m_uQueued == 0; });
+    return !m_bError;
+}
+
+bool CNvBitstreamWriter::Close()
+{
+    if (!IsOpen())
+        return true;
+
+    bool bOk = Flush();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_bQuit = true;
+    }
+    m_cvQueued.notify_one();
+    m_thread.join();
+
+    if (close(m_fd) != 0)
+    {
+        bOk = false;
+    }
+    m_fd = -1;
+    free(m_pChunks);
+    m_pChunks = NULL;
+    return bOk;
+}
+
+void CNvBitstreamWriter::GetStats(NvBitstreamWriterStats *pStats)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    *pStats = m_stStats;
+}
+
+void CNvBitstreamWriter::WriterThread()
+{
+    std::vector<struct iovec> vIov;
+
+    for (;;)
+    {
+        unsigned int uHead, uCount;
+        bool bFailed;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cvQueued.wait(lock, [this] { return m_uQueued != 0 || m_bQuit; });
+            if (m_uQueued == 0)
+                return;
+
+            // everything queued so far goes out in one call
+            uHead   = m_uHead;
+            uCount  = std::min(m_uQueued, (unsigned int)IOV_MAX);
+            bFailed = m_bError;     // past a failed write the rest is dropped
+        }
+
+        vIov.resize(uCount);
+        size_t nTotal = 0;
+        for (unsigned int i = 0; i < uCount; i++)
+        {
+            unsigned int uChunk = (uHead + i) % m_uChunks;
+            vIov[i].iov_base = m_pChunks + uChunk * m_nChunkBytes;
+            vIov[i].iov_len  = m_vFill[uChunk];
+            nTotal += m_vFill[uChunk];
+        }
+
+        // writev() may stop short (pipes, signals); resume where it did
+        std::chrono::steady_clock::time_point tStart = std::chrono::steady_clock::now();
+        unsigned long long nCalls = 0;
+        struct iovec *pIov = &vIov[0];
+        int nIov = (int)uCount;
+        while (nTotal && !bFailed)
+        {
+            ssize_t nWritten = writev(m_fd, pIov, nIov);
+            nCalls++;
+            if (nWritten < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                printf("CNvBitstreamWriter: write failed: %s\n", strerror(errno));
+                bFailed = true;
+                break;
+            }
+            nTotal -= nWritten;
+            while (nIov && (size_t)nWritten >= pIov->iov_len)
+            {
+                nWritten -= pIov->iov_len;
+                pIov++;
+                nIov--;
+            }
+            if (nIov)
+            {
+                pIov->iov_base = (unsigned char *)pIov->iov_base + nWritten;
+                pIov->iov_len -= nWritten;
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for (unsigned int i = 0; i < uCount; i++)
+            {
+                m_vFill[(uHead + i) % m_uChunks] = 0;
+            }
+            m_uHead = (uHead + uCount) % m_uChunks;
+            m_uQueued -= uCount;
+            m_bError = m_bError || bFailed;
+            m_stStats.nWrites += nCalls;
+            m_stStats.nChunks += uCount;
+            m_stStats.nWriteUs += ElapsedUs(tStart);
+        }
+        m_cvWritten.notify_all();
+    }
+}
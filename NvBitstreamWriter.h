@@ -0,0 +1,106 @@
+/*
+ * Copyright 1993-2015 NVIDIA Corporation.  All rights reserved.
+ *
+ * Please refer to the NVIDIA end user license agreement (EULA) associated
+ * with this source code for terms and conditions that govern your use of
+ * this software. Any use, reproduction, disclosure, or distribution of
+ * this software and related documentation outside the terms of the EULA
+ * is strictly prohibited.
+ *
+ */
+
+#ifndef NV_BITSTREAM_WRITER_H
+#define NV_BITSTREAM_WRITER_H
+
+#include <stddef.h>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// ring of 8 x 1 MB: a couple of seconds of 5 Mbit/s video before Write() waits
+#define NV_BITSTREAM_CHUNK_BYTES    (1 << 20)
+#define NV_BITSTREAM_CHUNK_COUNT    8
+
+struct NvBitstreamWriterStats
+{
+    unsigned long long nBytes;          // handed to Write()
+    unsigned long long nWrites;         // writev() calls
+    unsigned long long nChunks;         // chunks written, full or flushed
+    unsigned long long nWriteUs;        // writer thread time inside writev()
+    unsigned long long nHandoffs;       // chunks queued for the writer
+    unsigned long long nQueuedSum;      // queue depth after each handoff, for the average
+    unsigned int       uMaxQueued;      // most chunks queued at once
+    unsigned long long nBlocked;        // Write() calls that waited for a free chunk
+    unsigned long long nBlockedUs;
+};
+
+// Output file written from a dedicated thread, so a slow disk holds up the
+// encoder only once the whole ring is full.
+//
+// Write() copies into the current chunk of a fixed ring and returns; a full
+// chunk is queued and the writer thread sends everything queued to the file
+// in one writev(), so the file sees a few large writes instead of one
+// small fwrite() per frame. Chunks are page-aligned and a multiple of the
+// page size, so every write but the final partial one covers whole pages.
+//
+// Single producer: Write(), Flush() and Close() must all come from one
+// thread, or be serialized by the caller. Write() copies into the current
+// chunk with the lock released, which is only safe while no other thread
+// can fill or queue that chunk; the writer thread never touches a chunk
+// before it is queued.
+class CNvBitstreamWriter
+{
+public:
+    CNvBitstreamWriter();
+    ~CNvBitstreamWriter();
+
+    // Creates or truncates szPath and starts the writer thread. The writer
+    // may be reopened on another file after Close(); its stats add up over
+    // all of them.
+    bool Open(const char *szPath, size_t nChunkBytes = NV_BITSTREAM_CHUNK_BYTES,
+              unsigned int uChunks = NV_BITSTREAM_CHUNK_COUNT);
+
+    bool IsOpen() const
+    {
+        return m_fd >= 0;
+    }
+
+    // False once a write to the file has failed; the data is dropped.
+    // Producer thread only, see above.
+    bool Write(const void *pData, size_t nBytes);
+
+    // Queues the partly filled chunk and waits until the file has it all.
+    bool Flush();
+
+    // Flush(), then stops the thread and closes the file. False if any
+    // write failed.
+    bool Close();
+
+    void GetStats(NvBitstreamWriterStats *pStats);
+
+private:
+    void QueueCurrent();
+    void WriterThread();
+
+    // non-copyable
+    CNvBitstreamWriter(const CNvBitstreamWriter &);
+    CNvBitstreamWriter &operator=(const CNvBitstreamWriter &);
+
+    int                        m_fd;
+    unsigned char             *m_pChunks;
+    size_t                     m_nChunkBytes;
+    unsigned int               m_uChunks;
+    std::vector<size_t>        m_vFill;         // bytes in each chunk
+    unsigned int               m_uHead;         // oldest chunk not on disk yet
+    unsigned int               m_uQueued;       // chunks from m_uHead on that the writer owns
+    bool                       m_bQuit;
+    bool                       m_bError;
+    std::mutex                 m_mutex;
+    std::condition_variable    m_cvQueued;
+    std::condition_variable    m_cvWritten;
+    std::thread                m_thread;
+    NvBitstreamWriterStats     m_stStats;
+};
+
+#endif // NV_BITSTREAM_WRITER_H
@@ -0,0 +1,391 @@
+/*
+ * Copyright 1993-2015 NVIDIA Corporation.  All rights reserved.
+ *
+ * Please refer to the NVIDIA end user license agreement (EULA) associated
+ * with this source code for terms and conditions that govern your use of
+ * this software. Any use, reproduction, disclosure, or distribution of
+ * this software and related documentation outside the terms of the EULA
+ * is strictly prohibited.
+ *
+ */
+
+#include "NvCmafSegmenter.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+
+bool nvCmafIsPlaylistPath(const char *szPath)
+{
+    const char *szExt = szPath ? strrchr(szPath, '.') : NULL;
+    return szExt && (!strcasecmp(szExt, ".m3u8") || !strcasecmp(szExt, ".mpd"));
+}
+
+// ISO 8601 in UTC, as the MPD wants its times
+static std::string UtcTime(long long tSeconds)
+{
+    time_t t = (time_t)tSeconds;
+    struct tm stTime;
+    char szTime[32];
+    gmtime_r(&t, &stTime);
+    strftime(szTime, sizeof(szTime), "%Y-%m-%dT%H:%M:%SZ", &stTime);
+    return szTime;
+}
+
+// xs:duration of a tick count
+static std::string Duration(unsigned long long nTicks, unsigned int uTimescale)
+{
+    char szDuration[48];
+    snprintf(szDuration, sizeof(szDuration), "PT%.3fS", (double)nTicks / uTimescale);
+    return szDuration;
+}
+
+static std::string XmlEscape(const std::string &s)
+{
+    std::string sOut;
+    for (size_t i = 0; i < s.size(); i++)
+    {
+        switch (s[i])
+        {
+        case '&':  sOut += "&amp;";  break;
+        case '<':  sOut += "&lt;";   break;
+        case '>':  sOut += "&gt;";   break;
+        case '"':  sOut += "&quot;"; break;
+        default:   sOut += s[i];     break;
+        }
+    }
+    return sOut;
+}
+
+static unsigned long long Gcd(unsigned long long a, unsigned long long b)
+{
+    while (b)
+    {
+        unsigned long long r = a % b;
+        a = b;
+        b = r;
+    }
+    return a;
+}
+
+// Replaces szPath in one step: a reader opening it gets the old list or the
+// new one, never half of either.
+static bool WriteFileAtomic(const std::string &sPath, const std::string &sText)
+{
+    std::string sTemp = sPath + ".tmp";
+    FILE *fp = fopen(sTemp.c_str(), "wb");
+    if (!fp)
+    {
+        printf("CNvCmafSegmenter: cannot open %s: %s\n", sTemp.c_str(), strerror(errno));
+        return false;
+    }
+    bool bOk = fwrite(sText.data(), 1, sText.size(), fp) == sText.size();
+    bOk = (fclose(fp) == 0) && bOk;
+    if (!bOk || rename(sTemp.c_str(), sPath.c_str()) != 0)
+    {
+        printf("CNvCmafSegmenter: cannot write %s: %s\n", sPath.c_str(), strerror(errno));
+        unlink(sTemp.c_str());
+        return false;
+    }
+    return true;
+}
+
+CNvCmafSegmenter::CNvCmafSegmenter(): m_pOutput(NULL), m_pMuxer(NULL), m_tStart(0), m_bInSegment(false), m_nSegment(0),
+                                      m_nSegmentTime(0), m_nSegmentStartBytes(0), m_nMaxDuration(0), m_nMaxBitrate(0)
+{
+    memset(&m_oConfig, 0, sizeof(m_oConfig));
+    memset(&m_stStats, 0, sizeof(m_stStats));
+}
+
+bool CNvCmafSegmenter::Open(CNvBitstreamWriter *pOutput, const CNvMp4Muxer *pMuxer, const char *szPlaylist,
+                            const NvCmafSegmenterConfig &oConfig)
+{
+    if (!pOutput || !pMuxer || !pMuxer->Timescale() || !nvCmafIsPlaylistPath(szPlaylist))
+    {
+        return false;
+    }
+
+    std::string sPath(szPlaylist);
+    size_t nSlash = sPath.rfind('/');
+    m_sDir  = (nSlash == std::string::npos) ? std::string() : sPath.substr(0, nSlash + 1);
+    m_sName = sPath.substr(m_sDir.size(), sPath.rfind('.') - m_sDir.size());
+
+    // fail here rather than at the first frame
+    if (m_sName.empty() || access(m_sDir.empty() ? "." : m_sDir.c_str(), W_OK) != 0)
+    {
+        printf("CNvCmafSegmenter: cannot write segments for %s\n", szPlaylist);
+        return false;
+    }
+
+    m_pOutput = pOutput;
+    m_pMuxer = pMuxer;
+    m_oConfig = oConfig;
+    SetSegmentFrames(oConfig.uSegmentFrames);
+    m_sFile.clear();
+    m_bInSegment = false;
+    m_nSegment = 0;
+    m_vSegments.clear();
+    m_nMaxDuration = 0;
+    m_nMaxBitrate = 0;
+    memset(&m_stStats, 0, sizeof(m_stStats));
+    return true;
+}
+
+std::string CNvCmafSegmenter::SegmentName(unsigned long long nNumber) const
+{
+    char szNumber[32];
+    snprintf(szNumber, sizeof(szNumber), "_%05llu.m4s", nNumber);
+    return m_sName + szNumber;
+}
+
+bool CNvCmafSegmenter::OpenFile(const std::string &sName)
+{
+    m_sFile = m_sDir + sName;
+    return m_pOutput->Open((m_sFile + ".tmp").c_str());
+}
+
+bool CNvCmafSegmenter::CloseFile()
+{
+    std::string sTemp = m_sFile + ".tmp";
+    if (!m_pOutput->Close())
+    {
+        printf("CNvCmafSegmenter: writing %s failed\n", m_sFile.c_str());
+        return false;
+    }
+    if (rename(sTemp.c_str(), m_sFile.c_str()) != 0)
+    {
+        printf("CNvCmafSegmenter: cannot rename %s: %s\n", sTemp.c_str(), strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+bool CNvCmafSegmenter::OnInitSegment()
+{
+    m_tStart = (long long)time(NULL);
+    return OpenFile(m_sName + "_init.mp4");
+}
+
+bool CNvCmafSegmenter::OnFragmentStart(unsigned long long nTime, bool bKeyframe)
+{
+    // the first fragment completes the init segment
+    if (!m_bInSegment)
+    {
+        m_bInSegment = true;
+        return CloseFile() && StartSegment(nTime);
+    }
+
+    // the rest of this segment, unless the encoder put the IDR here
+    unsigned long long nTicks = (unsigned long long)m_oConfig.uSegmentFrames * m_pMuxer->FrameDuration();
+    if (!bKeyframe || nTime - m_nSegmentTime < nTicks)
+        return true;
+
+    std::chrono::steady_clock::time_point tStart = std::chrono::steady_clock::now();
+    bool bOk = FinishSegment(nTime, false) && StartSegment(nTime);
+    unsigned long long nUs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - tStart).count();
+    m_stStats.nSwitchUs += nUs;
+    m_stStats.nMaxSwitchUs = std::max(m_stStats.nMaxSwitchUs, nUs);
+    return bOk;
+}
+
+bool CNvCmafSegmenter::OnEnd(unsigned long long nEndTime)
+{
+    return m_bInSegment && FinishSegment(nEndTime, true);
+}
+
+bool CNvCmafSegmenter::StartSegment(unsigned long long nTime)
+{
+    m_nSegment++;
+    m_nSegmentTime = nTime;
+    if (!OpenFile(SegmentName(m_nSegment)))
+        return false;
+
+    NvBitstreamWriterStats oWriterStats;
+    m_pOutput->GetStats(&oWriterStats);
+    m_nSegmentStartBytes = oWriterStats.nBytes;
+
+    // styp: a CMAF segment that is also a DASH media segment; with audio
+    // muxed in, two tracks, only the latter
+    static const unsigned char styp[] = { 0, 0, 0, 24, 's', 't', 'y', 'p', 'c', 'm', 'f', 's', 0, 0, 0, 0,
+                                          'c', 'm', 'f', 's', 'm', 's', 'd', 'h' };
+    static const unsigned char stypMuxed[] = { 0, 0, 0, 20, 's', 't', 'y', 'p', 'm', 's', 'd', 'h', 0, 0, 0, 0,
+                                               'm', 's', 'd', 'h' };
+    if (m_pMuxer->HasAudio())
+        return m_pOutput->Write(stypMuxed, sizeof(stypMuxed));
+    return m_pOutput->Write(styp, sizeof(styp));
+}
+
+bool CNvCmafSegmenter::FinishSegment(unsigned long long nEndTime, bool bLast)
+{
+    NvBitstreamWriterStats oWriterStats;
+    m_pOutput->GetStats(&oWriterStats);
+
+    Segment stSegment;
+    stSegment.nNumber   = m_nSegment;
+    stSegment.nTime     = m_nSegmentTime;
+    stSegment.nDuration = nEndTime - m_nSegmentTime;
+    stSegment.nBytes    = oWriterStats.nBytes - m_nSegmentStartBytes;
+
+    // the segment goes on disk under its name before any list names it
+    if (!CloseFile())
+        return false;
+
+    m_vSegments.push_back(stSegment);
+    m_stStats.nSegments++;
+    m_stStats.nMaxSegmentBytes = std::max(m_stStats.nMaxSegmentBytes, stSegment.nBytes);
+    m_nMaxDuration = std::max(m_nMaxDuration, stSegment.nDuration);
+    if (stSegment.nDuration)
+    {
+        m_nMaxBitrate = std::max(m_nMaxBitrate, stSegment.nBytes * 8 * m_pMuxer->Timescale() / stSegment.nDuration);
+    }
+
+    if (!WritePlaylists(bLast))
+        return false;
+
+    // no list names these any more, and the previous lists are a window old
+    while (m_oConfig.uWindow && m_vSegments.size() > 2 * (size_t)m_oConfig.uWindow)
+    {
+        unlink((m_sDir + SegmentName(m_vSegments.front().nNumber)).c_str());
+        m_vSegments.pop_front();
+        m_stStats.nRemoved++;
+    }
+    return true;
+}
+
+bool CNvCmafSegmenter::WritePlaylists(bool bLast)
+{
+    m_stStats.nPlaylistUpdates++;
+    bool bHls = WriteFileAtomic(m_sDir + m_sName + ".m3u8", HlsPlaylist(bLast));
+    bool bDash = WriteFileAtomic(m_sDir + m_sName + ".mpd", DashManifest(bLast));
+    return bHls && bDash;
+}
+
+// RFC 8216 media playlist; EXT-X-MAP of an fMP4 init segment wants
+// version 6 or later
+std::string CNvCmafSegmenter::HlsPlaylist(bool bLast) const
+{
+    unsigned int uTimescale = m_pMuxer->Timescale();
+    size_t nFirst = (m_oConfig.uWindow && m_vSegments.size() > m_oConfig.uWindow) ? m_vSegments.size() - m_oConfig.uWindow : 0;
+
+    // EXTINF rounded to the nearest second must not exceed the target;
+    // with the IDRs where they belong no segment is longer than the others
+    unsigned long long nTarget = (unsigned long long)m_oConfig.uSegmentFrames * m_pMuxer->FrameDuration();
+    nTarget = (std::max(nTarget, m_nMaxDuration) + uTimescale / 2) / uTimescale;
+
+    char szLine[256];
+    std::string s = "#EXTM3U\n#EXT-X-VERSION:7\n";
+    snprintf(szLine, sizeof(szLine), "#EXT-X-TARGETDURATION:%llu\n#EXT-X-MEDIA-SEQUENCE:%llu\n",
+             std::max(nTarget, 1ull), m_vSegments.empty() ? 1ull : m_vSegments[nFirst].nNumber);
+    s += szLine;
+    if (!m_oConfig.uWindow)
+    {
+        s += bLast ? "#EXT-X-PLAYLIST-TYPE:VOD\n" : "#EXT-X-PLAYLIST-TYPE:EVENT\n";
+    }
+    s += "#EXT-X-INDEPENDENT-SEGMENTS\n";
+    s += "#EXT-X-MAP:URI=\"" + m_sName + "_init.mp4\"\n";
+    for (size_t i = nFirst; i < m_vSegments.size(); i++)
+    {
+        snprintf(szLine, sizeof(szLine), "#EXTINF:%.3f,\n", (double)m_vSegments[i].nDuration / uTimescale);
+        s += szLine;
+        s += SegmentName(m_vSegments[i].nNumber) + "\n";
+    }
+    if (bLast)
+    {
+        s += "#EXT-X-ENDLIST\n";
+    }
+    return s;
+}
+
+// ISO/IEC 23009-1 live profile. While live the MPD is dynamic and players
+// reload it every segment; the last one is static, or for a sliding window
+// stays dynamic with a duration and no further updates.
+std::string CNvCmafSegmenter::DashManifest(bool bLast) const
+{
+    const NvMp4MuxerConfig &oMuxerConfig = m_pMuxer->Config();
+    unsigned int uTimescale = m_pMuxer->Timescale();
+    unsigned long long nSegmentTicks = (unsigned long long)m_oConfig.uSegmentFrames * m_pMuxer->FrameDuration();
+    size_t nFirst = (m_oConfig.uWindow && m_vSegments.size() > m_oConfig.uWindow) ? m_vSegments.size() - m_oConfig.uWindow : 0;
+    bool bStatic = bLast && !m_oConfig.uWindow;
+    unsigned long long nEnd = m_vSegments.empty() ? 0 : m_vSegments.back().nTime + m_vSegments.back().nDuration;
+    unsigned long long nGcd = Gcd(uTimescale, m_pMuxer->FrameDuration());
+
+    char szLine[512];
+    std::string s = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+                    "<MPD xmlns=\"urn:mpeg:dash:schema:mpd:2011\" "
+                    "profiles=\"urn:mpeg:dash:profile:isoff-live:2011,urn:mpeg:dash:profile:cmaf:2019\"";
+    if (bStatic)
+    {
+        s += " type=\"static\" mediaPresentationDuration=\"" + Duration(nEnd, uTimescale) + "\"";
+    }
+    else
+    {
+        s += " type=\"dynamic\" availabilityStartTime=\"" + UtcTime(m_tStart) + "\"";
+        s += " publishTime=\"" + UtcTime((long long)time(NULL)) + "\"";
+        s += bLast ? " mediaPresentationDuration=\"" + Duration(nEnd, uTimescale) + "\""
+                   : " minimumUpdatePeriod=\"" + Duration(nSegmentTicks, uTimescale) + "\"";
+        if (m_oConfig.uWindow)
+        {
+            s += " timeShiftBufferDepth=\"" + Duration(nSegmentTicks * m_oConfig.uWindow, uTimescale) + "\"";
+        }
+    }
+    s += " minBufferTime=\"" + Duration(nSegmentTicks, uTimescale) + "\">\n";
+
+    // a multiplexed representation lists both codecs and no content type
+    std::string sCodecs = m_pMuxer->CodecString();
+    if (m_pMuxer->HasAudio())
+    {
+        sCodecs += "," + m_pMuxer->AudioCodecString();
+    }
+    s += "  <Period id=\"0\" start=\"PT0S\">\n";
+    s += m_pMuxer->HasAudio() ? "    <AdaptationSet mimeType=\"video/mp4\" segmentAlignment=\"true\" startWithSAP=\"1\">\n"
+                              : "    <AdaptationSet contentType=\"video\" mimeType=\"video/mp4\" segmentAlignment=\"true\" startWithSAP=\"1\">\n";
+    snprintf(szLine, sizeof(szLine),
+             "      <Representation id=\"0\" codecs=\"%s\" width=\"%u\" height=\"%u\" frameRate=\"%llu/%llu\" bandwidth=\"%llu\">\n",
+             sCodecs.c_str(), oMuxerConfig.width, oMuxerConfig.height,
+             uTimescale / nGcd, m_pMuxer->FrameDuration() / nGcd, std::max(m_nMaxBitrate, 1ull));
+    s += szLine;
+    snprintf(szLine, sizeof(szLine), "\" startNumber=\"%llu\">\n",
+             m_vSegments.empty() ? 1ull : m_vSegments[nFirst].nNumber);
+    s += "        <SegmentTemplate timescale=\"" + std::to_string(uTimescale) +
+         "\" initialization=\"" + XmlEscape(m_sName) + "_init.mp4\" media=\"" + XmlEscape(m_sName) +
+         "_$Number%05d$.m4s" + szLine;
+
+    // runs of equal durations; only the first S needs its time, the rest
+    // follow on
+    s += "          <SegmentTimeline>\n";
+    for (size_t i = nFirst; i < m_vSegments.size(); )
+    {
+        size_t nRun = 1;
+        while (i + nRun < m_vSegments.size() && m_vSegments[i + nRun].nDuration == m_vSegments[i].nDuration)
+        {
+            nRun++;
+        }
+        if (i == nFirst)
+        {
+            snprintf(szLine, sizeof(szLine), "            <S t=\"%llu\" d=\"%llu\"", m_vSegments[i].nTime, m_vSegments[i].nDuration);
+        }
+        else
+        {
+            snprintf(szLine, sizeof(szLine), "            <S d=\"%llu\"", m_vSegments[i].nDuration);
+        }
+        s += szLine;
+        if (nRun > 1)
+        {
+            s += " r=\"" + std::to_string(nRun - 1) + "\"";
+        }
+        s += "/>\n";
+        i += nRun;
+    }
+    s += "          </SegmentTimeline>\n"
+         "        </SegmentTemplate>\n"
+         "      </Representation>\n"
+         "    </AdaptationSet>\n"
+         "  </Period>\n"
+         "</MPD>\n";
+    return s;
+}
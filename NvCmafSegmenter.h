@@ -0,0 +1,144 @@
+/*
+ * Copyright 1993-2015 NVIDIA Corporation.  All rights reserved.
+ *
+ * Please refer to the NVIDIA end user license agreement (EULA) associated
+ * with this source code for terms and conditions that govern your use of
+ * this software. Any use, reproduction, disclosure, or distribution of
+ * this software and related documentation outside the terms of the EULA
+ * is strictly prohibited.
+ *
+ */
+
+#ifndef NV_CMAF_SEGMENTER_H
+#define NV_CMAF_SEGMENTER_H
+
+#include <deque>
+#include <string>
+
+#include "NvBitstreamWriter.h"
+#include "NvMp4Muxer.h"
+
+struct NvCmafSegmenterConfig
+{
+    unsigned int    uSegmentFrames;     // frames per segment; the encoder puts an IDR at every multiple
+    unsigned int    uWindow;            // segments listed while live, 0 = all of them
+};
+
+struct NvCmafSegmenterStats
+{
+    unsigned long long nSegments;
+    unsigned long long nRemoved;            // deleted after sliding out of the window
+    unsigned long long nPlaylistUpdates;    // .m3u8 and .mpd rewritten together
+    unsigned long long nMaxSegmentBytes;
+    unsigned long long nSwitchUs;           // closing a segment, listing it and opening the next
+    unsigned long long nMaxSwitchUs;
+};
+
+// true for the names written as segments plus playlists: *.m3u8 and *.mpd
+bool nvCmafIsPlaylistPath(const char *szPath);
+
+// Cuts the output of a CNvMp4Muxer into CMAF segments for live HLS and
+// DASH. For "dir/name.m3u8" (or .mpd) it writes
+//  - dir/name_init.mp4, the CMAF header (ftyp + moov)
+//  - dir/name_00001.m4s, ... one file per segment: styp, then the moof +
+//    mdat fragments of uSegmentFrames frames starting at a keyframe
+//  - dir/name.m3u8, an HLS media playlist with EXT-X-MAP, and
+//    dir/name.mpd, a DASH manifest with a SegmentTemplate / SegmentTimeline
+// Both lists describe the same segment files. An audio track of the
+// muxer goes into the same segments, which makes them multiplexed DASH
+// segments rather than CMAF ones.
+//
+// A segment ends at the first keyframe at least uSegmentFrames after its
+// start, so the encoder has to force an IDR every uSegmentFrames frames
+// for the segments to come out even. Files are written as name.tmp and
+// renamed once complete, the segment before the lists that name it, so a
+// player or web server polling the directory never sees a partial file.
+// The lists follow every segment; with a window they keep the last uWindow
+// segments and the segment files one more window back, for players still
+// on an older list, then delete them. Close() of the muxer marks the lists
+// complete (EXT-X-ENDLIST, static MPD).
+//
+// All calls come from the muxer's thread; the segmenter reopens the
+// writer it shares with the muxer for every file.
+class CNvCmafSegmenter : public INvMp4MuxerListener
+{
+public:
+    CNvCmafSegmenter();
+
+    // pMuxer must have been opened with this segmenter as its listener;
+    // nothing is written before its first frame.
+    bool Open(CNvBitstreamWriter *pOutput, const CNvMp4Muxer *pMuxer, const char *szPlaylist,
+              const NvCmafSegmenterConfig &oConfig);
+
+    bool IsOpen() const
+    {
+        return m_pMuxer != NULL;
+    }
+
+    // before the first frame
+    void SetSegmentFrames(unsigned int uFrames)
+    {
+        m_oConfig.uSegmentFrames = uFrames ? uFrames : 1;
+    }
+    void SetWindow(unsigned int uSegments)
+    {
+        m_oConfig.uWindow = uSegments;
+    }
+
+    unsigned int SegmentFrames() const
+    {
+        return m_oConfig.uSegmentFrames;
+    }
+
+    void GetStats(NvCmafSegmenterStats *pStats) const
+    {
+        *pStats = m_stStats;
+    }
+
+    // INvMp4MuxerListener
+    virtual bool OnInitSegment();
+    virtual bool OnFragmentStart(unsigned long long nTime, bool bKeyframe);
+    virtual bool OnEnd(unsigned long long nEndTime);
+
+private:
+    struct Segment
+    {
+        unsigned long long nNumber;
+        unsigned long long nTime;       // decode time of the first frame, ticks
+        unsigned long long nDuration;
+        unsigned long long nBytes;
+    };
+
+    std::string SegmentName(unsigned long long nNumber) const;
+    bool OpenFile(const std::string &sName);
+    bool CloseFile();
+    bool StartSegment(unsigned long long nTime);
+    bool FinishSegment(unsigned long long nEndTime, bool bLast);
+    bool WritePlaylists(bool bLast);
+    std::string HlsPlaylist(bool bLast) const;
+    std::string DashManifest(bool bLast) const;
+
+    // non-copyable
+    CNvCmafSegmenter(const CNvCmafSegmenter &);
+    CNvCmafSegmenter &operator=(const CNvCmafSegmenter &);
+
+    CNvBitstreamWriter         *m_pOutput;
+    const CNvMp4Muxer          *m_pMuxer;
+    NvCmafSegmenterConfig       m_oConfig;
+    std::string                 m_sDir;             // with the trailing '/', or empty
+    std::string                 m_sName;            // file name without extension
+    std::string                 m_sFile;            // open in m_pOutput as m_sFile + ".tmp"
+    long long                   m_tStart;           // wall clock of the first frame, seconds since 1970
+
+    bool                        m_bInSegment;       // false while the init segment is open
+    unsigned long long          m_nSegment;         // number of the open segment, from 1
+    unsigned long long          m_nSegmentTime;
+    unsigned long long          m_nSegmentStartBytes;
+
+    std::deque<Segment>         m_vSegments;        // listed, and the window before that
+    unsigned long long          m_nMaxDuration;
+    unsigned long long          m_nMaxBitrate;      // bits per second of the busiest segment
+    NvCmafSegmenterStats        m_stStats;
+};
+
+#endif // NV_CMAF_SEGMENTER_H
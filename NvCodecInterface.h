@@ -0,0 +1,113 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 1993-2015 NVIDIA Corporation.  All rights reserved.
+//
+// Please refer to the NVIDIA end user license agreement (EULA) associated
+// with this source code for terms and conditions that govern your use of
+// this software. Any use, reproduction, disclosure, or distribution of
+// this software and related documentation outside the terms of the EULA
+// is strictly prohibited.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#ifndef NV_CODEC_INTERFACE_H
+#define NV_CODEC_INTERFACE_H
+
+#include <nvcuvid.h>
+#include "nvEncodeAPI.h"
+#include "NvColorMatrix.h"
+#include "NvAudioQueue.h"
+#include "NvBitstreamWriter.h"
+#include "NvMp4Muxer.h"
+#include "NvCmafSegmenter.h"
+
+// 10-bit 4:2:0 input, P010 layout: 16-bit samples with the value in bits
+// 6-15, CbCr plane at pitch * height. NvEncodeAPI 5.0 has no 10-bit input
+// format (later SDKs add NV_ENC_BUFFER_FORMAT_YUV420_10BIT with this value),
+// so only CNvSWEncoder accepts it.
+#define NV_ENC_BUFFER_FORMAT_P010_PL ((NV_ENC_BUFFER_FORMAT)0x10000)
+
+// defined in NvHWEncoder.h
+typedef struct _EncodeBuffer EncodeBuffer;
+typedef struct _NvEncPictureCommand NvEncPictureCommand;
+
+// Decoder backend as seen by videoDecodeMain. Decoded pictures are announced
+// through the FrameQueue handed to the backend and are accessed with
+// mapFrame()/unmapFrame(). isHostMemory() tells whether mapped pointers are
+// CUDA device pointers (CNvHWDecoder) or plain host pointers
+// (CNvSWDecoder) carried in a CUdeviceptr.
+class INvVideoDecoder
+{
+    public:
+        virtual ~INvVideoDecoder() {}
+
+        virtual void start() = 0;
+
+        virtual void stop() = 0;
+
+        virtual void getProgressive(bool &progressive) = 0;
+
+        // YCbCr matrix and range of the decoded pictures
+        virtual NvColorSpace colorSpace() const = 0;
+
+        // 8 for NV12 surfaces, 10 for P010
+        virtual unsigned int bitDepth() const = 0;
+
+        virtual unsigned int sourceWidth() const = 0;
+
+        virtual unsigned int sourceHeight() const = 0;
+
+        virtual unsigned long targetWidth() const = 0;
+
+        virtual unsigned long targetHeight() const = 0;
+
+        virtual void mapFrame(int iPictureIndex, CUdeviceptr *ppDevice, unsigned int *nPitch, CUVIDPROCPARAMS *pVideoProcessingParameters) = 0;
+
+        virtual void unmapFrame(CUdeviceptr pDevice) = 0;
+
+        virtual CUvideoctxlock getCtxLock() const = 0;
+
+        virtual bool isHostMemory() const = 0;
+
+        // Where the audio packets of the source go, before start(); NULL
+        // (the default) discards them.
+        virtual void setAudioQueue(CNvAudioQueue *pAudioQueue) = 0;
+};
+
+// Encoder backend: the subset of the NvEncodeAPI session that
+// videoDecodeMain drives. CNvHWEncoder forwards to libnvidia-encode,
+// CNvSWEncoder emulates it on the CPU. Both write the output file through
+// a CNvBitstreamWriter: ProcessOutput() only copies the bitstream into its
+// ring, and NvEncDestroyEncoder() flushes and closes it. For an .mp4 or
+// .m4v name the bitstream goes through a CNvMp4Muxer on the way, which
+// GetMuxer() returns; it is NULL for raw Annex-B output. For an .m3u8 or
+// .mpd name the muxer output is cut into CMAF segments with HLS and DASH
+// lists by the CNvCmafSegmenter that GetSegmenter() returns, and the caller
+// forces an IDR at the start of every segment. Closing the muxer early,
+// from the thread calling ProcessOutput(), completes the file or the lists.
+class INvVideoEncoder
+{
+public:
+    virtual ~INvVideoEncoder() {}
+
+    virtual NVENCSTATUS Initialize(void* device, NV_ENC_DEVICE_TYPE deviceType) = 0;
+    virtual NVENCSTATUS CreateEncoder(const char* outputName, int codec, int width, int height, int fps, int bitrate) = 0;
+    virtual NVENCSTATUS NvEncCreateInputBuffer(uint32_t width, uint32_t height, NV_ENC_BUFFER_FORMAT bufferFmt, void** inputBuffer) = 0;
+    virtual NVENCSTATUS NvEncDestroyInputBuffer(NV_ENC_INPUT_PTR inputBuffer) = 0;
+    virtual NVENCSTATUS NvEncCreateBitstreamBuffer(uint32_t size, void** bitstreamBuffer) = 0;
+    virtual NVENCSTATUS NvEncDestroyBitstreamBuffer(NV_ENC_OUTPUT_PTR bitstreamBuffer) = 0;
+    virtual NVENCSTATUS NvEncLockInputBuffer(void* inputBuffer, void** bufferDataPtr, uint32_t* pitch) = 0;
+    virtual NVENCSTATUS NvEncUnlockInputBuffer(NV_ENC_INPUT_PTR inputBuffer) = 0;
+    virtual NVENCSTATUS NvEncEncodeFrame(EncodeBuffer *pEncodeBuffer, NvEncPictureCommand *encPicCommand,
+                                         uint32_t width, uint32_t height,
+                                         NV_ENC_PIC_STRUCT ePicStruct = NV_ENC_PIC_STRUCT_FRAME,
+                                         int8_t *qpDeltaMapArray = NULL, uint32_t qpDeltaMapArraySize = 0) = 0;
+    virtual NVENCSTATUS NvEncFlushEncoderQueue(void *hEOSEvent) = 0;
+    virtual NVENCSTATUS ProcessOutput(const EncodeBuffer *pEncodeBuffer) = 0;
+    virtual NVENCSTATUS NvEncDestroyEncoder() = 0;
+    virtual CNvBitstreamWriter *GetOutput() = 0;
+    virtual CNvMp4Muxer *GetMuxer() = 0;
+    virtual CNvCmafSegmenter *GetSegmenter() = 0;
+};
+
+#endif // NV_CODEC_INTERFACE_H
@@ -0,0 +1,191 @@
+/*
+ * Copyright 1993-2015 NVIDIA Corporation.  All rights reserved.
+ *
+ * Please refer to the NVIDIA end user license agreement (EULA) associated
+ * with this source code for terms and conditions that govern your use of
+ * this software. Any use, reproduction, disclosure, or distribution of
+ * this software and related documentation outside the terms of the EULA
+ * is strictly prohibited.
+ *
+ */
+
+#ifndef _NVCOLORMATRIX_H_
+#define _NVCOLORMATRIX_H_
+
+// YCbCr <-> RGB matrices as Q13 integers, computed at compile time from the
+// luma weights of each standard. Shared by videoPP.cu and the host kernels,
+// which instantiate one converter per matrix and evaluate the same integer
+// expressions, so GPU and every CPU ISA produce identical pixels.
+//
+// Per pixel (>> is arithmetic, results clamped to [0, Max]):
+//   R  = (Y*(Y' - YOffset) + RV*(Cr - CMid)                  + 4096) >> 13
+//   G  = (Y*(Y' - YOffset) + GU*(Cb - CMid) + GV*(Cr - CMid) + 4096) >> 13
+//   B  = (Y*(Y' - YOffset) + BU*(Cb - CMid)                  + 4096) >> 13
+//   Y' = (YR*R + YG*G + YB*B + (YOffset << 13) + 4096) >> 13
+// and per 2x2 quad, from the sums sR, sG, sB of its four pixels:
+//   Cb = (UR*sR + UG*sG + UB*sB + (CMid << 15) + (1 << 14)) >> 15
+//   Cr = (VR*sR + VG*sG + VB*sB + (CMid << 15) + (1 << 14)) >> 15
+// At 8 bits Max = 255, CMid = 128 and YOffset is 16 (limited) or 0; the
+// 10-bit instances (P010 / ARGB2101010) scale those by 4 and use 1023.
+// Every coefficient fits in int16, so the SIMD paths can use pmaddwd.
+
+typedef enum
+{
+    NV_COLOR_MATRIX_BT601 = 0,
+    NV_COLOR_MATRIX_BT709,
+    NV_COLOR_MATRIX_BT2020,
+    NV_COLOR_MATRIX_COUNT
+} NvColorMatrix;
+
+typedef enum
+{
+    NV_COLOR_RANGE_LIMITED = 0,     // Y 16..235, C 16..240
+    NV_COLOR_RANGE_FULL,            // 0..255
+    NV_COLOR_RANGE_COUNT
+} NvColorRange;
+
+// zero-initialized means BT.601 limited range, what videoPP always used
+struct NvColorSpace
+{
+    NvColorMatrix eMatrix;
+    NvColorRange  eRange;
+};
+
+#define NV_COLOR_Q      13
+
+constexpr int nvColorQ13(double x)
+{
+    return (int)(x * (1 << NV_COLOR_Q) + (x < 0 ? -0.5 : 0.5));
+}
+
+template <NvColorMatrix M> struct NvLumaWeights;
+template <> struct NvLumaWeights<NV_COLOR_MATRIX_BT601>  { static constexpr double Kr = 0.299,  Kb = 0.114;  };
+template <> struct NvLumaWeights<NV_COLOR_MATRIX_BT709>  { static constexpr double Kr = 0.2126, Kb = 0.0722; };
+template <> struct NvLumaWeights<NV_COLOR_MATRIX_BT2020> { static constexpr double Kr = 0.2627, Kb = 0.0593; };
+
+template <NvColorMatrix M, NvColorRange R, int Bits = 8>
+struct NvColorMatrixQ13
+{
+    static constexpr double Kr = NvLumaWeights<M>::Kr;
+    static constexpr double Kb = NvLumaWeights<M>::Kb;
+    static constexpr double Kg = 1.0 - Kr - Kb;
+
+    // sample range at this bit depth; RGB always spans [0, Max]
+    static constexpr int    Max    = (1 << Bits) - 1;
+    static constexpr int    CMid   = 1 << (Bits - 1);
+    static constexpr double RGBMax = Max;
+    static constexpr double YRange = (R == NV_COLOR_RANGE_FULL) ? RGBMax : (double)(219 << (Bits - 8));
+    static constexpr double CRange = (R == NV_COLOR_RANGE_FULL) ? RGBMax : (double)(224 << (Bits - 8));
+
+    static constexpr int YOffset = (R == NV_COLOR_RANGE_FULL) ? 0 : 16 << (Bits - 8);
+
+    // YCbCr -> RGB
+    static constexpr int Y  = nvColorQ13(RGBMax / YRange);
+    static constexpr int RV = nvColorQ13(2.0 * (1.0 - Kr) * RGBMax / CRange);
+    static constexpr int GU = nvColorQ13(-2.0 * (1.0 - Kb) * Kb / Kg * RGBMax / CRange);
+    static constexpr int GV = nvColorQ13(-2.0 * (1.0 - Kr) * Kr / Kg * RGBMax / CRange);
+    static constexpr int BU = nvColorQ13(2.0 * (1.0 - Kb) * RGBMax / CRange);
+
+    // RGB -> YCbCr
+    static constexpr int YR = nvColorQ13(Kr * YRange / RGBMax);
+    static constexpr int YG = nvColorQ13(Kg * YRange / RGBMax);
+    static constexpr int YB = nvColorQ13(Kb * YRange / RGBMax);
+    static constexpr int UR = nvColorQ13(-Kr / (2.0 * (1.0 - Kb)) * CRange / RGBMax);
+    static constexpr int UG = nvColorQ13(-Kg / (2.0 * (1.0 - Kb)) * CRange / RGBMax);
+    static constexpr int UB = nvColorQ13(0.5 * CRange / RGBMax);
+    static constexpr int VR = nvColorQ13(0.5 * CRange / RGBMax);
+    static constexpr int VG = nvColorQ13(-Kg / (2.0 * (1.0 - Kr)) * CRange / RGBMax);
+    static constexpr int VB = nvColorQ13(-Kb / (2.0 * (1.0 - Kr)) * CRange / RGBMax);
+
+    static_assert(Bits == 8 || Bits == 10, "quad sums of wider samples overflow the int16 SIMD lanes");
+
+    static_assert(Y < 32768 && BU < 32768 && RV < 32768, "coefficients must fit in int16");
+};
+
+#if defined(__CUDACC__)
+#define NV_COLOR_HD __host__ __device__
+#else
+#define NV_COLOR_HD
+#endif
+
+NV_COLOR_HD inline int nvClamp(int x, int max)
+{
+    return x < 0 ? 0 : (x > max ? max : x);
+}
+
+// one pixel to clamped R, G, B; Cb/Cr are the (interpolated) samples of its pair
+template <class CM>
+NV_COLOR_HD inline void nvYUV2RGB(int luma, int chromaCb, int chromaCr, int &r, int &g, int &b)
+{
+    int y = (luma - CM::YOffset) * CM::Y + (1 << (NV_COLOR_Q - 1));
+    int u = chromaCb - CM::CMid;
+    int v = chromaCr - CM::CMid;
+
+    r = nvClamp((y + CM::RV * v) >> NV_COLOR_Q, CM::Max);
+    g = nvClamp((y + CM::GU * u + CM::GV * v) >> NV_COLOR_Q, CM::Max);
+    b = nvClamp((y + CM::BU * u) >> NV_COLOR_Q, CM::Max);
+}
+
+// 8-bit matrix, packed as ARGB8888
+template <class CM>
+NV_COLOR_HD inline unsigned int nvYUV2ARGB(int luma, int chromaCb, int chromaCr)
+{
+    int r, g, b;
+    nvYUV2RGB<CM>(luma, chromaCb, chromaCr, r, g, b);
+
+    return (unsigned int)b | ((unsigned int)g << 8) | ((unsigned int)r << 16) | 0xff000000u;
+}
+
+// 10-bit matrix, packed as ARGB2101010 (A in bits 30-31, then R, G, B)
+template <class CM>
+NV_COLOR_HD inline unsigned int nvYUV2ARGB2101010(int luma, int chromaCb, int chromaCr)
+{
+    int r, g, b;
+    nvYUV2RGB<CM>(luma, chromaCb, chromaCr, r, g, b);
+
+    return (unsigned int)b | ((unsigned int)g << 10) | ((unsigned int)r << 20) | 0xc0000000u;
+}
+
+template <class CM>
+NV_COLOR_HD inline unsigned int nvRGB2Y(int r, int g, int b)
+{
+    return (unsigned int)nvClamp((CM::YR * r + CM::YG * g + CM::YB * b +
+                                  (CM::YOffset << NV_COLOR_Q) + (1 << (NV_COLOR_Q - 1))) >> NV_COLOR_Q, CM::Max);
+}
+
+// chroma of a 2x2 quad from the sums of its 4 samples
+template <class CM, class T>
+NV_COLOR_HD inline void nvRGB2UV(int sumR, int sumG, int sumB, T &chromaCb, T &chromaCr)
+{
+    const int bias = (CM::CMid << (NV_COLOR_Q + 2)) + (1 << (NV_COLOR_Q + 1));
+
+    chromaCb = (T)nvClamp((CM::UR * sumR + CM::UG * sumG + CM::UB * sumB + bias) >> (NV_COLOR_Q + 2), CM::Max);
+    chromaCr = (T)nvClamp((CM::VR * sumR + CM::VG * sumG + CM::VB * sumB + bias) >> (NV_COLOR_Q + 2), CM::Max);
+}
+
+// P010 keeps each 10-bit sample in the top bits of a 16-bit word
+#define NV_P010_SHIFT   6
+
+// Expands X(name, matrix, range) once per supported colour space; used to
+// stamp out kernels and dispatch tables.
+#define NV_FOR_EACH_COLOR_SPACE(X) \
+    X(BT601,       NV_COLOR_MATRIX_BT601,  NV_COLOR_RANGE_LIMITED) \
+    X(BT601_Full,  NV_COLOR_MATRIX_BT601,  NV_COLOR_RANGE_FULL)    \
+    X(BT709,       NV_COLOR_MATRIX_BT709,  NV_COLOR_RANGE_LIMITED) \
+    X(BT709_Full,  NV_COLOR_MATRIX_BT709,  NV_COLOR_RANGE_FULL)    \
+    X(BT2020,      NV_COLOR_MATRIX_BT2020, NV_COLOR_RANGE_LIMITED) \
+    X(BT2020_Full, NV_COLOR_MATRIX_BT2020, NV_COLOR_RANGE_FULL)
+
+// "BT709", "BT601_Full", ... as used in the kernel names
+inline const char *nvColorSpaceName(NvColorSpace oColorSpace)
+{
+    static const char *names[NV_COLOR_MATRIX_COUNT][NV_COLOR_RANGE_COUNT] =
+    {
+        { "BT601",  "BT601_Full"  },
+        { "BT709",  "BT709_Full"  },
+        { "BT2020", "BT2020_Full" },
+    };
+    return names[oColorSpace.eMatrix][oColorSpace.eRange];
+}
+
+#endif
@@ -0,0 +1,130 @@
+/*
+ * Copyright 1993-2015 NVIDIA Corporation.  All rights reserved.
+ *
+ * Please refer to the NVIDIA end user license agreement (EULA) associated
+ * with this source code for terms and conditions that govern your use of
+ * this software. Any use, reproduction, disclosure, or distribution of
+ * this software and related documentation outside the terms of the EULA
+ * is strictly prohibited.
+ *
+ */
+
+#include "NvCudaLoader.h"
+
+#include <cuda.h>
+#include <cudaProfiler.h>
+#include <nvcuvid.h>
+#include <dlfcn.h>
+#include <stdio.h>
+
+struct NvCudaLibraries
+{
+    void *hCuda;
+    void *hNvcuvid;
+
+    NvCudaLibraries()
+    {
+        hCuda    = Open("libcuda.so.1");
+        hNvcuvid = Open("libnvcuvid.so.1");
+    }
+
+    static void *Open(const char *szName)
+    {
+        void *hLib = dlopen(szName, RTLD_LAZY);
+        if (hLib == NULL)
+        {
+            printf("NvCudaLoader: %s\n", dlerror());
+        }
+        return hLib;
+    }
+};
+
+// opened by whichever thread gets here first, the others wait for it
+static const NvCudaLibraries &libraries()
+{
+    static NvCudaLibraries s_oLibraries;
+    return s_oLibraries;
+}
+
+bool nvCudaLoad()
+{
+    return libraries().hCuda && libraries().hNvcuvid;
+}
+
+static void *cudaSymbol(bool bNvcuvid, const char *szName)
+{
+    void *hLib = bNvcuvid ? libraries().hNvcuvid : libraries().hCuda;
+    void *pfn = hLib ? dlsym(hLib, szName) : NULL;
+    if (hLib && pfn == NULL)
+    {
+        printf("NvCudaLoader: no %s in %s\n", szName, bNvcuvid ? "libnvcuvid.so.1" : "libcuda.so.1");
+    }
+    return pfn;
+}
+
+#define NV_CUDA_STRING2(x) #x
+#define NV_CUDA_STRING(x)  NV_CUDA_STRING2(x)
+
+// One forwarder. name is expanded through the versioning macros of cuda.h
+// (cuCtxCreate is cuCtxCreate_v2, ...) before it names both the definition
+// and the symbol looked up, so the two always agree with the headers; a
+// parameter list that doesn't match the header's fails to compile.
+#define NV_CUDA_FORWARD(bNvcuvid, name, params, args)                                        \
+    CUresult CUDAAPI name params                                                            \
+    {                                                                                       \
+        static decltype(&name) s_pfn = (decltype(&name))cudaSymbol(bNvcuvid, NV_CUDA_STRING(name)); \
+        return s_pfn ? s_pfn args : CUDA_ERROR_NOT_INITIALIZED;                             \
+    }
+
+#define NV_CUDA(name, params, args)    NV_CUDA_FORWARD(false, name, params, args)
+#define NV_CUVID(name, params, args)   NV_CUDA_FORWARD(true, name, params, args)
+
+// driver API
+NV_CUDA(cuInit, (unsigned int Flags), (Flags))
+NV_CUDA(cuDeviceGet, (CUdevice *device, int ordinal), (device, ordinal))
+NV_CUDA(cuDeviceGetName, (char *name, int len, CUdevice dev), (name, len, dev))
+NV_CUDA(cuDeviceComputeCapability, (int *major, int *minor, CUdevice dev), (major, minor, dev))
+NV_CUDA(cuCtxCreate, (CUcontext *pctx, unsigned int flags, CUdevice dev), (pctx, flags, dev))
+NV_CUDA(cuCtxDestroy, (CUcontext ctx), (ctx))
+NV_CUDA(cuCtxPushCurrent, (CUcontext ctx), (ctx))
+NV_CUDA(cuCtxPopCurrent, (CUcontext *pctx), (pctx))
+NV_CUDA(cuMemAlloc, (CUdeviceptr *dptr, size_t bytesize), (dptr, bytesize))
+NV_CUDA(cuMemFree, (CUdeviceptr dptr), (dptr))
+NV_CUDA(cuMemHostAlloc, (void **pp, size_t bytesize, unsigned int Flags), (pp, bytesize, Flags))
+NV_CUDA(cuMemFreeHost, (void *p), (p))
+NV_CUDA(cuMemHostGetDevicePointer, (CUdeviceptr *pdptr, void *p, unsigned int Flags), (pdptr, p, Flags))
+NV_CUDA(cuMemcpyHtoD, (CUdeviceptr dstDevice, const void *srcHost, size_t ByteCount), (dstDevice, srcHost, ByteCount))
+NV_CUDA(cuMemcpyDtoH, (void *dstHost, CUdeviceptr srcDevice, size_t ByteCount), (dstHost, srcDevice, ByteCount))
+NV_CUDA(cuStreamCreate, (CUstream *phStream, unsigned int Flags), (phStream, Flags))
+NV_CUDA(cuStreamDestroy, (CUstream hStream), (hStream))
+NV_CUDA(cuEventCreate, (CUevent *phEvent, unsigned int Flags), (phEvent, Flags))
+NV_CUDA(cuEventRecord, (CUevent hEvent, CUstream hStream), (hEvent, hStream))
+NV_CUDA(cuEventSynchronize, (CUevent hEvent), (hEvent))
+NV_CUDA(cuEventDestroy, (CUevent hEvent), (hEvent))
+NV_CUDA(cuModuleLoad, (CUmodule *module, const char *fname), (module, fname))
+NV_CUDA(cuModuleGetFunction, (CUfunction *hfunc, CUmodule hmod, const char *name), (hfunc, hmod, name))
+NV_CUDA(cuLaunchKernel, (CUfunction f,
+                         unsigned int gridDimX, unsigned int gridDimY, unsigned int gridDimZ,
+                         unsigned int blockDimX, unsigned int blockDimY, unsigned int blockDimZ,
+                         unsigned int sharedMemBytes, CUstream hStream, void **kernelParams, void **extra),
+                        (f, gridDimX, gridDimY, gridDimZ, blockDimX, blockDimY, blockDimZ,
+                         sharedMemBytes, hStream, kernelParams, extra))
+NV_CUDA(cuProfilerStop, (void), ())
+
+// NVCUVID: video source, parser and decoder
+NV_CUVID(cuvidCreateVideoSource, (CUvideosource *pObj, const char *pszFileName, CUVIDSOURCEPARAMS *pParams),
+                                 (pObj, pszFileName, pParams))
+NV_CUVID(cuvidDestroyVideoSource, (CUvideosource obj), (obj))
+NV_CUVID(cuvidSetVideoSourceState, (CUvideosource obj, cudaVideoState state), (obj, state))
+NV_CUVID(cuvidGetSourceVideoFormat, (CUvideosource obj, CUVIDEOFORMAT *pvidfmt, unsigned int flags), (obj, pvidfmt, flags))
+NV_CUVID(cuvidCreateVideoParser, (CUvideoparser *pObj, CUVIDPARSERPARAMS *pParams), (pObj, pParams))
+NV_CUVID(cuvidParseVideoData, (CUvideoparser obj, CUVIDSOURCEDATAPACKET *pPacket), (obj, pPacket))
+NV_CUVID(cuvidCreateDecoder, (CUvideodecoder *phDecoder, CUVIDDECODECREATEINFO *pdci), (phDecoder, pdci))
+NV_CUVID(cuvidDecodePicture, (CUvideodecoder hDecoder, CUVIDPICPARAMS *pPicParams), (hDecoder, pPicParams))
+NV_CUVID(cuvidMapVideoFrame, (CUvideodecoder hDecoder, int nPicIdx, CUdeviceptr *pDevPtr, unsigned int *pPitch,
+                              CUVIDPROCPARAMS *pVPP), (hDecoder, nPicIdx, pDevPtr, pPitch, pVPP))
+NV_CUVID(cuvidUnmapVideoFrame, (CUvideodecoder hDecoder, CUdeviceptr DevPtr), (hDecoder, DevPtr))
+NV_CUVID(cuvidCtxLockCreate, (CUvideoctxlock *pLock, CUcontext ctx), (pLock, ctx))
+NV_CUVID(cuvidCtxLockDestroy, (CUvideoctxlock lck), (lck))
+NV_CUVID(cuvidCtxLock, (CUvideoctxlock lck, unsigned int reserved_flags), (lck, reserved_flags))
+NV_CUVID(cuvidCtxUnlock, (CUvideoctxlock lck, unsigned int reserved_flags), (lck, reserved_flags))
@@ -0,0 +1,25 @@
+/*
+ * Copyright 1993-2015 NVIDIA Corporation.  All rights reserved.
+ *
+ * Please refer to the NVIDIA end user license agreement (EULA) associated
+ * with this source code for terms and conditions that govern your use of
+ * this software. Any use, reproduction, disclosure, or distribution of
+ * this software and related documentation outside the terms of the EULA
+ * is strictly prohibited.
+ *
+ */
+
+#ifndef NV_CUDA_LOADER_H
+#define NV_CUDA_LOADER_H
+
+// The CUDA driver API and NVCUVID functions the GPU path calls are defined
+// in NvCudaLoader.cpp, each one forwarding to the entry point of the same
+// name in libcuda.so.1 or libnvcuvid.so.1, opened on first use the way
+// CNvHWEncoder opens libnvidia-encode.so.1. Nothing links against the
+// driver, so -sw runs on machines where it isn't installed.
+
+// Opens both libraries, once; false, with dlerror() printed, when either is
+// missing. The forwarders return CUDA_ERROR_NOT_INITIALIZED in that case.
+bool nvCudaLoad();
+
+#endif
@@ -0,0 +1,429 @@
+/*
+ * Copyright 1993-2015 NVIDIA Corporation.  All rights reserved.
+ *
+ * Please refer to the NVIDIA end user license agreement (EULA) associated
+ * with this source code for terms and conditions that govern your use of
+ * this software. Any use, reproduction, disclosure, or distribution of
+ * this software and related documentation outside the terms of the EULA
+ * is strictly prohibited.
+ *
+ */
+
+#include "NvFilterGraph.h"
+#include "NvFilters.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+// pixels each stage of a point-wise pass runs on before the next one takes
+// over: 1 KB of ARGB, so the run stays in L1 across the whole pass
+#define FILTER_CHUNK_PIXELS 256
+
+static const NvFilterInfo s_aFilters[] =
+{
+    { "keepred",    "",                              "keep the red channel, zero green and blue", nvCreateKeepRedFilter },
+    { "levels",     "black=B:white=W:gamma=G",       "stretch B..W (of 0..255) to the full range, then gamma", nvCreateLevelsFilter },
+    { "invert",     "",                              "negative", nvCreateInvertFilter },
+    { "saturation", "amount=A",                      "scale the colour around luma, 0 = grey, 1 = unchanged", nvCreateSaturationFilter },
+    { "dilate",     "radius=R",                      "per-channel maximum over a (2R+1)^2 square", nvCreateDilateFilter },
+    { "erode",      "radius=R",                      "per-channel minimum over a (2R+1)^2 square", nvCreateErodeFilter },
+    { "box",        "radius=R:passes=N",             "mean over a (2R+1)^2 square, N times", nvCreateBoxBlurFilter },
+    { "gauss",      "sigma=S",                       "Gaussian blur, as three box blurs", nvCreateGaussFilter },
+    { "unsharp",    "radius=R:amount=A:threshold=T", "sharpen: add A x (pixel - box blur) where it exceeds T", nvCreateUnsharpFilter },
+    { "median",     "size=3|5:luma=0|1",             "median of each channel over the window, or of luma only", nvCreateMedianFilter },
+    { "bilateral",  "radius=R:spatial=S:range=V",    "denoise luma, weights of distance (sigma S) and difference (sigma V)", nvCreateBilateralFilter },
+    { "tavg",       "weight=W",                      "running average over frames, W of the new one", nvCreateTemporalAverageFilter },
+};
+
+const NvFilterInfo *nvFilterRegistry(size_t *pnCount)
+{
+    *pnCount = sizeof(s_aFilters) / sizeof(s_aFilters[0]);
+    return s_aFilters;
+}
+
+const char *nvFilterNames()
+{
+    static std::string sNames;
+
+    if (sNames.empty())
+    {
+        for (size_t i = 0; i < sizeof(s_aFilters) / sizeof(s_aFilters[0]); i++)
+        {
+            sNames += (i ? ", " : "") + std::string(s_aFilters[i].szName);
+        }
+    }
+    return sNames.c_str();
+}
+
+bool CNvFilterOptions::Parse(const std::string &sOptions)
+{
+    size_t nStart = 0;
+
+    while (nStart < sOptions.size())
+    {
+        size_t nEnd = sOptions.find(':', nStart);
+        if (nEnd == std::string::npos)
+        {
+            nEnd = sOptions.size();
+        }
+
+        std::string sOption = sOptions.substr(nStart, nEnd - nStart);
+        size_t nEquals = sOption.find('=');
+        if (nEquals == 0 || nEquals == std::string::npos || nEquals + 1 == sOption.size())
+        {
+            printf("CNvFilterGraph: %s: \"%s\" is not key=value\n", m_sFilter.c_str(), sOption.c_str());
+            return false;
+        }
+        m_mValues[sOption.substr(0, nEquals)] = sOption.substr(nEquals + 1);
+        nStart = nEnd + 1;
+    }
+    return true;
+}
+
+bool CNvFilterOptions::Get(const char *szKey, double fDefault, double fMin, double fMax, double *pValue)
+{
+    std::map<std::string, std::string>::const_iterator it = m_mValues.find(szKey);
+
+    m_mUsed[szKey] = true;
+    if (it == m_mValues.end())
+    {
+        *pValue = fDefault;
+        return true;
+    }
+
+    char *pEnd = NULL;
+    double fValue = strtod(it->second.c_str(), &pEnd);
+    if (*pEnd || !(fValue >= fMin && fValue <= fMax))
+    {
+        printf("CNvFilterGraph: %s: %s must be a number in %g..%g\n", m_sFilter.c_str(), szKey, fMin, fMax);
+        return false;
+    }
+    *pValue = fValue;
+    return true;
+}
+
+const char *CNvFilterOptions::Unused() const
+{
+    for (std::map<std::string, std::string>::const_iterator it = m_mValues.begin(); it != m_mValues.end(); ++it)
+    {
+        if (!m_mUsed.count(it->first))
+            return it->first.c_str();
+    }
+    return NULL;
+}
+
+CNvFilterGraph::CNvFilterGraph()
+{
+    Compile();
+}
+
+CNvFilterGraph::~CNvFilterGraph()
+{
+    Clear();
+}
+
+void CNvFilterGraph::Clear()
+{
+    for (size_t i = 0; i < m_vFilters.size(); i++)
+    {
+        delete m_vFilters[i];
+    }
+    m_vFilters.clear();
+    m_vChains.clear();
+    Compile();
+}
+
+void CNvFilterGraph::Add(INvFilter *pFilter)
+{
+    m_vFilters.push_back(pFilter);
+    m_vChains.push_back(pFilter->Name());
+    Compile();
+}
+
+bool CNvFilterGraph::Parse(const char *szChain)
+{
+    std::string sChain = szChain;
+    std::vector<INvFilter *> vFilters;
+    std::vector<std::string> vChains;
+    size_t nFilters = 0;
+    const NvFilterInfo *pRegistry = nvFilterRegistry(&nFilters);
+    bool bOk = true;
+
+    for (size_t nStart = 0; bOk && sChain != "none" && nStart < sChain.size(); )
+    {
+        size_t nEnd = sChain.find(',', nStart);
+        if (nEnd == std::string::npos)
+        {
+            nEnd = sChain.size();
+        }
+
+        std::string sFilter = sChain.substr(nStart, nEnd - nStart);
+        size_t nColon = std::min(sFilter.find(':'), sFilter.size());
+        std::string sName = sFilter.substr(0, nColon);
+        nStart = nEnd + 1;
+
+        const NvFilterInfo *pInfo = NULL;
+        for (size_t i = 0; i < nFilters; i++)
+        {
+            if (sName == pRegistry[i].szName)
+            {
+                pInfo = &pRegistry[i];
+            }
+        }
+        if (!pInfo)
+        {
+            printf("CNvFilterGraph: unknown filter \"%s\"\n", sName.c_str());
+            bOk = false;
+            break;
+        }
+
+        CNvFilterOptions oOptions(sName);
+        INvFilter *pFilter = NULL;
+        if (!oOptions.Parse(sFilter.substr(std::min(nColon + 1, sFilter.size()))) || !(pFilter = pInfo->pfnCreate(oOptions)))
+        {
+            bOk = false;
+            break;
+        }
+        vFilters.push_back(pFilter);
+        vChains.push_back(sFilter);
+
+        if (oOptions.Unused())
+        {
+            printf("CNvFilterGraph: %s has no option \"%s\"\n", sName.c_str(), oOptions.Unused());
+            bOk = false;
+        }
+    }
+
+    if (!bOk)
+    {
+        for (size_t i = 0; i < vFilters.size(); i++)
+        {
+            delete vFilters[i];
+        }
+        return false;
+    }
+
+    Clear();
+    m_vFilters = vFilters;
+    m_vChains = vChains;
+    Compile();
+    return true;
+}
+
+// vFirst becomes vThen(vFirst(in)) for each channel, both 3 << nBits entries
+static void composeCurves(std::vector<uint16> &vFirst, const std::vector<uint16> &vThen, uint32 nBits)
+{
+    uint32 nValues = 1u << nBits;
+
+    for (uint32 c = 0; c < 3; c++)
+    {
+        for (uint32 v = 0; v < nValues; v++)
+        {
+            vFirst[c * nValues + v] = vThen[c * nValues + vFirst[c * nValues + v]];
+        }
+    }
+}
+
+static std::vector<uint16> identityCurves(uint32 nBits)
+{
+    uint32 nValues = 1u << nBits;
+    std::vector<uint16> vCurves(3 * nValues);
+
+    for (uint32 i = 0; i < 3 * nValues; i++)
+    {
+        vCurves[i] = (uint16)(i & (nValues - 1));
+    }
+    return vCurves;
+}
+
+void CNvFilterGraph::Compile()
+{
+    bool bPointwise = true;
+    bool b2101010 = true;
+    bool bTemporal = false;
+    uint32 nHaloRows = 0;
+
+    m_vPasses.clear();
+    m_sDescription.clear();
+
+    for (size_t i = 0; i < m_vFilters.size(); i++)
+    {
+        INvFilter *pFilter = m_vFilters[i];
+        bool bNewPass = m_vPasses.empty() || m_vPasses.back().pFilter || pFilter->Access() != NV_FILTER_POINTWISE;
+
+        if (bNewPass)
+        {
+            m_vPasses.push_back(Pass());
+            m_vPasses.back().pFilter = NULL;
+            m_sDescription += m_sDescription.empty() ? "" : " | ";
+        }
+        else
+        {
+            m_sDescription += "+";
+        }
+        m_sDescription += pFilter->Name();
+
+        Pass &oPass = m_vPasses.back();
+        if (pFilter->Access() != NV_FILTER_POINTWISE)
+        {
+            oPass.pFilter = pFilter;
+            bPointwise = false;
+            bTemporal |= pFilter->Access() == NV_FILTER_TEMPORAL;
+            nHaloRows += pFilter->Access() == NV_FILTER_NEIGHBORHOOD ? pFilter->HaloRows() : 0;
+            continue;
+        }
+
+        std::vector<uint16> vCurves[2] = { std::vector<uint16>(3 << 8), std::vector<uint16>(3 << 10) };
+        if (!pFilter->Curves(8, &vCurves[0][0]) || !pFilter->Curves(10, &vCurves[1][0]))
+        {
+            Stage oStage;
+            oStage.pFilter = pFilter;
+            oPass.vStages.push_back(oStage);
+            b2101010 &= pFilter->Supports2101010();
+            continue;
+        }
+
+        // a curve after a curve folds into its tables
+        if (oPass.vStages.empty() || oPass.vStages.back().pFilter)
+        {
+            Stage oStage;
+            oStage.pFilter = NULL;
+            oStage.vCurves[0] = identityCurves(8);
+            oStage.vCurves[1] = identityCurves(10);
+            oPass.vStages.push_back(oStage);
+        }
+        for (uint32 d = 0; d < 2; d++)
+        {
+            uint16 uMax = d ? 1023 : 255;
+            for (size_t v = 0; v < vCurves[d].size(); v++)
+            {
+                vCurves[d][v] = std::min(vCurves[d][v], uMax);
+            }
+            composeCurves(oPass.vStages.back().vCurves[d], vCurves[d], d ? 10 : 8);
+        }
+    }
+
+    for (uint32 d = 0; d < 2; d++)
+    {
+        m_vCurves[d] = CurvesOnly() && !m_vPasses.empty() ? m_vPasses[0].vStages[0].vCurves[d] : identityCurves(d ? 10 : 8);
+    }
+
+    // a lone luma filter works on the Y plane, with no ARGB at all
+    bool bLuma = m_vFilters.size() == 1 && m_vFilters[0]->SupportsLuma();
+    if (bLuma)
+    {
+        m_sDescription += " (Y plane)";
+    }
+
+    m_oHost.szName        = m_sDescription.c_str();
+    m_oHost.pfnRow        = bPointwise ? RunRow : NULL;
+    m_oHost.pfnRow2101010 = bPointwise && b2101010 ? RunRow2101010 : NULL;
+    m_oHost.pfnFrame      = bPointwise || bLuma ? NULL : RunFrame;
+    m_oHost.pParams       = this;
+    m_oHost.nHaloRows     = bTemporal ? CPU_HALO_WHOLE_FRAME : nHaloRows;
+    m_oHost.pfnLuma       = bLuma ? RunLuma : NULL;
+}
+
+bool CNvFilterGraph::CurvesOnly() const
+{
+    return m_vPasses.empty() ||
+           (m_vPasses.size() == 1 && m_vPasses[0].vStages.size() == 1 && !m_vPasses[0].vStages[0].pFilter);
+}
+
+void CNvFilterGraph::Reset()
+{
+    for (size_t i = 0; i < m_vFilters.size(); i++)
+    {
+        m_vFilters[i]->Reset();
+    }
+}
+
+static void applyCurves(const uint16 *pCurves, uint32 *pARGB, uint32 width)
+{
+    const uint16 *pR = pCurves, *pG = pCurves + 256, *pB = pCurves + 512;
+
+    for (uint32 x = 0; x < width; x++)
+    {
+        uint32 p = pARGB[x];
+        pARGB[x] = 0xff000000 | ((uint32)pR[(p >> 16) & 0xff] << 16) | ((uint32)pG[(p >> 8) & 0xff] << 8) | pB[p & 0xff];
+    }
+}
+
+static void applyCurves2101010(const uint16 *pCurves, uint32 *pARGB, uint32 width)
+{
+    const uint16 *pR = pCurves, *pG = pCurves + 1024, *pB = pCurves + 2048;
+
+    for (uint32 x = 0; x < width; x++)
+    {
+        uint32 p = pARGB[x];
+        pARGB[x] = 0xc0000000 | ((uint32)pR[(p >> 20) & 0x3ff] << 20) | ((uint32)pG[(p >> 10) & 0x3ff] << 10) | pB[p & 0x3ff];
+    }
+}
+
+void CNvFilterGraph::RunPointwise(const Pass &oPass, uint32 *pARGB, uint32 width, bool b2101010) const
+{
+    for (uint32 x = 0; x < width; x += FILTER_CHUNK_PIXELS)
+    {
+        uint32 nPixels = std::min(width - x, (uint32)FILTER_CHUNK_PIXELS);
+
+        for (size_t i = 0; i < oPass.vStages.size(); i++)
+        {
+            const Stage &oStage = oPass.vStages[i];
+
+            if (oStage.pFilter)
+            {
+                oStage.pFilter->ProcessRow(pARGB + x, nPixels, b2101010);
+            }
+            else if (b2101010)
+            {
+                applyCurves2101010(&oStage.vCurves[1][0], pARGB + x, nPixels);
+            }
+            else
+            {
+                applyCurves(&oStage.vCurves[0][0], pARGB + x, nPixels);
+            }
+        }
+    }
+}
+
+void CNvFilterGraph::RunRow(uint32 *pARGB, uint32 width, const void *pParams)
+{
+    const CNvFilterGraph *pGraph = (const CNvFilterGraph *)pParams;
+    pGraph->RunPointwise(pGraph->m_vPasses[0], pARGB, width, false);
+}
+
+void CNvFilterGraph::RunRow2101010(uint32 *pARGB, uint32 width, const void *pParams)
+{
+    const CNvFilterGraph *pGraph = (const CNvFilterGraph *)pParams;
+    pGraph->RunPointwise(pGraph->m_vPasses[0], pARGB, width, true);
+}
+
+void CNvFilterGraph::RunFrame(uint32 *pARGB, size_t nPitch, uint32 width, uint32 height, const void *pParams)
+{
+    const CNvFilterGraph *pGraph = (const CNvFilterGraph *)pParams;
+
+    for (size_t i = 0; i < pGraph->m_vPasses.size(); i++)
+    {
+        const Pass &oPass = pGraph->m_vPasses[i];
+
+        if (oPass.pFilter)
+        {
+            oPass.pFilter->ProcessFrame(pARGB, nPitch, width, height);
+            continue;
+        }
+        for (uint32 y = 0; y < height; y++)
+        {
+            pGraph->RunPointwise(oPass, (uint32 *)((uint8 *)pARGB + y * nPitch), width, false);
+        }
+    }
+}
+
+void CNvFilterGraph::RunLuma(const uint8 *pSrc, size_t nSourcePitch, uint8 *pDst, size_t nDestPitch,
+                             uint32 width, uint32 height, uint32 yBegin, uint32 yEnd, const void *pParams)
+{
+    const CNvFilterGraph *pGraph = (const CNvFilterGraph *)pParams;
+
+    pGraph->m_vFilters[0]->ProcessLuma(pSrc, nSourcePitch, pDst, nDestPitch, width, height, yBegin, yEnd);
+}
@@ -0,0 +1,246 @@
+/*
+ * Copyright 1993-2015 NVIDIA Corporation.  All rights reserved.
+ *
+ * Please refer to the NVIDIA end user license agreement (EULA) associated
+ * with this source code for terms and conditions that govern your use of
+ * this software. Any use, reproduction, disclosure, or distribution of
+ * this software and related documentation outside the terms of the EULA
+ * is strictly prohibited.
+ *
+ */
+
+#ifndef NV_FILTER_GRAPH_H
+#define NV_FILTER_GRAPH_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "cpuProcessFrame.h"
+
+// What an output pixel of a filter depends on. The graph schedules on it:
+// runs of point-wise filters share one pass over the pixels, neighbourhood
+// filters get their halo of rows when the frame is cut into strips, and a
+// temporal filter keeps the frame whole and in order.
+enum NvFilterAccess
+{
+    NV_FILTER_POINTWISE = 0,    // the same pixel of the input
+    NV_FILTER_NEIGHBORHOOD,     // a window around it, HaloRows() up and down
+    NV_FILTER_TEMPORAL,         // the same place in earlier frames too
+};
+
+// One node of a filter graph, working in place on packed ARGB.
+//
+// Point-wise filters that map R, G and B each through a curve of their own
+// implement Curves() only: the graph composes every run of them into one
+// lookup table per channel, which is also all the GPU path runs. Other
+// point-wise filters implement ProcessRow(), neighbourhood and temporal
+// ones ProcessFrame(). Neighbourhood filters are called from several
+// threads at once on different strips; a temporal filter sees every frame,
+// in order, on one thread at a time.
+class INvFilter
+{
+public:
+    virtual ~INvFilter() {}
+
+    virtual const char *Name() const = 0;
+    virtual NvFilterAccess Access() const = 0;
+
+    // neighbourhood: rows of context the window needs above and below
+    virtual uint32 HaloRows() const
+    {
+        return 0;
+    }
+
+    // The output of each input value 0..(1 << nBits) - 1, for R, then G,
+    // then B, into pCurves (3 << nBits entries); false if the filter isn't
+    // a curve. Asked for 8 and 10 bits.
+    virtual bool Curves(uint32 nBits, uint16 *pCurves) const
+    {
+        return false;
+    }
+
+    // point-wise: whether ProcessRow() takes ARGB2101010 as well
+    virtual bool Supports2101010() const
+    {
+        return false;
+    }
+
+    virtual void ProcessRow(uint32 *pARGB, uint32 width, bool b2101010) const
+    {
+    }
+
+    // A strip of height rows; the rows at its top and bottom count as the
+    // edges of the frame, the halo makes up for that.
+    virtual void ProcessFrame(uint32 *pARGB, size_t nPitch, uint32 width, uint32 height)
+    {
+    }
+
+    // Neighbourhood filters of luma alone can also work on the Y plane of
+    // NV12: rows [yBegin, yEnd) of pDst from the whole of pSrc, called from
+    // several threads at once. A chain of just such a filter then never
+    // converts to ARGB.
+    virtual bool SupportsLuma() const
+    {
+        return false;
+    }
+
+    virtual void ProcessLuma(const uint8 *pSrc, size_t nSourcePitch, uint8 *pDst, size_t nDestPitch,
+                             uint32 width, uint32 height, uint32 yBegin, uint32 yEnd) const
+    {
+    }
+
+    // temporal: forget the frames seen so far
+    virtual void Reset()
+    {
+    }
+};
+
+// The key=value options of one filter in a chain, e.g. "black=16:white=235"
+class CNvFilterOptions
+{
+public:
+    CNvFilterOptions(const std::string &sFilter): m_sFilter(sFilter)
+    {
+    }
+
+    bool Parse(const std::string &sOptions);
+
+    // szKey as a number in [fMin, fMax], fDefault when absent; prints the
+    // problem and returns false otherwise
+    bool Get(const char *szKey, double fDefault, double fMin, double fMax, double *pValue);
+
+    // an option no Get() has asked for, NULL when all were used
+    const char *Unused() const;
+
+private:
+    std::string                          m_sFilter;
+    std::map<std::string, std::string>   m_mValues;
+    std::map<std::string, bool>          m_mUsed;
+};
+
+// Creates a filter from its options, NULL after printing why not
+typedef INvFilter *(*NvFilterFactory)(CNvFilterOptions &oOptions);
+
+struct NvFilterInfo
+{
+    const char      *szName;
+    const char      *szOptions;     // for -filters help
+    const char      *szDescription;
+    NvFilterFactory  pfnCreate;
+};
+
+// every filter the chains can name, and how many there are
+const NvFilterInfo *nvFilterRegistry(size_t *pnCount);
+
+// the registry as "name, name, ..." for the help text
+const char *nvFilterNames();
+
+// A chain of filters on the ARGB frame between the two colour conversions,
+// compiled into passes: adjacent point-wise filters fuse into one pass that
+// runs them all on a few hundred pixels at a time while they sit in L1,
+// with adjacent curves collapsed into a single table lookup; every other
+// filter is a pass of its own. Every filter has a host implementation, so
+// any chain runs with -sw and in the benchmarks without a GPU; the GPU
+// path takes chains of curves, applied as one lookup kernel.
+class CNvFilterGraph
+{
+public:
+    CNvFilterGraph();
+    ~CNvFilterGraph();
+
+    // Replaces the chain with "name[:key=value...],name...", "none" for an
+    // empty one. On an error the old chain stays and false is returned.
+    bool Parse(const char *szChain);
+
+    // appends pFilter, which the graph then owns
+    void Add(INvFilter *pFilter);
+    void Clear();
+
+    bool Empty() const
+    {
+        return m_vFilters.empty();
+    }
+
+    size_t FilterCount() const
+    {
+        return m_vFilters.size();
+    }
+
+    INvFilter *Filter(size_t i) const
+    {
+        return m_vFilters[i];
+    }
+
+    // filter i as Parse() took it, options included
+    const std::string &FilterChain(size_t i) const
+    {
+        return m_vChains[i];
+    }
+
+    // The chain as a host postprocess for cpuPostprocessNV12/P010(), NULL
+    // when it is empty. A chain of point-wise filters only is fusable; one
+    // with a temporal filter runs on whole frames, and a lone luma filter
+    // on the Y plane.
+    const CpuPostprocess *HostPostprocess() const
+    {
+        return m_vFilters.empty() ? NULL : &m_oHost;
+    }
+
+    // the passes, e.g. "levels+keepred | dilate"
+    const std::string &Description() const
+    {
+        return m_sDescription;
+    }
+
+    // true when every filter is a curve, which is what the GPU path runs
+    bool CurvesOnly() const;
+
+    // the composed curves of a CurvesOnly() chain, 3 << nBits entries for
+    // nBits = 8 or 10, R then G then B
+    const uint16 *Curves(uint32 nBits) const
+    {
+        return &m_vCurves[nBits > 8 ? 1 : 0][0];
+    }
+
+    // restarts the temporal filters, e.g. after a benchmark ran the chain
+    void Reset();
+
+private:
+    // One step of a point-wise pass: a filter's ProcessRow(), or the lookup
+    // tables of a run of curves when pFilter is NULL.
+    struct Stage
+    {
+        const INvFilter      *pFilter;
+        std::vector<uint16>   vCurves[2];       // 8 and 10 bits
+    };
+
+    // point-wise passes have stages, the others one filter
+    struct Pass
+    {
+        std::vector<Stage>    vStages;
+        INvFilter            *pFilter;
+    };
+
+    void Compile();
+    void RunPointwise(const Pass &oPass, uint32 *pARGB, uint32 width, bool b2101010) const;
+
+    static void RunRow(uint32 *pARGB, uint32 width, const void *pParams);
+    static void RunRow2101010(uint32 *pARGB, uint32 width, const void *pParams);
+    static void RunFrame(uint32 *pARGB, size_t nPitch, uint32 width, uint32 height, const void *pParams);
+    static void RunLuma(const uint8 *pSrc, size_t nSourcePitch, uint8 *pDst, size_t nDestPitch,
+                        uint32 width, uint32 height, uint32 yBegin, uint32 yEnd, const void *pParams);
+
+    // non-copyable
+    CNvFilterGraph(const CNvFilterGraph &);
+    CNvFilterGraph &operator=(const CNvFilterGraph &);
+
+    std::vector<INvFilter *>    m_vFilters;
+    std::vector<std::string>    m_vChains;      // per filter
+    std::vector<Pass>           m_vPasses;
+    std::vector<uint16>         m_vCurves[2];   // the whole chain, when CurvesOnly()
+    std::string                 m_sDescription;
+    CpuPostprocess              m_oHost;
+};
+
+#endif // NV_FILTER_GRAPH_H
@@ -0,0 +1,906 @@
+/*
+ * Copyright 1993-2015 NVIDIA Corporation.  All rights reserved.
+ *
+ * Please refer to the NVIDIA end user license agreement (EULA) associated
+ * with this source code for terms and conditions that govern your use of
+ * this software. Any use, reproduction, disclosure, or distribution of
+ * this software and related documentation outside the terms of the EULA
+ * is strictly prohibited.
+ *
+ */
+
+#include "NvFilters.h"
+#include "cpuProcessFrameKernels.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+// keepred: what the ARGBpostprocess placeholder kernel did, green and blue
+// to zero
+class CNvKeepRedFilter : public INvFilter
+{
+public:
+    virtual const char *Name() const
+    {
+        return "keepred";
+    }
+
+    virtual NvFilterAccess Access() const
+    {
+        return NV_FILTER_POINTWISE;
+    }
+
+    virtual bool Curves(uint32 nBits, uint16 *pCurves) const
+    {
+        uint32 nValues = 1u << nBits;
+
+        for (uint32 v = 0; v < nValues; v++)
+        {
+            pCurves[v] = (uint16)v;
+            pCurves[nValues + v] = pCurves[2 * nValues + v] = 0;
+        }
+        return true;
+    }
+};
+
+INvFilter *nvCreateKeepRedFilter(CNvFilterOptions &oOptions)
+{
+    return new CNvKeepRedFilter();
+}
+
+// levels: black..white of 0..255 stretched to the full range, then gamma;
+// the same curve on all three channels
+class CNvLevelsFilter : public INvFilter
+{
+public:
+    CNvLevelsFilter(double fBlack, double fWhite, double fGamma): m_fBlack(fBlack), m_fWhite(fWhite), m_fGamma(fGamma)
+    {
+    }
+
+    virtual const char *Name() const
+    {
+        return "levels";
+    }
+
+    virtual NvFilterAccess Access() const
+    {
+        return NV_FILTER_POINTWISE;
+    }
+
+    virtual bool Curves(uint32 nBits, uint16 *pCurves) const
+    {
+        uint32 nValues = 1u << nBits;
+        double fMax = nValues - 1;
+        double fScale = fMax / 255.0;
+
+        for (uint32 v = 0; v < nValues; v++)
+        {
+            double f = (v - m_fBlack * fScale) / ((m_fWhite - m_fBlack) * fScale);
+            f = pow(std::min(std::max(f, 0.0), 1.0), 1.0 / m_fGamma);
+            pCurves[v] = pCurves[nValues + v] = pCurves[2 * nValues + v] = (uint16)(f * fMax + 0.5);
+        }
+        return true;
+    }
+
+private:
+    double m_fBlack;
+    double m_fWhite;
+    double m_fGamma;
+};
+
+INvFilter *nvCreateLevelsFilter(CNvFilterOptions &oOptions)
+{
+    double fBlack, fWhite, fGamma;
+
+    if (!oOptions.Get("black", 0.0, 0.0, 254.0, &fBlack) || !oOptions.Get("white", 255.0, 1.0, 255.0, &fWhite) ||
+        !oOptions.Get("gamma", 1.0, 0.1, 10.0, &fGamma))
+        return NULL;
+    if (fWhite <= fBlack)
+    {
+        printf("CNvFilterGraph: levels: white must be above black\n");
+        return NULL;
+    }
+    return new CNvLevelsFilter(fBlack, fWhite, fGamma);
+}
+
+class CNvInvertFilter : public INvFilter
+{
+public:
+    virtual const char *Name() const
+    {
+        return "invert";
+    }
+
+    virtual NvFilterAccess Access() const
+    {
+        return NV_FILTER_POINTWISE;
+    }
+
+    virtual bool Curves(uint32 nBits, uint16 *pCurves) const
+    {
+        uint32 nValues = 1u << nBits;
+
+        for (uint32 i = 0; i < 3 * nValues; i++)
+        {
+            pCurves[i] = (uint16)(nValues - 1 - (i & (nValues - 1)));
+        }
+        return true;
+    }
+};
+
+INvFilter *nvCreateInvertFilter(CNvFilterOptions &oOptions)
+{
+    return new CNvInvertFilter();
+}
+
+// saturation: each channel moved away from (or towards) the pixel's luma,
+// BT.709 weights in Q8; needs all three channels, so it isn't a curve
+class CNvSaturationFilter : public INvFilter
+{
+public:
+    explicit CNvSaturationFilter(double fAmount): m_nAmount((int32)(fAmount * 256.0 + 0.5))
+    {
+    }
+
+    virtual const char *Name() const
+    {
+        return "saturation";
+    }
+
+    virtual NvFilterAccess Access() const
+    {
+        return NV_FILTER_POINTWISE;
+    }
+
+    virtual bool Supports2101010() const
+    {
+        return true;
+    }
+
+    virtual void ProcessRow(uint32 *pARGB, uint32 width, bool b2101010) const
+    {
+        if (b2101010)
+        {
+            Saturate<10>(pARGB, width, 0xc0000000);
+        }
+        else
+        {
+            Saturate<8>(pARGB, width, 0xff000000);
+        }
+    }
+
+private:
+    template <int BITS>
+    void Saturate(uint32 *pARGB, uint32 width, uint32 uAlpha) const
+    {
+        const int32 nMax = (1 << BITS) - 1;
+
+        for (uint32 x = 0; x < width; x++)
+        {
+            int32 c[3] = { (int32)(pARGB[x] >> (2 * BITS)) & nMax, (int32)(pARGB[x] >> BITS) & nMax, (int32)pARGB[x] & nMax };
+            int32 y = (54 * c[0] + 183 * c[1] + 19 * c[2] + 128) >> 8;
+            uint32 p = uAlpha;
+
+            for (int i = 0; i < 3; i++)
+            {
+                int32 v = y + (((c[i] - y) * m_nAmount + 128) >> 8);
+                p |= (uint32)std::min(std::max(v, 0), nMax) << ((2 - i) * BITS);
+            }
+            pARGB[x] = p;
+        }
+    }
+
+    int32 m_nAmount;    // Q8
+};
+
+INvFilter *nvCreateSaturationFilter(CNvFilterOptions &oOptions)
+{
+    double fAmount;
+
+    if (!oOptions.Get("amount", 1.0, 0.0, 4.0, &fAmount))
+        return NULL;
+    return new CNvSaturationFilter(fAmount);
+}
+
+// dilate / erode: per-channel maximum or minimum over a square, as a row
+// pass and then a column pass, since both separate. The window is clamped
+// at the edges.
+class CNvMorphologyFilter : public INvFilter
+{
+public:
+    CNvMorphologyFilter(bool bDilate, uint32 nRadius): m_bDilate(bDilate), m_nRadius(nRadius)
+    {
+    }
+
+    virtual const char *Name() const
+    {
+        return m_bDilate ? "dilate" : "erode";
+    }
+
+    virtual NvFilterAccess Access() const
+    {
+        return NV_FILTER_NEIGHBORHOOD;
+    }
+
+    virtual uint32 HaloRows() const
+    {
+        return m_nRadius;
+    }
+
+    virtual void ProcessFrame(uint32 *pARGB, size_t nPitch, uint32 width, uint32 height)
+    {
+        if (m_bDilate)
+        {
+            Run<true>(pARGB, nPitch, width, height);
+        }
+        else
+        {
+            Run<false>(pARGB, nPitch, width, height);
+        }
+    }
+
+private:
+    template <bool MAX>
+    static inline uint32 Pick(uint32 a, uint32 b)
+    {
+        uint32 r = MAX ? std::max(a & 0xff0000, b & 0xff0000) : std::min(a & 0xff0000, b & 0xff0000);
+        uint32 g = MAX ? std::max(a & 0xff00, b & 0xff00) : std::min(a & 0xff00, b & 0xff00);
+        uint32 c = MAX ? std::max(a & 0xff, b & 0xff) : std::min(a & 0xff, b & 0xff);
+        return 0xff000000 | r | g | c;
+    }
+
+    template <bool MAX>
+    void Run(uint32 *pARGB, size_t nPitch, uint32 width, uint32 height) const
+    {
+        // the rows after the horizontal pass; per thread, strips run at once
+        static thread_local std::vector<uint32> tls_vRows;
+        tls_vRows.resize((size_t)width * height);
+        int32 nRadius = (int32)m_nRadius;
+
+        for (uint32 y = 0; y < height; y++)
+        {
+            const uint32 *pRow = (const uint32 *)((const uint8 *)pARGB + y * nPitch);
+            uint32 *pOut = &tls_vRows[(size_t)y * width];
+
+            for (int32 x = 0; x < (int32)width; x++)
+            {
+                uint32 p = pRow[x];
+                for (int32 k = 1; k <= nRadius; k++)
+                {
+                    p = Pick<MAX>(p, pRow[std::max(x - k, 0)]);
+                    p = Pick<MAX>(p, pRow[std::min(x + k, (int32)width - 1)]);
+                }
+                pOut[x] = p;
+            }
+        }
+
+        for (int32 y = 0; y < (int32)height; y++)
+        {
+            uint32 *pOut = (uint32 *)((uint8 *)pARGB + y * nPitch);
+
+            for (uint32 x = 0; x < width; x++)
+            {
+                uint32 p = tls_vRows[(size_t)y * width + x];
+                for (int32 k = 1; k <= nRadius; k++)
+                {
+                    p = Pick<MAX>(p, tls_vRows[(size_t)std::max(y - k, 0) * width + x]);
+                    p = Pick<MAX>(p, tls_vRows[(size_t)std::min(y + k, (int32)height - 1) * width + x]);
+                }
+                pOut[x] = p;
+            }
+        }
+    }
+
+    bool   m_bDilate;
+    uint32 m_nRadius;
+};
+
+static INvFilter *createMorphologyFilter(CNvFilterOptions &oOptions, bool bDilate)
+{
+    double fRadius;
+
+    if (!oOptions.Get("radius", 1.0, 1.0, 16.0, &fRadius))
+        return NULL;
+    return new CNvMorphologyFilter(bDilate, (uint32)fRadius);
+}
+
+INvFilter *nvCreateDilateFilter(CNvFilterOptions &oOptions)
+{
+    return createMorphologyFilter(oOptions, true);
+}
+
+INvFilter *nvCreateErodeFilter(CNvFilterOptions &oOptions)
+{
+    return createMorphologyFilter(oOptions, false);
+}
+
+// box / gauss: a box blur, or a Gaussian as a few box blurs in a row,
+// each box a horizontal and a vertical pass of running sums, so the cost
+// per pixel doesn't depend on the radius. The rows run all their
+// horizontal passes while they sit in L1; the vertical passes go down
+// blocks of BLUR_BLOCK_PIXELS columns, with the rows a window still has to
+// subtract kept in a ring, since the frame is overwritten in place. The
+// window is clamped at the edges.
+#define BLUR_BLOCK_PIXELS 64
+
+static inline uint32 *filterRow(uint32 *pARGB, size_t nPitch, uint32 y)
+{
+    return (uint32 *)((uint8 *)pARGB + y * nPitch);
+}
+
+class CNvBoxBlurFilter : public INvFilter
+{
+public:
+    CNvBoxBlurFilter(const char *szName, const std::vector<uint32> &vRadii): m_szName(szName), m_nHalo(0)
+    {
+        for (size_t i = 0; i < vRadii.size(); i++)
+        {
+            if (vRadii[i])
+            {
+                m_vRadii.push_back(vRadii[i]);
+                m_nHalo += vRadii[i];
+            }
+        }
+    }
+
+    virtual const char *Name() const
+    {
+        return m_szName;
+    }
+
+    virtual NvFilterAccess Access() const
+    {
+        return NV_FILTER_NEIGHBORHOOD;
+    }
+
+    virtual uint32 HaloRows() const
+    {
+        return m_nHalo;
+    }
+
+    virtual void ProcessFrame(uint32 *pARGB, size_t nPitch, uint32 width, uint32 height)
+    {
+        const CpuFilterKernels &oKernels = cpuFilterKernels();
+
+        if (m_vRadii.empty())
+            return;
+
+        for (uint32 y = 0; y < height; y++)
+        {
+            uint32 *pRow = (uint32 *)((uint8 *)pARGB + y * nPitch);
+            for (size_t i = 0; i < m_vRadii.size(); i++)
+            {
+                BlurRow(oKernels, pRow, pRow, width, m_vRadii[i]);
+            }
+        }
+
+        for (uint32 x = 0; x < width; x += BLUR_BLOCK_PIXELS)
+        {
+            for (size_t i = 0; i < m_vRadii.size(); i++)
+            {
+                BlurColumns(oKernels, pARGB + x, nPitch, std::min(width - x, (uint32)BLUR_BLOCK_PIXELS), height, m_vRadii[i]);
+            }
+        }
+    }
+
+    static uint32 Scale(uint32 nRadius)
+    {
+        return (65536 + nRadius) / (2 * nRadius + 1);
+    }
+
+    // one horizontal pass over pSrc into pDst, which may be pSrc, through a
+    // copy with the edge pixels repeated r times before it and r + 1 after
+    static void BlurRow(const CpuFilterKernels &oKernels, const uint32 *pSrc, uint32 *pDst, uint32 width, uint32 nRadius)
+    {
+        static thread_local std::vector<uint32> tls_vPadded;
+        tls_vPadded.resize(width + 2 * nRadius + 1);
+        uint32 *pPadded = &tls_vPadded[nRadius];
+
+        std::fill(pPadded - nRadius, pPadded, pSrc[0]);
+        std::copy(pSrc, pSrc + width, pPadded);
+        std::fill(pPadded + width, pPadded + width + nRadius + 1, pSrc[width - 1]);
+
+        oKernels.pfnBoxBlurRow(pPadded, pDst, width, nRadius, Scale(nRadius));
+    }
+
+    // One vertical pass down nPixels columns from pColumns. Row y is saved
+    // to slot y % (r + 1) of the ring before its output replaces it, and
+    // stays there until row y + r, the last window to subtract it, is out.
+    static void BlurColumns(const CpuFilterKernels &oKernels, uint32 *pColumns, size_t nPitch,
+                            uint32 nPixels, uint32 height, uint32 nRadius)
+    {
+        static thread_local std::vector<uint32> tls_vSums;
+        static thread_local std::vector<uint32> tls_vRing;
+        tls_vSums.assign(4 * nPixels, 0);
+        tls_vRing.resize((size_t)(nRadius + 1) * nPixels);
+        uint32 nScale = Scale(nRadius);
+
+        // the window of row 0: rows -r..r, clamped
+        for (int32 k = -(int32)nRadius; k <= (int32)nRadius; k++)
+        {
+            const uint32 *pRow = filterRow(pColumns, nPitch, std::min((uint32)std::max(k, 0), height - 1));
+            for (uint32 x = 0; x < nPixels; x++)
+            {
+                for (uint32 c = 0; c < 4; c++)
+                {
+                    tls_vSums[4 * x + c] += cpuBoxChannel(pRow[x], c);
+                }
+            }
+        }
+
+        for (uint32 y = 0; y < height; y++)
+        {
+            uint32 *pRow = filterRow(pColumns, nPitch, y);
+            const uint32 *pAdd = filterRow(pColumns, nPitch, std::min(y + nRadius + 1, height - 1));
+            const uint32 *pSub = &tls_vRing[(size_t)((y > nRadius ? y - nRadius : 0) % (nRadius + 1)) * nPixels];
+
+            std::copy(pRow, pRow + nPixels, &tls_vRing[(size_t)(y % (nRadius + 1)) * nPixels]);
+            oKernels.pfnBoxBlurColumns(&tls_vSums[0], pAdd, pSub, pRow, nPixels, nScale);
+        }
+    }
+
+private:
+    const char          *m_szName;
+    std::vector<uint32>  m_vRadii;      // one per box pass
+    uint32               m_nHalo;
+};
+
+INvFilter *nvCreateBoxBlurFilter(CNvFilterOptions &oOptions)
+{
+    double fRadius, fPasses;
+
+    if (!oOptions.Get("radius", 2.0, 0.0, 127.0, &fRadius) || !oOptions.Get("passes", 1.0, 1.0, 4.0, &fPasses))
+        return NULL;
+    return new CNvBoxBlurFilter("box", std::vector<uint32>((size_t)fPasses, (uint32)fRadius));
+}
+
+// Widths of n boxes whose repeated blur has standard deviation sigma: the
+// first m of width wl and the rest of wl + 2, wl the odd width just below
+// the ideal one (W. Kovesi, "Fast almost-Gaussian filtering", 2010).
+std::vector<uint32> nvGaussBoxRadii(double fSigma, uint32 nBoxes)
+{
+    double fIdeal = sqrt(12.0 * fSigma * fSigma / nBoxes + 1.0);
+    int32 wl = (int32)floor(fIdeal);
+    if (wl % 2 == 0)
+        wl--;
+    int32 m = (int32)floor((12.0 * fSigma * fSigma - nBoxes * wl * wl - 4.0 * nBoxes * wl - 3.0 * nBoxes) / (-4.0 * wl - 4.0) + 0.5);
+
+    std::vector<uint32> vRadii;
+    for (int32 i = 0; i < (int32)nBoxes; i++)
+    {
+        vRadii.push_back((uint32)(((i < m ? wl : wl + 2) - 1) / 2));
+    }
+    return vRadii;
+}
+
+INvFilter *nvCreateGaussFilter(CNvFilterOptions &oOptions)
+{
+    double fSigma;
+
+    if (!oOptions.Get("sigma", 2.0, 1.0, 64.0, &fSigma))
+        return NULL;
+    return new CNvBoxBlurFilter("gauss", nvGaussBoxRadii(fSigma, 3));
+}
+
+// unsharp: original + amount * (original - blur) per channel, where the
+// two differ by more than the threshold, the blur a box of the radius. One
+// pass down the rows does it all: a ring holds the row blurs of the 2r + 2
+// rows around the current one, the column sums of their window give the
+// blur of a row while the original is still in the frame, and the output
+// then replaces it. The scratch is those rows, not a second frame.
+class CNvUnsharpFilter : public INvFilter
+{
+public:
+    CNvUnsharpFilter(uint32 nRadius, double fAmount, uint32 nThreshold):
+        m_nRadius(nRadius), m_nAmount((int32)(fAmount * 256.0 + 0.5)), m_nThreshold((int32)nThreshold)
+    {
+    }
+
+    virtual const char *Name() const
+    {
+        return "unsharp";
+    }
+
+    virtual NvFilterAccess Access() const
+    {
+        return NV_FILTER_NEIGHBORHOOD;
+    }
+
+    virtual uint32 HaloRows() const
+    {
+        return m_nRadius;
+    }
+
+    virtual void ProcessFrame(uint32 *pARGB, size_t nPitch, uint32 width, uint32 height)
+    {
+        const CpuFilterKernels &oKernels = cpuFilterKernels();
+        uint32 nRing = 2 * m_nRadius + 2;
+        uint32 nScale = CNvBoxBlurFilter::Scale(m_nRadius);
+
+        static thread_local std::vector<uint32> tls_vSums;
+        static thread_local std::vector<uint32> tls_vRing;
+        tls_vSums.assign(4 * (size_t)width, 0);
+        tls_vRing.resize((size_t)nRing * width);
+
+        // the row blur of row y, in its slot of the ring
+        auto fnRing = [&](uint32 y) { return &tls_vRing[(size_t)(y % nRing) * width]; };
+
+        // the window of row 0: rows -r..r, clamped
+        for (uint32 y = 0; y <= std::min(m_nRadius, height - 1); y++)
+        {
+            CNvBoxBlurFilter::BlurRow(oKernels, filterRow(pARGB, nPitch, y), fnRing(y), width, m_nRadius);
+        }
+        for (int32 k = -(int32)m_nRadius; k <= (int32)m_nRadius; k++)
+        {
+            const uint32 *pBlur = fnRing(std::min((uint32)std::max(k, 0), height - 1));
+            for (uint32 x = 0; x < width; x++)
+            {
+                for (uint32 c = 0; c < 4; c++)
+                {
+                    tls_vSums[4 * x + c] += cpuBoxChannel(pBlur[x], c);
+                }
+            }
+        }
+
+        for (uint32 y = 0; y < height; y++)
+        {
+            // row y + r + 1 is still the original, the frame has only been
+            // written above y
+            uint32 yAdd = std::min(y + m_nRadius + 1, height - 1);
+            if (yAdd == y + m_nRadius + 1)
+            {
+                CNvBoxBlurFilter::BlurRow(oKernels, filterRow(pARGB, nPitch, yAdd), fnRing(yAdd), width, m_nRadius);
+            }
+
+            oKernels.pfnUnsharpRow(&tls_vSums[0], fnRing(yAdd), fnRing(y > m_nRadius ? y - m_nRadius : 0),
+                                   filterRow(pARGB, nPitch, y), width, nScale, m_nAmount, m_nThreshold);
+        }
+    }
+
+private:
+    uint32 m_nRadius;
+    int32  m_nAmount;       // Q8
+    int32  m_nThreshold;
+};
+
+INvFilter *nvCreateUnsharpFilter(CNvFilterOptions &oOptions)
+{
+    double fRadius, fAmount, fThreshold;
+
+    if (!oOptions.Get("radius", 2.0, 1.0, 32.0, &fRadius) || !oOptions.Get("amount", 1.0, 0.0, 5.0, &fAmount) ||
+        !oOptions.Get("threshold", 0.0, 0.0, 255.0, &fThreshold))
+        return NULL;
+    return new CNvUnsharpFilter((uint32)fRadius, fAmount, (uint32)fThreshold);
+}
+
+// median: the median of a 3x3 or 5x5 window, of every channel on its own,
+// or of luma only, with R, G and B then moved by the pixel's change in
+// luma so the chroma stays. The N rows of the window are copies in a ring,
+// padded with the edge pixels, so the output can replace the frame row as
+// it goes; the medians are the min/max networks of cpuMedianRow().
+class CNvMedianFilter : public INvFilter
+{
+public:
+    CNvMedianFilter(uint32 nSize, bool bLuma): m_nSize(nSize), m_bLuma(bLuma)
+    {
+    }
+
+    virtual const char *Name() const
+    {
+        return "median";
+    }
+
+    virtual NvFilterAccess Access() const
+    {
+        return NV_FILTER_NEIGHBORHOOD;
+    }
+
+    virtual uint32 HaloRows() const
+    {
+        return m_nSize / 2;
+    }
+
+    virtual void ProcessFrame(uint32 *pARGB, size_t nPitch, uint32 width, uint32 height)
+    {
+        const CpuFilterKernels &oKernels = cpuFilterKernels();
+        MedianRowFunc pfnMedian = m_nSize == 3 ? oKernels.pfnMedian3Row : oKernels.pfnMedian5Row;
+        uint32 nHalo = m_nSize / 2;
+        uint32 nStep = m_bLuma ? 1 : 4;
+        uint32 nBytes = width * nStep;
+        uint32 nPadded = nBytes + 2 * nHalo * nStep;
+
+        static thread_local std::vector<uint8> tls_vRing;
+        static thread_local std::vector<uint8> tls_vLuma;
+        tls_vRing.resize((size_t)m_nSize * nPadded);
+        tls_vLuma.resize(width);
+
+        // row y into its slot of the ring, as ARGB or luma, edges repeated
+        auto fnSlot = [&](uint32 y) { return &tls_vRing[(size_t)(y % m_nSize) * nPadded + nHalo * nStep]; };
+        auto fnLoad = [&](uint32 y)
+        {
+            const uint32 *pRow = filterRow(pARGB, nPitch, y);
+            uint8 *pSlot = fnSlot(y);
+
+            if (m_bLuma)
+            {
+                oKernels.pfnARGBLumaRow(pRow, pSlot, width);
+            }
+            else
+            {
+                memcpy(pSlot, pRow, nBytes);
+            }
+            for (uint32 i = 0; i < nHalo * nStep; i++)
+            {
+                pSlot[(int32)i - (int32)(nHalo * nStep)] = pSlot[i % nStep];
+                pSlot[nBytes + i] = pSlot[nBytes - nStep + i % nStep];
+            }
+        };
+
+        for (uint32 y = 0; y < std::min(nHalo, height); y++)
+        {
+            fnLoad(y);
+        }
+
+        for (uint32 y = 0; y < height; y++)
+        {
+            // row y + N / 2 is still the original, the frame has only been
+            // written above y
+            if (y + nHalo < height)
+            {
+                fnLoad(y + nHalo);
+            }
+
+            const uint8 *apRows[5];
+            for (uint32 r = 0; r < m_nSize; r++)
+            {
+                apRows[r] = fnSlot((uint32)std::min(std::max((int32)(y + r) - (int32)nHalo, 0), (int32)height - 1));
+            }
+
+            uint32 *pRow = filterRow(pARGB, nPitch, y);
+            if (!m_bLuma)
+            {
+                pfnMedian(apRows, (uint8 *)pRow, nBytes, nStep);
+                continue;
+            }
+
+            pfnMedian(apRows, &tls_vLuma[0], nBytes, nStep);
+            oKernels.pfnShiftLumaRow(pRow, apRows[nHalo], &tls_vLuma[0], width);
+        }
+    }
+
+private:
+    uint32 m_nSize;         // 3 or 5
+    bool   m_bLuma;
+};
+
+INvFilter *nvCreateMedianFilter(CNvFilterOptions &oOptions)
+{
+    double fSize, fLuma;
+
+    if (!oOptions.Get("size", 3.0, 3.0, 5.0, &fSize) || !oOptions.Get("luma", 0.0, 0.0, 1.0, &fLuma))
+        return NULL;
+    if (fSize != 3.0 && fSize != 5.0)
+    {
+        printf("CNvFilterGraph: median: size must be 3 or 5\n");
+        return NULL;
+    }
+    return new CNvMedianFilter((uint32)fSize, fLuma != 0.0);
+}
+
+// bilateral: a denoiser of luma that averages the window weighted by
+// distance and by difference from the centre, exp(-d^2 / 2 sigma^2) of
+// each, both in Q8 tables built once with the filter, so a tap is two
+// lookups and a multiply. As the only filter it runs on the Y plane of
+// NV12; in a longer chain it takes the luma of the ARGB frame and moves R,
+// G and B by the change. Each source row is copied once per strip into a
+// ring of 2r + 1 padded rows that every tap then reads.
+class CNvBilateralFilter : public INvFilter
+{
+public:
+    CNvBilateralFilter(uint32 nRadius, double fSpatial, double fRange): m_nRadius(nRadius), m_vRange(511)
+    {
+        int32 r = (int32)nRadius;
+
+        for (int32 dy = -r; dy <= r; dy++)
+        {
+            for (int32 dx = -r; dx <= r; dx++)
+            {
+                m_vSpatial.push_back((uint32)(256.0 * exp(-(dx * dx + dy * dy) / (2.0 * fSpatial * fSpatial)) + 0.5));
+            }
+        }
+        for (int32 d = -255; d <= 255; d++)
+        {
+            m_vRange[d + 255] = (uint32)(256.0 * exp(-d * d / (2.0 * fRange * fRange)) + 0.5);
+        }
+    }
+
+    virtual const char *Name() const
+    {
+        return "bilateral";
+    }
+
+    virtual NvFilterAccess Access() const
+    {
+        return NV_FILTER_NEIGHBORHOOD;
+    }
+
+    virtual uint32 HaloRows() const
+    {
+        return m_nRadius;
+    }
+
+    virtual bool SupportsLuma() const
+    {
+        return true;
+    }
+
+    virtual void ProcessLuma(const uint8 *pSrc, size_t nSourcePitch, uint8 *pDst, size_t nDestPitch,
+                             uint32 width, uint32 height, uint32 yBegin, uint32 yEnd) const
+    {
+        uint32 nRing = 2 * m_nRadius + 1;
+        uint32 nPadded = width + 2 * m_nRadius;
+        int32 r = (int32)m_nRadius;
+
+        static thread_local std::vector<uint8> tls_vRing;
+        tls_vRing.resize((size_t)nRing * nPadded);
+
+        // source row y, clamped, in its slot of the ring with the edge
+        // pixels repeated r times on either side
+        auto fnSlot = [&](int32 y) { return &tls_vRing[(size_t)(((uint32)y + nRing) % nRing) * nPadded + m_nRadius]; };
+        auto fnLoad = [&](int32 y)
+        {
+            const uint8 *pRow = pSrc + std::min((uint32)std::max(y, 0), height - 1) * nSourcePitch;
+            uint8 *pSlot = fnSlot(y);
+
+            memcpy(pSlot, pRow, width);
+            memset(pSlot - r, pRow[0], m_nRadius);
+            memset(pSlot + width, pRow[width - 1], m_nRadius);
+        };
+
+        for (int32 y = (int32)yBegin - r; y < (int32)yBegin + r; y++)
+        {
+            fnLoad(y);
+        }
+
+        for (uint32 y = yBegin; y < yEnd; y++)
+        {
+            fnLoad((int32)y + r);
+
+            const uint8 *apRows[2 * 16 + 1];
+            for (int32 dy = -r; dy <= r; dy++)
+            {
+                apRows[dy + r] = fnSlot((int32)y + dy) - r;
+            }
+
+            uint8 *pOut = pDst + y * nDestPitch;
+            for (uint32 x = 0; x < width; x++)
+            {
+                const uint32 *pRange = &m_vRange[255 - apRows[r][x + r]];
+                const uint32 *pSpatial = &m_vSpatial[0];
+                // up to 33 x 33 taps of Q16 weights: the sum needs 64 bits
+                unsigned long long nSum = 0;
+                uint32 nWeights = 0;
+
+                for (uint32 k = 0; k < nRing; k++)
+                {
+                    const uint8 *pTaps = apRows[k] + x;
+                    for (uint32 dx = 0; dx < nRing; dx++)
+                    {
+                        uint32 q = pTaps[dx];
+                        uint32 w = *pSpatial++ * pRange[q];
+                        nSum += w * q;
+                        nWeights += w;
+                    }
+                }
+                pOut[x] = (uint8)((nSum + nWeights / 2) / nWeights);
+            }
+        }
+    }
+
+    virtual void ProcessFrame(uint32 *pARGB, size_t nPitch, uint32 width, uint32 height)
+    {
+        const CpuFilterKernels &oKernels = cpuFilterKernels();
+
+        static thread_local std::vector<uint8> tls_vLuma;
+        tls_vLuma.resize(2 * (size_t)width * height);
+        uint8 *pLuma = &tls_vLuma[0];
+        uint8 *pFiltered = pLuma + (size_t)width * height;
+
+        for (uint32 y = 0; y < height; y++)
+        {
+            oKernels.pfnARGBLumaRow(filterRow(pARGB, nPitch, y), pLuma + (size_t)y * width, width);
+        }
+        ProcessLuma(pLuma, width, pFiltered, width, width, height, 0, height);
+        for (uint32 y = 0; y < height; y++)
+        {
+            oKernels.pfnShiftLumaRow(filterRow(pARGB, nPitch, y), pLuma + (size_t)y * width, pFiltered + (size_t)y * width, width);
+        }
+    }
+
+private:
+    uint32              m_nRadius;
+    std::vector<uint32> m_vSpatial;     // Q8 per tap, row by row
+    std::vector<uint32> m_vRange;       // Q8 per difference -255..255
+};
+
+INvFilter *nvCreateBilateralFilter(CNvFilterOptions &oOptions)
+{
+    double fRadius, fSpatial, fRange;
+
+    if (!oOptions.Get("radius", 2.0, 1.0, 16.0, &fRadius) || !oOptions.Get("spatial", 1.5, 0.3, 16.0, &fSpatial) ||
+        !oOptions.Get("range", 12.0, 1.0, 255.0, &fRange))
+        return NULL;
+    return new CNvBilateralFilter((uint32)fRadius, fSpatial, fRange);
+}
+
+// tavg: exponential running average, out = W * frame + (1 - W) * previous
+// out, per channel in Q8. The first frame, and any after a size change,
+// passes through and starts the average.
+class CNvTemporalAverageFilter : public INvFilter
+{
+public:
+    explicit CNvTemporalAverageFilter(double fWeight): m_nWeight((uint32)(fWeight * 256.0 + 0.5)), m_nWidth(0), m_nHeight(0)
+    {
+    }
+
+    virtual const char *Name() const
+    {
+        return "tavg";
+    }
+
+    virtual NvFilterAccess Access() const
+    {
+        return NV_FILTER_TEMPORAL;
+    }
+
+    virtual void ProcessFrame(uint32 *pARGB, size_t nPitch, uint32 width, uint32 height)
+    {
+        bool bFirst = width != m_nWidth || height != m_nHeight;
+
+        m_vPrevious.resize((size_t)width * height);
+        m_nWidth  = width;
+        m_nHeight = height;
+
+        for (uint32 y = 0; y < height; y++)
+        {
+            uint32 *pRow = (uint32 *)((uint8 *)pARGB + y * nPitch);
+            uint32 *pPrevious = &m_vPrevious[(size_t)y * width];
+
+            for (uint32 x = 0; x < width && !bFirst; x++)
+            {
+                uint32 p = 0xff000000;
+                for (uint32 nShift = 0; nShift < 24; nShift += 8)
+                {
+                    uint32 uNew = (pRow[x] >> nShift) & 0xff;
+                    uint32 uOld = (pPrevious[x] >> nShift) & 0xff;
+                    p |= ((uNew * m_nWeight + uOld * (256 - m_nWeight) + 128) >> 8) << nShift;
+                }
+                pRow[x] = p;
+            }
+            std::copy(pRow, pRow + width, pPrevious);
+        }
+    }
+
+    virtual void Reset()
+    {
+        m_nWidth = m_nHeight = 0;
+    }
+
+private:
+    uint32              m_nWeight;      // Q8
+    uint32              m_nWidth;       // of m_vPrevious, 0 before the first frame
+    uint32              m_nHeight;
+    std::vector<uint32> m_vPrevious;
+};
+
+INvFilter *nvCreateTemporalAverageFilter(CNvFilterOptions &oOptions)
+{
+    double fWeight;
+
+    if (!oOptions.Get("weight", 0.25, 0.01, 1.0, &fWeight))
+        return NULL;
+    return new CNvTemporalAverageFilter(fWeight);
+}
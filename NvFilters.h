@@ -0,0 +1,43 @@
+/*
+ * Copyright 1993-2015 NVIDIA Corporation.  All rights reserved.
+ *
+ * Please refer to the NVIDIA end user license agreement (EULA) associated
+ * with this source code for terms and conditions that govern your use of
+ * this software. Any use, reproduction, disclosure, or distribution of
+ * this software and related documentation outside the terms of the EULA
+ * is strictly prohibited.
+ *
+ */
+
+#ifndef NV_FILTERS_H
+#define NV_FILTERS_H
+
+#include "NvFilterGraph.h"
+
+// Factories of the filters in the registry of NvFilterGraph.cpp; a new
+// filter adds its factory here and a line to the registry.
+
+// curves
+INvFilter *nvCreateKeepRedFilter(CNvFilterOptions &oOptions);
+INvFilter *nvCreateLevelsFilter(CNvFilterOptions &oOptions);
+INvFilter *nvCreateInvertFilter(CNvFilterOptions &oOptions);
+
+// other point-wise filters
+INvFilter *nvCreateSaturationFilter(CNvFilterOptions &oOptions);
+
+// neighbourhood
+INvFilter *nvCreateDilateFilter(CNvFilterOptions &oOptions);
+INvFilter *nvCreateErodeFilter(CNvFilterOptions &oOptions);
+INvFilter *nvCreateBoxBlurFilter(CNvFilterOptions &oOptions);
+INvFilter *nvCreateGaussFilter(CNvFilterOptions &oOptions);
+INvFilter *nvCreateUnsharpFilter(CNvFilterOptions &oOptions);
+INvFilter *nvCreateMedianFilter(CNvFilterOptions &oOptions);
+INvFilter *nvCreateBilateralFilter(CNvFilterOptions &oOptions);
+
+// radii of the nBoxes box blurs that approximate a Gaussian of fSigma
+std::vector<uint32> nvGaussBoxRadii(double fSigma, uint32 nBoxes);
+
+// temporal
+INvFilter *nvCreateTemporalAverageFilter(CNvFilterOptions &oOptions);
+
+#endif // NV_FILTERS_H
@@ -0,0 +1,252 @@
+/*
+ * Copyright 1993-2015 NVIDIA Corporation.  All rights reserved.
+ *
+ * Please refer to the NVIDIA end user license agreement (EULA) associated
+ * with this source code for terms and conditions that govern your use of
+ * this software. Any use, reproduction, disclosure, or distribution of
+ * this software and related documentation outside the terms of the EULA
+ * is strictly prohibited.
+ *
+ */
+
+#include "NvFramePool.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+
+const char *nvFrameFormatName(NvFrameFormat eFormat)
+{
+    static const char *names[NV_FRAME_FORMAT_COUNT] = { "NV12", "P010", "ARGB" };
+    return (eFormat >= 0 && eFormat < NV_FRAME_FORMAT_COUNT) ? names[eFormat] : "unknown";
+}
+
+size_t nvFrameRowBytes(NvFrameFormat eFormat, unsigned int width)
+{
+    switch (eFormat)
+    {
+        case NV_FRAME_FORMAT_NV12: return nvPixelFormatMinPitch(NV_PIXEL_FORMAT_NV12, width);
+        case NV_FRAME_FORMAT_P010: return 2 * nvPixelFormatMinPitch(NV_PIXEL_FORMAT_NV12, width);
+        case NV_FRAME_FORMAT_ARGB: return 4 * (size_t)width;
+        default:                   return 0;
+    }
+}
+
+size_t nvFrameBytes(NvFrameFormat eFormat, size_t nPitch, unsigned int height)
+{
+    switch (eFormat)
+    {
+        // P010 is NV12 at twice the pitch
+        case NV_FRAME_FORMAT_NV12:
+        case NV_FRAME_FORMAT_P010: return nvPixelFormatFrameBytes(NV_PIXEL_FORMAT_NV12, nPitch, height);
+        case NV_FRAME_FORMAT_ARGB: return nPitch * height;
+        default:                   return 0;
+    }
+}
+
+void *CNvHostFrameAllocator::Allocate(size_t nBytes, size_t nAlign)
+{
+    void *pData = NULL;
+    if (posix_memalign(&pData, nAlign < sizeof(void *) ? sizeof(void *) : nAlign, nBytes))
+        return NULL;
+    return pData;
+}
+
+void CNvHostFrameAllocator::Free(void *pData)
+{
+    free(pData);
+}
+
+void CNvFrameRef::Reset()
+{
+    if (m_pFrame && m_pFrame->nRefs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+        m_pFrame->pPool->Recycle(m_pFrame);
+    }
+    m_pFrame = NULL;
+}
+
+size_t CNvFrameRef::Pitch() const
+{
+    return m_pFrame ? m_pFrame->pPool->Pitch() : 0;
+}
+
+CNvFramePool::CNvFramePool(): m_pAllocator(NULL), m_nPitch(0), m_nFrameBytes(0), m_nInUse(0), m_nHighWater(0),
+                              m_nAcquires(0), m_nAcquireWaits(0), m_nAcquireWaitUs(0)
+{
+    memset(&m_oConfig, 0, sizeof(m_oConfig));
+}
+
+CNvFramePool::~CNvFramePool()
+{
+    Deinitialize();
+}
+
+bool CNvFramePool::Initialize(const NvFramePoolConfig &oConfig, INvFrameAllocator *pAllocator)
+{
+    Deinitialize();
+
+    unsigned int nPitchAlign = oConfig.nPitchAlign ? oConfig.nPitchAlign : NV_FRAME_POOL_PITCH_ALIGN;
+    if ((nPitchAlign & (nPitchAlign - 1)) || !oConfig.nMaxFrames || oConfig.nPrealloc > oConfig.nMaxFrames)
+    {
+        assert(0);
+        return false;
+    }
+
+    m_oConfig = oConfig;
+    m_oConfig.nPitchAlign = nPitchAlign;
+    m_pAllocator = pAllocator;
+    m_nPitch = (nvFrameRowBytes(oConfig.eFormat, oConfig.width) + nPitchAlign - 1) & ~(size_t)(nPitchAlign - 1);
+    m_nFrameBytes = nvFrameBytes(oConfig.eFormat, m_nPitch, oConfig.height);
+    m_nHighWater = 0;
+    m_nAcquires = m_nAcquireWaits = m_nAcquireWaitUs = 0;
+
+    for (unsigned int i = 0; i < oConfig.nPrealloc; i++)
+    {
+        NvPooledFrame *pFrame = AllocateFrame();
+        if (!pFrame)
+        {
+            Deinitialize();
+            return false;
+        }
+        m_vFrames.push_back(pFrame);
+        m_vFree.push_back(pFrame);
+    }
+    return true;
+}
+
+void CNvFramePool::Deinitialize()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // a frame still referenced would be freed under its holder
+    assert(m_nInUse == 0);
+
+    for (size_t i = 0; i < m_vFrames.size(); i++)
+    {
+        m_pAllocator->Free(m_vFrames[i]->pData);
+        delete m_vFrames[i];
+    }
+    m_vFrames.clear();
+    m_vFree.clear();
+}
+
+NvPooledFrame *CNvFramePool::AllocateFrame()
+{
+    // the first row starts on the same boundary as the others
+    void *pData = m_pAllocator->Allocate(m_nFrameBytes, m_oConfig.nPitchAlign);
+    if (!pData)
+    {
+        printf("CNvFramePool: %s allocation of %zu bytes failed\n", m_pAllocator->Name(), m_nFrameBytes);
+        return NULL;
+    }
+
+    NvPooledFrame *pFrame = new NvPooledFrame;
+    pFrame->pData = pData;
+    pFrame->pPool = this;
+    pFrame->nRefs.store(0);
+    return pFrame;
+}
+
+CNvFrameRef CNvFramePool::TakeFrame(bool bWait)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    m_nAcquires++;
+    if (m_vFree.empty() && m_vFrames.size() >= m_oConfig.nMaxFrames)
+    {
+        if (!bWait)
+            return CNvFrameRef();
+
+        std::chrono::steady_clock::time_point tStart = std::chrono::steady_clock::now();
+        // a free frame, or room to allocate one after Trim()
+        m_cvFree.wait(lock, [this] { return !m_vFree.empty() || m_vFrames.size() < m_oConfig.nMaxFrames; });
+        m_nAcquireWaits++;
+        m_nAcquireWaitUs += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - tStart).count();
+    }
+
+    NvPooledFrame *pFrame = NULL;
+    if (!m_vFree.empty())
+    {
+        pFrame = m_vFree.back();
+        m_vFree.pop_back();
+    }
+    else
+    {
+        // Below the limit: grow. Allocation can be slow (pinned memory), but
+        // a release on another thread only ever takes the lock briefly to
+        // push its frame, and nothing else could be handed out meanwhile.
+        pFrame = AllocateFrame();
+        if (!pFrame)
+            return CNvFrameRef();
+        m_vFrames.push_back(pFrame);
+    }
+
+    m_nInUse++;
+    if (m_nInUse > m_nHighWater)
+    {
+        m_nHighWater = m_nInUse;
+    }
+
+    pFrame->nRefs.store(1, std::memory_order_relaxed);
+    return CNvFrameRef(pFrame);
+}
+
+CNvFrameRef CNvFramePool::Acquire()
+{
+    return TakeFrame(true);
+}
+
+CNvFrameRef CNvFramePool::TryAcquire()
+{
+    return TakeFrame(false);
+}
+
+void CNvFramePool::Recycle(NvPooledFrame *pFrame)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_vFree.push_back(pFrame);
+        m_nInUse--;
+    }
+    m_cvFree.notify_one();
+}
+
+void CNvFramePool::Trim()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        for (size_t i = 0; i < m_vFree.size(); i++)
+        {
+            for (size_t j = 0; j < m_vFrames.size(); j++)
+            {
+                if (m_vFrames[j] == m_vFree[i])
+                {
+                    m_vFrames.erase(m_vFrames.begin() + j);
+                    break;
+                }
+            }
+            m_pAllocator->Free(m_vFree[i]->pData);
+            delete m_vFree[i];
+        }
+        m_vFree.clear();
+    }
+    // waiters at nMaxFrames may allocate now
+    m_cvFree.notify_all();
+}
+
+void CNvFramePool::GetStats(NvFramePoolStats *pStats)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    pStats->nAllocated     = (unsigned int)m_vFrames.size();
+    pStats->nInUse         = m_nInUse;
+    pStats->nHighWater     = m_nHighWater;
+    pStats->nFrameBytes    = m_nFrameBytes;
+    pStats->nAcquires      = m_nAcquires;
+    pStats->nAcquireWaits  = m_nAcquireWaits;
+    pStats->nAcquireWaitUs = m_nAcquireWaitUs;
+}
@@ -0,0 +1,226 @@
+/*
+ * Copyright 1993-2015 NVIDIA Corporation.  All rights reserved.
+ *
+ * Please refer to the NVIDIA end user license agreement (EULA) associated
+ * with this source code for terms and conditions that govern your use of
+ * this software. Any use, reproduction, disclosure, or distribution of
+ * this software and related documentation outside the terms of the EULA
+ * is strictly prohibited.
+ *
+ */
+
+#ifndef NV_FRAME_POOL_H
+#define NV_FRAME_POOL_H
+
+#include <stddef.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+#include "NvPixelFormat.h"
+
+// Frame formats the pools hand out. The YUV ones use the NV12 layout:
+// luma rows, then NV_CHROMA_ROWS_420(height) rows of CbCr pairs, all at
+// one pitch.
+typedef enum
+{
+    NV_FRAME_FORMAT_NV12 = 0,   // 8-bit 4:2:0
+    NV_FRAME_FORMAT_P010,       // NV12 with 16-bit samples, 10 bits in the MSBs
+    NV_FRAME_FORMAT_ARGB,       // one uint32 per pixel, ARGB8888 or ARGB2101010
+    NV_FRAME_FORMAT_COUNT
+} NvFrameFormat;
+
+const char *nvFrameFormatName(NvFrameFormat eFormat);
+
+// bytes of visible pixels in a row
+size_t nvFrameRowBytes(NvFrameFormat eFormat, unsigned int width);
+
+// bytes of a frame of height rows at nPitch, chroma included
+size_t nvFrameBytes(NvFrameFormat eFormat, size_t nPitch, unsigned int height);
+
+// Where the frames live. The pool only ever sees these two calls, so the
+// CUDA flavours (device memory, pinned host memory) are implemented next
+// to the context that owns them and the pool itself runs without a GPU.
+// Allocate() returns NULL on failure; the result is aligned to at least
+// nAlign bytes. For device memory the pointer is the CUdeviceptr.
+class INvFrameAllocator
+{
+public:
+    virtual ~INvFrameAllocator() {}
+    virtual void *Allocate(size_t nBytes, size_t nAlign) = 0;
+    virtual void  Free(void *pData) = 0;
+    virtual const char *Name() const = 0;
+};
+
+// posix_memalign()ed host memory, for -sw and for testing
+class CNvHostFrameAllocator : public INvFrameAllocator
+{
+public:
+    virtual void *Allocate(size_t nBytes, size_t nAlign);
+    virtual void  Free(void *pData);
+    virtual const char *Name() const { return "host"; }
+};
+
+// Frame geometry and limits of one pool. Every frame in a pool has the
+// same size; the pitch is the row bytes rounded up to nPitchAlign, which
+// keeps rows on cache lines for the host kernels and on the coalescing
+// boundary for the GPU ones.
+struct NvFramePoolConfig
+{
+    NvFrameFormat   eFormat;
+    unsigned int    width;
+    unsigned int    height;
+    unsigned int    nPitchAlign;    // power of two; 0 means NV_FRAME_POOL_PITCH_ALIGN
+    unsigned int    nMaxFrames;     // Acquire() blocks while this many are held
+    unsigned int    nPrealloc;      // allocated up front, the rest on demand
+};
+
+#define NV_FRAME_POOL_PITCH_ALIGN   256
+
+struct NvFramePoolStats
+{
+    unsigned int        nAllocated;     // frames backed by memory
+    unsigned int        nInUse;         // frames with a reference
+    unsigned int        nHighWater;     // most frames ever in use at once
+    size_t              nFrameBytes;
+    unsigned long long  nAcquires;
+    unsigned long long  nAcquireWaits;  // Acquire() calls that found every frame held
+    unsigned long long  nAcquireWaitUs;
+};
+
+class CNvFramePool;
+
+struct NvPooledFrame
+{
+    void               *pData;
+    CNvFramePool       *pPool;
+    std::atomic<int>    nRefs;
+};
+
+// Counted reference to a pooled frame. Copies share the frame; it goes back
+// to its pool when the last one is dropped, from whichever thread that is.
+// A default-constructed reference holds nothing.
+class CNvFrameRef
+{
+public:
+    CNvFrameRef(): m_pFrame(NULL)
+    {
+    }
+    explicit CNvFrameRef(NvPooledFrame *pFrame): m_pFrame(pFrame)
+    {
+    }
+    CNvFrameRef(const CNvFrameRef &oOther): m_pFrame(oOther.m_pFrame)
+    {
+        if (m_pFrame)
+            m_pFrame->nRefs.fetch_add(1, std::memory_order_relaxed);
+    }
+    CNvFrameRef(CNvFrameRef &&oOther): m_pFrame(oOther.m_pFrame)
+    {
+        oOther.m_pFrame = NULL;
+    }
+    ~CNvFrameRef()
+    {
+        Reset();
+    }
+
+    CNvFrameRef &operator=(CNvFrameRef oOther)
+    {
+        NvPooledFrame *pFrame = m_pFrame;
+        m_pFrame = oOther.m_pFrame;
+        oOther.m_pFrame = pFrame;
+        return *this;
+    }
+
+    void Reset();
+
+    bool IsNull() const
+    {
+        return m_pFrame == NULL;
+    }
+
+    void *Data() const
+    {
+        return m_pFrame ? m_pFrame->pData : NULL;
+    }
+
+    int RefCount() const
+    {
+        return m_pFrame ? m_pFrame->nRefs.load() : 0;
+    }
+
+    size_t Pitch() const;
+
+private:
+    NvPooledFrame *m_pFrame;
+};
+
+// Fixed-size frames recycled through a free list. Frames are allocated on
+// first use up to nMaxFrames, so a pool only grows to what the pipeline
+// actually holds at once (the high water mark); past that Acquire() waits
+// for a reference to be dropped, which is the back-pressure between the
+// stage holding frames and the one producing them.
+class CNvFramePool
+{
+public:
+    CNvFramePool();
+    ~CNvFramePool();
+
+    // The allocator must stay alive until Deinitialize().
+    bool Initialize(const NvFramePoolConfig &oConfig, INvFrameAllocator *pAllocator);
+
+    // Frees every frame; none may be referenced any more.
+    void Deinitialize();
+
+    // A frame nobody else references, waiting while nMaxFrames are held.
+    // Null if the allocator fails.
+    CNvFrameRef Acquire();
+
+    // Null instead of waiting
+    CNvFrameRef TryAcquire();
+
+    // Frees the frames on the free list, e.g. after a resolution change.
+    void Trim();
+
+    const NvFramePoolConfig &Config() const
+    {
+        return m_oConfig;
+    }
+    size_t Pitch() const
+    {
+        return m_nPitch;
+    }
+    size_t FrameBytes() const
+    {
+        return m_nFrameBytes;
+    }
+
+    void GetStats(NvFramePoolStats *pStats);
+
+private:
+    friend class CNvFrameRef;
+
+    NvPooledFrame *AllocateFrame();
+    CNvFrameRef    TakeFrame(bool bWait);
+    void           Recycle(NvPooledFrame *pFrame);
+
+    // non-copyable
+    CNvFramePool(const CNvFramePool &);
+    CNvFramePool &operator=(const CNvFramePool &);
+
+    NvFramePoolConfig             m_oConfig;
+    INvFrameAllocator            *m_pAllocator;
+    size_t                        m_nPitch;
+    size_t                        m_nFrameBytes;
+    std::mutex                    m_mutex;
+    std::condition_variable       m_cvFree;
+    std::vector<NvPooledFrame *>  m_vFrames;        // every allocated frame
+    std::vector<NvPooledFrame *>  m_vFree;
+    unsigned int                  m_nInUse;
+    unsigned int                  m_nHighWater;
+    unsigned long long            m_nAcquires;
+    unsigned long long            m_nAcquireWaits;
+    unsigned long long            m_nAcquireWaitUs;
+};
+
+#endif // NV_FRAME_POOL_H
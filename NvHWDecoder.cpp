@@ -14,8 +14,6 @@
 #include <cuviddec.h>
 #include <assert.h>
 
-#define MAX_FRAME_COUNT 2
-
 static int HandleVideoData(void *pUserData, CUVIDSOURCEDATAPACKET *pPacket)
 {
     VideoSourceData *pVideoSourceData = (VideoSourceData *)pUserData;
@@ -31,6 +29,22 @@ static int HandleVideoData(void *pUserData, CUVIDSOURCEDATAPACKET *pPacket)
     return !pVideoSourceData->pFrameQueue->isDecodeFinished();
 }
 
+// Audio packets as the source demuxes them, in the elementary stream
+// format; they are only buffered here, the muxer takes them on the encoder
+// output thread.
+static int HandleAudioData(void *pUserData, CUVIDSOURCEDATAPACKET *pPacket)
+{
+    VideoSourceData *pVideoSourceData = (VideoSourceData *)pUserData;
+
+    if (pVideoSourceData->pAudioQueue && pPacket->payload_size)
+    {
+        pVideoSourceData->pAudioQueue->Push(pPacket->payload, pPacket->payload_size,
+                                            (pPacket->flags & CUVID_PKT_TIMESTAMP) != 0, pPacket->timestamp);
+    }
+
+    return !pVideoSourceData->pFrameQueue->isDecodeFinished();
+}
+
 static int HandleVideoSequence(void *pUserData, CUVIDEOFORMAT *pFormat)
 {
     return 1;
@@ -113,7 +127,7 @@ bool CNvHWDecoder::createVideoSource(const std::string& sFileName)
     memset(&oVideoSourceParameters, 0, sizeof(CUVIDSOURCEPARAMS));
     oVideoSourceParameters.pUserData = &oSourceData_;               
     oVideoSourceParameters.pfnVideoDataHandler = HandleVideoData;   
-    oVideoSourceParameters.pfnAudioDataHandler = 0;
+    oVideoSourceParameters.pfnAudioDataHandler = HandleAudioData;
     CUresult oResult = cuvidCreateVideoSource(&oSourceData_.hVideoSource, sFileName.c_str(), &oVideoSourceParameters);
     return (CUDA_SUCCESS == oResult);
 
@@ -123,6 +137,7 @@ CNvHWDecoder::CNvHWDecoder(const std::string& sFileName, FrameQueue *pFrameQueue
 {
     oSourceData_.pFrameQueue = pFrameQueue;
     oSourceData_.pContext      = pCudaContext;
+    oSourceData_.pAudioQueue   = NULL;
 
     CUresult result = cuvidCtxLockCreate(&hContextLock, pCudaContext);
     if (result != CUDA_SUCCESS) {
@@ -156,6 +171,43 @@ void CNvHWDecoder::getProgressive(bool &progressive)
     progressive = (rCudaVideoFormat.progressive_sequence != 0);
 }
 
+unsigned int CNvHWDecoder::bitDepth() const
+{
+    // this nvcuvid only outputs cudaVideoSurfaceFormat_NV12
+    return 8;
+}
+
+NvColorSpace CNvHWDecoder::colorSpace() const
+{
+    CUVIDEOFORMAT rCudaVideoFormat = format();
+    NvColorSpace oColorSpace;
+
+    // matrix_coefficients as in H.264/HEVC Table E-5 and MPEG-2 Table 6-9
+    switch (rCudaVideoFormat.video_signal_description.matrix_coefficients)
+    {
+        case 1:                 // BT.709
+            oColorSpace.eMatrix = NV_COLOR_MATRIX_BT709;
+            break;
+        case 5:                 // BT.470 System B/G
+        case 6:                 // SMPTE 170M
+            oColorSpace.eMatrix = NV_COLOR_MATRIX_BT601;
+            break;
+        case 9:                 // BT.2020 non-constant luminance
+        case 10:                // BT.2020 constant luminance, nearest we have
+            oColorSpace.eMatrix = NV_COLOR_MATRIX_BT2020;
+            break;
+        default:
+            // unspecified: HD streams are normally BT.709, SD ones BT.601
+            oColorSpace.eMatrix = (rCudaVideoFormat.coded_height >= 720) ? NV_COLOR_MATRIX_BT709
+                                                                         : NV_COLOR_MATRIX_BT601;
+            break;
+    }
+
+    oColorSpace.eRange = rCudaVideoFormat.video_signal_description.video_full_range_flag ? NV_COLOR_RANGE_FULL
+                                                                                        : NV_COLOR_RANGE_LIMITED;
+    return oColorSpace;
+}
+
 void CNvHWDecoder::start()
 {
     CUresult oResult = cuvidSetVideoSourceState(oSourceData_.hVideoSource, cudaVideoState_Started);
@@ -14,6 +14,10 @@
 
 #include <nvcuvid.h>
 #include <string>
+#include "NvCodecInterface.h"
+
+// Decoder output surfaces, i.e. how many decoded frames can be mapped at once.
+#define MAX_FRAME_COUNT 4
 
 class FrameQueue;
 
@@ -24,9 +28,10 @@ struct VideoSourceData
     CUvideodecoder hVideoDecoder;
     FrameQueue    *pFrameQueue;			
     CUcontext      pContext;
+    CNvAudioQueue *pAudioQueue;     // NULL: audio packets are dropped
 };
 
-class CNvHWDecoder
+class CNvHWDecoder : public INvVideoDecoder
 {
     public:
         CNvHWDecoder(const std::string& sFileName, FrameQueue *pFrameQueue, CUcontext pCudaContext);
@@ -38,6 +43,10 @@ class CNvHWDecoder
 
         void getProgressive(bool &progressive);
 
+        NvColorSpace colorSpace() const;
+
+        unsigned int bitDepth() const;
+
         unsigned int sourceWidth() const;
 
         unsigned int sourceHeight() const;
@@ -52,6 +61,10 @@ class CNvHWDecoder
 
         CUvideoctxlock getCtxLock() const;
 
+        bool isHostMemory() const { return false; }
+
+        void setAudioQueue(CNvAudioQueue *pAudioQueue) { oSourceData_.pAudioQueue = pAudioQueue; }
+
     protected:
         CUVIDEOFORMAT format() const;
             
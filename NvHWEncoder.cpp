@@ -180,18 +180,24 @@ NVENCSTATUS CNvHWEncoder::NvEncGetEncodePresetConfig(GUID encodeGUID, GUID  pres
     return nvStatus;
 }
 
-NVENCSTATUS CNvHWEncoder::NvEncCreateInputBuffer(uint32_t width, uint32_t height, void** inputBuffer)
+NVENCSTATUS CNvHWEncoder::NvEncCreateInputBuffer(uint32_t width, uint32_t height, NV_ENC_BUFFER_FORMAT bufferFmt, void** inputBuffer)
 {
     NVENCSTATUS nvStatus = NV_ENC_SUCCESS;
     NV_ENC_CREATE_INPUT_BUFFER createInputBufferParams;
 
+    // this API version only takes 8-bit input
+    if (bufferFmt == NV_ENC_BUFFER_FORMAT_P010_PL)
+    {
+        return NV_ENC_ERR_UNSUPPORTED_PARAM;
+    }
+
     memset(&createInputBufferParams, 0, sizeof(createInputBufferParams));
     SET_VER(createInputBufferParams, NV_ENC_CREATE_INPUT_BUFFER);
 
     createInputBufferParams.width = width;
     createInputBufferParams.height = height;
     createInputBufferParams.memoryHeap = NV_ENC_MEMORY_HEAP_SYSMEM_CACHED;
-    createInputBufferParams.bufferFmt = NV_ENC_BUFFER_FORMAT_NV12_PL;
+    createInputBufferParams.bufferFmt = bufferFmt;
 
     nvStatus = m_pEncodeAPI->nvEncCreateInputBuffer(m_hEncoder, &createInputBufferParams);
     if (nvStatus != NV_ENC_SUCCESS)
@@ -434,6 +440,12 @@ NVENCSTATUS CNvHWEncoder::NvEncDestroyEncoder()
         m_bEncoderInitialized = false;
     }
 
+    bool bMuxed = m_oMuxer.Close();
+    if ((!m_oOutput.Close() || !bMuxed) && nvStatus == NV_ENC_SUCCESS)
+    {
+        nvStatus = NV_ENC_ERR_GENERIC;
+    }
+
     return nvStatus;
 }
 
@@ -516,7 +528,6 @@ CNvHWEncoder::CNvHWEncoder()
     m_bEncoderInitialized = false;
     m_pEncodeAPI = NULL;
     m_hinstLib = NULL;
-    m_fOutput = NULL;
     m_EncodeIdx = 0;
 
     memset(&m_stCreateEncodeParams, 0, sizeof(m_stCreateEncodeParams));
@@ -541,10 +552,8 @@ CNvHWEncoder::~CNvHWEncoder()
         m_hinstLib = NULL;
     }
 
-    if (m_fOutput){
-        fclose(m_fOutput);
-        m_fOutput = NULL;
-    }
+    m_oMuxer.Close();
+    m_oOutput.Close();
 }
 
 NVENCSTATUS CNvHWEncoder::ValidateEncodeGUID (GUID inputCodecGuid)
@@ -645,11 +654,27 @@ NVENCSTATUS CNvHWEncoder::CreateEncoder(const char* outputName, int codec, int w
         return NV_ENC_ERR_INVALID_PARAM;
     }
 
-    m_fOutput = fopen(outputName, "wb");
-    if (!m_fOutput) {
+    // segments open their own files as they go
+    bool bSegmented = nvCmafIsPlaylistPath(outputName);
+    if (!bSegmented && !m_oOutput.Open(outputName)) {
         return NV_ENC_ERR_INVALID_PARAM;
     }
 
+    // one-second fragments: NVENC runs with an infinite GOP here
+    if (bSegmented || nvMp4IsMp4Path(outputName)) {
+        NvMp4MuxerConfig oMuxerConfig = { codec == NV_ENC_HEVC, (unsigned int)width, (unsigned int)height, (unsigned int)fps, 1, (unsigned int)fps };
+        if (!m_oMuxer.Open(&m_oOutput, oMuxerConfig, bSegmented ? &m_oSegmenter : NULL)) {
+            return NV_ENC_ERR_INVALID_PARAM;
+        }
+    }
+    // two-second segments unless the caller says otherwise
+    if (bSegmented) {
+        NvCmafSegmenterConfig oSegmenterConfig = { 2 * (unsigned int)fps, 0 };
+        if (!m_oSegmenter.Open(&m_oOutput, &m_oMuxer, outputName, oSegmenterConfig)) {
+            return NV_ENC_ERR_INVALID_PARAM;
+        }
+    }
+
     GUID inputCodecGUID = codec == NV_ENC_H264 ? NV_ENC_CODEC_H264_GUID : NV_ENC_CODEC_HEVC_GUID;
     nvStatus = ValidateEncodeGUID(inputCodecGUID);
     if (nvStatus != NV_ENC_SUCCESS)
@@ -790,7 +815,17 @@ NVENCSTATUS CNvHWEncoder::ProcessOutput(const EncodeBuffer *pEncodeBuffer)
     nvStatus = m_pEncodeAPI->nvEncLockBitstream(m_hEncoder, &lockBitstreamData);
     if (nvStatus == NV_ENC_SUCCESS)
     {
-        fwrite(lockBitstreamData.bitstreamBufferPtr, 1, lockBitstreamData.bitstreamSizeInBytes, m_fOutput);
+        // a copy into the writer's ring, or into the muxer's fragment; the
+        // disk is the writer thread's problem
+        if (m_oMuxer.IsOpen())
+        {
+            m_oMuxer.WriteFrame(lockBitstreamData.bitstreamBufferPtr, lockBitstreamData.bitstreamSizeInBytes,
+                                lockBitstreamData.outputTimeStamp);
+        }
+        else
+        {
+            m_oOutput.Write(lockBitstreamData.bitstreamBufferPtr, lockBitstreamData.bitstreamSizeInBytes);
+        }
         nvStatus = m_pEncodeAPI->nvEncUnlockBitstream(m_hEncoder, pEncodeBuffer->stOutputBfr.hBitstreamBuffer);
     }
 
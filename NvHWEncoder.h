@@ -19,6 +19,7 @@
 #include <cuda.h>
 
 #include "nvEncodeAPI.h"
+#include "NvCodecInterface.h"
 
 #define SET_VER(configStruct, type) {configStruct.version = type##_VER;}
 
@@ -80,11 +81,13 @@ enum
     NV_ENC_HEVC = 1,
 };
 
-class CNvHWEncoder
+class CNvHWEncoder : public INvVideoEncoder
 {
 public:
     uint32_t                                             m_EncodeIdx;
-    FILE                                                *m_fOutput;
+    CNvBitstreamWriter                                   m_oOutput;
+    CNvMp4Muxer                                          m_oMuxer;
+    CNvCmafSegmenter                                     m_oSegmenter;
 
 protected:
     bool                                                 m_bEncoderInitialized;
@@ -108,7 +111,7 @@ public:
     NVENCSTATUS NvEncGetEncodePresetCount(GUID encodeGUID, uint32_t* encodePresetGUIDCount);
     NVENCSTATUS NvEncGetEncodePresetGUIDs(GUID encodeGUID, GUID* presetGUIDs, uint32_t guidArraySize, uint32_t* encodePresetGUIDCount);
     NVENCSTATUS NvEncGetEncodePresetConfig(GUID encodeGUID, GUID  presetGUID, NV_ENC_PRESET_CONFIG* presetConfig);
-    NVENCSTATUS NvEncCreateInputBuffer(uint32_t width, uint32_t height, void** inputBuffer);
+    NVENCSTATUS NvEncCreateInputBuffer(uint32_t width, uint32_t height, NV_ENC_BUFFER_FORMAT bufferFmt, void** inputBuffer);
     NVENCSTATUS NvEncDestroyInputBuffer(NV_ENC_INPUT_PTR inputBuffer);
     NVENCSTATUS NvEncCreateBitstreamBuffer(uint32_t size, void** bitstreamBuffer);
     NVENCSTATUS NvEncDestroyBitstreamBuffer(NV_ENC_OUTPUT_PTR bitstreamBuffer);
@@ -128,6 +131,9 @@ public:
     NVENCSTATUS NvEncRegisterResource(NV_ENC_INPUT_RESOURCE_TYPE resourceType, void* resourceToRegister, uint32_t width, uint32_t height, uint32_t pitch, void** registeredResource);
     NVENCSTATUS NvEncUnregisterResource(NV_ENC_REGISTERED_PTR registeredRes);
     NVENCSTATUS NvEncFlushEncoderQueue(void *hEOSEvent);
+    CNvBitstreamWriter *GetOutput() { return &m_oOutput; }
+    CNvMp4Muxer *GetMuxer() { return m_oMuxer.Timescale() ? &m_oMuxer : NULL; }    // opened, maybe closed since
+    CNvCmafSegmenter *GetSegmenter() { return m_oSegmenter.IsOpen() ? &m_oSegmenter : NULL; }
 
     CNvHWEncoder();
     virtual ~CNvHWEncoder();
@@ -0,0 +1,1022 @@
+/*
+ * Copyright 1993-2015 NVIDIA Corporation.  All rights reserved.
+ *
+ * Please refer to the NVIDIA end user license agreement (EULA) associated
+ * with this source code for terms and conditions that govern your use of
+ * this software. Any use, reproduction, disclosure, or distribution of
+ * this software and related documentation outside the terms of the EULA
+ * is strictly prohibited.
+ *
+ */
+
+#include "NvMp4Muxer.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+
+// sample_flags of ISO/IEC 14496-12 8.8.3.1: sample_depends_on = 2 for a
+// keyframe; depends on others and sample_is_non_sync_sample otherwise
+#define MP4_SAMPLE_FLAGS_SYNC       0x02000000
+#define MP4_SAMPLE_FLAGS_NON_SYNC   0x01010000
+
+// index into m_avParameterSets
+enum { PARAM_VPS = 0, PARAM_SPS, PARAM_PPS };
+
+// track_ID of the video and the audio track
+#define MP4_VIDEO_TRACK             1
+#define MP4_AUDIO_TRACK             2
+
+bool nvMp4IsMp4Path(const char *szPath)
+{
+    const char *szExt = szPath ? strrchr(szPath, '.') : NULL;
+    return szExt && (!strcasecmp(szExt, ".mp4") || !strcasecmp(szExt, ".m4v"));
+}
+
+std::string nvMp4CodecString(bool bHEVC, const unsigned char *pProfile)
+{
+    char szCodec[64];
+
+    if (!bHEVC)
+    {
+        snprintf(szCodec, sizeof(szCodec), "avc1.%02x%02x%02x", pProfile[0], pProfile[1], pProfile[2]);
+        return szCodec;
+    }
+
+    // hvc1.<space><profile>.<compatibility, bit-reversed>.<tier><level>.<constraints>
+    uint32_t uCompat = ((uint32_t)pProfile[1] << 24) | (pProfile[2] << 16) | (pProfile[3] << 8) | pProfile[4];
+    uint32_t uReversed = 0;
+    for (int i = 0; i < 32; i++)
+    {
+        uReversed |= ((uCompat >> i) & 1) << (31 - i);
+    }
+    static const char *spaces[4] = { "", "A", "B", "C" };
+    int n = snprintf(szCodec, sizeof(szCodec), "hvc1.%s%u.%X.%c%u", spaces[pProfile[0] >> 6], pProfile[0] & 0x1f,
+                     uReversed, (pProfile[0] & 0x20) ? 'H' : 'L', pProfile[11]);
+
+    // constraint bytes up to the last non-zero one
+    int nConstraints = 6;
+    while (nConstraints > 0 && pProfile[4 + nConstraints] == 0)
+    {
+        nConstraints--;
+    }
+    for (int i = 0; i < nConstraints; i++)
+    {
+        n += snprintf(szCodec + n, sizeof(szCodec) - n, ".%X", pProfile[5 + i]);
+    }
+    return szCodec;
+}
+
+// Big-endian box building into a byte vector. A box is opened with its
+// size left at zero and patched by EndBox() once its children are in.
+static void Put8(std::vector<unsigned char> &v, unsigned int x)
+{
+    v.push_back((unsigned char)x);
+}
+
+static void Put16(std::vector<unsigned char> &v, unsigned int x)
+{
+    Put8(v, x >> 8);
+    Put8(v, x);
+}
+
+static void Put32(std::vector<unsigned char> &v, uint32_t x)
+{
+    Put16(v, x >> 16);
+    Put16(v, x & 0xffff);
+}
+
+static void Put64(std::vector<unsigned char> &v, unsigned long long x)
+{
+    Put32(v, (uint32_t)(x >> 32));
+    Put32(v, (uint32_t)x);
+}
+
+static void PutBytes(std::vector<unsigned char> &v, const void *pData, size_t nBytes)
+{
+    v.insert(v.end(), (const unsigned char *)pData, (const unsigned char *)pData + nBytes);
+}
+
+static void PutZeros(std::vector<unsigned char> &v, size_t nBytes)
+{
+    v.insert(v.end(), nBytes, 0);
+}
+
+static size_t BeginBox(std::vector<unsigned char> &v, const char *szType)
+{
+    size_t nStart = v.size();
+    Put32(v, 0);
+    PutBytes(v, szType, 4);
+    return nStart;
+}
+
+static size_t BeginFullBox(std::vector<unsigned char> &v, const char *szType, unsigned int uVersion, uint32_t uFlags)
+{
+    size_t nStart = BeginBox(v, szType);
+    Put32(v, (uVersion << 24) | uFlags);
+    return nStart;
+}
+
+static void EndBox(std::vector<unsigned char> &v, size_t nStart)
+{
+    uint32_t uSize = (uint32_t)(v.size() - nStart);
+    v[nStart]     = (unsigned char)(uSize >> 24);
+    v[nStart + 1] = (unsigned char)(uSize >> 16);
+    v[nStart + 2] = (unsigned char)(uSize >> 8);
+    v[nStart + 3] = (unsigned char)uSize;
+}
+
+// unity matrix of mvhd and tkhd
+static void PutMatrix(std::vector<unsigned char> &v)
+{
+    static const uint32_t matrix[9] = { 0x00010000, 0, 0, 0, 0x00010000, 0, 0, 0, 0x40000000 };
+    for (int i = 0; i < 9; i++)
+    {
+        Put32(v, matrix[i]);
+    }
+}
+
+// dinf of a track whose media is in this file
+static void PutDataInformation(std::vector<unsigned char> &v)
+{
+    size_t dinf = BeginBox(v, "dinf");
+    size_t dref = BeginFullBox(v, "dref", 0, 0);
+    Put32(v, 1);
+    size_t url = BeginFullBox(v, "url ", 0, 1);
+    EndBox(v, url);
+    EndBox(v, dref);
+    EndBox(v, dinf);
+}
+
+// the stbl tables after stsd, empty: the samples are all in the fragments
+static void PutEmptySampleTables(std::vector<unsigned char> &v)
+{
+    const char *tables[4] = { "stts", "stsc", "stsz", "stco" };
+    for (int i = 0; i < 4; i++)
+    {
+        size_t table = BeginFullBox(v, tables[i], 0, 0);
+        if (i == 2)
+        {
+            Put32(v, 0);    // sample_size
+        }
+        Put32(v, 0);        // entry_count / sample_count
+        EndBox(v, table);
+    }
+}
+
+// trex: defaults for the track's fragments
+static void PutTrackExtends(std::vector<unsigned char> &v, uint32_t uTrackID, uint32_t uDuration, uint32_t uFlags)
+{
+    size_t trex = BeginFullBox(v, "trex", 0, 0);
+    Put32(v, uTrackID);
+    Put32(v, 1);            // default_sample_description_index
+    Put32(v, uDuration);
+    Put32(v, 0);
+    Put32(v, uFlags);
+    EndBox(v, trex);
+}
+
+static void PutDataOffset(std::vector<unsigned char> &v, size_t nAt, uint32_t uOffset)
+{
+    v[nAt]     = (unsigned char)(uOffset >> 24);
+    v[nAt + 1] = (unsigned char)(uOffset >> 16);
+    v[nAt + 2] = (unsigned char)(uOffset >> 8);
+    v[nAt + 3] = (unsigned char)uOffset;
+}
+
+// First bytes of a NAL unit's RBSP, emulation prevention bytes removed
+static size_t Unescape(const unsigned char *pNal, size_t nSize, size_t nHeader, unsigned char *pOut, size_t nOut)
+{
+    size_t n = 0;
+    int nZeros = 0;
+    for (size_t i = nHeader; i < nSize && n < nOut; i++)
+    {
+        if (nZeros >= 2 && pNal[i] == 3)
+        {
+            nZeros = 0;
+            continue;
+        }
+        pOut[n++] = pNal[i];
+        nZeros = pNal[i] ? 0 : nZeros + 1;
+    }
+    return n;
+}
+
+CNvMp4Muxer::CNvMp4Muxer(): m_pOutput(NULL), m_pListener(NULL), m_uTimescale(0), m_uFrameDuration(0), m_bInitWritten(false), m_bError(false),
+                            m_pFrame(NULL), m_bFragmentKey(false), m_nFragmentTime(0), m_nFrames(0), m_uSequence(0),
+                            m_nFileBytes(0), m_nAudioNext(0)
+{
+    memset(&m_oConfig, 0, sizeof(m_oConfig));
+    memset(&m_oAudio, 0, sizeof(m_oAudio));
+    memset(&m_stStats, 0, sizeof(m_stStats));
+}
+
+bool CNvMp4Muxer::Open(CNvBitstreamWriter *pOutput, const NvMp4MuxerConfig &oConfig,
+                       INvMp4MuxerListener *pListener)
+{
+    if (!pOutput || !oConfig.width || !oConfig.height || !oConfig.uFpsNum || !oConfig.uFpsDen)
+    {
+        return false;
+    }
+
+    m_pOutput = pOutput;
+    m_pListener = pListener;
+    m_oConfig = oConfig;
+
+    // 30 fps becomes 30000 / 1000 rather than 30 / 1, which leaves room
+    // for timestamps that aren't whole frames; 30000/1001 stays as it is
+    unsigned int uScale = (oConfig.uFpsDen == 1) ? 1000 : 1;
+    m_uTimescale = oConfig.uFpsNum * uScale;
+    m_uFrameDuration = oConfig.uFpsDen * uScale;
+
+    m_sCodec.clear();
+    m_bInitWritten = false;
+    m_bError = false;
+    for (int i = 0; i < 3; i++)
+    {
+        m_avParameterSets[i].clear();
+    }
+    m_vMdat.clear();
+    m_vSampleSizes.clear();
+    m_vSampleOffsets.clear();
+    m_nFrames = 0;
+    m_uSequence = 0;
+    m_nFileBytes = 0;
+    m_vIndex.clear();
+    memset(&m_oAudio, 0, sizeof(m_oAudio));
+    m_vAudio.clear();
+    m_vAudioFrames.clear();
+    m_nAudioNext = 0;
+    memset(&m_stStats, 0, sizeof(m_stStats));
+    return true;
+}
+
+bool CNvMp4Muxer::Fail(const char *szMessage)
+{
+    printf("CNvMp4Muxer: %s\n", szMessage);
+    m_bError = true;
+    return false;
+}
+
+bool CNvMp4Muxer::Emit(const void *pData, size_t nBytes)
+{
+    m_nFileBytes += nBytes;
+    if (nBytes && !m_pOutput->Write(pData, nBytes))
+    {
+        m_bError = true;
+        return false;
+    }
+    return true;
+}
+
+// Sorts the parameter sets of the current frame into m_avParameterSets
+// (first frame) or checks that they repeat the ones there (later frames).
+bool CNvMp4Muxer::CollectParameterSets(bool bKeyframe)
+{
+    bool bHEVC = m_oConfig.bHEVC;
+
+    for (size_t i = 0; i < m_vNals.size(); i++)
+    {
+        const unsigned char *pNal = m_pFrame + m_vNals[i].first;
+        size_t nSize = m_vNals[i].second;
+        unsigned int nalType = bHEVC ? (pNal[0] >> 1) & 0x3f : pNal[0] & 0x1f;
+
+        int iSet = -1;
+        if (bHEVC)
+        {
+            iSet = (nalType == 32) ? PARAM_VPS : (nalType == 33) ? PARAM_SPS : (nalType == 34) ? PARAM_PPS : -1;
+        }
+        else
+        {
+            iSet = (nalType == 7) ? PARAM_SPS : (nalType == 8) ? PARAM_PPS : -1;
+        }
+        if (iSet < 0)
+            continue;
+
+        std::vector<Nal> &vSets = m_avParameterSets[iSet];
+        bool bKnown = false;
+        for (size_t j = 0; j < vSets.size() && !bKnown; j++)
+        {
+            bKnown = vSets[j].size() == nSize && !memcmp(&vSets[j][0], pNal, nSize);
+        }
+        if (bKnown)
+            continue;
+
+        // one sample description for the whole track
+        if (m_nFrames)
+            return Fail("parameter sets changed mid-stream, which one fragmented MP4 track can't carry");
+        vSets.push_back(Nal(pNal, pNal + nSize));
+    }
+
+    if (!m_nFrames)
+    {
+        if (!bKeyframe)
+            return Fail("the stream doesn't start with a keyframe");
+        if ((bHEVC && m_avParameterSets[PARAM_VPS].empty()) || m_avParameterSets[PARAM_SPS].empty() ||
+            m_avParameterSets[PARAM_PPS].empty())
+            return Fail("no parameter sets before the first keyframe");
+
+        // the avcC/hvcC fields below are read straight from the SPS
+        if (m_avParameterSets[PARAM_SPS][0].size() < (bHEVC ? 15u : 4u))
+            return Fail("SPS too short");
+    }
+    return true;
+}
+
+bool CNvMp4Muxer::WriteInit()
+{
+    const bool bHEVC = m_oConfig.bHEVC;
+    const Nal &sps = m_avParameterSets[PARAM_SPS][0];
+
+    // Profile fields. H.264 keeps them in the three bytes after the NAL
+    // header; HEVC in the general profile_tier_level after sps_max_sub_layers
+    // (12 bytes, escaped like the rest of the RBSP). The bit depth isn't
+    // parsed: High 10 and Main 10 are 10 bits, everything else 8, which is
+    // what either encoder produces.
+    unsigned char ptl[13] = { 0 };
+    unsigned int nBitDepth = 8;
+    if (bHEVC)
+    {
+        Unescape(&sps[0], sps.size(), 2, ptl, sizeof(ptl));
+        nBitDepth = ((ptl[1] & 0x1f) == 2) ? 10 : 8;
+        m_sCodec = nvMp4CodecString(true, ptl + 1);
+    }
+    else
+    {
+        nBitDepth = (sps[1] == 110) ? 10 : 8;
+        m_sCodec = nvMp4CodecString(false, &sps[1]);
+    }
+
+    std::vector<unsigned char> &v = m_vBox;
+    v.clear();
+
+    size_t ftyp = BeginBox(v, "ftyp");
+    PutBytes(v, "iso6", 4);
+    Put32(v, 0);
+    PutBytes(v, "iso6", 4);
+    PutBytes(v, "iso5", 4);
+    PutBytes(v, "mp41", 4);
+    PutBytes(v, bHEVC ? "hvc1" : "avc1", 4);
+    if (m_pListener && !HasAudio())
+    {
+        PutBytes(v, "cmfc", 4);     // CMAF tracks are one to a file
+    }
+    EndBox(v, ftyp);
+
+    size_t moov = BeginBox(v, "moov");
+    {
+        // durations are 0: the samples are all in the fragments
+        size_t mvhd = BeginFullBox(v, "mvhd", 0, 0);
+        Put32(v, 0);                // creation_time
+        Put32(v, 0);                // modification_time
+        Put32(v, m_uTimescale);
+        Put32(v, 0);                // duration
+        Put32(v, 0x00010000);       // rate 1.0
+        Put16(v, 0x0100);           // volume 1.0
+        PutZeros(v, 10);
+        PutMatrix(v);
+        PutZeros(v, 24);            // pre_defined
+        Put32(v, HasAudio() ? MP4_AUDIO_TRACK + 1 : MP4_VIDEO_TRACK + 1);     // next_track_ID
+        EndBox(v, mvhd);
+
+        size_t trak = BeginBox(v, "trak");
+        {
+            size_t tkhd = BeginFullBox(v, "tkhd", 0, 3);    // enabled, in movie
+            Put32(v, 0);
+            Put32(v, 0);
+            Put32(v, MP4_VIDEO_TRACK);
+            Put32(v, 0);
+            Put32(v, 0);            // duration
+            PutZeros(v, 8);
+            Put16(v, 0);            // layer
+            Put16(v, 0);            // alternate_group
+            Put16(v, 0);            // volume
+            Put16(v, 0);
+            PutMatrix(v);
+            Put32(v, m_oConfig.width << 16);
+            Put32(v, m_oConfig.height << 16);
+            EndBox(v, tkhd);
+
+            size_t mdia = BeginBox(v, "mdia");
+            {
+                size_t mdhd = BeginFullBox(v, "mdhd", 0, 0);
+                Put32(v, 0);
+                Put32(v, 0);
+                Put32(v, m_uTimescale);
+                Put32(v, 0);
+                Put16(v, 0x55c4);   // 'und'
+                Put16(v, 0);
+                EndBox(v, mdhd);
+
+                size_t hdlr = BeginFullBox(v, "hdlr", 0, 0);
+                Put32(v, 0);
+                PutBytes(v, "vide", 4);
+                PutZeros(v, 12);
+                PutBytes(v, "VideoHandler", 13);
+                EndBox(v, hdlr);
+
+                size_t minf = BeginBox(v, "minf");
+                {
+                    size_t vmhd = BeginFullBox(v, "vmhd", 0, 1);
+                    PutZeros(v, 8);     // graphicsmode, opcolor
+                    EndBox(v, vmhd);
+
+                    PutDataInformation(v);
+
+                    size_t stbl = BeginBox(v, "stbl");
+                    {
+                        size_t stsd = BeginFullBox(v, "stsd", 0, 0);
+                        Put32(v, 1);
+
+                        size_t entry = BeginBox(v, bHEVC ? "hvc1" : "avc1");
+                        PutZeros(v, 6);
+                        Put16(v, 1);        // data_reference_index
+                        PutZeros(v, 16);
+                        Put16(v, m_oConfig.width);
+                        Put16(v, m_oConfig.height);
+                        Put32(v, 0x00480000);   // 72 dpi
+                        Put32(v, 0x00480000);
+                        Put32(v, 0);
+                        Put16(v, 1);        // frame_count
+                        PutZeros(v, 32);    // compressorname
+                        Put16(v, 0x0018);   // depth
+                        Put16(v, 0xffff);   // pre_defined = -1
+
+                        if (bHEVC)
+                        {
+                            size_t hvcC = BeginBox(v, "hvcC");
+                            Put8(v, 1);                 // configurationVersion
+                            PutBytes(v, ptl + 1, 12);   // profile, tier, compatibility, constraints, level
+                            Put16(v, 0xf000);           // min_spatial_segmentation_idc
+                            Put8(v, 0xfc);              // parallelismType
+                            Put8(v, 0xfc | 1);          // chroma_format_idc 4:2:0
+                            Put8(v, 0xf8 | (nBitDepth - 8));
+                            Put8(v, 0xf8 | (nBitDepth - 8));
+                            Put16(v, 0);                // avgFrameRate
+                            // numTemporalLayers and temporalIdNested from the
+                            // SPS, 4-byte NAL lengths
+                            Put8(v, ((((ptl[0] >> 1) & 7) + 1) << 3) | ((ptl[0] & 1) << 2) | 3);
+                            Put8(v, 3);                 // numOfArrays
+                            static const unsigned int nalTypes[3] = { 32, 33, 34 };
+                            for (int i = PARAM_VPS; i <= PARAM_PPS; i++)
+                            {
+                                Put8(v, 0x80 | nalTypes[i]);    // array_completeness
+                                Put16(v, (unsigned int)m_avParameterSets[i].size());
+                                for (size_t j = 0; j < m_avParameterSets[i].size(); j++)
+                                {
+                                    Put16(v, (unsigned int)m_avParameterSets[i][j].size());
+                                    PutBytes(v, &m_avParameterSets[i][j][0], m_avParameterSets[i][j].size());
+                                }
+                            }
+                            EndBox(v, hvcC);
+                        }
+                        else
+                        {
+                            size_t avcC = BeginBox(v, "avcC");
+                            Put8(v, 1);                 // configurationVersion
+                            Put8(v, sps[1]);            // profile
+                            Put8(v, sps[2]);            // compatibility
+                            Put8(v, sps[3]);            // level
+                            Put8(v, 0xfc | 3);          // 4-byte NAL lengths
+                            Put8(v, 0xe0 | (unsigned int)m_avParameterSets[PARAM_SPS].size());
+                            for (size_t j = 0; j < m_avParameterSets[PARAM_SPS].size(); j++)
+                            {
+                                Put16(v, (unsigned int)m_avParameterSets[PARAM_SPS][j].size());
+                                PutBytes(v, &m_avParameterSets[PARAM_SPS][j][0], m_avParameterSets[PARAM_SPS][j].size());
+                            }
+                            Put8(v, (unsigned int)m_avParameterSets[PARAM_PPS].size());
+                            for (size_t j = 0; j < m_avParameterSets[PARAM_PPS].size(); j++)
+                            {
+                                Put16(v, (unsigned int)m_avParameterSets[PARAM_PPS][j].size());
+                                PutBytes(v, &m_avParameterSets[PARAM_PPS][j][0], m_avParameterSets[PARAM_PPS][j].size());
+                            }
+                            // required for the High profiles
+                            if (sps[1] == 100 || sps[1] == 110 || sps[1] == 122 || sps[1] == 244)
+                            {
+                                Put8(v, 0xfc | 1);      // chroma_format 4:2:0
+                                Put8(v, 0xf8 | (nBitDepth - 8));
+                                Put8(v, 0xf8 | (nBitDepth - 8));
+                                Put8(v, 0);             // numOfSequenceParameterSetExt
+                            }
+                            EndBox(v, avcC);
+                        }
+                        EndBox(v, entry);
+                        EndBox(v, stsd);
+
+                        PutEmptySampleTables(v);
+                    }
+                    EndBox(v, stbl);
+                }
+                EndBox(v, minf);
+            }
+            EndBox(v, mdia);
+        }
+        EndBox(v, trak);
+
+        if (HasAudio())
+        {
+            PutAudioTrack(v);
+        }
+
+        // every audio frame is a sync sample
+        size_t mvex = BeginBox(v, "mvex");
+        PutTrackExtends(v, MP4_VIDEO_TRACK, m_uFrameDuration, MP4_SAMPLE_FLAGS_NON_SYNC);
+        if (HasAudio())
+        {
+            PutTrackExtends(v, MP4_AUDIO_TRACK, m_oAudio.uFrameSamples, MP4_SAMPLE_FLAGS_SYNC);
+        }
+        EndBox(v, mvex);
+    }
+    EndBox(v, moov);
+
+    m_bInitWritten = true;
+    m_stStats.nHeaderBytes += v.size();
+    if (m_pListener && !m_pListener->OnInitSegment())
+    {
+        m_bError = true;
+        return false;
+    }
+    return Emit(&v[0], v.size());
+}
+
+// trak of the audio passthrough: the sample entry describes the frames
+// and needs nothing from outside them
+void CNvMp4Muxer::PutAudioTrack(std::vector<unsigned char> &v) const
+{
+    bool bAc3 = m_oAudio.eCodec == NV_AUDIO_CODEC_AC3;
+
+    size_t trak = BeginBox(v, "trak");
+    {
+        size_t tkhd = BeginFullBox(v, "tkhd", 0, 3);    // enabled, in movie
+        Put32(v, 0);
+        Put32(v, 0);
+        Put32(v, MP4_AUDIO_TRACK);
+        Put32(v, 0);
+        Put32(v, 0);            // duration
+        PutZeros(v, 8);
+        Put16(v, 0);            // layer
+        Put16(v, 1);            // alternate_group
+        Put16(v, 0x0100);       // volume 1.0
+        Put16(v, 0);
+        PutMatrix(v);
+        Put32(v, 0);            // width, height
+        Put32(v, 0);
+        EndBox(v, tkhd);
+
+        size_t mdia = BeginBox(v, "mdia");
+        {
+            size_t mdhd = BeginFullBox(v, "mdhd", 0, 0);
+            Put32(v, 0);
+            Put32(v, 0);
+            Put32(v, m_oAudio.uSampleRate);
+            Put32(v, 0);
+            Put16(v, 0x55c4);   // 'und'
+            Put16(v, 0);
+            EndBox(v, mdhd);
+
+            size_t hdlr = BeginFullBox(v, "hdlr", 0, 0);
+            Put32(v, 0);
+            PutBytes(v, "soun", 4);
+            PutZeros(v, 12);
+            PutBytes(v, "SoundHandler", 13);
+            EndBox(v, hdlr);
+
+            size_t minf = BeginBox(v, "minf");
+            {
+                size_t smhd = BeginFullBox(v, "smhd", 0, 0);
+                Put16(v, 0);    // balance
+                Put16(v, 0);
+                EndBox(v, smhd);
+
+                PutDataInformation(v);
+
+                size_t stbl = BeginBox(v, "stbl");
+                {
+                    size_t stsd = BeginFullBox(v, "stsd", 0, 0);
+                    Put32(v, 1);
+
+                    // AudioSampleEntry; AC-3 says 2 channels whatever it
+                    // carries (ETSI TS 102 366 F.3), dac3 has the layout
+                    size_t entry = BeginBox(v, bAc3 ? "ac-3" : "mp4a");
+                    PutZeros(v, 6);
+                    Put16(v, 1);        // data_reference_index
+                    PutZeros(v, 8);
+                    Put16(v, bAc3 ? 2 : m_oAudio.uChannels);
+                    Put16(v, 16);       // samplesize
+                    Put32(v, 0);
+                    Put32(v, m_oAudio.uSampleRate << 16);
+
+                    if (bAc3)
+                    {
+                        size_t dac3 = BeginBox(v, "dac3");
+                        PutBytes(v, m_oAudio.auDac3, 3);
+                        EndBox(v, dac3);
+                    }
+                    else
+                    {
+                        // ES_Descriptor with a DecoderConfigDescriptor for
+                        // MPEG-1 (0x6B) or MPEG-2 (0x69) audio, which need
+                        // no DecoderSpecificInfo, and the MP4 SLConfig
+                        size_t esds = BeginFullBox(v, "esds", 0, 0);
+                        Put8(v, 0x03);
+                        Put8(v, 3 + 15 + 3);
+                        Put16(v, 0);            // ES_ID
+                        Put8(v, 0);
+                        Put8(v, 0x04);
+                        Put8(v, 13);
+                        Put8(v, m_oAudio.uMpegVersion == 1 ? 0x6b : 0x69);
+                        Put8(v, (0x05 << 2) | 1);   // AudioStream
+                        Put8(v, 0);             // bufferSizeDB
+                        Put16(v, 0);
+                        Put32(v, m_oAudio.uBitrate);    // maxBitrate
+                        Put32(v, m_oAudio.uBitrate);    // avgBitrate
+                        Put8(v, 0x06);
+                        Put8(v, 1);
+                        Put8(v, 2);             // predefined: MP4
+                        EndBox(v, esds);
+                    }
+                    EndBox(v, entry);
+                    EndBox(v, stsd);
+
+                    PutEmptySampleTables(v);
+                }
+                EndBox(v, stbl);
+            }
+            EndBox(v, minf);
+        }
+        EndBox(v, mdia);
+    }
+    EndBox(v, trak);
+}
+
+std::string CNvMp4Muxer::AudioCodecString() const
+{
+    switch (m_oAudio.eCodec)
+    {
+    case NV_AUDIO_CODEC_MPEG:
+        return m_oAudio.uMpegVersion == 1 ? "mp4a.6B" : "mp4a.69";
+    case NV_AUDIO_CODEC_AC3:
+        return "ac-3";
+    default:
+        return std::string();
+    }
+}
+
+bool CNvMp4Muxer::SetAudioFormat(const NvAudioFormat &oFormat)
+{
+    if (!IsOpen() || m_bInitWritten || !oFormat.uSampleRate || !oFormat.uFrameSamples ||
+        (oFormat.eCodec != NV_AUDIO_CODEC_MPEG && oFormat.eCodec != NV_AUDIO_CODEC_AC3))
+    {
+        return false;
+    }
+    m_oAudio = oFormat;
+    return true;
+}
+
+bool CNvMp4Muxer::WriteAudioFrame(const void *pFrame, size_t nBytes, unsigned long long nTime)
+{
+    if (!IsOpen() || m_bError || !HasAudio())
+        return false;
+
+    // snapped onto the frame grid of the audio so far: half a frame off is
+    // timestamp jitter, more is a gap, or an overlap that is dropped
+    unsigned long long nHalf = m_oAudio.uFrameSamples / 2;
+    if (m_stStats.nAudioFrames || !m_vAudioFrames.empty())
+    {
+        if (nTime + nHalf < m_nAudioNext)
+        {
+            m_stStats.nAudioDropped++;
+            return true;
+        }
+        if (nTime <= m_nAudioNext + nHalf)
+        {
+            nTime = m_nAudioNext;
+        }
+        else
+        {
+            m_stStats.nAudioGaps++;
+        }
+    }
+
+    m_vAudioFrames.push_back(std::make_pair(nTime, (uint32_t)nBytes));
+    PutBytes(m_vAudio, pFrame, nBytes);
+    m_nAudioNext = nTime + m_oAudio.uFrameSamples;
+    return true;
+}
+
+bool CNvMp4Muxer::WriteFragment(bool bLast)
+{
+    size_t nSamples = m_vSampleSizes.size();
+    if (!nSamples)
+        return true;
+
+    // the init segment goes out with the first fragment, by which time the
+    // audio format is known if there is audio
+    if (!m_bInitWritten)
+    {
+        if (!WriteInit())
+            return false;
+        if (m_pListener && !m_pListener->OnFragmentStart(m_nFragmentTime, m_bFragmentKey))
+        {
+            m_bError = true;
+            return false;
+        }
+    }
+
+    bool bOffsets = false;
+    for (size_t i = 0; i < nSamples && !bOffsets; i++)
+    {
+        bOffsets = m_vSampleOffsets[i] != 0;
+    }
+
+    // the audio that starts before the video of this fragment ends, or all
+    // of it at the end, as far as it runs on without a gap
+    size_t nAudio = 0, nAudioBytes = 0;
+    unsigned long long nVideoEnd = m_nFrames * m_uFrameDuration;
+    while (nAudio < m_vAudioFrames.size())
+    {
+        const std::pair<unsigned long long, uint32_t> &frame = m_vAudioFrames[nAudio];
+        if (!bLast && frame.first * m_uTimescale >= nVideoEnd * m_oAudio.uSampleRate)
+            break;
+        if (nAudio && frame.first != m_vAudioFrames[0].first + nAudio * m_oAudio.uFrameSamples)
+            break;
+        nAudioBytes += frame.second;
+        nAudio++;
+    }
+
+    std::vector<unsigned char> &v = m_vBox;
+    v.clear();
+
+    unsigned long long nMoofOffset = m_nFileBytes;
+    m_uSequence++;
+
+    size_t moof = BeginBox(v, "moof");
+    size_t mfhd = BeginFullBox(v, "mfhd", 0, 0);
+    Put32(v, m_uSequence);
+    EndBox(v, mfhd);
+
+    size_t nDataOffset = 0, nAudioDataOffset = 0;
+    size_t traf = BeginBox(v, "traf");
+    {
+        // offsets from the moof, every sample one frame long and not a
+        // keyframe unless the trun says so for the first one
+        size_t tfhd = BeginFullBox(v, "tfhd", 0, 0x020000 | 0x000008 | 0x000020);
+        Put32(v, MP4_VIDEO_TRACK);
+        Put32(v, m_uFrameDuration);
+        Put32(v, MP4_SAMPLE_FLAGS_NON_SYNC);
+        EndBox(v, tfhd);
+
+        size_t tfdt = BeginFullBox(v, "tfdt", 1, 0);
+        Put64(v, m_nFragmentTime);
+        EndBox(v, tfdt);
+
+        // data offset, sizes, first sample flags and signed composition
+        // offsets if there are any
+        uint32_t uFlags = 0x000001 | 0x000200 | (m_bFragmentKey ? 0x000004 : 0) | (bOffsets ? 0x000800 : 0);
+        size_t trun = BeginFullBox(v, "trun", bOffsets ? 1 : 0, uFlags);
+        Put32(v, (uint32_t)nSamples);
+        nDataOffset = v.size();
+        Put32(v, 0);
+        if (m_bFragmentKey)
+        {
+            Put32(v, MP4_SAMPLE_FLAGS_SYNC);
+        }
+        for (size_t i = 0; i < nSamples; i++)
+        {
+            Put32(v, m_vSampleSizes[i]);
+            if (bOffsets)
+            {
+                Put32(v, (uint32_t)m_vSampleOffsets[i]);
+            }
+        }
+        EndBox(v, trun);
+    }
+    EndBox(v, traf);
+
+    // the audio, all sync samples of one frame each
+    if (nAudio)
+    {
+        size_t atraf = BeginBox(v, "traf");
+        size_t tfhd = BeginFullBox(v, "tfhd", 0, 0x020000 | 0x000008 | 0x000020);
+        Put32(v, MP4_AUDIO_TRACK);
+        Put32(v, m_oAudio.uFrameSamples);
+        Put32(v, MP4_SAMPLE_FLAGS_SYNC);
+        EndBox(v, tfhd);
+
+        size_t tfdt = BeginFullBox(v, "tfdt", 1, 0);
+        Put64(v, m_vAudioFrames[0].first);
+        EndBox(v, tfdt);
+
+        size_t trun = BeginFullBox(v, "trun", 0, 0x000001 | 0x000200);
+        Put32(v, (uint32_t)nAudio);
+        nAudioDataOffset = v.size();
+        Put32(v, 0);
+        for (size_t i = 0; i < nAudio; i++)
+        {
+            Put32(v, m_vAudioFrames[i].second);
+        }
+        EndBox(v, trun);
+        EndBox(v, atraf);
+    }
+    EndBox(v, moof);
+
+    // the video samples start right after the mdat header, the audio
+    // after them
+    uint32_t uDataOffset = (uint32_t)(v.size() - moof + 8);
+    PutDataOffset(v, nDataOffset, uDataOffset);
+    if (nAudio)
+    {
+        PutDataOffset(v, nAudioDataOffset, uDataOffset + (uint32_t)m_vMdat.size());
+    }
+
+    Put32(v, (uint32_t)(8 + m_vMdat.size() + nAudioBytes));
+    PutBytes(v, "mdat", 4);
+
+    if (m_bFragmentKey)
+    {
+        m_vIndex.push_back(std::make_pair(m_nFragmentTime, nMoofOffset));
+    }
+
+    m_stStats.nFragments++;
+    m_stStats.nHeaderBytes += v.size();
+    m_stStats.nMediaBytes += m_vMdat.size() + nAudioBytes;
+    m_stStats.nAudioFrames += nAudio;
+    if (nSamples > m_stStats.uMaxFragmentFrames)
+    {
+        m_stStats.uMaxFragmentFrames = (unsigned int)nSamples;
+    }
+    if (m_vMdat.size() > m_stStats.nMaxFragmentBytes)
+    {
+        m_stStats.nMaxFragmentBytes = m_vMdat.size();
+    }
+
+    bool bOk = Emit(&v[0], v.size()) && Emit(m_vMdat.empty() ? NULL : &m_vMdat[0], m_vMdat.size()) &&
+               Emit(m_vAudio.empty() ? NULL : &m_vAudio[0], nAudioBytes);
+
+    // clear() keeps the capacity, so steady state allocates nothing
+    m_vMdat.clear();
+    m_vSampleSizes.clear();
+    m_vSampleOffsets.clear();
+    m_vAudio.erase(m_vAudio.begin(), m_vAudio.begin() + nAudioBytes);
+    m_vAudioFrames.erase(m_vAudioFrames.begin(), m_vAudioFrames.begin() + nAudio);
+    return bOk;
+}
+
+bool CNvMp4Muxer::WriteFrame(const void *pAnnexB, size_t nBytes, unsigned long long nPts)
+{
+    if (!IsOpen() || m_bError)
+        return false;
+
+    const unsigned char *pData = (const unsigned char *)pAnnexB;
+    const unsigned char *pEnd = pData + nBytes;
+    bool bHEVC = m_oConfig.bHEVC;
+
+    // NAL units between 00 00 01 start codes. The zero before a 4-byte
+    // start code (and any trailing_zero_8bits) ends up at the end of the
+    // previous unit, whose last byte is never zero, so it is trimmed.
+    m_pFrame = pData;
+    m_vNals.clear();
+    const unsigned char *pNal = NULL;
+    for (const unsigned char *p = pData; p + 3 <= pEnd; )
+    {
+        if (p[2] > 1)
+        {
+            p += 3;
+        }
+        else if (p[0] == 0 && p[1] == 0 && p[2] == 1)
+        {
+            if (pNal)
+            {
+                m_vNals.push_back(std::make_pair((size_t)(pNal - pData), (size_t)(p - pNal)));
+            }
+            pNal = p + 3;
+            p += 3;
+        }
+        else
+        {
+            p++;
+        }
+    }
+    if (pNal)
+    {
+        m_vNals.push_back(std::make_pair((size_t)(pNal - pData), (size_t)(pEnd - pNal)));
+    }
+
+    bool bKeyframe = false;
+    for (size_t i = 0; i < m_vNals.size(); )
+    {
+        while (m_vNals[i].second && pData[m_vNals[i].first + m_vNals[i].second - 1] == 0)
+        {
+            m_vNals[i].second--;
+        }
+        if (m_vNals[i].second < (bHEVC ? 3u : 2u))
+        {
+            m_vNals.erase(m_vNals.begin() + i);
+            continue;
+        }
+
+        unsigned char header = pData[m_vNals[i].first];
+        bKeyframe = bKeyframe || (bHEVC ? ((header >> 1) & 0x3f) >= 16 && ((header >> 1) & 0x3f) <= 21
+                                        : (header & 0x1f) == 5);
+        i++;
+    }
+
+    if (!CollectParameterSets(bKeyframe))
+        return false;
+
+    // a keyframe starts a fragment, so every fragment but the ones cut by
+    // size or frame count is a random access point
+    if (!m_vSampleSizes.empty() &&
+        (bKeyframe || (m_oConfig.uFragmentFrames && m_vSampleSizes.size() >= m_oConfig.uFragmentFrames) ||
+         m_vMdat.size() + nBytes > NV_MP4_MAX_FRAGMENT_BYTES))
+    {
+        if (!WriteFragment(false))
+            return false;
+    }
+
+    // the first fragment is announced after the init segment, which
+    // WriteFragment() writes
+    if (m_vSampleSizes.empty())
+    {
+        m_bFragmentKey = bKeyframe;
+        m_nFragmentTime = m_nFrames * m_uFrameDuration;
+        if (m_bInitWritten && m_pListener && !m_pListener->OnFragmentStart(m_nFragmentTime, bKeyframe))
+        {
+            m_bError = true;
+            return false;
+        }
+    }
+
+    // the sample: everything but parameter sets and access unit delimiters
+    size_t nSampleStart = m_vMdat.size();
+    for (size_t i = 0; i < m_vNals.size(); i++)
+    {
+        const unsigned char *pUnit = pData + m_vNals[i].first;
+        uint32_t uSize = (uint32_t)m_vNals[i].second;
+        unsigned int nalType = bHEVC ? (pUnit[0] >> 1) & 0x3f : pUnit[0] & 0x1f;
+        if (bHEVC ? (nalType >= 32 && nalType <= 35) : (nalType >= 7 && nalType <= 9))
+            continue;
+
+        Put32(m_vMdat, uSize);
+        PutBytes(m_vMdat, pUnit, uSize);
+    }
+
+    m_vSampleSizes.push_back((uint32_t)(m_vMdat.size() - nSampleStart));
+    m_vSampleOffsets.push_back((int32_t)((long long)nPts * m_uFrameDuration - (long long)m_nFrames * m_uFrameDuration));
+    m_nFrames++;
+    m_stStats.nFrames++;
+    m_stStats.nKeyframes += bKeyframe ? 1 : 0;
+    return true;
+}
+
+bool CNvMp4Muxer::Close()
+{
+    if (!IsOpen())
+        return true;
+
+    bool bOk = !m_bError && WriteFragment(true);
+
+    // what couldn't follow on in the last fragment
+    m_stStats.nAudioDropped += m_vAudioFrames.size();
+    m_vAudio.clear();
+    m_vAudioFrames.clear();
+
+    if (bOk && m_bInitWritten && m_pListener)
+    {
+        bOk = m_pListener->OnEnd(m_nFrames * m_uFrameDuration);
+    }
+
+    // mfra: where the keyframe fragments start, so a player can seek
+    // without reading every moof; mfro at the very end gives its size
+    if (bOk && m_bInitWritten && !m_pListener)
+    {
+        std::vector<unsigned char> &v = m_vBox;
+        v.clear();
+
+        size_t mfra = BeginBox(v, "mfra");
+        size_t tfra = BeginFullBox(v, "tfra", 1, 0);
+        Put32(v, MP4_VIDEO_TRACK);
+        Put32(v, 0);                // 1-byte traf, trun and sample numbers
+        Put32(v, (uint32_t)m_vIndex.size());
+        for (size_t i = 0; i < m_vIndex.size(); i++)
+        {
+            Put64(v, m_vIndex[i].first);
+            Put64(v, m_vIndex[i].second);
+            Put8(v, 1);
+            Put8(v, 1);
+            Put8(v, 1);
+        }
+        EndBox(v, tfra);
+        size_t mfro = BeginFullBox(v, "mfro", 0, 0);
+        Put32(v, (uint32_t)(v.size() - mfra + 4));
+        EndBox(v, mfro);
+        EndBox(v, mfra);
+
+        m_stStats.nHeaderBytes += v.size();
+        bOk = Emit(&v[0], v.size());
+    }
+
+    m_pOutput = NULL;
+    m_pListener = NULL;
+    return bOk;
+}
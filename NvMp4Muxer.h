@@ -0,0 +1,234 @@
+/*
+ * Copyright 1993-2015 NVIDIA Corporation.  All rights reserved.
+ *
+ * Please refer to the NVIDIA end user license agreement (EULA) associated
+ * with this source code for terms and conditions that govern your use of
+ * this software. Any use, reproduction, disclosure, or distribution of
+ * this software and related documentation outside the terms of the EULA
+ * is strictly prohibited.
+ *
+ */
+
+#ifndef NV_MP4_MUXER_H
+#define NV_MP4_MUXER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "NvAudioQueue.h"
+#include "NvBitstreamWriter.h"
+
+// A fragment is cut at this size whatever the GOP length, which bounds the
+// muxer's memory when NVENC runs with an infinite GOP.
+#define NV_MP4_MAX_FRAGMENT_BYTES   (32 << 20)
+
+struct NvMp4MuxerConfig
+{
+    bool            bHEVC;
+    unsigned int    width;
+    unsigned int    height;
+    unsigned int    uFpsNum;            // constant frame rate uFpsNum / uFpsDen
+    unsigned int    uFpsDen;
+    unsigned int    uFragmentFrames;    // also cut after this many frames; 0 = at keyframes only
+};
+
+struct NvMp4MuxerStats
+{
+    unsigned long long nFrames;
+    unsigned long long nKeyframes;
+    unsigned long long nFragments;
+    unsigned long long nMediaBytes;         // samples in the mdat boxes, video and audio
+    unsigned long long nHeaderBytes;        // everything else: ftyp, moov, moof, mdat headers, mfra
+    unsigned int       uMaxFragmentFrames;
+    size_t             nMaxFragmentBytes;   // largest video mdat payload, i.e. what the muxer buffered
+    unsigned long long nAudioFrames;        // written
+    unsigned long long nAudioDropped;       // overlapping the ones before, or left over at the end
+    unsigned long long nAudioGaps;          // jumps forward in the audio timestamps
+};
+
+// Told where the muxer's output changes files, if it should; a segmenter
+// switches pOutput to the next file in these. The calls come from
+// WriteFrame() and Close(), right before the bytes in question are written,
+// and a false return fails the muxer like a write error.
+class INvMp4MuxerListener
+{
+public:
+    virtual ~INvMp4MuxerListener() {}
+
+    // the init segment (ftyp + moov) comes next
+    virtual bool OnInitSegment() = 0;
+
+    // a fragment starting at decode time nTime (ticks) has begun to collect;
+    // everything before it has been written
+    virtual bool OnFragmentStart(unsigned long long nTime, bool bKeyframe) = 0;
+
+    // after the last fragment, which ends at nEndTime
+    virtual bool OnEnd(unsigned long long nEndTime) = 0;
+};
+
+// true for the names written as MP4: *.mp4 and *.m4v
+bool nvMp4IsMp4Path(const char *szPath);
+
+// RFC 6381 codecs parameter from the profile fields as avcC / hvcC store
+// them: for H.264 the three bytes profile, compatibility and level, for HEVC
+// the 12 bytes of the general profile_tier_level. E.g. "avc1.64001f" or
+// "hvc1.1.6.L93.90".
+std::string nvMp4CodecString(bool bHEVC, const unsigned char *pProfile);
+
+// Streaming fragmented MP4 (ISO BMFF) writer for one H.264 or HEVC track.
+//
+// WriteFrame() takes one encoded picture in Annex-B form, as the encoders
+// return it, and stores its NAL units with 4-byte length prefixes. The
+// parameter sets of the first frame, which must be a keyframe, go into the
+// avcC/hvcC box of the init segment (ftyp + moov) and are dropped from the
+// samples, so the track is 'avc1' / 'hvc1'. Frames collect in the current
+// fragment until the next keyframe, uFragmentFrames or
+// NV_MP4_MAX_FRAGMENT_BYTES, and then go out as one moof + mdat; the
+// muxer holds one fragment, never the file. Close() writes the last
+// fragment and an mfra index of the keyframe fragments for seeking.
+//
+// With a listener the output may be cut into separate files at fragment
+// boundaries (CMAF segments); the init segment then also carries the
+// 'cmfc' brand and there is no mfra, since no one file holds every moof.
+//
+// Samples are in decode order at a constant frame rate: decode time is
+// frame number x frame duration and presentation time comes from nPts, so
+// reordered (B-frame) streams get composition offsets. Not thread safe;
+// one thread (the encoder output thread) does all the writing.
+//
+// An audio track can be added for passthrough: MPEG audio as 'mp4a', AC-3
+// as 'ac-3', the frames stored unchanged. The init segment waits for the
+// first fragment so the audio format can still be set by then. Audio
+// frames are held until the video fragment they play with is written and
+// go into the same moof and mdat, after the video. The audio timeline is
+// the timestamps snapped to whole frames: a jump forward starts the next
+// fragment's audio at the new time, frames overlapping the previous ones
+// are dropped.
+class CNvMp4Muxer
+{
+public:
+    CNvMp4Muxer();
+
+    // Nothing is written before the first frame; pOutput must stay open
+    // until Close(), or be reopened by pListener.
+    bool Open(CNvBitstreamWriter *pOutput, const NvMp4MuxerConfig &oConfig,
+              INvMp4MuxerListener *pListener = NULL);
+
+    bool IsOpen() const
+    {
+        return m_pOutput != NULL;
+    }
+
+    // before the first frame
+    void SetFragmentFrames(unsigned int uFrames)
+    {
+        m_oConfig.uFragmentFrames = uFrames;
+    }
+
+    // nPts is the presentation time in frames. False, and the muxer stops
+    // writing, if the stream can't be put in this track (no leading
+    // keyframe, parameter sets changing midway) or the output failed.
+    bool WriteFrame(const void *pAnnexB, size_t nBytes, unsigned long long nPts);
+
+    // Adds an audio track of this format. Before the first fragment is
+    // written; false after that, or for a format MP4 can't carry.
+    bool SetAudioFormat(const NvAudioFormat &oFormat);
+
+    bool HasAudio() const
+    {
+        return m_oAudio.eCodec != NV_AUDIO_CODEC_NONE;
+    }
+
+    // One audio frame of the format set, as it was in the stream; nTime is
+    // its presentation time in samples from the first video frame.
+    bool WriteAudioFrame(const void *pFrame, size_t nBytes, unsigned long long nTime);
+
+    // Writes what is buffered and the index; leaves pOutput open.
+    bool Close();
+
+    const NvMp4MuxerConfig &Config() const
+    {
+        return m_oConfig;
+    }
+
+    // ticks per second of the track, and per frame
+    unsigned int Timescale() const
+    {
+        return m_uTimescale;
+    }
+    unsigned int FrameDuration() const
+    {
+        return m_uFrameDuration;
+    }
+
+    // RFC 6381 codecs parameter, e.g. "avc1.64001f"; empty before the
+    // first fragment
+    const std::string &CodecString() const
+    {
+        return m_sCodec;
+    }
+
+    // of the audio track, e.g. "mp4a.6B" or "ac-3"; empty without one
+    std::string AudioCodecString() const;
+
+    void GetStats(NvMp4MuxerStats *pStats) const
+    {
+        *pStats = m_stStats;
+    }
+
+private:
+    typedef std::vector<unsigned char> Nal;
+
+    bool Fail(const char *szMessage);
+    bool CollectParameterSets(bool bKeyframe);
+    bool WriteInit();
+    void PutAudioTrack(std::vector<unsigned char> &v) const;
+    bool WriteFragment(bool bLast);
+    bool Emit(const void *pData, size_t nBytes);
+
+    // non-copyable
+    CNvMp4Muxer(const CNvMp4Muxer &);
+    CNvMp4Muxer &operator=(const CNvMp4Muxer &);
+
+    CNvBitstreamWriter                      *m_pOutput;
+    INvMp4MuxerListener                     *m_pListener;
+    NvMp4MuxerConfig                         m_oConfig;
+    unsigned int                             m_uTimescale;
+    unsigned int                             m_uFrameDuration;
+    std::string                              m_sCodec;
+    bool                                     m_bInitWritten;
+    bool                                     m_bError;
+
+    // NAL units of the frame being written: offset and size in it
+    std::vector<std::pair<size_t, size_t> >  m_vNals;
+    const unsigned char                     *m_pFrame;
+
+    // VPS (HEVC only), SPS and PPS, without start codes
+    std::vector<Nal>                         m_avParameterSets[3];
+
+    // the fragment being collected
+    std::vector<unsigned char>               m_vMdat;
+    std::vector<uint32_t>                    m_vSampleSizes;
+    std::vector<int32_t>                     m_vSampleOffsets;   // composition offsets, ticks
+    bool                                     m_bFragmentKey;     // first sample is a keyframe
+    unsigned long long                       m_nFragmentTime;    // decode time of the first sample
+
+    unsigned long long                       m_nFrames;          // written so far, decode order
+    unsigned int                             m_uSequence;        // mfhd sequence number
+    unsigned long long                       m_nFileBytes;
+    std::vector<std::pair<unsigned long long, unsigned long long> > m_vIndex;  // (time, moof offset)
+    std::vector<unsigned char>               m_vBox;             // moov or moof being built
+
+    // audio frames waiting for their fragment, back to back, with their
+    // times in samples
+    NvAudioFormat                            m_oAudio;
+    std::vector<unsigned char>               m_vAudio;
+    std::vector<std::pair<unsigned long long, uint32_t> > m_vAudioFrames;  // (time, size)
+    unsigned long long                       m_nAudioNext;       // where the next frame follows on
+    NvMp4MuxerStats                          m_stStats;
+};
+
+#endif // NV_MP4_MUXER_H
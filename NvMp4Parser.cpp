@@ -0,0 +1,938 @@
+/*
+ * Copyright 1993-2015 NVIDIA Corporation.  All rights reserved.
+ *
+ * Please refer to the NVIDIA end user license agreement (EULA) associated
+ * with this source code for terms and conditions that govern your use of
+ * this software. Any use, reproduction, disclosure, or distribution of
+ * this software and related documentation outside the terms of the EULA
+ * is strictly prohibited.
+ *
+ */
+
+#include "NvMp4Parser.h"
+#include "NvMp4Muxer.h"
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <map>
+#include <vector>
+
+// moov, moof and mfra are read whole; anything bigger is not ours
+#define MP4_MAX_HEADER_BOX_BYTES    (16 << 20)
+
+// sample_is_non_sync_sample
+#define MP4_SAMPLE_NON_SYNC         0x00010000
+
+static uint32_t Get32(const unsigned char *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static unsigned long long Get64(const unsigned char *p)
+{
+    return ((unsigned long long)Get32(p) << 32) | Get32(p + 4);
+}
+
+// One box: where it starts, its total size and how much of that is header
+struct Mp4Box
+{
+    unsigned long long nOffset;
+    unsigned long long nSize;
+    unsigned int       nHeader;
+    char               type[5];
+};
+
+// Box header at p[0..n), size 0 meaning "to the end"
+static bool ParseBoxHeader(const unsigned char *p, unsigned long long n, unsigned long long nOffset, Mp4Box &box)
+{
+    if (n < 8)
+        return false;
+
+    box.nOffset = nOffset;
+    box.nSize = Get32(p);
+    box.nHeader = 8;
+    memcpy(box.type, p + 4, 4);
+    box.type[4] = 0;
+    if (box.nSize == 1)
+    {
+        if (n < 16)
+            return false;
+        box.nSize = Get64(p + 8);
+        box.nHeader = 16;
+    }
+    else if (box.nSize == 0)
+    {
+        box.nSize = n;
+    }
+    return box.nSize >= box.nHeader && box.nSize <= n;
+}
+
+// First child of the given type in the payload p[0..n), offsets relative to p
+static bool FindBox(const unsigned char *p, size_t n, const char *szType, Mp4Box &box)
+{
+    for (size_t pos = 0; pos < n; pos += (size_t)box.nSize)
+    {
+        if (!ParseBoxHeader(p + pos, n - pos, pos, box))
+            return false;
+        if (!memcmp(box.type, szType, 4))
+            return true;
+    }
+    return false;
+}
+
+// Whether the trak's mdia/hdlr has this handler_type
+static bool HasHandler(const unsigned char *pTrak, size_t nTrak, const char *szType)
+{
+    Mp4Box mdia, hdlr;
+    if (!FindBox(pTrak, nTrak, "mdia", mdia))
+        return false;
+    const unsigned char *pMdia = pTrak + mdia.nOffset + mdia.nHeader;
+    return FindBox(pMdia, (size_t)(mdia.nSize - mdia.nHeader), "hdlr", hdlr) && hdlr.nSize >= 20 &&
+           !memcmp(pMdia + hdlr.nOffset + hdlr.nHeader + 8, szType, 4);
+}
+
+class CMp4Checker
+{
+public:
+    CMp4Checker(const char *szPath, NvMp4FileInfo *pInfo): m_szPath(szPath), m_pInfo(pInfo), m_pFile(NULL),
+        m_bMoov(false), m_bHEVC(false), m_bInBandSetsAllowed(false), m_nLengthSize(4),
+        m_eAudioCodec(NV_AUDIO_CODEC_NONE), m_uSequence(0), m_nFragmentTime(0)
+    {
+        memset(&m_oVideo, 0, sizeof(m_oVideo));
+        memset(&m_oAudio, 0, sizeof(m_oAudio));
+    }
+
+    ~CMp4Checker()
+    {
+        if (m_pFile)
+            fclose(m_pFile);
+    }
+
+    bool Run();
+
+private:
+    struct Track
+    {
+        uint32_t           uID;             // 0: there is no such track
+        uint32_t           uTimescale;
+        bool               bTrex;
+        uint32_t           uTrexDuration;
+        uint32_t           uTrexSize;
+        uint32_t           uTrexFlags;
+        unsigned long long nDecodeTime;     // where the fragments so far ended
+    };
+
+    struct Sample
+    {
+        unsigned long long nOffset;     // in the file
+        uint32_t           uSize;
+        uint32_t           uDuration;
+        bool               bSync;
+        bool               bAudio;
+    };
+
+    static bool OffsetLess(const Sample &a, const Sample &b)
+    {
+        return a.nOffset < b.nOffset;
+    }
+
+    void Error(unsigned long long nOffset, const char *szFormat, ...);
+    bool ReadAt(unsigned long long nOffset, void *pData, size_t nBytes);
+    bool ParseMoov(const unsigned char *p, size_t n, unsigned long long nOffset);
+    bool ParseTrak(const unsigned char *pTrak, size_t nTrak, unsigned long long nOffset, bool bVideo,
+                   Track &track, Mp4Box &entry, const unsigned char *&pEntry);
+    bool ParseVideoTrak(const unsigned char *pTrak, size_t nTrak, unsigned long long nOffset);
+    bool ParseAudioTrak(const unsigned char *pTrak, size_t nTrak, unsigned long long nOffset);
+    bool ParseMoof(const unsigned char *p, size_t n, unsigned long long nOffset);
+    bool ParseTraf(const unsigned char *pTraf, size_t nTraf, unsigned long long nOffset, bool &bVideo);
+    void CheckMdat(const Mp4Box &mdat);
+    void CheckSample(const Sample &sample);
+    void ParseMfra(const unsigned char *p, size_t n, const Mp4Box &mfra);
+
+    const char             *m_szPath;
+    NvMp4FileInfo          *m_pInfo;
+    FILE                   *m_pFile;
+
+    // from the moov
+    bool                    m_bMoov;
+    bool                    m_bHEVC;
+    bool                    m_bInBandSetsAllowed;   // avc3 / hev1
+    unsigned int            m_nLengthSize;
+    Track                   m_oVideo;
+    Track                   m_oAudio;
+    NvAudioCodec            m_eAudioCodec;
+
+    // the fragments so far
+    uint32_t                m_uSequence;
+    unsigned long long      m_nFragmentTime;        // tfdt of the video traf of the last moof
+    std::vector<Sample>     m_vSamples;             // of the moof waiting for its mdat, all tracks
+    std::map<unsigned long long, std::pair<unsigned long long, bool> > m_mMoofs;   // offset -> (tfdt, starts with sync)
+    std::vector<unsigned char> m_vSample;
+};
+
+void CMp4Checker::Error(unsigned long long nOffset, const char *szFormat, ...)
+{
+    char szMessage[256];
+    va_list args;
+    va_start(args, szFormat);
+    vsnprintf(szMessage, sizeof(szMessage), szFormat, args);
+    va_end(args);
+
+    printf("nvMp4Check: %s at offset %llu: %s\n", m_szPath, nOffset, szMessage);
+    m_pInfo->nErrors++;
+}
+
+bool CMp4Checker::ReadAt(unsigned long long nOffset, void *pData, size_t nBytes)
+{
+    return fseeko(m_pFile, (off_t)nOffset, SEEK_SET) == 0 && fread(pData, 1, nBytes, m_pFile) == nBytes;
+}
+
+bool CMp4Checker::ParseMoov(const unsigned char *p, size_t n, unsigned long long nOffset)
+{
+    Mp4Box trak, mvex, box;
+
+    // the video trak, and a sound one if there is one, in any order
+    bool bTrak = false;
+    for (size_t pos = 0; pos < n; pos += (size_t)trak.nSize)
+    {
+        if (!ParseBoxHeader(p + pos, n - pos, pos, trak))
+        {
+            Error(nOffset, "malformed box in the moov");
+            return false;
+        }
+        if (memcmp(trak.type, "trak", 4))
+            continue;
+
+        const unsigned char *pTrak = p + pos + trak.nHeader;
+        size_t nTrak = (size_t)(trak.nSize - trak.nHeader);
+        if (HasHandler(pTrak, nTrak, "soun"))
+        {
+            if (m_oAudio.uID)
+            {
+                Error(nOffset, "more than one audio track");
+            }
+            else if (!ParseAudioTrak(pTrak, nTrak, nOffset))
+            {
+                return false;
+            }
+        }
+        else if (bTrak)
+        {
+            Error(nOffset, "more than one video track");
+        }
+        else
+        {
+            if (!ParseVideoTrak(pTrak, nTrak, nOffset))
+                return false;
+            bTrak = true;
+        }
+    }
+    if (!bTrak)
+    {
+        Error(nOffset, "moov without a video trak");
+        return false;
+    }
+    if (m_oAudio.uID && m_oAudio.uID == m_oVideo.uID)
+    {
+        Error(nOffset, "audio and video are both track %u", m_oVideo.uID);
+        return false;
+    }
+
+    if (!FindBox(p, n, "mvex", mvex))
+    {
+        Error(nOffset, "no mvex/trex: not a fragmented file");
+        return false;
+    }
+    const unsigned char *pMvex = p + mvex.nOffset + mvex.nHeader;
+    size_t nMvex = (size_t)(mvex.nSize - mvex.nHeader);
+    for (size_t pos = 0; pos < nMvex && ParseBoxHeader(pMvex + pos, nMvex - pos, pos, box); pos += (size_t)box.nSize)
+    {
+        const unsigned char *pTrex = pMvex + pos + box.nHeader;
+        if (memcmp(box.type, "trex", 4) || box.nSize < box.nHeader + 24)
+            continue;
+
+        Track *pTrack = Get32(pTrex + 4) == m_oVideo.uID ? &m_oVideo
+                      : (m_oAudio.uID && Get32(pTrex + 4) == m_oAudio.uID) ? &m_oAudio : NULL;
+        if (pTrack)
+        {
+            pTrack->bTrex         = true;
+            pTrack->uTrexDuration = Get32(pTrex + 12);
+            pTrack->uTrexSize     = Get32(pTrex + 16);
+            pTrack->uTrexFlags    = Get32(pTrex + 20);
+        }
+    }
+    if (!m_oVideo.bTrex)
+    {
+        Error(nOffset, "no trex for track %u: not a fragmented file", m_oVideo.uID);
+        return false;
+    }
+    if (m_oAudio.uID && !m_oAudio.bTrex)
+    {
+        Error(nOffset, "no trex for audio track %u", m_oAudio.uID);
+        return false;
+    }
+
+    m_bMoov = true;
+    return true;
+}
+
+// tkhd, mdhd and the sample entry of a trak, whose sample tables have to
+// be empty; pEntry gets the start of the stsd entries
+bool CMp4Checker::ParseTrak(const unsigned char *pTrak, size_t nTrak, unsigned long long nOffset, bool bVideo,
+                            Track &track, Mp4Box &entry, const unsigned char *&pEntry)
+{
+    Mp4Box box, mdia, minf, stbl, stsd;
+
+    if (FindBox(pTrak, nTrak, "tkhd", box) && box.nSize >= box.nHeader + 84 &&
+        (pTrak[box.nOffset + box.nHeader] != 1 || box.nSize >= box.nHeader + 96))
+    {
+        const unsigned char *pBox = pTrak + box.nOffset + box.nHeader;
+        bool bV1 = pBox[0] == 1;
+        track.uID = Get32(pBox + (bV1 ? 20 : 12));
+        if (bVideo)
+        {
+            m_pInfo->width  = Get32(pBox + (bV1 ? 88 : 76)) >> 16;
+            m_pInfo->height = Get32(pBox + (bV1 ? 92 : 80)) >> 16;
+        }
+    }
+    else
+    {
+        Error(nOffset, "trak without a tkhd");
+        return false;
+    }
+
+    if (!FindBox(pTrak, nTrak, "mdia", mdia))
+    {
+        Error(nOffset, "trak without an mdia");
+        return false;
+    }
+    const unsigned char *pMdia = pTrak + mdia.nOffset + mdia.nHeader;
+    size_t nMdia = (size_t)(mdia.nSize - mdia.nHeader);
+
+    if (FindBox(pMdia, nMdia, "mdhd", box) && box.nSize >= 32)
+    {
+        const unsigned char *pBox = pMdia + box.nOffset + box.nHeader;
+        track.uTimescale = Get32(pBox + (pBox[0] == 1 ? 20 : 12));
+    }
+    if (!track.uTimescale)
+    {
+        Error(nOffset, "no mdhd timescale");
+    }
+
+    if (!FindBox(pMdia, nMdia, "minf", minf) ||
+        !FindBox(pMdia + minf.nOffset + minf.nHeader, (size_t)(minf.nSize - minf.nHeader), "stbl", stbl))
+    {
+        Error(nOffset, "mdia without minf/stbl");
+        return false;
+    }
+    const unsigned char *pStbl = pMdia + minf.nOffset + minf.nHeader + stbl.nOffset + stbl.nHeader;
+    size_t nStbl = (size_t)(stbl.nSize - stbl.nHeader);
+
+    // every sample is in a fragment
+    const char *tables[2] = { "stts", "stsz" };
+    for (int i = 0; i < 2; i++)
+    {
+        if (FindBox(pStbl, nStbl, tables[i], box) && box.nSize >= 20 &&
+            Get32(pStbl + box.nOffset + box.nHeader + (i == 1 ? 8 : 4)) != 0)
+        {
+            Error(nOffset, "%s lists samples outside the fragments", tables[i]);
+        }
+    }
+
+    // stsd: version/flags, entry_count, then the visual sample entry with
+    // its 78 bytes of fields before the child boxes, or the audio one
+    // with 28
+    size_t nFields = bVideo ? 78 : 28;
+    if (!FindBox(pStbl, nStbl, "stsd", stsd) || stsd.nSize < stsd.nHeader + 8 + 8 + nFields)
+    {
+        Error(nOffset, "no %s sample entry", bVideo ? "video" : "audio");
+        return false;
+    }
+    pEntry = pStbl + stsd.nOffset + stsd.nHeader + 8;
+    if (!ParseBoxHeader(pEntry, stsd.nSize - stsd.nHeader - 8, 0, entry) || entry.nSize < 8 + nFields)
+    {
+        Error(nOffset, "malformed sample entry");
+        return false;
+    }
+    return true;
+}
+
+bool CMp4Checker::ParseVideoTrak(const unsigned char *pTrak, size_t nTrak, unsigned long long nOffset)
+{
+    Mp4Box box, entry;
+    const unsigned char *pEntries;
+
+    if (!ParseTrak(pTrak, nTrak, nOffset, true, m_oVideo, entry, pEntries))
+        return false;
+    m_pInfo->uTimescale = m_oVideo.uTimescale;
+    if (!HasHandler(pTrak, nTrak, "vide"))
+    {
+        Error(nOffset, "the track is not video");
+    }
+
+    if (!memcmp(entry.type, "avc1", 4) || !memcmp(entry.type, "avc3", 4))
+    {
+        m_bHEVC = false;
+    }
+    else if (!memcmp(entry.type, "hvc1", 4) || !memcmp(entry.type, "hev1", 4))
+    {
+        m_bHEVC = true;
+    }
+    else
+    {
+        Error(nOffset, "sample entry '%s' is neither H.264 nor HEVC", entry.type);
+        return false;
+    }
+    m_bInBandSetsAllowed = !memcmp(entry.type, "avc3", 4) || !memcmp(entry.type, "hev1", 4);
+
+    const unsigned char *pConfigs = pEntries + entry.nHeader + 78;
+    size_t nConfigs = (size_t)(entry.nSize - entry.nHeader - 78);
+    if (!FindBox(pConfigs, nConfigs, m_bHEVC ? "hvcC" : "avcC", box) || box.nSize < box.nHeader + (m_bHEVC ? 23 : 7))
+    {
+        Error(nOffset, "'%s' without its %s", entry.type, m_bHEVC ? "hvcC" : "avcC");
+        return false;
+    }
+    const unsigned char *pConfig = pConfigs + box.nOffset + box.nHeader;
+    m_nLengthSize = (pConfig[m_bHEVC ? 21 : 4] & 3) + 1;
+    m_pInfo->sCodec = nvMp4CodecString(m_bHEVC, pConfig + 1);
+    if (m_nLengthSize == 3)
+    {
+        Error(nOffset, "NAL length size of 3 bytes");
+    }
+    return true;
+}
+
+// MPEG audio ('mp4a' with an esds) or AC-3 ('ac-3' with a dac3), timed in
+// samples
+bool CMp4Checker::ParseAudioTrak(const unsigned char *pTrak, size_t nTrak, unsigned long long nOffset)
+{
+    Mp4Box box, entry;
+    const unsigned char *pEntries;
+
+    if (!ParseTrak(pTrak, nTrak, nOffset, false, m_oAudio, entry, pEntries))
+        return false;
+
+    const unsigned char *pFields = pEntries + entry.nHeader;
+    const unsigned char *pConfigs = pFields + 28;
+    size_t nConfigs = (size_t)(entry.nSize - entry.nHeader - 28);
+    if (!memcmp(entry.type, "mp4a", 4))
+    {
+        m_eAudioCodec = NV_AUDIO_CODEC_MPEG;
+        if (!FindBox(pConfigs, nConfigs, "esds", box))
+        {
+            Error(nOffset, "'mp4a' without its esds");
+        }
+    }
+    else if (!memcmp(entry.type, "ac-3", 4))
+    {
+        m_eAudioCodec = NV_AUDIO_CODEC_AC3;
+        if (!FindBox(pConfigs, nConfigs, "dac3", box) || box.nSize < box.nHeader + 3)
+        {
+            Error(nOffset, "'ac-3' without its dac3");
+        }
+    }
+    else
+    {
+        Error(nOffset, "audio sample entry '%s' is neither MPEG audio nor AC-3", entry.type);
+        return false;
+    }
+
+    m_pInfo->sAudioCodec = entry.type;
+    m_pInfo->uAudioSampleRate = Get32(pFields + 24) >> 16;
+    if (m_pInfo->uAudioSampleRate != m_oAudio.uTimescale)
+    {
+        Error(nOffset, "audio at %u Hz with a timescale of %u", m_pInfo->uAudioSampleRate, m_oAudio.uTimescale);
+    }
+    return true;
+}
+
+bool CMp4Checker::ParseMoof(const unsigned char *p, size_t n, unsigned long long nOffset)
+{
+    Mp4Box mfhd, traf;
+
+    if (!FindBox(p, n, "mfhd", mfhd) || mfhd.nSize < mfhd.nHeader + 8)
+    {
+        Error(nOffset, "moof without an mfhd");
+        return false;
+    }
+    uint32_t uSequence = Get32(p + mfhd.nOffset + mfhd.nHeader + 4);
+    if (uSequence != m_uSequence + 1)
+    {
+        Error(nOffset, "fragment sequence number %u after %u", uSequence, m_uSequence);
+    }
+    m_uSequence = uSequence;
+
+    // every traf, the video one and maybe an audio one
+    m_vSamples.clear();
+    bool bTraf = false, bVideo = false;
+    for (size_t pos = 0; pos < n; pos += (size_t)traf.nSize)
+    {
+        if (!ParseBoxHeader(p + pos, n - pos, pos, traf))
+        {
+            Error(nOffset, "malformed box in the moof");
+            return false;
+        }
+        if (memcmp(traf.type, "traf", 4))
+            continue;
+
+        bTraf = true;
+        if (!ParseTraf(p + pos + traf.nHeader, (size_t)(traf.nSize - traf.nHeader), nOffset, bVideo))
+            return false;
+    }
+    if (!bTraf)
+    {
+        Error(nOffset, "moof without a traf");
+        return false;
+    }
+
+    // the video samples come first in m_vSamples unless the trafs are
+    // the other way round
+    const Sample *pFirst = NULL;
+    for (size_t i = 0; i < m_vSamples.size() && !pFirst; i++)
+    {
+        pFirst = m_vSamples[i].bAudio ? NULL : &m_vSamples[i];
+    }
+    if (!pFirst)
+    {
+        Error(nOffset, "fragment without samples");
+    }
+    m_mMoofs[nOffset] = std::make_pair(m_nFragmentTime, pFirst && pFirst->bSync);
+    m_pInfo->nFragments++;
+    return true;
+}
+
+bool CMp4Checker::ParseTraf(const unsigned char *pTraf, size_t nTraf, unsigned long long nOffset, bool &bVideo)
+{
+    Mp4Box box;
+
+    // tfhd: the track, the defaults and where offsets count from
+    if (!FindBox(pTraf, nTraf, "tfhd", box) || box.nSize < box.nHeader + 8)
+    {
+        Error(nOffset, "traf without a tfhd");
+        return false;
+    }
+    const unsigned char *pTfhd = pTraf + box.nOffset + box.nHeader;
+    const unsigned char *pTfhdEnd = pTraf + box.nOffset + box.nSize;
+    uint32_t uFlags = Get32(pTfhd) & 0xffffff;
+    uint32_t uTrackID = Get32(pTfhd + 4);
+    bool bAudio = m_oAudio.uID && uTrackID == m_oAudio.uID;
+    if (!bAudio && uTrackID != m_oVideo.uID)
+    {
+        Error(nOffset, "traf for track %u, the moov has %u", uTrackID, m_oVideo.uID);
+    }
+    if (!bAudio && bVideo)
+    {
+        Error(nOffset, "second traf for the video track");
+    }
+    bVideo = bVideo || !bAudio;
+    Track &track = bAudio ? m_oAudio : m_oVideo;
+
+    unsigned long long nBase = nOffset;
+    uint32_t uDuration = track.uTrexDuration, uSize = track.uTrexSize, uSampleFlags = track.uTrexFlags;
+    const unsigned char *q = pTfhd + 8;
+    size_t nFields = ((uFlags & 0x01) ? 8 : 0) + ((uFlags & 0x02) ? 4 : 0) + ((uFlags & 0x08) ? 4 : 0) +
+                     ((uFlags & 0x10) ? 4 : 0) + ((uFlags & 0x20) ? 4 : 0);
+    if (q + nFields > pTfhdEnd)
+    {
+        Error(nOffset, "tfhd too short for its flags");
+        return false;
+    }
+    if (uFlags & 0x01) { nBase = Get64(q); q += 8; }
+    if (uFlags & 0x02) { q += 4; }
+    if (uFlags & 0x08) { uDuration = Get32(q); q += 4; }
+    if (uFlags & 0x10) { uSize = Get32(q); q += 4; }
+    if (uFlags & 0x20) { uSampleFlags = Get32(q); q += 4; }
+
+    // tfdt: fragments have to line up without reading the ones before;
+    // audio may jump ahead over a gap in the source
+    if (!FindBox(pTraf, nTraf, "tfdt", box) || box.nSize < box.nHeader + 8)
+    {
+        Error(nOffset, "traf without a tfdt");
+    }
+    else
+    {
+        const unsigned char *pTfdt = pTraf + box.nOffset + box.nHeader;
+        unsigned long long nTime = (pTfdt[0] == 1 && box.nSize >= box.nHeader + 12) ? Get64(pTfdt + 4) : Get32(pTfdt + 4);
+        if (bAudio ? nTime < track.nDecodeTime : nTime != track.nDecodeTime)
+        {
+            Error(nOffset, "%stfdt %llu, the previous fragment ended at %llu", bAudio ? "audio " : "", nTime, track.nDecodeTime);
+        }
+        track.nDecodeTime = nTime;
+    }
+    if (!bAudio)
+    {
+        m_nFragmentTime = track.nDecodeTime;
+    }
+
+    // every trun of the traf, in order
+    unsigned long long nDataEnd = nBase;
+    for (size_t pos = 0; pos < nTraf; pos += (size_t)box.nSize)
+    {
+        if (!ParseBoxHeader(pTraf + pos, nTraf - pos, pos, box))
+        {
+            Error(nOffset, "malformed box in the traf");
+            return false;
+        }
+        if (memcmp(box.type, "trun", 4))
+            continue;
+
+        const unsigned char *pTrun = pTraf + pos + box.nHeader;
+        const unsigned char *pTrunEnd = pTraf + pos + box.nSize;
+        if (pTrun + 8 > pTrunEnd)
+        {
+            Error(nOffset, "trun too short");
+            return false;
+        }
+        uint32_t uTrunFlags = Get32(pTrun) & 0xffffff;
+        uint32_t uCount = Get32(pTrun + 4);
+        q = pTrun + 8;
+
+        unsigned long long nData = nDataEnd;
+        uint32_t uFirstFlags = uSampleFlags;
+        bool bFirstFlags = false;
+        if (uTrunFlags & 0x001)
+        {
+            if (q + 4 > pTrunEnd) { Error(nOffset, "trun too short"); return false; }
+            nData = nBase + (int32_t)Get32(q);
+            q += 4;
+        }
+        if (uTrunFlags & 0x004)
+        {
+            if (q + 4 > pTrunEnd) { Error(nOffset, "trun too short"); return false; }
+            uFirstFlags = Get32(q);
+            bFirstFlags = true;
+            q += 4;
+        }
+
+        size_t nPerSample = 4 * (((uTrunFlags >> 8) & 1) + ((uTrunFlags >> 9) & 1) + ((uTrunFlags >> 10) & 1) + ((uTrunFlags >> 11) & 1));
+        if ((size_t)(pTrunEnd - q) < (unsigned long long)uCount * nPerSample)
+        {
+            Error(nOffset, "trun too short for %u samples", uCount);
+            return false;
+        }
+        if (bFirstFlags && (uTrunFlags & 0x400))
+        {
+            Error(nOffset, "trun has both first-sample and per-sample flags");
+        }
+
+        for (uint32_t i = 0; i < uCount; i++)
+        {
+            Sample sample;
+            uint32_t uFlagsOfSample = (i == 0) ? uFirstFlags : uSampleFlags;
+            sample.uDuration = uDuration;
+            sample.uSize = uSize;
+            if (uTrunFlags & 0x100) { sample.uDuration = Get32(q); q += 4; }
+            if (uTrunFlags & 0x200) { sample.uSize = Get32(q); q += 4; }
+            if (uTrunFlags & 0x400) { uFlagsOfSample = Get32(q); q += 4; }
+            if (uTrunFlags & 0x800) { q += 4; }
+
+            sample.nOffset = nData;
+            sample.bSync = !(uFlagsOfSample & MP4_SAMPLE_NON_SYNC);
+            sample.bAudio = bAudio;
+            nData += sample.uSize;
+            track.nDecodeTime += sample.uDuration;
+
+            if (bAudio)
+            {
+                if (!sample.bSync)
+                {
+                    Error(nOffset, "audio frame %llu not marked as a sync sample", m_pInfo->nAudioFrames);
+                }
+                m_pInfo->nAudioFrames++;
+                m_vSamples.push_back(sample);
+                continue;
+            }
+
+            if (!sample.uDuration)
+            {
+                Error(nOffset, "sample %llu has no duration", m_pInfo->nFrames);
+            }
+            if (m_pInfo->nFrames == 0 && !sample.bSync)
+            {
+                Error(nOffset, "the first sample is not a sync sample");
+            }
+            m_pInfo->nFrames++;
+            m_pInfo->nKeyframes += sample.bSync ? 1 : 0;
+            m_vSamples.push_back(sample);
+        }
+        nDataEnd = nData;
+    }
+    return true;
+}
+
+void CMp4Checker::CheckSample(const Sample &sample)
+{
+    m_vSample.resize(sample.uSize);
+    if (sample.uSize && !ReadAt(sample.nOffset, &m_vSample[0], sample.uSize))
+    {
+        Error(sample.nOffset, "sample can't be read");
+        return;
+    }
+
+    // one whole frame of the format and length the track says
+    if (sample.bAudio)
+    {
+        NvAudioFormat oFormat;
+        size_t nFrame = nvAudioParseHeader(m_vSample.empty() ? NULL : &m_vSample[0], sample.uSize, &oFormat);
+        if (nFrame != sample.uSize)
+        {
+            Error(sample.nOffset, "audio sample of %u bytes holds a frame of %zu", sample.uSize, nFrame);
+        }
+        else if (oFormat.eCodec != m_eAudioCodec || oFormat.uSampleRate != m_pInfo->uAudioSampleRate)
+        {
+            Error(sample.nOffset, "audio frame at %u Hz doesn't match its sample entry", oFormat.uSampleRate);
+        }
+        else if (sample.uDuration != oFormat.uFrameSamples)
+        {
+            Error(sample.nOffset, "audio sample lasts %u, its frame has %u samples", sample.uDuration, oFormat.uFrameSamples);
+        }
+        return;
+    }
+
+    bool bSlice = false, bRandomAccess = false;
+    size_t pos = 0;
+    while (pos < sample.uSize)
+    {
+        if (sample.uSize - pos < m_nLengthSize)
+        {
+            Error(sample.nOffset + pos, "sample ends inside a NAL length");
+            return;
+        }
+        size_t nNal = 0;
+        for (unsigned int i = 0; i < m_nLengthSize; i++)
+        {
+            nNal = (nNal << 8) | m_vSample[pos + i];
+        }
+        pos += m_nLengthSize;
+        if (nNal == 0 || nNal > sample.uSize - pos)
+        {
+            Error(sample.nOffset + pos, "NAL unit of %zu bytes in a sample with %zu left", nNal, (size_t)(sample.uSize - pos));
+            return;
+        }
+
+        unsigned int nalType = m_bHEVC ? (m_vSample[pos] >> 1) & 0x3f : m_vSample[pos] & 0x1f;
+        bool bParameterSet = m_bHEVC ? (nalType >= 32 && nalType <= 34) : (nalType == 7 || nalType == 8);
+        if (bParameterSet && !m_bInBandSetsAllowed)
+        {
+            Error(sample.nOffset + pos, "parameter set (NAL type %u) inside an %s sample", nalType, m_bHEVC ? "hvc1" : "avc1");
+        }
+        bSlice = bSlice || (m_bHEVC ? nalType < 32 : (nalType >= 1 && nalType <= 5));
+        bRandomAccess = bRandomAccess || (m_bHEVC ? (nalType >= 16 && nalType <= 21) : nalType == 5);
+        pos += nNal;
+    }
+
+    if (!bSlice)
+    {
+        Error(sample.nOffset, "sample without a slice");
+    }
+    if (bRandomAccess != sample.bSync)
+    {
+        Error(sample.nOffset, bRandomAccess ? "%s picture not marked as a sync sample" : "sync sample without an %s picture",
+              m_bHEVC ? "IRAP" : "IDR");
+    }
+}
+
+void CMp4Checker::CheckMdat(const Mp4Box &mdat)
+{
+    unsigned long long nStart = mdat.nOffset + mdat.nHeader;
+    unsigned long long nEnd = mdat.nOffset + mdat.nSize;
+
+    // the samples of all tracks back to back, covering the whole payload
+    std::stable_sort(m_vSamples.begin(), m_vSamples.end(), OffsetLess);
+    unsigned long long nNext = nStart;
+    for (size_t i = 0; i < m_vSamples.size(); i++)
+    {
+        const Sample &sample = m_vSamples[i];
+        if (sample.nOffset != nNext || sample.nOffset + sample.uSize > nEnd)
+        {
+            Error(sample.nOffset, "sample %zu of the fragment is not where its mdat continues (%llu..%llu)", i, nNext, nEnd);
+            return;
+        }
+        CheckSample(sample);
+        nNext += sample.uSize;
+    }
+    if (nNext != nEnd)
+    {
+        Error(nNext, "%llu bytes of mdat no sample refers to", nEnd - nNext);
+    }
+}
+
+void CMp4Checker::ParseMfra(const unsigned char *p, size_t n, const Mp4Box &mfra)
+{
+    Mp4Box tfra, mfro;
+    unsigned long long nOffset = mfra.nOffset;
+
+    if (!FindBox(p, n, "mfro", mfro) || mfro.nSize < mfro.nHeader + 8 || mfro.nOffset + mfro.nSize != n)
+    {
+        Error(nOffset, "mfra doesn't end with an mfro");
+    }
+    else if (Get32(p + mfro.nOffset + mfro.nHeader + 4) != mfra.nSize)
+    {
+        Error(nOffset, "mfro gives %u bytes for an mfra of %llu", Get32(p + mfro.nOffset + mfro.nHeader + 4), mfra.nSize);
+    }
+
+    if (!FindBox(p, n, "tfra", tfra) || tfra.nSize < tfra.nHeader + 16)
+    {
+        Error(nOffset, "mfra without a tfra");
+        return;
+    }
+    const unsigned char *q = p + tfra.nOffset + tfra.nHeader;
+    const unsigned char *pEnd = p + tfra.nOffset + tfra.nSize;
+    bool bV1 = q[0] == 1;
+    uint32_t uSizes = Get32(q + 8);
+    uint32_t uEntries = Get32(q + 12);
+    size_t nEntry = (bV1 ? 16 : 8) + ((uSizes >> 4) & 3) + 1 + ((uSizes >> 2) & 3) + 1 + (uSizes & 3) + 1;
+    q += 16;
+    if ((size_t)(pEnd - q) < (unsigned long long)uEntries * nEntry)
+    {
+        Error(nOffset, "tfra too short for %u entries", uEntries);
+        return;
+    }
+    if (Get32(p + tfra.nOffset + tfra.nHeader + 4) != m_oVideo.uID)
+    {
+        Error(nOffset, "tfra for track %u", Get32(p + tfra.nOffset + tfra.nHeader + 4));
+    }
+
+    for (uint32_t i = 0; i < uEntries; i++, q += nEntry)
+    {
+        unsigned long long nTime = bV1 ? Get64(q) : Get32(q);
+        unsigned long long nMoof = bV1 ? Get64(q + 8) : Get32(q + 4);
+        std::map<unsigned long long, std::pair<unsigned long long, bool> >::const_iterator it = m_mMoofs.find(nMoof);
+        if (it == m_mMoofs.end())
+        {
+            Error(nOffset, "tfra entry %u points at %llu, which is not a moof", i, nMoof);
+        }
+        else if (it->second.first != nTime || !it->second.second)
+        {
+            Error(nOffset, "tfra entry %u: the moof at %llu starts at %llu%s, not at %llu", i, nMoof,
+                  it->second.first, it->second.second ? "" : " with a non-sync sample", nTime);
+        }
+    }
+    m_pInfo->nIndexEntries = uEntries;
+}
+
+bool CMp4Checker::Run()
+{
+    m_pFile = fopen(m_szPath, "rb");
+    if (!m_pFile)
+    {
+        printf("nvMp4Check: cannot open %s\n", m_szPath);
+        m_pInfo->nErrors++;
+        return false;
+    }
+    fseeko(m_pFile, 0, SEEK_END);
+    unsigned long long nFileSize = (unsigned long long)ftello(m_pFile);
+
+    std::vector<unsigned char> vBox;
+    bool bExpectMdat = false;
+    unsigned long long nOffset = 0;
+    unsigned int nBoxes = 0;
+    while (nOffset < nFileSize)
+    {
+        unsigned char header[16];
+        size_t nHeader = (size_t)std::min<unsigned long long>(16, nFileSize - nOffset);
+        Mp4Box box;
+        if (!ReadAt(nOffset, header, nHeader) || !ParseBoxHeader(header, nFileSize - nOffset, nOffset, box))
+        {
+            Error(nOffset, "box header broken or running past the end of the file");
+            break;
+        }
+        bool bFirst = nBoxes++ == 0;
+        if (bFirst && memcmp(box.type, "ftyp", 4))
+        {
+            Error(nOffset, "the file starts with '%s', not ftyp", box.type);
+        }
+        if (bExpectMdat && memcmp(box.type, "mdat", 4))
+        {
+            Error(nOffset, "moof followed by '%s' instead of its mdat", box.type);
+            bExpectMdat = false;
+        }
+
+        bool bRead = !memcmp(box.type, "moov", 4) || !memcmp(box.type, "moof", 4) || !memcmp(box.type, "mfra", 4);
+        if (bRead)
+        {
+            if (box.nSize > MP4_MAX_HEADER_BOX_BYTES)
+            {
+                Error(nOffset, "%s of %llu bytes", box.type, box.nSize);
+                break;
+            }
+            vBox.resize((size_t)(box.nSize - box.nHeader));
+            if (!vBox.empty() && !ReadAt(nOffset + box.nHeader, &vBox[0], vBox.size()))
+            {
+                Error(nOffset, "%s can't be read", box.type);
+                break;
+            }
+        }
+        const unsigned char *pBody = vBox.empty() ? NULL : &vBox[0];
+
+        if (!memcmp(box.type, "moov", 4))
+        {
+            if (m_bMoov)
+            {
+                Error(nOffset, "second moov");
+            }
+            else if (!ParseMoov(pBody, vBox.size(), nOffset))
+            {
+                break;
+            }
+        }
+        else if (!memcmp(box.type, "moof", 4))
+        {
+            if (!m_bMoov)
+            {
+                Error(nOffset, "moof before the moov");
+                break;
+            }
+            if (!ParseMoof(pBody, vBox.size(), nOffset))
+                break;
+            bExpectMdat = true;
+        }
+        else if (!memcmp(box.type, "mdat", 4))
+        {
+            if (!bExpectMdat)
+            {
+                Error(nOffset, "mdat without a moof");
+            }
+            else
+            {
+                CheckMdat(box);
+            }
+            bExpectMdat = false;
+        }
+        else if (!memcmp(box.type, "mfra", 4))
+        {
+            ParseMfra(pBody, vBox.size(), box);
+        }
+
+        nOffset += box.nSize;
+    }
+
+    if (bExpectMdat)
+    {
+        Error(nOffset, "the last moof has no mdat");
+    }
+    if (!m_bMoov)
+    {
+        Error(nOffset, "no moov");
+    }
+    m_pInfo->nDuration = m_oVideo.nDecodeTime;
+    return m_pInfo->nErrors == 0;
+}
+
+bool nvMp4Check(const char *szPath, NvMp4FileInfo *pInfo)
+{
+    pInfo->sCodec.clear();
+    pInfo->width = pInfo->height = pInfo->uTimescale = 0;
+    pInfo->nFragments = pInfo->nFrames = pInfo->nKeyframes = 0;
+    pInfo->nDuration = pInfo->nIndexEntries = 0;
+    pInfo->sAudioCodec.clear();
+    pInfo->uAudioSampleRate = 0;
+    pInfo->nAudioFrames = 0;
+    pInfo->nErrors = 0;
+
+    CMp4Checker oChecker(szPath, pInfo);
+    return oChecker.Run();
+}
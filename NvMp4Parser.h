@@ -0,0 +1,54 @@
+/*
+ * Copyright 1993-2015 NVIDIA Corporation.  All rights reserved.
+ *
+ * Please refer to the NVIDIA end user license agreement (EULA) associated
+ * with this source code for terms and conditions that govern your use of
+ * this software. Any use, reproduction, disclosure, or distribution of
+ * this software and related documentation outside the terms of the EULA
+ * is strictly prohibited.
+ *
+ */
+
+#ifndef NV_MP4_PARSER_H
+#define NV_MP4_PARSER_H
+
+#include <string>
+
+struct NvMp4FileInfo
+{
+    std::string        sCodec;          // RFC 6381, from avcC / hvcC
+    unsigned int       width;
+    unsigned int       height;
+    unsigned int       uTimescale;
+    unsigned long long nFragments;
+    unsigned long long nFrames;
+    unsigned long long nKeyframes;
+    unsigned long long nDuration;       // decode time after the last sample, ticks
+    unsigned long long nIndexEntries;   // tfra entries; 0 without an mfra
+    std::string        sAudioCodec;     // sample entry of the audio track, "mp4a" or "ac-3"; empty without one
+    unsigned int       uAudioSampleRate;
+    unsigned long long nAudioFrames;
+    unsigned int       nErrors;
+};
+
+// Reads a fragmented MP4 with one H.264 or HEVC track, and maybe an MPEG
+// audio or AC-3 one, as CNvMp4Muxer writes it, box by box on the CPU and
+// checks that a player could use it:
+//  - ftyp, then a moov whose sample tables are empty and whose mvex has a
+//    trex for each track, with an avcC / hvcC sample entry
+//  - every moof followed by its mdat, mfhd sequence numbers counting up
+//    from 1, tfdt continuing where the previous fragment ended
+//  - the trun samples tiling the mdat payload exactly, each sample a chain
+//    of NAL units that fills it, with a slice, and sync samples exactly the
+//    ones holding an IDR / IRAP picture; the first sample is one
+//  - no parameter sets inside avc1 / hvc1 samples
+//  - audio samples of one whole frame each, lasting its sample count,
+//    their tfdt never going back; the samples of both tracks together
+//    tiling the mdat
+//  - mfra entries, if any, pointing at moofs starting with a sync sample
+// at that decode time, and mfro giving the mfra size.
+// Problems go to stdout; the result is true when there were none. The
+// file is read a box or a sample at a time, never whole.
+bool nvMp4Check(const char *szPath, NvMp4FileInfo *pInfo);
+
+#endif // NV_MP4_PARSER_H
@@ -0,0 +1,281 @@
+/*
+ * Copyright 1993-2015 NVIDIA Corporation.  All rights reserved.
+ *
+ * Please refer to the NVIDIA end user license agreement (EULA) associated
+ * with this source code for terms and conditions that govern your use of
+ * this software. Any use, reproduction, disclosure, or distribution of
+ * this software and related documentation outside the terms of the EULA
+ * is strictly prohibited.
+ *
+ */
+
+#ifndef NV_PIPELINE_H
+#define NV_PIPELINE_H
+
+#include <assert.h>
+#include <string.h>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Bounded blocking FIFO of item pointers used between pipeline stages.
+// Pop() returns NULL once the FIFO is closed and empty.
+template<class T>
+class CNvBlockingFifo
+{
+public:
+    CNvBlockingFifo(): m_uCapacity(0), m_uHead(0), m_uCount(0), m_bClosed(false), m_nWaitUs(0)
+    {
+    }
+
+    void Initialize(unsigned int uCapacity)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_vItems.assign(uCapacity, (T *)NULL);
+        m_uCapacity = uCapacity;
+        m_uHead = 0;
+        m_uCount = 0;
+        m_bClosed = false;
+    }
+
+    void Push(T *pItem)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cvNotFull.wait(lock, [this] { return m_uCount < m_uCapacity; });
+            m_vItems[(m_uHead + m_uCount) % m_uCapacity] = pItem;
+            m_uCount++;
+        }
+        m_cvNotEmpty.notify_one();
+    }
+
+    T *Pop()
+    {
+        T *pItem = NULL;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            if (m_uCount == 0 && !m_bClosed)
+            {
+                std::chrono::steady_clock::time_point tStart = std::chrono::steady_clock::now();
+                m_cvNotEmpty.wait(lock, [this] { return m_uCount > 0 || m_bClosed; });
+                m_nWaitUs += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - tStart).count();
+            }
+
+            if (m_uCount == 0)
+                return NULL;
+
+            pItem = m_vItems[m_uHead];
+            m_uHead = (m_uHead + 1) % m_uCapacity;
+            m_uCount--;
+        }
+        m_cvNotFull.notify_one();
+        return pItem;
+    }
+
+    void Close()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_bClosed = true;
+        }
+        m_cvNotEmpty.notify_all();
+    }
+
+    // time Pop() spent waiting for input
+    unsigned long long WaitUs()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_nWaitUs;
+    }
+
+private:
+    std::vector<T *>        m_vItems;
+    unsigned int            m_uCapacity;
+    unsigned int            m_uHead;
+    unsigned int            m_uCount;
+    bool                    m_bClosed;
+    unsigned long long      m_nWaitUs;
+    std::mutex              m_mutex;
+    std::condition_variable m_cvNotEmpty;
+    std::condition_variable m_cvNotFull;
+};
+
+struct NvPipelineStageStats
+{
+    const char         *szName;
+    unsigned long long  nFrames;
+    unsigned long long  nBusyUs;    // time spent inside the stage function
+    unsigned long long  nStarvedUs; // time spent waiting for the previous stage
+};
+
+// Staged executor: every stage runs on its own worker thread and frames flow
+// from stage to stage through bounded FIFOs, so all stages work on different
+// frames at the same time and steady-state throughput is set by the slowest
+// stage. The number of frames in flight is the number of frame slots handed
+// to Initialize(); Acquire() blocks when all of them are in use, which is the
+// back-pressure for the producer. Stages see frames in submission order.
+//
+// Stage functions are plain callbacks and know nothing about CUDA, so a
+// pipeline can be driven end-to-end with CPU stand-in stages.
+//
+// videoPP runs convert (which includes the postprocess), download and encode
+// as stages. Decode is not one: it already runs on a thread of its own (the
+// NVCUVID video source's, or CNvSWDecoder's) and hands frames over through
+// FrameQueue, whose surface accounting already throttles it. Wrapping it in
+// a stage would only add a hop. The render loop takes frames off FrameQueue
+// and submits them as the producer.
+template<class T>
+class CNvPipeline
+{
+public:
+    typedef std::function<void (T *)> StageFunc;
+
+    CNvPipeline(): m_uFrameCount(0), m_bRunning(false)
+    {
+    }
+
+    ~CNvPipeline()
+    {
+        Stop();
+        for (size_t i = 0; i < m_vStages.size(); i++)
+        {
+            delete m_vStages[i];
+        }
+    }
+
+    bool Initialize(T *pFrames, unsigned int uFrameCount)
+    {
+        assert(!m_bRunning);
+        m_oFreeFrames.Initialize(uFrameCount);
+        for (unsigned int i = 0; i < uFrameCount; i++)
+        {
+            m_oFreeFrames.Push(&pFrames[i]);
+        }
+        m_uFrameCount = uFrameCount;
+        return true;
+    }
+
+    void AddStage(const char *szName, StageFunc fnStage)
+    {
+        assert(!m_bRunning);
+        Stage *pStage = new Stage;
+        pStage->sName = szName;
+        pStage->fnStage = fnStage;
+        pStage->nFrames = 0;
+        pStage->nBusyUs = 0;
+        m_vStages.push_back(pStage);
+    }
+
+    void Start()
+    {
+        assert(!m_bRunning && !m_vStages.empty());
+        for (size_t i = 0; i < m_vStages.size(); i++)
+        {
+            m_vStages[i]->oInput.Initialize(m_uFrameCount);
+        }
+        for (size_t i = 0; i < m_vStages.size(); i++)
+        {
+            m_vStages[i]->oThread = std::thread(&CNvPipeline::StageWorker, this, i);
+        }
+        m_bRunning = true;
+    }
+
+    // Blocks until a frame slot is free.
+    T *Acquire()
+    {
+        return m_oFreeFrames.Pop();
+    }
+
+    void Submit(T *pFrame)
+    {
+        m_vStages[0]->oInput.Push(pFrame);
+    }
+
+    // Lets every submitted frame run through all stages, then joins the
+    // workers. The pipeline can be restarted with Start().
+    void Stop()
+    {
+        if (!m_bRunning)
+            return;
+
+        m_vStages[0]->oInput.Close();
+        for (size_t i = 0; i < m_vStages.size(); i++)
+        {
+            m_vStages[i]->oThread.join();
+        }
+        m_bRunning = false;
+    }
+
+    unsigned int StageCount() const
+    {
+        return (unsigned int)m_vStages.size();
+    }
+
+    void GetStageStats(unsigned int uStage, NvPipelineStageStats *pStats)
+    {
+        Stage *pStage = m_vStages[uStage];
+        std::lock_guard<std::mutex> lock(pStage->mutex);
+        pStats->szName     = pStage->sName.c_str();
+        pStats->nFrames    = pStage->nFrames;
+        pStats->nBusyUs    = pStage->nBusyUs;
+        pStats->nStarvedUs = pStage->oInput.WaitUs();
+    }
+
+private:
+    struct Stage
+    {
+        std::string        sName;
+        StageFunc          fnStage;
+        CNvBlockingFifo<T> oInput;
+        std::thread        oThread;
+        std::mutex         mutex;
+        unsigned long long nFrames;
+        unsigned long long nBusyUs;
+    };
+
+    void StageWorker(size_t uStage)
+    {
+        Stage *pStage = m_vStages[uStage];
+        bool bLast = (uStage + 1 == m_vStages.size());
+
+        T *pFrame = pStage->oInput.Pop();
+        while (pFrame)
+        {
+            std::chrono::steady_clock::time_point tStart = std::chrono::steady_clock::now();
+            pStage->fnStage(pFrame);
+            unsigned long long nUs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - tStart).count();
+
+            {
+                std::lock_guard<std::mutex> lock(pStage->mutex);
+                pStage->nFrames += 1;
+                pStage->nBusyUs += nUs;
+            }
+
+            if (bLast)
+                m_oFreeFrames.Push(pFrame);
+            else
+                m_vStages[uStage + 1]->oInput.Push(pFrame);
+
+            pFrame = pStage->oInput.Pop();
+        }
+
+        // end of stream travels down the chain
+        if (!bLast)
+            m_vStages[uStage + 1]->oInput.Close();
+    }
+
+    // non-copyable
+    CNvPipeline(const CNvPipeline &);
+    CNvPipeline &operator=(const CNvPipeline &);
+
+    std::vector<Stage *> m_vStages;
+    CNvBlockingFifo<T>   m_oFreeFrames;
+    unsigned int         m_uFrameCount;
+    bool                 m_bRunning;
+};
+
+#endif // NV_PIPELINE_H
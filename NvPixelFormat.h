@@ -0,0 +1,203 @@
+/*
+ * Copyright 1993-2015 NVIDIA Corporation.  All rights reserved.
+ *
+ * Please refer to the NVIDIA end user license agreement (EULA) associated
+ * with this source code for terms and conditions that govern your use of
+ * this software. Any use, reproduction, disclosure, or distribution of
+ * this software and related documentation outside the terms of the EULA
+ * is strictly prohibited.
+ *
+ */
+
+#ifndef _NVPIXELFORMAT_H_
+#define _NVPIXELFORMAT_H_
+
+#include <stddef.h>
+#include "NvColorMatrix.h"
+
+// 8-bit YCbCr layouts the colour converters take. A frame is one block:
+// nPitch is the pitch of the luma plane (of the packed rows for YUY2) in
+// bytes and the chroma planes follow it at fixed offsets, the way nvcuvid
+// and NVENC lay out NV12. Chroma is cosited with the even pixels; the 4:2:0
+// formats interpolate it vertically on odd lines, as NV12 always did.
+typedef enum
+{
+    NV_PIXEL_FORMAT_NV12 = 0,   // 4:2:0, Y plane, then CbCr pairs
+    NV_PIXEL_FORMAT_I420,       // 4:2:0, Y, Cb and Cr planes; chroma pitch is nPitch / 2
+    NV_PIXEL_FORMAT_YV12,       // I420 with the Cr plane first
+    NV_PIXEL_FORMAT_NV16,       // 4:2:2, Y plane, then a full height of CbCr pairs
+    NV_PIXEL_FORMAT_YUV444,     // 4:4:4, Y, Cb and Cr planes of nPitch * height
+    NV_PIXEL_FORMAT_YUY2,       // 4:2:2 packed, Y0 Cb Y1 Cr per pixel pair
+    NV_PIXEL_FORMAT_COUNT
+} NvPixelFormat;
+
+// Layout traits, one specialization per format. The kernels are templates
+// on these, so every format gets its own instance whose address arithmetic
+// is resolved at compile time. All offsets are in bytes from the start of
+// the frame; (xc, yc) are chroma sample coordinates, i.e. the pixel
+// coordinates shifted right by ChromaShiftX / ChromaShiftY.
+template <NvPixelFormat F> struct NvPixelFormatTraits;
+
+// rows in a chroma plane of a 4:2:0 frame; an odd last line gets its own
+#define NV_CHROMA_ROWS_420(height)  (((height) + 1) >> 1)
+
+template <> struct NvPixelFormatTraits<NV_PIXEL_FORMAT_NV12>
+{
+    static constexpr int ChromaShiftX = 1, ChromaShiftY = 1;
+
+    NV_COLOR_HD static size_t luma(size_t nPitch, unsigned int height, unsigned int x, unsigned int y)
+    {
+        return y * nPitch + x;
+    }
+    NV_COLOR_HD static size_t cb(size_t nPitch, unsigned int height, unsigned int xc, unsigned int yc)
+    {
+        return nPitch * height + yc * nPitch + 2 * xc;
+    }
+    NV_COLOR_HD static size_t cr(size_t nPitch, unsigned int height, unsigned int xc, unsigned int yc)
+    {
+        return cb(nPitch, height, xc, yc) + 1;
+    }
+    NV_COLOR_HD static size_t frameBytes(size_t nPitch, unsigned int height)
+    {
+        return nPitch * (height + NV_CHROMA_ROWS_420(height));
+    }
+};
+
+template <> struct NvPixelFormatTraits<NV_PIXEL_FORMAT_I420>
+{
+    static constexpr int ChromaShiftX = 1, ChromaShiftY = 1;
+
+    NV_COLOR_HD static size_t luma(size_t nPitch, unsigned int height, unsigned int x, unsigned int y)
+    {
+        return y * nPitch + x;
+    }
+    NV_COLOR_HD static size_t cb(size_t nPitch, unsigned int height, unsigned int xc, unsigned int yc)
+    {
+        return nPitch * height + yc * (nPitch >> 1) + xc;
+    }
+    NV_COLOR_HD static size_t cr(size_t nPitch, unsigned int height, unsigned int xc, unsigned int yc)
+    {
+        return cb(nPitch, height, xc, yc) + NV_CHROMA_ROWS_420(height) * (nPitch >> 1);
+    }
+    NV_COLOR_HD static size_t frameBytes(size_t nPitch, unsigned int height)
+    {
+        return nPitch * height + 2 * NV_CHROMA_ROWS_420(height) * (nPitch >> 1);
+    }
+};
+
+template <> struct NvPixelFormatTraits<NV_PIXEL_FORMAT_YV12> : NvPixelFormatTraits<NV_PIXEL_FORMAT_I420>
+{
+    typedef NvPixelFormatTraits<NV_PIXEL_FORMAT_I420> I420;
+
+    NV_COLOR_HD static size_t cb(size_t nPitch, unsigned int height, unsigned int xc, unsigned int yc)
+    {
+        return I420::cr(nPitch, height, xc, yc);
+    }
+    NV_COLOR_HD static size_t cr(size_t nPitch, unsigned int height, unsigned int xc, unsigned int yc)
+    {
+        return I420::cb(nPitch, height, xc, yc);
+    }
+};
+
+template <> struct NvPixelFormatTraits<NV_PIXEL_FORMAT_NV16>
+{
+    static constexpr int ChromaShiftX = 1, ChromaShiftY = 0;
+
+    NV_COLOR_HD static size_t luma(size_t nPitch, unsigned int height, unsigned int x, unsigned int y)
+    {
+        return y * nPitch + x;
+    }
+    NV_COLOR_HD static size_t cb(size_t nPitch, unsigned int height, unsigned int xc, unsigned int yc)
+    {
+        return nPitch * height + yc * nPitch + 2 * xc;
+    }
+    NV_COLOR_HD static size_t cr(size_t nPitch, unsigned int height, unsigned int xc, unsigned int yc)
+    {
+        return cb(nPitch, height, xc, yc) + 1;
+    }
+    NV_COLOR_HD static size_t frameBytes(size_t nPitch, unsigned int height)
+    {
+        return 2 * nPitch * height;
+    }
+};
+
+template <> struct NvPixelFormatTraits<NV_PIXEL_FORMAT_YUV444>
+{
+    static constexpr int ChromaShiftX = 0, ChromaShiftY = 0;
+
+    NV_COLOR_HD static size_t luma(size_t nPitch, unsigned int height, unsigned int x, unsigned int y)
+    {
+        return y * nPitch + x;
+    }
+    NV_COLOR_HD static size_t cb(size_t nPitch, unsigned int height, unsigned int xc, unsigned int yc)
+    {
+        return nPitch * height + yc * nPitch + xc;
+    }
+    NV_COLOR_HD static size_t cr(size_t nPitch, unsigned int height, unsigned int xc, unsigned int yc)
+    {
+        return 2 * nPitch * height + yc * nPitch + xc;
+    }
+    NV_COLOR_HD static size_t frameBytes(size_t nPitch, unsigned int height)
+    {
+        return 3 * nPitch * height;
+    }
+};
+
+template <> struct NvPixelFormatTraits<NV_PIXEL_FORMAT_YUY2>
+{
+    static constexpr int ChromaShiftX = 1, ChromaShiftY = 0;
+
+    NV_COLOR_HD static size_t luma(size_t nPitch, unsigned int height, unsigned int x, unsigned int y)
+    {
+        return y * nPitch + 2 * x;
+    }
+    NV_COLOR_HD static size_t cb(size_t nPitch, unsigned int height, unsigned int xc, unsigned int yc)
+    {
+        return yc * nPitch + 4 * xc + 1;
+    }
+    NV_COLOR_HD static size_t cr(size_t nPitch, unsigned int height, unsigned int xc, unsigned int yc)
+    {
+        return cb(nPitch, height, xc, yc) + 2;
+    }
+    NV_COLOR_HD static size_t frameBytes(size_t nPitch, unsigned int height)
+    {
+        return nPitch * height;
+    }
+};
+
+// Expands X(name, format) once per format; used to stamp out kernels and
+// dispatch tables next to NV_FOR_EACH_COLOR_SPACE.
+#define NV_FOR_EACH_PIXEL_FORMAT(X)         \
+    X(NV12,   NV_PIXEL_FORMAT_NV12)         \
+    X(I420,   NV_PIXEL_FORMAT_I420)         \
+    X(YV12,   NV_PIXEL_FORMAT_YV12)         \
+    X(NV16,   NV_PIXEL_FORMAT_NV16)         \
+    X(YUV444, NV_PIXEL_FORMAT_YUV444)       \
+    X(YUY2,   NV_PIXEL_FORMAT_YUY2)
+
+// "NV12", "I420", ... as used in the kernel names
+inline const char *nvPixelFormatName(NvPixelFormat eFormat)
+{
+    static const char *names[NV_PIXEL_FORMAT_COUNT] = { "NV12", "I420", "YV12", "NV16", "YUV444", "YUY2" };
+    return (eFormat >= 0 && eFormat < NV_PIXEL_FORMAT_COUNT) ? names[eFormat] : "unknown";
+}
+
+// smallest pitch that holds width pixels
+inline size_t nvPixelFormatMinPitch(NvPixelFormat eFormat, unsigned int width)
+{
+    return (eFormat == NV_PIXEL_FORMAT_YUY2) ? 2 * (size_t)width : width;
+}
+
+inline size_t nvPixelFormatFrameBytes(NvPixelFormat eFormat, size_t nPitch, unsigned int height)
+{
+    switch (eFormat)
+    {
+#define NV_PIXEL_FORMAT_FRAME_BYTES(name, F) \
+        case F: return NvPixelFormatTraits<F>::frameBytes(nPitch, height);
+        NV_FOR_EACH_PIXEL_FORMAT(NV_PIXEL_FORMAT_FRAME_BYTES)
+#undef NV_PIXEL_FORMAT_FRAME_BYTES
+        default: return 0;
+    }
+}
+
+#endif
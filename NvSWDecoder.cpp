@@ -0,0 +1,275 @@
+/*
+ * Copyright 1993-2015 NVIDIA Corporation.  All rights reserved.
+ *
+ * Please refer to the NVIDIA end user license agreement (EULA) associated
+ * with this source code for terms and conditions that govern your use of
+ * this software. Any use, reproduction, disclosure, or distribution of
+ * this software and related documentation outside the terms of the EULA
+ * is strictly prohibited.
+ *
+ */
+
+#include "NvSWDecoder.h"
+#include "FrameQueue.h"
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+#include <vector>
+
+#define SW_SURFACE_PITCH_ALIGN 256
+
+// the frame rate the timestamps assume, that of the encoder
+#define SW_FRAME_RATE 30
+
+// Synthetic audio: MPEG-1 layer III, 48 kHz stereo at 128 kbit/s, i.e.
+// 384-byte frames of 1152 samples without padding. Every frame is silent
+// (zero side info, no main data); the rest of it is ancillary data that
+// numbers the frame, so the bytes can be followed into the output.
+#define SW_AUDIO_FRAME_BYTES    384
+#define SW_AUDIO_FRAME_SAMPLES  1152
+#define SW_AUDIO_SAMPLE_RATE    48000
+#define SW_AUDIO_BYTE_RATE      (SW_AUDIO_FRAME_BYTES * SW_AUDIO_SAMPLE_RATE / SW_AUDIO_FRAME_SAMPLES)
+#define SW_AUDIO_SIDE_INFO      32
+
+static const unsigned char s_swAudioHeader[4] = { 0xff, 0xfb, 0x94, 0x00 };
+
+CNvSWDecoder::CNvSWDecoder(const std::string& sFileName, FrameQueue *pFrameQueue, const NvSWDecoderConfig& oConfig)
+    : pFrameQueue_(pFrameQueue)
+    , pAudioQueue_(NULL)
+    , oConfig_(oConfig)
+    , fInput_(NULL)
+    , nSurfaces_(FrameQueue::cnMaximumSize)
+    , bStop_(false)
+{
+    assert(oConfig_.nWidth && oConfig_.nHeight);
+    assert(!(oConfig_.nWidth & 1) && !(oConfig_.nHeight & 1));
+    assert(oConfig_.nBitDepth == 8 || oConfig_.nBitDepth == 10);
+
+    if (!sFileName.empty())
+    {
+        fInput_ = fopen(sFileName.c_str(), "rb");
+        if (!fInput_) {
+            printf("CNvSWDecoder: cannot open %s, using a synthetic source\n", sFileName.c_str());
+        }
+    }
+
+    nPitch_ = (oConfig_.nWidth * bytesPerSample() + SW_SURFACE_PITCH_ALIGN - 1) & ~(SW_SURFACE_PITCH_ALIGN - 1);
+
+    memset(aSurfaces_, 0, sizeof(aSurfaces_));
+    for (unsigned int i = 0; i < nSurfaces_; i++)
+    {
+        if (posix_memalign((void **)&aSurfaces_[i], SW_SURFACE_PITCH_ALIGN, nPitch_ * oConfig_.nHeight * 3 / 2)) {
+            printf("CNvSWDecoder: out of memory\n");
+            assert(0);
+        }
+    }
+}
+
+CNvSWDecoder::~CNvSWDecoder()
+{
+    stop();
+
+    for (unsigned int i = 0; i < nSurfaces_; i++)
+    {
+        free(aSurfaces_[i]);
+    }
+
+    if (fInput_) {
+        fclose(fInput_);
+    }
+}
+
+void CNvSWDecoder::start()
+{
+    if (oThread_.joinable())
+        return;
+
+    bStop_ = false;
+    oThread_ = std::thread(&CNvSWDecoder::decodeThread, this);
+}
+
+void CNvSWDecoder::stop()
+{
+    bStop_ = true;
+    pFrameQueue_->endDecode();
+
+    if (oThread_.joinable())
+        oThread_.join();
+}
+
+// Equivalent of the nvcuvid source thread: decode order == display order,
+// one surface per picture index, HandlePictureDecode/Display semantics.
+void CNvSWDecoder::decodeThread()
+{
+    for (unsigned int nFrame = 0; !bStop_; nFrame++)
+    {
+        int iPictureIndex = nFrame % nSurfaces_;
+
+        if (!pFrameQueue_->waitUntilFrameAvailable(iPictureIndex))
+            break;
+
+        if (!readFrame(aSurfaces_[iPictureIndex], nFrame))
+            break;
+
+        if (oConfig_.nLatencyUs)
+            usleep(oConfig_.nLatencyUs);
+
+        // demuxed ahead of the picture, as in a transport stream
+        if (oConfig_.bAudio && pAudioQueue_)
+            pushAudio(nFrame);
+
+        // in the nvcuvid source clock, which the audio shares
+        CUVIDPARSERDISPINFO oDisplayInfo;
+        memset(&oDisplayInfo, 0, sizeof(oDisplayInfo));
+        oDisplayInfo.picture_index     = iPictureIndex;
+        oDisplayInfo.progressive_frame = 1;
+        oDisplayInfo.timestamp         = (long long)nFrame * NV_AUDIO_CLOCK_RATE / SW_FRAME_RATE;
+
+        pFrameQueue_->enqueue(&oDisplayInfo);
+    }
+
+    pFrameQueue_->endDecode();
+}
+
+// The audio that plays during frame nFrame, as one packet. Packets don't
+// line up with audio frames; each carries the timestamp of the first frame
+// that starts in it, as a PES packet header would.
+void CNvSWDecoder::pushAudio(unsigned int nFrame)
+{
+    unsigned long long nBegin = (unsigned long long)nFrame * SW_AUDIO_BYTE_RATE / SW_FRAME_RATE;
+    unsigned long long nEnd   = (unsigned long long)(nFrame + 1) * SW_AUDIO_BYTE_RATE / SW_FRAME_RATE;
+
+    std::vector<unsigned char> vPacket(nEnd - nBegin);
+    for (unsigned long long nOffset = nBegin; nOffset < nEnd; nOffset++)
+    {
+        unsigned long long nAudioFrame = nOffset / SW_AUDIO_FRAME_BYTES;
+        unsigned int i = (unsigned int)(nOffset % SW_AUDIO_FRAME_BYTES);
+        vPacket[nOffset - nBegin] = i < sizeof(s_swAudioHeader) ? s_swAudioHeader[i]
+                                  : i < sizeof(s_swAudioHeader) + SW_AUDIO_SIDE_INFO ? 0
+                                  : (unsigned char)((nAudioFrame * 7 + i) % 251);
+    }
+
+    unsigned long long nFirst = (nBegin + SW_AUDIO_FRAME_BYTES - 1) / SW_AUDIO_FRAME_BYTES;
+    bool bStarts = nFirst * SW_AUDIO_FRAME_BYTES < nEnd;
+    pAudioQueue_->Push(&vPacket[0], vPacket.size(), bStarts,
+                       (long long)(nFirst * SW_AUDIO_FRAME_SAMPLES * NV_AUDIO_CLOCK_RATE / SW_AUDIO_SAMPLE_RATE));
+}
+
+bool CNvSWDecoder::readFrame(unsigned char *pSurface, unsigned int nFrame)
+{
+    unsigned int nWidth  = oConfig_.nWidth;
+    unsigned int nHeight = oConfig_.nHeight;
+
+    if (fInput_)
+    {
+        // tightly packed NV12/P010 on disk, pitched in memory
+        unsigned int nRowBytes = nWidth * bytesPerSample();
+        for (unsigned int y = 0; y < nHeight * 3 / 2; y++)
+        {
+            if (fread(pSurface + y * nPitch_, 1, nRowBytes, fInput_) != nRowBytes)
+                return false;
+        }
+        return true;
+    }
+
+    if (nFrame >= oConfig_.nFrameCount)
+        return false;
+
+    if (oConfig_.nBitDepth == 10)
+    {
+        // same gradient at 10 bits, MSB-aligned as in P010
+        for (unsigned int y = 0; y < nHeight; y++)
+        {
+            unsigned short *pLuma = (unsigned short *)(pSurface + y * nPitch_);
+            for (unsigned int x = 0; x < nWidth; x++)
+            {
+                pLuma[x] = (unsigned short)((64 + ((4 * (x + y + 2 * nFrame)) % 876)) << NV_P010_SHIFT);
+            }
+        }
+
+        for (unsigned int y = 0; y < nHeight / 2; y++)
+        {
+            unsigned short *pChroma = (unsigned short *)(pSurface + nPitch_ * (nHeight + y));
+            for (unsigned int x = 0; x < nWidth; x += 2)
+            {
+                pChroma[x]     = (unsigned short)((64 + ((4 * (x + nFrame)) % 896)) << NV_P010_SHIFT);
+                pChroma[x + 1] = (unsigned short)((64 + ((4 * (2 * y + nFrame)) % 896)) << NV_P010_SHIFT);
+            }
+        }
+        return true;
+    }
+
+    // moving gradient, deterministic for a given frame number
+    for (unsigned int y = 0; y < nHeight; y++)
+    {
+        unsigned char *pLuma = pSurface + y * nPitch_;
+        for (unsigned int x = 0; x < nWidth; x++)
+        {
+            pLuma[x] = (unsigned char)(16 + ((x + y + 2 * nFrame) % 220));
+        }
+    }
+
+    unsigned char *pChroma = pSurface + nPitch_ * nHeight;
+    for (unsigned int y = 0; y < nHeight / 2; y++)
+    {
+        for (unsigned int x = 0; x < nWidth; x += 2)
+        {
+            pChroma[y * nPitch_ + x]     = (unsigned char)(16 + ((x + nFrame) % 224));
+            pChroma[y * nPitch_ + x + 1] = (unsigned char)(16 + ((2 * y + nFrame) % 224));
+        }
+    }
+    return true;
+}
+
+void CNvSWDecoder::getProgressive(bool &progressive)
+{
+    progressive = true;
+}
+
+NvColorSpace CNvSWDecoder::colorSpace() const
+{
+    return oConfig_.oColorSpace;
+}
+
+unsigned int CNvSWDecoder::bitDepth() const
+{
+    return oConfig_.nBitDepth;
+}
+
+unsigned int CNvSWDecoder::sourceWidth() const
+{
+    return oConfig_.nWidth;
+}
+
+unsigned int CNvSWDecoder::sourceHeight() const
+{
+    return oConfig_.nHeight;
+}
+
+unsigned long CNvSWDecoder::targetWidth() const
+{
+    return oConfig_.nWidth;
+}
+
+unsigned long CNvSWDecoder::targetHeight() const
+{
+    return oConfig_.nHeight;
+}
+
+void CNvSWDecoder::mapFrame(int iPictureIndex, CUdeviceptr *ppDevice, unsigned int *pPitch, CUVIDPROCPARAMS *pVideoProcessingParameters)
+{
+    assert(iPictureIndex >= 0 && iPictureIndex < (int)nSurfaces_);
+
+    *ppDevice = (CUdeviceptr)aSurfaces_[iPictureIndex];
+    *pPitch   = nPitch_;
+}
+
+void CNvSWDecoder::unmapFrame(CUdeviceptr pDevice)
+{
+}
+
+CUvideoctxlock CNvSWDecoder::getCtxLock() const
+{
+    return NULL;
+}
@@ -0,0 +1,91 @@
+/*
+ * Copyright 1993-2015 NVIDIA Corporation.  All rights reserved.
+ *
+ * Please refer to the NVIDIA end user license agreement (EULA) associated
+ * with this source code for terms and conditions that govern your use of
+ * this software. Any use, reproduction, disclosure, or distribution of
+ * this software and related documentation outside the terms of the EULA
+ * is strictly prohibited.
+ *
+ */
+
+#ifndef NV_SW_DECODER_H
+#define NV_SW_DECODER_H
+
+#include <stdio.h>
+#include <string>
+#include <thread>
+#include <atomic>
+#include "NvCodecInterface.h"
+
+class FrameQueue;
+
+struct NvSWDecoderConfig
+{
+    unsigned int nWidth;        // raw frame size
+    unsigned int nHeight;
+    unsigned int nFrameCount;   // frames to synthesize when there is no input file
+    unsigned int nLatencyUs;    // simulated decode time per frame
+    NvColorSpace oColorSpace;   // raw NV12 carries no signal description
+    unsigned int nBitDepth;     // 8 for NV12, 10 for P010 input and surfaces
+    bool         bAudio;        // synthesize a silent MP3 track for setAudioQueue()
+};
+
+// CPU stand-in for CNvHWDecoder. Reads raw NV12 (or P010) frames from a file (or
+// synthesizes a deterministic test pattern) into host surfaces and feeds
+// them to the FrameQueue from its own thread, the same way the nvcuvid
+// parser callbacks do, so the queue and pipeline code runs unchanged on
+// machines without a GPU.
+class CNvSWDecoder : public INvVideoDecoder
+{
+    public:
+        CNvSWDecoder(const std::string& sFileName, FrameQueue *pFrameQueue, const NvSWDecoderConfig& oConfig);
+        ~CNvSWDecoder();
+
+        void start();
+
+        void stop();
+
+        void getProgressive(bool &progressive);
+
+        NvColorSpace colorSpace() const;
+
+        unsigned int bitDepth() const;
+
+        unsigned int sourceWidth() const;
+
+        unsigned int sourceHeight() const;
+
+        unsigned long targetWidth() const;
+
+        unsigned long targetHeight() const;
+
+        void mapFrame(int iPictureIndex, CUdeviceptr *ppDevice, unsigned int *nPitch, CUVIDPROCPARAMS *pVideoProcessingParameters);
+
+        void unmapFrame(CUdeviceptr pDevice);
+
+        CUvideoctxlock getCtxLock() const;
+
+        bool isHostMemory() const { return true; }
+
+        void setAudioQueue(CNvAudioQueue *pAudioQueue) { pAudioQueue_ = pAudioQueue; }
+
+    protected:
+        void decodeThread();
+        unsigned int bytesPerSample() const { return oConfig_.nBitDepth > 8 ? 2 : 1; }
+        bool readFrame(unsigned char *pSurface, unsigned int nFrame);
+        void pushAudio(unsigned int nFrame);
+
+    private:
+        FrameQueue         *pFrameQueue_;
+        CNvAudioQueue      *pAudioQueue_;
+        NvSWDecoderConfig   oConfig_;
+        FILE               *fInput_;
+        unsigned int        nPitch_;
+        unsigned char      *aSurfaces_[32];
+        unsigned int        nSurfaces_;
+        std::thread         oThread_;
+        std::atomic<bool>   bStop_;
+};
+
+#endif // NV_SW_DECODER_H
@@ -0,0 +1,325 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 1993-2015 NVIDIA Corporation.  All rights reserved.
+//
+// Please refer to the NVIDIA end user license agreement (EULA) associated
+// with this source code for terms and conditions that govern your use of
+// this software. Any use, reproduction, disclosure, or distribution of
+// this software and related documentation outside the terms of the EULA
+// is strictly prohibited.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#include "NvSWEncoder.h"
+#include <thread>
+
+#define SW_SURFACE_PITCH_ALIGN 256
+
+// Appends a NAL unit with start code, inserting emulation prevention bytes
+// so that downstream Annex-B parsers see a well-formed stream.
+static void AppendNal(std::vector<unsigned char> &vOut, const unsigned char *pHeader, size_t nHeader,
+                      const unsigned char *pPayload, size_t nSize)
+{
+    static const unsigned char startCode[4] = { 0, 0, 0, 1 };
+    vOut.insert(vOut.end(), startCode, startCode + 4);
+    vOut.insert(vOut.end(), pHeader, pHeader + nHeader);
+
+    int nZeros = 0;
+    for (size_t i = 0; i < nSize; i++)
+    {
+        if (nZeros == 2 && pPayload[i] <= 3)
+        {
+            vOut.push_back(3);
+            nZeros = 0;
+        }
+        vOut.push_back(pPayload[i]);
+        nZeros = pPayload[i] ? 0 : nZeros + 1;
+    }
+    // rbsp trailing bits
+    vOut.push_back(0x80);
+}
+
+// NAL header for the configured codec: one byte for H.264, two for HEVC
+static size_t NalHeader(bool bHEVC, unsigned int nalType, unsigned char *pHeader)
+{
+    if (bHEVC)
+    {
+        pHeader[0] = (unsigned char)(nalType << 1);
+        pHeader[1] = 1;     // nuh_temporal_id_plus1
+        return 2;
+    }
+
+    pHeader[0] = (unsigned char)((nalType >= 5 ? 0x60 : 0x40) | nalType);
+    return 1;
+}
+
+// FNV-1a over the visible part of a pitched NV12 or P010 picture
+static unsigned long long HashNV12(const unsigned char *pData, uint32_t uPitch, uint32_t uRowBytes, uint32_t uHeight)
+{
+    unsigned long long hash = 0xcbf29ce484222325ULL;
+    for (uint32_t y = 0; y < uHeight * 3 / 2; y++)
+    {
+        const unsigned char *pRow = pData + y * uPitch;
+        for (uint32_t x = 0; x < uRowBytes; x++)
+        {
+            hash = (hash ^ pRow[x]) * 0x100000001b3ULL;
+        }
+    }
+    return hash;
+}
+
+CNvSWEncoder::CNvSWEncoder(unsigned int uLatencyUs)
+{
+    m_EncodeIdx = 0;
+    m_uLatencyUs = uLatencyUs;
+    m_nCodec = NV_ENC_H264;
+    m_bEncoderInitialized = false;
+    memset(&m_stStats, 0, sizeof(m_stStats));
+}
+
+CNvSWEncoder::~CNvSWEncoder()
+{
+    m_oMuxer.Close();
+    m_oOutput.Close();
+}
+
+NVENCSTATUS CNvSWEncoder::Initialize(void* device, NV_ENC_DEVICE_TYPE deviceType)
+{
+    return NV_ENC_SUCCESS;
+}
+
+NVENCSTATUS CNvSWEncoder::CreateEncoder(const char* outputName, int codec, int width, int height, int fps, int bitrate)
+{
+    if (!width || !height){
+        return NV_ENC_ERR_INVALID_PARAM;
+    }
+
+    // segments open their own files as they go
+    bool bSegmented = nvCmafIsPlaylistPath(outputName);
+    if (!bSegmented && !m_oOutput.Open(outputName)) {
+        return NV_ENC_ERR_INVALID_PARAM;
+    }
+
+    if (bSegmented || nvMp4IsMp4Path(outputName)) {
+        NvMp4MuxerConfig oMuxerConfig = { codec == NV_ENC_HEVC, (unsigned int)width, (unsigned int)height, (unsigned int)fps, 1, (unsigned int)fps };
+        if (!m_oMuxer.Open(&m_oOutput, oMuxerConfig, bSegmented ? &m_oSegmenter : NULL)) {
+            return NV_ENC_ERR_INVALID_PARAM;
+        }
+    }
+    // two-second segments unless the caller says otherwise
+    if (bSegmented) {
+        NvCmafSegmenterConfig oSegmenterConfig = { 2 * (unsigned int)fps, 0 };
+        if (!m_oSegmenter.Open(&m_oOutput, &m_oMuxer, outputName, oSegmenterConfig)) {
+            return NV_ENC_ERR_INVALID_PARAM;
+        }
+    }
+
+    m_nCodec = codec;
+    m_bEncoderInitialized = true;
+
+    return NV_ENC_SUCCESS;
+}
+
+NVENCSTATUS CNvSWEncoder::NvEncCreateInputBuffer(uint32_t width, uint32_t height, NV_ENC_BUFFER_FORMAT bufferFmt, void** inputBuffer)
+{
+    if (bufferFmt != NV_ENC_BUFFER_FORMAT_NV12_PL && bufferFmt != NV_ENC_BUFFER_FORMAT_P010_PL)
+    {
+        return NV_ENC_ERR_UNSUPPORTED_PARAM;
+    }
+
+    InputSurface *pSurface = new InputSurface;
+    pSurface->uBytesPerSample = (bufferFmt == NV_ENC_BUFFER_FORMAT_P010_PL) ? 2 : 1;
+    pSurface->uPitch  = (width * pSurface->uBytesPerSample + SW_SURFACE_PITCH_ALIGN - 1) & ~(SW_SURFACE_PITCH_ALIGN - 1);
+    pSurface->uWidth  = width;
+    pSurface->uHeight = height;
+    pSurface->bLocked = false;
+    pSurface->bWritten = false;
+
+    if (posix_memalign((void **)&pSurface->pData, SW_SURFACE_PITCH_ALIGN, pSurface->uPitch * height * 3 / 2))
+    {
+        delete pSurface;
+        return NV_ENC_ERR_OUT_OF_MEMORY;
+    }
+    memset(pSurface->pData, 0, pSurface->uPitch * height * 3 / 2);
+
+    *inputBuffer = pSurface;
+    return NV_ENC_SUCCESS;
+}
+
+NVENCSTATUS CNvSWEncoder::NvEncDestroyInputBuffer(NV_ENC_INPUT_PTR inputBuffer)
+{
+    InputSurface *pSurface = (InputSurface *)inputBuffer;
+    if (pSurface)
+    {
+        free(pSurface->pData);
+        delete pSurface;
+    }
+    return NV_ENC_SUCCESS;
+}
+
+NVENCSTATUS CNvSWEncoder::NvEncCreateBitstreamBuffer(uint32_t size, void** bitstreamBuffer)
+{
+    BitstreamSurface *pBitstream = new BitstreamSurface;
+    pBitstream->vData.reserve(256);
+    *bitstreamBuffer = pBitstream;
+    return NV_ENC_SUCCESS;
+}
+
+NVENCSTATUS CNvSWEncoder::NvEncDestroyBitstreamBuffer(NV_ENC_OUTPUT_PTR bitstreamBuffer)
+{
+    delete (BitstreamSurface *)bitstreamBuffer;
+    return NV_ENC_SUCCESS;
+}
+
+NVENCSTATUS CNvSWEncoder::NvEncLockInputBuffer(void* inputBuffer, void** bufferDataPtr, uint32_t* pitch)
+{
+    InputSurface *pSurface = (InputSurface *)inputBuffer;
+    if (!pSurface || pSurface->bLocked)
+    {
+        assert(0);
+        return NV_ENC_ERR_INVALID_PARAM;
+    }
+
+    pSurface->bLocked = true;
+    pSurface->bWritten = true;
+    m_stStats.nLocks++;
+    *bufferDataPtr = pSurface->pData;
+    *pitch = pSurface->uPitch;
+    return NV_ENC_SUCCESS;
+}
+
+NVENCSTATUS CNvSWEncoder::NvEncUnlockInputBuffer(NV_ENC_INPUT_PTR inputBuffer)
+{
+    InputSurface *pSurface = (InputSurface *)inputBuffer;
+    if (!pSurface || !pSurface->bLocked)
+    {
+        assert(0);
+        return NV_ENC_ERR_INVALID_PARAM;
+    }
+
+    pSurface->bLocked = false;
+    return NV_ENC_SUCCESS;
+}
+
+NVENCSTATUS CNvSWEncoder::NvEncEncodeFrame(EncodeBuffer *pEncodeBuffer, NvEncPictureCommand *encPicCommand,
+                                           uint32_t width, uint32_t height, NV_ENC_PIC_STRUCT ePicStruct,
+                                           int8_t *qpDeltaMapArray, uint32_t qpDeltaMapArraySize)
+{
+    InputSurface *pSurface = (InputSurface *)pEncodeBuffer->stInputBfr.hInputSurface;
+    BitstreamSurface *pBitstream = (BitstreamSurface *)pEncodeBuffer->stOutputBfr.hBitstreamBuffer;
+    if (!pSurface || !pBitstream || pSurface->bLocked)
+    {
+        assert(0);
+        return NV_ENC_ERR_INVALID_PARAM;
+    }
+
+    bool bIDR = (m_EncodeIdx == 0) || (encPicCommand && encPicCommand->bForceIDR);
+    bool bHEVC = (m_nCodec == NV_ENC_HEVC);
+    bool b10Bit = (pSurface->uBytesPerSample == 2);
+
+    pBitstream->vData.clear();
+    unsigned char header[2];
+    size_t nHeader;
+    if (bIDR)
+    {
+        // Parameter sets only carry the leading fields a container needs
+        // (profile/level); the remainder just records the picture size.
+        // 10-bit input signals Main10 / High 10.
+        if (bHEVC)
+        {
+            const unsigned char ptl = b10Bit ? 0x02 : 0x01;
+            const unsigned char vps[] = { 0x0c, 0x01, 0xff, 0xff, ptl, 0x60, 0, 0, 0, 0x90, 0, 0, 0, 0, 0, 93 };
+            const unsigned char sps[] = { 0x01, ptl, 0x60, 0, 0, 0, 0x90, 0, 0, 0, 0, 0, 93,
+                                          (unsigned char)(width >> 8), (unsigned char)width,
+                                          (unsigned char)(height >> 8), (unsigned char)height };
+            const unsigned char pps[] = { 0xc1, 0x72 };
+
+            nHeader = NalHeader(true, 32, header);
+            AppendNal(pBitstream->vData, header, nHeader, vps, sizeof(vps));
+            nHeader = NalHeader(true, 33, header);
+            AppendNal(pBitstream->vData, header, nHeader, sps, sizeof(sps));
+            nHeader = NalHeader(true, 34, header);
+            AppendNal(pBitstream->vData, header, nHeader, pps, sizeof(pps));
+        }
+        else
+        {
+            const unsigned char sps[] = { (unsigned char)(b10Bit ? 110 : 66), (unsigned char)(b10Bit ? 0x00 : 0xc0), 31, (unsigned char)(width >> 8), (unsigned char)width,
+                                          (unsigned char)(height >> 8), (unsigned char)height };
+            const unsigned char pps[] = { 0xce, 0x3c };
+
+            nHeader = NalHeader(false, 7, header);
+            AppendNal(pBitstream->vData, header, nHeader, sps, sizeof(sps));
+            nHeader = NalHeader(false, 8, header);
+            AppendNal(pBitstream->vData, header, nHeader, pps, sizeof(pps));
+        }
+    }
+
+    unsigned long long hash = HashNV12(pSurface->pData, pSurface->uPitch, width * pSurface->uBytesPerSample, height);
+    unsigned char slice[12];
+    for (int i = 0; i < 4; i++)
+    {
+        slice[i] = (unsigned char)(m_EncodeIdx >> (24 - 8 * i));
+    }
+    for (int i = 0; i < 8; i++)
+    {
+        slice[4 + i] = (unsigned char)(hash >> (56 - 8 * i));
+    }
+
+    // IDR_W_RADL / TRAIL_R for HEVC, IDR / non-IDR slice for H.264
+    nHeader = NalHeader(bHEVC, bHEVC ? (bIDR ? 19 : 1) : (bIDR ? 5 : 1), header);
+    AppendNal(pBitstream->vData, header, nHeader, slice, sizeof(slice));
+
+    pBitstream->nTimestamp = m_EncodeIdx;
+    pBitstream->tReady = std::chrono::steady_clock::now() + std::chrono::microseconds(m_uLatencyUs);
+
+    if (!pSurface->bWritten)
+    {
+        m_stStats.nStaleFrames++;
+    }
+    pSurface->bWritten = false;
+    m_stStats.nFrames++;
+
+    m_EncodeIdx++;
+
+    return NV_ENC_SUCCESS;
+}
+
+NVENCSTATUS CNvSWEncoder::NvEncFlushEncoderQueue(void *hEOSEvent)
+{
+    return NV_ENC_SUCCESS;
+}
+
+NVENCSTATUS CNvSWEncoder::ProcessOutput(const EncodeBuffer *pEncodeBuffer)
+{
+    BitstreamSurface *pBitstream = (BitstreamSurface *)pEncodeBuffer->stOutputBfr.hBitstreamBuffer;
+    if (!pBitstream)
+    {
+        return NV_ENC_ERR_INVALID_PARAM;
+    }
+
+    // same blocking behaviour as nvEncLockBitstream with doNotWait = false
+    std::this_thread::sleep_until(pBitstream->tReady);
+
+    if (m_oMuxer.IsOpen())
+    {
+        m_oMuxer.WriteFrame(&pBitstream->vData[0], pBitstream->vData.size(), pBitstream->nTimestamp);
+    }
+    else
+    {
+        m_oOutput.Write(&pBitstream->vData[0], pBitstream->vData.size());
+    }
+
+    return NV_ENC_SUCCESS;
+}
+
+void CNvSWEncoder::GetStats(NvSWEncoderStats *pStats) const
+{
+    *pStats = m_stStats;
+}
+
+NVENCSTATUS CNvSWEncoder::NvEncDestroyEncoder()
+{
+    m_bEncoderInitialized = false;
+    bool bMuxed = m_oMuxer.Close();
+    return (m_oOutput.Close() && bMuxed) ? NV_ENC_SUCCESS : NV_ENC_ERR_GENERIC;
+}
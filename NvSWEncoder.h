@@ -0,0 +1,95 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 1993-2015 NVIDIA Corporation.  All rights reserved.
+//
+// Please refer to the NVIDIA end user license agreement (EULA) associated
+// with this source code for terms and conditions that govern your use of
+// this software. Any use, reproduction, disclosure, or distribution of
+// this software and related documentation outside the terms of the EULA
+// is strictly prohibited.
+//
+////////////////////////////////////////////////////////////////////////////
+#ifndef NV_SW_ENCODER_H
+#define NV_SW_ENCODER_H
+
+#include <stdio.h>
+#include <chrono>
+#include <vector>
+#include "NvHWEncoder.h"
+
+// What the application did with the input surfaces, for checking that a
+// zero-copy pipeline really hands its frames over in place.
+struct NvSWEncoderStats
+{
+    unsigned long long nLocks;          // NvEncLockInputBuffer() calls
+    unsigned long long nFrames;         // frames encoded
+    unsigned long long nStaleFrames;    // encoded from a surface not locked since its last frame
+};
+
+// CPU stand-in for CNvHWEncoder. Input surfaces are plain host memory and
+// every frame is turned into a small deterministic Annex-B pseudo-bitstream
+// (SPS/PPS once, then one slice NAL carrying the frame number and a hash of
+// the picture). Each frame becomes ready nLatencyUs after submission and
+// ProcessOutput() waits for that, which models an asynchronous hardware
+// encoder without needing one.
+class CNvSWEncoder : public INvVideoEncoder
+{
+public:
+    uint32_t                                             m_EncodeIdx;
+    CNvBitstreamWriter                                   m_oOutput;
+    CNvMp4Muxer                                          m_oMuxer;
+    CNvCmafSegmenter                                     m_oSegmenter;
+
+protected:
+    struct InputSurface
+    {
+        unsigned char   *pData;
+        uint32_t         uPitch;
+        uint32_t         uWidth;
+        uint32_t         uHeight;
+        uint32_t         uBytesPerSample;   // 1 for NV12, 2 for P010
+        bool             bLocked;
+        bool             bWritten;          // locked since the last frame encoded from it
+    };
+
+    struct BitstreamSurface
+    {
+        std::vector<unsigned char>              vData;
+        unsigned long long                      nTimestamp;     // frame number, as NVENC's outputTimeStamp
+        std::chrono::steady_clock::time_point   tReady;
+    };
+
+    unsigned int                                         m_uLatencyUs;
+    int                                                  m_nCodec;
+    bool                                                 m_bEncoderInitialized;
+    NvSWEncoderStats                                     m_stStats;
+
+public:
+    CNvSWEncoder(unsigned int uLatencyUs);
+    virtual ~CNvSWEncoder();
+
+    NVENCSTATUS Initialize(void* device, NV_ENC_DEVICE_TYPE deviceType);
+    NVENCSTATUS CreateEncoder(const char* outputName, int codec, int width, int height, int fps, int bitrate);
+    NVENCSTATUS NvEncCreateInputBuffer(uint32_t width, uint32_t height, NV_ENC_BUFFER_FORMAT bufferFmt, void** inputBuffer);
+    NVENCSTATUS NvEncDestroyInputBuffer(NV_ENC_INPUT_PTR inputBuffer);
+    NVENCSTATUS NvEncCreateBitstreamBuffer(uint32_t size, void** bitstreamBuffer);
+    NVENCSTATUS NvEncDestroyBitstreamBuffer(NV_ENC_OUTPUT_PTR bitstreamBuffer);
+    NVENCSTATUS NvEncLockInputBuffer(void* inputBuffer, void** bufferDataPtr, uint32_t* pitch);
+    NVENCSTATUS NvEncUnlockInputBuffer(NV_ENC_INPUT_PTR inputBuffer);
+    NVENCSTATUS NvEncEncodeFrame(EncodeBuffer *pEncodeBuffer, NvEncPictureCommand *encPicCommand,
+                                 uint32_t width, uint32_t height,
+                                 NV_ENC_PIC_STRUCT ePicStruct = NV_ENC_PIC_STRUCT_FRAME,
+                                 int8_t *qpDeltaMapArray = NULL, uint32_t qpDeltaMapArraySize = 0);
+    NVENCSTATUS NvEncFlushEncoderQueue(void *hEOSEvent);
+    NVENCSTATUS ProcessOutput(const EncodeBuffer *pEncodeBuffer);
+    NVENCSTATUS NvEncDestroyEncoder();
+    CNvBitstreamWriter *GetOutput() { return &m_oOutput; }
+    CNvMp4Muxer *GetMuxer() { return m_oMuxer.Timescale() ? &m_oMuxer : NULL; }    // opened, maybe closed since
+    CNvCmafSegmenter *GetSegmenter() { return m_oSegmenter.IsOpen() ? &m_oSegmenter : NULL; }
+
+    // Lock and encode counts are updated by the submitting threads; read
+    // them once encoding has stopped.
+    void GetStats(NvSWEncoderStats *pStats) const;
+};
+
+#endif
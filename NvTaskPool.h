@@ -0,0 +1,361 @@
+/*
+ * Copyright 1993-2015 NVIDIA Corporation.  All rights reserved.
+ *
+ * Please refer to the NVIDIA end user license agreement (EULA) associated
+ * with this source code for terms and conditions that govern your use of
+ * this software. Any use, reproduction, disclosure, or distribution of
+ * this software and related documentation outside the terms of the EULA
+ * is strictly prohibited.
+ *
+ */
+
+#ifndef NV_TASK_POOL_H
+#define NV_TASK_POOL_H
+
+#include <assert.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "SpscRing.h"
+
+// deque slots for threads outside the pool calling ParallelFor() at once
+#define NV_TASK_POOL_CALLER_SLOTS 16
+
+struct NvTaskPoolStats
+{
+    unsigned long long nTasks;      // ranges run
+    unsigned long long nSteals;     // ranges taken from another thread's deque
+    unsigned long long nSerial;     // ParallelFor() calls run inline, no slot free
+};
+
+// Work-stealing pool for data-parallel loops inside a frame.
+//
+// Every thread taking part owns a deque of index ranges. It pushes and pops
+// at the back, so it keeps working on the rows next to the ones it just did,
+// and idle threads steal from the front, where the largest pieces are. A
+// range is split in half until it is down to the grain, each upper half
+// going onto the owner's deque, so a loop starts out as one task and only
+// fans out as far as there are thieves to take the pieces.
+//
+// Any thread may call ParallelFor(), several at once: the caller borrows a
+// deque slot for the call and works on the loop (and on stolen tasks of
+// other loops) until its own is done, so one pool serves every session in
+// the process and a loop never waits for a free worker. The pool threads
+// sleep when there is nothing to steal.
+class CNvTaskPool
+{
+public:
+    typedef std::function<void (unsigned int uBegin, unsigned int uEnd)> RangeFunc;
+
+    CNvTaskPool(): m_uWorkers(0), m_bQuit(false), m_nQueued(0), m_nSleepers(0), m_nTasks(0), m_nSteals(0), m_nSerial(0)
+    {
+        m_vSlots.resize(NV_TASK_POOL_CALLER_SLOTS);
+        for (unsigned int i = 0; i < NV_TASK_POOL_CALLER_SLOTS; i++)
+        {
+            m_vFreeSlots.push_back(i);
+        }
+    }
+
+    ~CNvTaskPool()
+    {
+        Resize(0);
+    }
+
+    // Number of pool threads, on top of the callers. Only while no
+    // ParallelFor() is running.
+    void Resize(unsigned int uWorkers)
+    {
+        if (uWorkers == m_uWorkers)
+            return;
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_bQuit = true;
+        }
+        m_cvWork.notify_all();
+        for (size_t i = 0; i < m_vThreads.size(); i++)
+        {
+            m_vThreads[i].join();
+        }
+        m_vThreads.clear();
+        m_bQuit = false;
+
+        // caller slots first, so the free list stays valid
+        m_vSlots.resize(NV_TASK_POOL_CALLER_SLOTS + uWorkers);
+        m_uWorkers = uWorkers;
+        for (unsigned int i = 0; i < uWorkers; i++)
+        {
+            m_vThreads.push_back(std::thread(&CNvTaskPool::Worker, this, NV_TASK_POOL_CALLER_SLOTS + i));
+        }
+    }
+
+    unsigned int WorkerCount() const
+    {
+        return m_uWorkers;
+    }
+
+    // Runs fnRange over [0, uCount) in ranges of at most uGrain indices and
+    // returns once all of them are done.
+    void ParallelFor(unsigned int uCount, unsigned int uGrain, const RangeFunc &fnRange)
+    {
+        if (uCount == 0)
+            return;
+
+        Job oJob;
+        oJob.pfnRange = &fnRange;
+        oJob.uGrain = uGrain ? uGrain : 1;
+        oJob.nPending.store(uCount);
+
+        if (uCount <= oJob.uGrain)
+        {
+            fnRange(0, uCount);
+            return;
+        }
+
+        // a task of this pool calling in again keeps its slot
+        int nOuterSlot = CurrentSlot();
+        int nSlot = nOuterSlot >= 0 ? nOuterSlot : AcquireSlot();
+        if (nSlot < 0)
+        {
+            m_nSerial.fetch_add(1, std::memory_order_relaxed);
+            fnRange(0, uCount);
+            return;
+        }
+        SetCurrentSlot(nSlot);
+
+        Task oTask = { &oJob, 0, uCount };
+        Run(nSlot, oTask);
+
+        // help out until the last range of this loop is done
+        while (oJob.nPending.load(std::memory_order_acquire) != 0)
+        {
+            if (TryPop(nSlot, &oTask) || TrySteal(nSlot, &oTask))
+            {
+                Run(nSlot, oTask);
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cvDone.wait(lock, [&] { return oJob.nPending.load() == 0 || m_nQueued.load() != 0; });
+        }
+
+        SetCurrentSlot(nOuterSlot);
+        if (nOuterSlot < 0)
+        {
+            ReleaseSlot(nSlot);
+        }
+    }
+
+    void GetStats(NvTaskPoolStats *pStats) const
+    {
+        pStats->nTasks  = m_nTasks.load();
+        pStats->nSteals = m_nSteals.load();
+        pStats->nSerial = m_nSerial.load();
+    }
+
+private:
+    struct Job
+    {
+        const RangeFunc          *pfnRange;
+        unsigned int              uGrain;
+        std::atomic<unsigned int> nPending;     // indices not done yet
+    };
+
+    struct Task
+    {
+        Job          *pJob;
+        unsigned int  uBegin;
+        unsigned int  uEnd;
+    };
+
+    // one per thread; the padding keeps neighbours off each other's lines
+    struct Slot
+    {
+        Slot(): nSize(0)
+        {
+        }
+        Slot(const Slot &): nSize(0)
+        {
+        }
+
+        std::mutex                 mutex;
+        std::deque<Task>           qTasks;
+        std::atomic<unsigned int>  nSize;       // lets thieves skip empty deques without the lock
+        char                       aPad[NV_CACHE_LINE_SIZE];
+    };
+
+    // the slot the calling thread works from, -1 outside of this pool
+    struct SlotBinding
+    {
+        const CNvTaskPool *pPool;
+        int                nSlot;
+    };
+
+    static SlotBinding &CurrentBinding()
+    {
+        thread_local SlotBinding oBinding = { NULL, -1 };
+        return oBinding;
+    }
+
+    int CurrentSlot() const
+    {
+        return CurrentBinding().pPool == this ? CurrentBinding().nSlot : -1;
+    }
+
+    void SetCurrentSlot(int nSlot)
+    {
+        CurrentBinding().pPool = nSlot >= 0 ? this : NULL;
+        CurrentBinding().nSlot = nSlot;
+    }
+
+    int AcquireSlot()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_vFreeSlots.empty())
+            return -1;
+        int nSlot = m_vFreeSlots.back();
+        m_vFreeSlots.pop_back();
+        return nSlot;
+    }
+
+    void ReleaseSlot(int nSlot)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_vFreeSlots.push_back(nSlot);
+    }
+
+    void Push(int nSlot, const Task &oTask)
+    {
+        Slot &oSlot = m_vSlots[nSlot];
+        {
+            std::lock_guard<std::mutex> lock(oSlot.mutex);
+            oSlot.qTasks.push_back(oTask);
+            oSlot.nSize.store((unsigned int)oSlot.qTasks.size());
+        }
+
+        // seq_cst against the sleeper count: either a worker going to sleep
+        // sees the task or we see the worker and wake it
+        m_nQueued.fetch_add(1);
+        if (m_nSleepers.load() != 0)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_cvWork.notify_one();
+        }
+    }
+
+    bool TryPop(int nSlot, Task *pTask)
+    {
+        Slot &oSlot = m_vSlots[nSlot];
+        if (oSlot.nSize.load(std::memory_order_relaxed) == 0)
+            return false;
+
+        std::lock_guard<std::mutex> lock(oSlot.mutex);
+        if (oSlot.qTasks.empty())
+            return false;
+        *pTask = oSlot.qTasks.back();
+        oSlot.qTasks.pop_back();
+        oSlot.nSize.store((unsigned int)oSlot.qTasks.size());
+        m_nQueued.fetch_sub(1);
+        return true;
+    }
+
+    bool TrySteal(int nSlot, Task *pTask)
+    {
+        // start at a different victim each time so thieves spread out
+        thread_local unsigned int tls_uSeed = 0x9e3779b9u ^ (unsigned int)nSlot;
+        tls_uSeed ^= tls_uSeed << 13;
+        tls_uSeed ^= tls_uSeed >> 17;
+        tls_uSeed ^= tls_uSeed << 5;
+
+        size_t nSlots = m_vSlots.size();
+        for (size_t i = 0; i < nSlots && m_nQueued.load(std::memory_order_relaxed) != 0; i++)
+        {
+            Slot &oVictim = m_vSlots[(tls_uSeed + i) % nSlots];
+            if (&oVictim == &m_vSlots[nSlot] || oVictim.nSize.load(std::memory_order_relaxed) == 0)
+                continue;
+
+            std::lock_guard<std::mutex> lock(oVictim.mutex);
+            if (oVictim.qTasks.empty())
+                continue;
+            *pTask = oVictim.qTasks.front();
+            oVictim.qTasks.pop_front();
+            oVictim.nSize.store((unsigned int)oVictim.qTasks.size());
+            m_nQueued.fetch_sub(1);
+            m_nSteals.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+        return false;
+    }
+
+    void Run(int nSlot, Task oTask)
+    {
+        Job *pJob = oTask.pJob;
+
+        while (oTask.uEnd - oTask.uBegin > pJob->uGrain)
+        {
+            unsigned int uMid = oTask.uBegin + (oTask.uEnd - oTask.uBegin) / 2;
+            Task oUpper = { pJob, uMid, oTask.uEnd };
+            Push(nSlot, oUpper);
+            oTask.uEnd = uMid;
+        }
+
+        (*pJob->pfnRange)(oTask.uBegin, oTask.uEnd);
+        m_nTasks.fetch_add(1, std::memory_order_relaxed);
+
+        // the caller may return as soon as this hits 0, so pJob is not
+        // touched after it
+        unsigned int nDone = oTask.uEnd - oTask.uBegin;
+        if (pJob->nPending.fetch_sub(nDone, std::memory_order_acq_rel) == nDone)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_cvDone.notify_all();
+        }
+    }
+
+    void Worker(int nSlot)
+    {
+        SetCurrentSlot(nSlot);
+
+        for (;;)
+        {
+            Task oTask;
+            if (TryPop(nSlot, &oTask) || TrySteal(nSlot, &oTask))
+            {
+                Run(nSlot, oTask);
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_nSleepers.fetch_add(1);
+            m_cvWork.wait(lock, [this] { return m_bQuit || m_nQueued.load() != 0; });
+            m_nSleepers.fetch_sub(1);
+            if (m_bQuit)
+                return;
+        }
+    }
+
+    // non-copyable
+    CNvTaskPool(const CNvTaskPool &);
+    CNvTaskPool &operator=(const CNvTaskPool &);
+
+    std::vector<Slot>          m_vSlots;        // callers, then pool threads
+    std::vector<int>           m_vFreeSlots;    // caller slots not lent out
+    std::vector<std::thread>   m_vThreads;
+    unsigned int               m_uWorkers;
+    bool                       m_bQuit;
+    std::mutex                 m_mutex;
+    std::condition_variable    m_cvWork;
+    std::condition_variable    m_cvDone;
+    std::atomic<unsigned int>  m_nQueued;       // tasks in all deques
+    std::atomic<unsigned int>  m_nSleepers;
+    std::atomic<unsigned long long> m_nTasks;
+    std::atomic<unsigned long long> m_nSteals;
+    std::atomic<unsigned long long> m_nSerial;
+};
+
+#endif // NV_TASK_POOL_H
@@ -0,0 +1,137 @@
+/*
+ * Copyright 1993-2015 NVIDIA Corporation.  All rights reserved.
+ *
+ * Please refer to the NVIDIA end user license agreement (EULA) associated
+ * with this source code for terms and conditions that govern your use of
+ * this software. Any use, reproduction, disclosure, or distribution of
+ * this software and related documentation outside the terms of the EULA
+ * is strictly prohibited.
+ *
+ */
+
+#ifndef SPSCRING_H
+#define SPSCRING_H
+
+#include <atomic>
+
+#define NV_CACHE_LINE_SIZE 64
+
+// smallest ring capacity (a power of two, at least 2) that holds n items
+constexpr unsigned int nvSpscRingCapacity(unsigned int n)
+{
+    return n <= 2 ? 2 : 2 * nvSpscRingCapacity((n + 1) / 2);
+}
+
+// Bounded single-producer/single-consumer ring.
+//
+// Exactly one thread may call the Push* functions and exactly one thread the
+// Pop* functions. Indices run freely and are masked on access, so N must be
+// a power of two. The producer publishes slots with a release store of the
+// tail and the consumer hands them back with a release store of the head;
+// each side keeps a private copy of the other side's index and only reloads
+// it when the ring looks full (or empty), which keeps the shared cache lines
+// from bouncing on every operation.
+template<class T, unsigned int N>
+class CNvSpscRing
+{
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "CNvSpscRing capacity must be a power of two");
+
+public:
+    static const unsigned int cnCapacity = N;
+
+    CNvSpscRing() : m_uHead(0), m_uCachedTail(0), m_uTail(0), m_uCachedHead(0)
+    {
+    }
+
+    // producer side
+    bool Push(const T &item)
+    {
+        return PushBatch(&item, 1) == 1;
+    }
+
+    unsigned int PushBatch(const T *pItems, unsigned int uCount)
+    {
+        unsigned int uTail = m_uTail.load(std::memory_order_relaxed);
+        unsigned int uFree = N - (uTail - m_uCachedHead);
+        if (uFree < uCount)
+        {
+            m_uCachedHead = m_uHead.load(std::memory_order_acquire);
+            uFree = N - (uTail - m_uCachedHead);
+        }
+
+        if (uCount > uFree)
+            uCount = uFree;
+
+        for (unsigned int i = 0; i < uCount; i++)
+        {
+            m_aItems[(uTail + i) & (N - 1)] = pItems[i];
+        }
+
+        if (uCount)
+            m_uTail.store(uTail + uCount, std::memory_order_release);
+
+        return uCount;
+    }
+
+    bool Full() const
+    {
+        return (m_uTail.load(std::memory_order_relaxed) - m_uHead.load(std::memory_order_acquire)) == N;
+    }
+
+    // consumer side
+    bool Pop(T *pItem)
+    {
+        return PopBatch(pItem, 1) == 1;
+    }
+
+    unsigned int PopBatch(T *pItems, unsigned int uMaxCount)
+    {
+        unsigned int uHead  = m_uHead.load(std::memory_order_relaxed);
+        unsigned int uCount = m_uCachedTail - uHead;
+        if (uCount < uMaxCount)
+        {
+            m_uCachedTail = m_uTail.load(std::memory_order_acquire);
+            uCount = m_uCachedTail - uHead;
+        }
+
+        if (uCount > uMaxCount)
+            uCount = uMaxCount;
+
+        for (unsigned int i = 0; i < uCount; i++)
+        {
+            pItems[i] = m_aItems[(uHead + i) & (N - 1)];
+        }
+
+        if (uCount)
+            m_uHead.store(uHead + uCount, std::memory_order_release);
+
+        return uCount;
+    }
+
+    bool Empty() const
+    {
+        return m_uTail.load(std::memory_order_acquire) == m_uHead.load(std::memory_order_relaxed);
+    }
+
+    // either side; only a snapshot when called concurrently
+    unsigned int Size() const
+    {
+        unsigned int uHead = m_uHead.load(std::memory_order_acquire);
+        return m_uTail.load(std::memory_order_acquire) - uHead;
+    }
+
+private:
+    // Consumer-owned line: head index plus its cached view of the tail.
+    std::atomic<unsigned int> m_uHead;
+    unsigned int              m_uCachedTail;
+    char                      m_aPad0[NV_CACHE_LINE_SIZE - sizeof(std::atomic<unsigned int>) - sizeof(unsigned int)];
+
+    // Producer-owned line: tail index plus its cached view of the head.
+    std::atomic<unsigned int> m_uTail;
+    unsigned int              m_uCachedHead;
+    char                      m_aPad1[NV_CACHE_LINE_SIZE - sizeof(std::atomic<unsigned int>) - sizeof(unsigned int)];
+
+    T                         m_aItems[N];
+};
+
+#endif // SPSCRING_H
@@ -0,0 +1,1973 @@
+/*
+ * Copyright 1993-2015 NVIDIA Corporation.  All rights reserved.
+ *
+ * Please refer to the NVIDIA end user license agreement (EULA) associated
+ * with this source code for terms and conditions that govern your use of
+ * this software. Any use, reproduction, disclosure, or distribution of
+ * this software and related documentation outside the terms of the EULA
+ * is strictly prohibited.
+ *
+ */
+
+#include "cpuBenchmark.h"
+#include "cpuProcessFrame.h"
+#include "NvFilterGraph.h"
+#include "NvTaskPool.h"
+#include "FrameQueue.h"
+#include "NvFramePool.h"
+#include "NvBitstreamWriter.h"
+#include "NvHWDecoder.h"
+#include "NvPipeline.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+// best of a few runs after a warm-up, in ms
+static double timeBest(const std::function<void ()> &fnRun, int nRuns = 5)
+{
+    double fBest = 1e30;
+
+    fnRun();
+    for (int i = 0; i < nRuns; i++)
+    {
+        std::chrono::steady_clock::time_point tStart = std::chrono::steady_clock::now();
+        fnRun();
+        fBest = std::min(fBest, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - tStart).count());
+    }
+    return fBest;
+}
+
+// Synthetic frames: an NV12 picture with some texture, its ARGB, and
+// destinations for both.
+struct BenchFrames
+{
+    uint32              width;
+    uint32              height;
+    size_t              nYUVPitch;
+    size_t              nARGBPitch;
+    std::vector<uint8>  vNV12;
+    std::vector<uint8>  vNV12Out;
+    std::vector<uint32> vARGB;
+
+    BenchFrames(uint32 w, uint32 h): width(w), height(h), nYUVPitch((w + 255) & ~255), nARGBPitch(w * 4)
+    {
+        vNV12.resize(nYUVPitch * (h + NV_CHROMA_ROWS_420(h)));
+        vNV12Out.resize(vNV12.size());
+        vARGB.resize((size_t)w * h);
+
+        for (size_t i = 0; i < vNV12.size(); i++)
+        {
+            vNV12[i] = (uint8)(i * 2654435761u >> 13);
+        }
+    }
+};
+
+// Every thread count up to the hardware threads, in powers of two past 8.
+static std::vector<uint32> threadCounts()
+{
+    uint32 nMax = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<uint32> vCounts;
+
+    for (uint32 n = 1; n <= nMax; n = (n < 8) ? n + 1 : n * 2)
+    {
+        vCounts.push_back(n);
+    }
+    if (vCounts.back() != nMax)
+    {
+        vCounts.push_back(nMax);
+    }
+    return vCounts;
+}
+
+static void benchScaling(uint32 width, uint32 height, const CpuPostprocess *pPostprocess)
+{
+    NvColorSpace oColorSpace = { NV_COLOR_MATRIX_BT709, NV_COLOR_RANGE_LIMITED };
+    BenchFrames oFrames(width, height);
+    CpuStripPlan oSaved = cpuStripPlan();
+    double fMPix = width * (double)height / 1e6;
+    double aBase[4] = { 0, 0, 0, 0 };
+
+    uint32 nStripRows = cpuStripRowsForL2(width, 8, pPostprocess, false);
+
+    printf("scaling: %ux%u, %s, %u-row strips, Mpixel/s (speedup over 1 thread)\n",
+           width, height, cpuISAName(cpuSelectedISA()), nStripRows);
+    printf("%7s %17s %17s %17s %17s %14s\n", "threads", "NV12->ARGB", "ARGB->NV12", "pp fused", "pp unfused", "steals/frame");
+
+    std::vector<uint32> vCounts = threadCounts();
+    for (size_t i = 0; i < vCounts.size(); i++)
+    {
+        CpuStripPlan oPlan = { nStripRows, vCounts[i] };
+        cpuSetStripPlan(oPlan);
+
+        NvTaskPoolStats oBefore, oAfter;
+        cpuTaskPool().GetStats(&oBefore);
+
+        double aMs[4];
+        aMs[0] = timeBest([&] { cpuNV12toARGB(&oFrames.vNV12[0], oFrames.nYUVPitch, &oFrames.vARGB[0], oFrames.nARGBPitch,
+                                              width, height, oColorSpace); });
+        aMs[1] = timeBest([&] { cpuARGBtoNV12(&oFrames.vARGB[0], oFrames.nARGBPitch, &oFrames.vNV12Out[0], oFrames.nYUVPitch,
+                                              width, height, oColorSpace); });
+        aMs[2] = timeBest([&] { cpuPostprocessNV12(&oFrames.vNV12[0], oFrames.nYUVPitch, &oFrames.vNV12Out[0], oFrames.nYUVPitch,
+                                                   &oFrames.vARGB[0], oFrames.nARGBPitch, width, height, oColorSpace,
+                                                   pPostprocess, true); });
+        aMs[3] = timeBest([&] { cpuPostprocessNV12(&oFrames.vNV12[0], oFrames.nYUVPitch, &oFrames.vNV12Out[0], oFrames.nYUVPitch,
+                                                   &oFrames.vARGB[0], oFrames.nARGBPitch, width, height, oColorSpace,
+                                                   pPostprocess, false); });
+
+        // 4 functions x 6 runs
+        cpuTaskPool().GetStats(&oAfter);
+
+        printf("%7u", vCounts[i]);
+        for (int k = 0; k < 4; k++)
+        {
+            if (i == 0)
+            {
+                aBase[k] = aMs[k];
+            }
+            printf(" %9.0f (%4.1fx)", fMPix / aMs[k] * 1000.0, aBase[k] / aMs[k]);
+        }
+        printf(" %14.1f\n", (oAfter.nSteals - oBefore.nSteals) / 24.0);
+    }
+
+    cpuSetStripPlan(oSaved);
+}
+
+// A postprocess on its own, in place on a whole ARGB frame, or from the
+// NV12 frame's Y plane to the output's for a luma one.
+static void runPostprocess(const CpuPostprocess *pPostprocess, BenchFrames &oFrames)
+{
+    if (pPostprocess->pfnLuma)
+    {
+        pPostprocess->pfnLuma(&oFrames.vNV12[0], oFrames.nYUVPitch, &oFrames.vNV12Out[0], oFrames.nYUVPitch,
+                              oFrames.width, oFrames.height, 0, oFrames.height, pPostprocess->pParams);
+        return;
+    }
+    if (pPostprocess->pfnFrame)
+    {
+        pPostprocess->pfnFrame(&oFrames.vARGB[0], oFrames.nARGBPitch, oFrames.width, oFrames.height, pPostprocess->pParams);
+        return;
+    }
+    for (uint32 y = 0; y < oFrames.height; y++)
+    {
+        pPostprocess->pfnRow(&oFrames.vARGB[(size_t)y * oFrames.width], oFrames.width, pPostprocess->pParams);
+    }
+}
+
+static const char *accessName(NvFilterAccess eAccess)
+{
+    return eAccess == NV_FILTER_POINTWISE ? "point-wise" : eAccess == NV_FILTER_NEIGHBORHOOD ? "neighbourhood" : "temporal";
+}
+
+static void benchFilters(uint32 width, uint32 height, CNvFilterGraph &oGraph)
+{
+    NvColorSpace oColorSpace = { NV_COLOR_MATRIX_BT709, NV_COLOR_RANGE_LIMITED };
+    BenchFrames oFrames(width, height);
+    CpuStripPlan oSaved = cpuStripPlan();
+    double fMPix = width * (double)height / 1e6;
+    const CpuPostprocess *pChain = oGraph.HostPostprocess();
+
+    printf("filters: %ux%u, %s, Mpixel/s\n", width, height, cpuISAName(cpuSelectedISA()));
+    if (!pChain)
+    {
+        printf("no filters\n");
+        return;
+    }
+
+    // every filter as a graph of its own, on the ARGB frame only
+    printf("%-40s %-14s %10s\n", "filter", "access", "ARGB");
+    for (size_t i = 0; i < oGraph.FilterCount(); i++)
+    {
+        CNvFilterGraph oSingle;
+        oSingle.Parse(oGraph.FilterChain(i).c_str());
+        cpuNV12toARGB(&oFrames.vNV12[0], oFrames.nYUVPitch, &oFrames.vARGB[0], oFrames.nARGBPitch, width, height, oColorSpace);
+
+        double fMs = timeBest([&] { runPostprocess(oSingle.HostPostprocess(), oFrames); });
+        printf("%-40s %-14s %10.0f\n", oGraph.FilterChain(i).c_str(), accessName(oGraph.Filter(i)->Access()), fMPix / fMs * 1000.0);
+    }
+
+    // NV12 -> ARGB -> chain -> NV12, whole frames on one thread unfused as
+    // the reference, then fused and in strips on all threads
+    struct Run
+    {
+        const char  *szName;
+        bool         bFused;
+        uint32       nStripRows;
+    };
+    Run aRuns[3] = {
+        { "unfused", false, 0 },
+        { "fused",   true,  0 },
+        { "strips",  true,  cpuStripRowsForL2(width, 8, pChain, true) },
+    };
+    std::vector<uint8> vReference;
+
+    printf("chain %s:\n", oGraph.Description().c_str());
+    for (int i = 0; i < 3; i++)
+    {
+        if (i == 1 && !cpuIsFusable(pChain))
+            continue;
+
+        CpuStripPlan oPlan = { aRuns[i].nStripRows, 0 };
+        cpuSetStripPlan(oPlan);
+
+        auto fnRun = [&] { cpuPostprocessNV12(&oFrames.vNV12[0], oFrames.nYUVPitch, &oFrames.vNV12Out[0], oFrames.nYUVPitch,
+                                              &oFrames.vARGB[0], oFrames.nARGBPitch, width, height, oColorSpace,
+                                              pChain, aRuns[i].bFused); };
+
+        // temporal filters start over so all runs see the same first frame
+        oGraph.Reset();
+        fnRun();
+        std::vector<uint8> vOutput = oFrames.vNV12Out;
+        double fMs = timeBest(fnRun);
+
+        if (vReference.empty())
+        {
+            vReference = vOutput;
+        }
+        printf("  %-8s %10.0f   %s\n", aRuns[i].szName, fMPix / fMs * 1000.0,
+               i == 0 ? "reference" : vOutput == vReference ? "same output" : "OUTPUT DIFFERS");
+    }
+
+    oGraph.Reset();
+    cpuSetStripPlan(oSaved);
+}
+
+// The box and Gaussian blurs over radii 1..64 on one thread, box on the
+// scalar kernels and the selected ISA's, on the ARGB frame only; the time
+// per pixel should not grow with the radius. Gaussian sigma is the radius.
+static void benchBlur(uint32 width, uint32 height)
+{
+    NvColorSpace oColorSpace = { NV_COLOR_MATRIX_BT709, NV_COLOR_RANGE_LIMITED };
+    BenchFrames oFrames(width, height);
+    CpuISA eISA = cpuSelectedISA();
+    double fMPix = width * (double)height / 1e6;
+    static const uint32 aRadii[] = { 1, 2, 4, 8, 16, 32, 64 };
+
+    cpuNV12toARGB(&oFrames.vNV12[0], oFrames.nYUVPitch, &oFrames.vARGB[0], oFrames.nARGBPitch, width, height, oColorSpace);
+    std::vector<uint32> vInput = oFrames.vARGB;
+
+    printf("blur: %ux%u, 1 thread, Mpixel/s\n", width, height);
+    printf("%6s %12s %12s %12s\n", "radius", "box scalar", "box simd", "gauss simd");
+    for (size_t i = 0; i < sizeof(aRadii) / sizeof(aRadii[0]); i++)
+    {
+        char szBox[64], szGauss[64];
+        snprintf(szBox, sizeof(szBox), "box:radius=%u", aRadii[i]);
+        snprintf(szGauss, sizeof(szGauss), "gauss:sigma=%u", aRadii[i]);
+
+        CNvFilterGraph oBox, oGauss;
+        oBox.Parse(szBox);
+        oGauss.Parse(szGauss);
+
+        double aMs[3];
+        std::vector<uint32> vScalar;
+        for (int k = 0; k < 3; k++)
+        {
+            cpuSelectISA(k == 0 ? CPU_ISA_SCALAR : eISA);
+            oFrames.vARGB = vInput;
+            runPostprocess((k < 2 ? oBox : oGauss).HostPostprocess(), oFrames);
+            if (k == 0)
+            {
+                vScalar = oFrames.vARGB;
+            }
+            else if (k == 1 && oFrames.vARGB != vScalar)
+            {
+                printf("radius %u: SIMD OUTPUT DIFFERS from scalar\n", aRadii[i]);
+            }
+            aMs[k] = timeBest([&] { runPostprocess((k < 2 ? oBox : oGauss).HostPostprocess(), oFrames); });
+        }
+        printf("%6u %12.0f %12.0f %12.0f\n", aRadii[i], fMPix / aMs[0] * 1000.0, fMPix / aMs[1] * 1000.0, fMPix / aMs[2] * 1000.0);
+    }
+
+    cpuSelectISA(eISA);
+}
+
+// The unsharp mask over radii 1..32 on one thread, in ms per megapixel of
+// ARGB, scalar and SIMD, next to the box blur of the same radius alone:
+// the mask does its blur in the same pass, so it should cost about that.
+static void benchUnsharp(uint32 width, uint32 height)
+{
+    NvColorSpace oColorSpace = { NV_COLOR_MATRIX_BT709, NV_COLOR_RANGE_LIMITED };
+    BenchFrames oFrames(width, height);
+    CpuISA eISA = cpuSelectedISA();
+    double fMPix = width * (double)height / 1e6;
+    static const uint32 aRadii[] = { 1, 2, 4, 8, 16, 32 };
+
+    cpuNV12toARGB(&oFrames.vNV12[0], oFrames.nYUVPitch, &oFrames.vARGB[0], oFrames.nARGBPitch, width, height, oColorSpace);
+    std::vector<uint32> vInput = oFrames.vARGB;
+
+    printf("unsharp: %ux%u, 1 thread, ms per Mpixel\n", width, height);
+    printf("%6s %15s %15s %12s\n", "radius", "unsharp scalar", "unsharp simd", "box simd");
+    for (size_t i = 0; i < sizeof(aRadii) / sizeof(aRadii[0]); i++)
+    {
+        char szUnsharp[64], szBox[64];
+        snprintf(szUnsharp, sizeof(szUnsharp), "unsharp:radius=%u:amount=1.5:threshold=2", aRadii[i]);
+        snprintf(szBox, sizeof(szBox), "box:radius=%u", aRadii[i]);
+
+        CNvFilterGraph oUnsharp, oBox;
+        oUnsharp.Parse(szUnsharp);
+        oBox.Parse(szBox);
+
+        double aMs[3];
+        std::vector<uint32> vScalar;
+        for (int k = 0; k < 3; k++)
+        {
+            cpuSelectISA(k == 0 ? CPU_ISA_SCALAR : eISA);
+            oFrames.vARGB = vInput;
+            runPostprocess((k < 2 ? oUnsharp : oBox).HostPostprocess(), oFrames);
+            if (k == 0)
+            {
+                vScalar = oFrames.vARGB;
+            }
+            else if (k == 1 && oFrames.vARGB != vScalar)
+            {
+                printf("radius %u: SIMD OUTPUT DIFFERS from scalar\n", aRadii[i]);
+            }
+            aMs[k] = timeBest([&] { runPostprocess((k < 2 ? oUnsharp : oBox).HostPostprocess(), oFrames); });
+        }
+        printf("%6u %15.2f %15.2f %12.2f\n", aRadii[i], aMs[0] / fMPix, aMs[1] / fMPix, aMs[2] / fMPix);
+    }
+
+    cpuSelectISA(eISA);
+}
+
+// The median filters at 1080p and 4K whatever -size says: Mpixel/s on one
+// thread for the scalar and SIMD networks on the ARGB frame, then frames/s
+// of the whole NV12 -> ARGB -> median -> NV12 path in strips on all threads.
+static void benchMedian()
+{
+    NvColorSpace oColorSpace = { NV_COLOR_MATRIX_BT709, NV_COLOR_RANGE_LIMITED };
+    CpuStripPlan oSaved = cpuStripPlan();
+    CpuISA eISA = cpuSelectedISA();
+    uint32 nThreads = std::max(1u, std::thread::hardware_concurrency());
+    static const uint32 aSizes[][2] = { { 1920, 1080 }, { 3840, 2160 } };
+    static const char *aChains[] = { "median:size=3", "median:size=5", "median:size=3:luma=1", "median:size=5:luma=1" };
+
+    printf("median: %s, Mpixel/s on 1 thread, frames/s of NV12 in and out on %u threads\n", cpuISAName(eISA), nThreads);
+    printf("%-10s %-22s %10s %10s %12s\n", "size", "filter", "scalar", "simd", "NV12 fps");
+    for (size_t i = 0; i < sizeof(aSizes) / sizeof(aSizes[0]); i++)
+    {
+        uint32 width = aSizes[i][0], height = aSizes[i][1];
+        BenchFrames oFrames(width, height);
+        double fMPix = width * (double)height / 1e6;
+
+        cpuNV12toARGB(&oFrames.vNV12[0], oFrames.nYUVPitch, &oFrames.vARGB[0], oFrames.nARGBPitch, width, height, oColorSpace);
+        std::vector<uint32> vInput = oFrames.vARGB;
+
+        for (size_t k = 0; k < sizeof(aChains) / sizeof(aChains[0]); k++)
+        {
+            CNvFilterGraph oGraph;
+            oGraph.Parse(aChains[k]);
+            const CpuPostprocess *pChain = oGraph.HostPostprocess();
+
+            // the scalar network is slow enough for one timed run
+            double aMs[2];
+            std::vector<uint32> vScalar;
+            for (int n = 0; n < 2; n++)
+            {
+                cpuSelectISA(n == 0 ? CPU_ISA_SCALAR : eISA);
+                oFrames.vARGB = vInput;
+                runPostprocess(pChain, oFrames);
+                if (n == 0)
+                {
+                    vScalar = oFrames.vARGB;
+                }
+                else if (oFrames.vARGB != vScalar)
+                {
+                    printf("%s: SIMD OUTPUT DIFFERS from scalar\n", aChains[k]);
+                }
+                aMs[n] = timeBest([&] { runPostprocess(pChain, oFrames); }, n == 0 ? 1 : 5);
+            }
+
+            CpuStripPlan oPlan = { cpuStripRowsForL2(width, 8, pChain, true), nThreads };
+            cpuSetStripPlan(oPlan);
+            double fMs = timeBest([&] { cpuPostprocessNV12(&oFrames.vNV12[0], oFrames.nYUVPitch, &oFrames.vNV12Out[0], oFrames.nYUVPitch,
+                                                           &oFrames.vARGB[0], oFrames.nARGBPitch, width, height, oColorSpace,
+                                                           pChain, true); });
+
+            char szSize[32];
+            snprintf(szSize, sizeof(szSize), "%ux%u", width, height);
+            printf("%-10s %-22s %10.0f %10.0f %12.1f\n", szSize, aChains[k], fMPix / aMs[0] * 1000.0, fMPix / aMs[1] * 1000.0,
+                   1000.0 / fMs);
+        }
+    }
+
+    cpuSelectISA(eISA);
+    cpuSetStripPlan(oSaved);
+}
+
+// The bilateral denoiser on the Y plane at 1080p whatever -size says, over a
+// few radii: Mpixel/s on one thread, then frames/s of the NV12 path in
+// strips, measured with one strip thread per hardware thread and with eight
+// (CpuStripPlan nThreads = 8). Eight threads only run as fast as eight cores
+// where there are eight, so the run says when 1080p30 is checked on fewer.
+static void benchBilateral()
+{
+    NvColorSpace oColorSpace = { NV_COLOR_MATRIX_BT709, NV_COLOR_RANGE_LIMITED };
+    CpuStripPlan oSaved = cpuStripPlan();
+    uint32 nThreads = std::max(1u, std::thread::hardware_concurrency());
+    uint32 width = 1920, height = 1080;
+    BenchFrames oFrames(width, height);
+    double fMPix = width * (double)height / 1e6;
+    static const uint32 aRadii[] = { 1, 2, 3, 5, 8 };
+    const uint32 aThreads[] = { nThreads, 8 };
+
+    printf("bilateral: %ux%u Y plane, Mpixel/s on 1 thread, measured frames/s of NV12 in and out in strips\n", width, height);
+    printf("%6s %10s %11s %11s\n", "radius", "Mpixel/s", "NV12 fps", "NV12 fps");
+    printf("%6s %10s %4u thread%s %3u threads\n", "", "1 thread", aThreads[0], aThreads[0] > 1 ? "s" : " ", aThreads[1]);
+    for (size_t i = 0; i < sizeof(aRadii) / sizeof(aRadii[0]); i++)
+    {
+        char szChain[64];
+        snprintf(szChain, sizeof(szChain), "bilateral:radius=%u", aRadii[i]);
+        CNvFilterGraph oGraph;
+        oGraph.Parse(szChain);
+        const CpuPostprocess *pChain = oGraph.HostPostprocess();
+
+        double fMs = timeBest([&] { runPostprocess(pChain, oFrames); });
+        printf("%6u %10.0f", aRadii[i], fMPix / fMs * 1000.0);
+
+        for (int t = 0; t < 2; t++)
+        {
+            CpuStripPlan oPlan = { cpuStripRowsForL2(width, 8, pChain, true), aThreads[t] };
+            cpuSetStripPlan(oPlan);
+            double fFrameMs = timeBest([&] { cpuPostprocessNV12(&oFrames.vNV12[0], oFrames.nYUVPitch, &oFrames.vNV12Out[0], oFrames.nYUVPitch,
+                                                                &oFrames.vARGB[0], oFrames.nARGBPitch, width, height, oColorSpace,
+                                                                pChain, true); });
+            printf(" %11.1f", 1000.0 / fFrameMs);
+        }
+        printf("\n");
+    }
+    if (nThreads < 8)
+    {
+        printf("  %u hardware thread%s: the 8-thread column is measured, but is not the rate of 8 cores\n",
+               nThreads, nThreads > 1 ? "s" : "");
+    }
+
+    cpuSetStripPlan(oSaved);
+}
+
+// The display queue between the parser callback and the render loop. First
+// the checks: it takes exactly cnMaximumSize frames, and two threads passing
+// frames the way the decoder does (a surface is reused only once the render
+// side released it) see every frame once, in order, and both wake up on
+// endDecode(). Then the throughput on two threads, in million ops/s (one
+// push plus one pop), of the bare ring, singly and in batches, of FrameQueue
+// itself, and of a mutex and condition variable queue for comparison.
+static void benchQueue()
+{
+    const unsigned int nFrames = 200000;
+    const unsigned int nRingOps = 4000000;
+    uint32 nThreads = std::max(1u, std::thread::hardware_concurrency());
+    bool bOk = true;
+
+    printf("queue: display queue of %u frames in a ring of %u, %u hardware threads\n",
+           FrameQueue::cnMaximumSize, nvSpscRingCapacity(FrameQueue::cnMaximumSize), nThreads);
+
+    {
+        FrameQueue oQueue;
+        CUVIDPARSERDISPINFO oInfo;
+        memset(&oInfo, 0, sizeof(oInfo));
+
+        unsigned int nQueued = 0;
+        while (nQueued <= FrameQueue::cnMaximumSize && oQueue.enqueue(&oInfo, 0))
+        {
+            nQueued++;
+        }
+        printf("  capacity            %u frames before enqueue refuses: %s\n", nQueued,
+               nQueued == FrameQueue::cnMaximumSize ? "ok" : "WRONG CAPACITY");
+        bOk = bOk && nQueued == FrameQueue::cnMaximumSize;
+    }
+
+    {
+        FrameQueue oQueue;
+        unsigned int nReceived = 0, nOutOfOrder = 0, nReusedEarly = 0;
+        bool bTimedOut = false;
+        std::vector<std::atomic<unsigned int> > vReleases(FrameQueue::cnMaximumSize);
+        for (size_t i = 0; i < vReleases.size(); i++)
+        {
+            vReleases[i].store(0);
+        }
+
+        std::thread oConsumer([&]
+        {
+            CUVIDPARSERDISPINFO oInfo;
+            while (oQueue.dequeue(&oInfo, 1000))
+            {
+                if (oInfo.timestamp != (CUvideotimestamp)nReceived ||
+                    oInfo.picture_index != (int)(nReceived % FrameQueue::cnMaximumSize))
+                {
+                    nOutOfOrder++;
+                }
+                nReceived++;
+                vReleases[oInfo.picture_index].fetch_add(1);
+                oQueue.releaseFrame(&oInfo);
+            }
+        });
+
+        std::chrono::steady_clock::time_point tStart = std::chrono::steady_clock::now();
+        CUVIDPARSERDISPINFO oInfo;
+        memset(&oInfo, 0, sizeof(oInfo));
+        for (unsigned int i = 0; i < nFrames; i++)
+        {
+            oInfo.picture_index = (int)(i % FrameQueue::cnMaximumSize);
+            oInfo.timestamp = i;
+            if (!oQueue.waitUntilFrameAvailable(oInfo.picture_index, 1000))
+            {
+                bTimedOut = true;
+                break;
+            }
+            // every earlier use of this surface has been released
+            if (vReleases[oInfo.picture_index].load() != i / FrameQueue::cnMaximumSize)
+            {
+                nReusedEarly++;
+            }
+            if (!oQueue.enqueue(&oInfo, 1000))
+            {
+                bTimedOut = true;
+                break;
+            }
+        }
+        oQueue.endDecode();
+        oConsumer.join();
+        double fMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - tStart).count();
+
+        bool bPassed = nReceived == nFrames && !nOutOfOrder && !nReusedEarly && !bTimedOut && oQueue.isDecodeFinished();
+        printf("  stress              %u of %u frames, %u out of order, %u surfaces reused early%s, %.0f ms: %s\n",
+               nReceived, nFrames, nOutOfOrder, nReusedEarly, bTimedOut ? ", TIMED OUT" : "", fMs,
+               bPassed ? "ok" : "FAILED");
+        bOk = bOk && bPassed;
+    }
+
+    // the ring alone, spinning (yielding) when full or empty
+    for (unsigned int nBatch = 1; nBatch <= 16; nBatch *= 16)
+    {
+        CNvSpscRing<unsigned int, 1024> *pRing = new CNvSpscRing<unsigned int, 1024>;
+        unsigned long long nSum = 0;
+
+        std::chrono::steady_clock::time_point tStart = std::chrono::steady_clock::now();
+        std::thread oConsumer([&]
+        {
+            unsigned int aItems[16];
+            for (unsigned int n = 0; n < nRingOps; )
+            {
+                unsigned int nPopped = pRing->PopBatch(aItems, nBatch);
+                for (unsigned int i = 0; i < nPopped; i++)
+                {
+                    nSum += aItems[i];
+                }
+                n += nPopped;
+                if (!nPopped)
+                {
+                    std::this_thread::yield();
+                }
+            }
+        });
+
+        unsigned int aItems[16];
+        for (unsigned int n = 0; n < nRingOps; )
+        {
+            for (unsigned int i = 0; i < nBatch; i++)
+            {
+                aItems[i] = n + i;
+            }
+            unsigned int nPushed = pRing->PushBatch(aItems, std::min(nBatch, nRingOps - n));
+            n += nPushed;
+            if (!nPushed)
+            {
+                std::this_thread::yield();
+            }
+        }
+        oConsumer.join();
+        double fMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - tStart).count();
+        delete pRing;
+
+        bool bSum = nSum == (unsigned long long)nRingOps * (nRingOps - 1) / 2;
+        printf("  ring, batch %-7u %8.1f M ops/s%s\n", nBatch, nRingOps / fMs / 1000.0, bSum ? "" : "  ITEMS LOST");
+        bOk = bOk && bSum;
+    }
+
+    // FrameQueue with its blocking waits, no surface handling
+    {
+        FrameQueue oQueue;
+        std::chrono::steady_clock::time_point tStart = std::chrono::steady_clock::now();
+        std::thread oConsumer([&]
+        {
+            CUVIDPARSERDISPINFO oInfo;
+            while (oQueue.dequeue(&oInfo, FrameQueue::cnInfinite))
+            {
+            }
+        });
+
+        CUVIDPARSERDISPINFO oInfo;
+        memset(&oInfo, 0, sizeof(oInfo));
+        for (unsigned int i = 0; i < nFrames; i++)
+        {
+            oQueue.enqueue(&oInfo);
+        }
+        oQueue.endDecode();
+        oConsumer.join();
+        double fMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - tStart).count();
+        printf("  FrameQueue          %8.1f M ops/s\n", nFrames / fMs / 1000.0);
+    }
+
+    // the same through a mutex, two condition variables and a deque
+    {
+        std::mutex oMutex;
+        std::condition_variable oNotEmpty, oNotFull;
+        std::deque<CUVIDPARSERDISPINFO> oQueue;
+        bool bEnd = false;
+
+        std::chrono::steady_clock::time_point tStart = std::chrono::steady_clock::now();
+        std::thread oConsumer([&]
+        {
+            for (;;)
+            {
+                std::unique_lock<std::mutex> lock(oMutex);
+                oNotEmpty.wait(lock, [&] { return !oQueue.empty() || bEnd; });
+                if (oQueue.empty())
+                {
+                    break;
+                }
+                oQueue.pop_front();
+                lock.unlock();
+                oNotFull.notify_one();
+            }
+        });
+
+        CUVIDPARSERDISPINFO oInfo;
+        memset(&oInfo, 0, sizeof(oInfo));
+        for (unsigned int i = 0; i <= nFrames; i++)
+        {
+            std::unique_lock<std::mutex> lock(oMutex);
+            if (i == nFrames)
+            {
+                bEnd = true;
+            }
+            else
+            {
+                oNotFull.wait(lock, [&] { return oQueue.size() < FrameQueue::cnMaximumSize; });
+                oQueue.push_back(oInfo);
+            }
+            lock.unlock();
+            oNotEmpty.notify_one();
+        }
+        oConsumer.join();
+        double fMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - tStart).count();
+        printf("  mutex and deque     %8.1f M ops/s\n", nFrames / fMs / 1000.0);
+    }
+
+    printf("queue: %s\n", bOk ? "all checks passed" : "CHECKS FAILED");
+}
+
+// the ISAs this CPU can run, scalar first
+static std::vector<CpuISA> runnableISAs()
+{
+    CpuISA eSaved = cpuSelectedISA();
+    std::vector<CpuISA> vISAs;
+
+    for (int i = 0; i < CPU_ISA_COUNT; i++)
+    {
+        if (cpuSelectISA((CpuISA)i))
+        {
+            vISAs.push_back((CpuISA)i);
+        }
+    }
+    cpuSelectISA(eSaved);
+    return vISAs;
+}
+
+// Sizes for the bit-exactness checks: whole vectors, and odd widths and
+// heights that leave a scalar tail, an odd last column and an odd last row.
+static const uint32 s_aCheckSizes[][2] = { { 1280, 720 }, { 643, 361 }, { 33, 7 }, { 3, 3 }, { 1, 1 } };
+
+// Throughput at 720p, 1080p and 4K whatever -size says.
+static const uint32 s_aBenchSizes[][2] = { { 1280, 720 }, { 1920, 1080 }, { 3840, 2160 } };
+
+// ARGBToNv12drvapi as it was before the Q13 matrices, ported line for line
+// as the baseline for -bench convert: floats, 8-bit RGB widened to 10 bits,
+// BT.601 limited coefficients without the +16 on luma, chroma from the left
+// pixel of each pair on even rows, and nothing done for an odd last column.
+static void oldARGBtoNV12(const uint32 *pSrcARGB, size_t nSourcePitch,
+                          uint8 *pDstNV12,        size_t nDestPitch,
+                          uint32 width,           uint32 height)
+{
+    for (uint32 y = 0; y < height; y++)
+    {
+        const uint32 *pSrc = pSrcARGB + y * (nSourcePitch >> 2);
+
+        for (uint32 x = 0; x + 1 < width; x += 2)
+        {
+            float yuv[6];
+
+            for (int i = 0; i < 2; i++)
+            {
+                float r = (float)(((pSrc[x + i] >> 16) & 0xFF) << 2);
+                float g = (float)(((pSrc[x + i] >>  8) & 0xFF) << 2);
+                float b = (float)(( pSrc[x + i]        & 0xFF) << 2);
+
+                yuv[i * 3 + 0] = r *  0.2568 + g *  0.5041 + b *  0.0979;
+                yuv[i * 3 + 1] = r * -0.1482 + g * -0.2910 + b *  0.4392 + 512;
+                yuv[i * 3 + 2] = r *  0.4392 + g * -0.3678 + b * -0.0714 + 512;
+            }
+            for (int i = 0; i < 6; i++)
+            {
+                yuv[i] = std::min(std::max(yuv[i] / 4, 0.0f), 255.f);
+            }
+
+            pDstNV12[y * nDestPitch + x    ] = (uint8)(uint32)yuv[0];
+            pDstNV12[y * nDestPitch + x + 1] = (uint8)(uint32)yuv[3];
+            if (!(y & 1))
+            {
+                uint8 *pChroma = pDstNV12 + nDestPitch * height + (y >> 1) * nDestPitch;
+                pChroma[x    ] = (uint8)(uint32)yuv[1];
+                pChroma[x + 1] = (uint8)(uint32)yuv[2];
+            }
+        }
+    }
+}
+
+// Compares what cpuARGBtoNV12 writes: width luma bytes per row, and the
+// CbCr pairs, one more byte for an odd width, per chroma row.
+static bool sameNV12(const std::vector<uint8> &vA, const std::vector<uint8> &vB, size_t nPitch, uint32 width, uint32 height)
+{
+    for (uint32 y = 0; y < height + NV_CHROMA_ROWS_420(height); y++)
+    {
+        uint32 nBytes = (y < height) ? width : (width + 1) & ~1;
+        if (memcmp(&vA[y * nPitch], &vB[y * nPitch], nBytes))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// The host colour conversions on every ISA this CPU runs. NV12 -> ARGB and
+// ARGB -> NV12 in every colour space must give the scalar rows' output on
+// each ISA, and write every pixel: the same conversion into a frame filled
+// with zeros and one filled with 0xDEADBEEF (0xEF for NV12) has to give the
+// same frame. Then Mpixel/s on one thread per ISA and size, ARGB -> NV12
+// next to the float kernel it replaced.
+static void benchConvert()
+{
+    std::vector<CpuISA> vISAs = runnableISAs();
+    CpuISA eISA = cpuSelectedISA();
+    bool bOk = true;
+
+    printf("convert: NV12 <-> ARGB, every colour space against scalar at");
+    for (size_t i = 0; i < sizeof(s_aCheckSizes) / sizeof(s_aCheckSizes[0]); i++)
+    {
+        printf(" %ux%u", s_aCheckSizes[i][0], s_aCheckSizes[i][1]);
+    }
+    printf("\n");
+
+    for (size_t i = 0; i < sizeof(s_aCheckSizes) / sizeof(s_aCheckSizes[0]); i++)
+    {
+        uint32 width = s_aCheckSizes[i][0], height = s_aCheckSizes[i][1];
+        BenchFrames oFrames(width, height);
+
+        // every RGB value rather than only those NV12 maps to
+        for (size_t k = 0; k < oFrames.vARGB.size(); k++)
+        {
+            oFrames.vARGB[k] = (uint32)(k * 2654435761u) | 0xFF000000;
+        }
+
+        for (uint32 c = 0; c < NV_COLOR_MATRIX_COUNT * NV_COLOR_RANGE_COUNT; c++)
+        {
+            NvColorSpace oColorSpace = { (NvColorMatrix)(c / NV_COLOR_RANGE_COUNT), (NvColorRange)(c % NV_COLOR_RANGE_COUNT) };
+            std::vector<uint32> vScalarARGB;
+            std::vector<uint8> vScalarNV12;
+
+            for (size_t k = 0; k < vISAs.size(); k++)
+            {
+                std::vector<uint32> vZero((size_t)width * height, 0), vFill((size_t)width * height, 0xDEADBEEF);
+                std::vector<uint8> vZeroNV12(oFrames.vNV12.size(), 0), vFillNV12(oFrames.vNV12.size(), 0xEF);
+
+                cpuSelectISA(vISAs[k]);
+                cpuNV12toARGB(&oFrames.vNV12[0], oFrames.nYUVPitch, &vZero[0], width * 4, width, height, oColorSpace);
+                cpuNV12toARGB(&oFrames.vNV12[0], oFrames.nYUVPitch, &vFill[0], width * 4, width, height, oColorSpace);
+                cpuARGBtoNV12(&oFrames.vARGB[0], oFrames.nARGBPitch, &vZeroNV12[0], oFrames.nYUVPitch, width, height, oColorSpace);
+                cpuARGBtoNV12(&oFrames.vARGB[0], oFrames.nARGBPitch, &vFillNV12[0], oFrames.nYUVPitch, width, height, oColorSpace);
+
+                if (vZero != vFill)
+                {
+                    printf("  NV12 -> ARGB %ux%u %s %s: PIXELS LEFT UNWRITTEN\n", width, height, nvColorSpaceName(oColorSpace), cpuISAName(vISAs[k]));
+                    bOk = false;
+                }
+                if (!sameNV12(vZeroNV12, vFillNV12, oFrames.nYUVPitch, width, height))
+                {
+                    printf("  ARGB -> NV12 %ux%u %s %s: PIXELS LEFT UNWRITTEN\n", width, height, nvColorSpaceName(oColorSpace), cpuISAName(vISAs[k]));
+                    bOk = false;
+                }
+                if (k == 0)
+                {
+                    vScalarARGB = vZero;
+                    vScalarNV12 = vZeroNV12;
+                    continue;
+                }
+                if (vZero != vScalarARGB)
+                {
+                    printf("  NV12 -> ARGB %ux%u %s %s: OUTPUT DIFFERS from scalar\n", width, height, nvColorSpaceName(oColorSpace), cpuISAName(vISAs[k]));
+                    bOk = false;
+                }
+                if (!sameNV12(vZeroNV12, vScalarNV12, oFrames.nYUVPitch, width, height))
+                {
+                    printf("  ARGB -> NV12 %ux%u %s %s: OUTPUT DIFFERS from scalar\n", width, height, nvColorSpaceName(oColorSpace), cpuISAName(vISAs[k]));
+                    bOk = false;
+                }
+            }
+        }
+    }
+
+    for (int bToNV12 = 0; bToNV12 < 2; bToNV12++)
+    {
+        NvColorSpace oColorSpace = { bToNV12 ? NV_COLOR_MATRIX_BT601 : NV_COLOR_MATRIX_BT709, NV_COLOR_RANGE_LIMITED };
+
+        printf("%s, %s, Mpixel/s on 1 thread\n", bToNV12 ? "ARGB -> NV12" : "NV12 -> ARGB", nvColorSpaceName(oColorSpace));
+        printf("%-10s", "size");
+        if (bToNV12)
+        {
+            printf(" %9s", "old float");
+        }
+        for (size_t k = 0; k < vISAs.size(); k++)
+        {
+            printf(" %9s", cpuISAName(vISAs[k]));
+        }
+        printf("\n");
+
+        for (size_t i = 0; i < sizeof(s_aBenchSizes) / sizeof(s_aBenchSizes[0]); i++)
+        {
+            uint32 width = s_aBenchSizes[i][0], height = s_aBenchSizes[i][1];
+            BenchFrames oFrames(width, height);
+            double fMPix = width * (double)height / 1e6;
+            char szSize[32];
+
+            cpuNV12toARGB(&oFrames.vNV12[0], oFrames.nYUVPitch, &oFrames.vARGB[0], oFrames.nARGBPitch, width, height, oColorSpace);
+
+            snprintf(szSize, sizeof(szSize), "%ux%u", width, height);
+            printf("%-10s", szSize);
+            if (bToNV12)
+            {
+                double fMs = timeBest([&] { oldARGBtoNV12(&oFrames.vARGB[0], oFrames.nARGBPitch, &oFrames.vNV12Out[0], oFrames.nYUVPitch,
+                                                          width, height); });
+                printf(" %9.0f", fMPix / fMs * 1000.0);
+            }
+            for (size_t k = 0; k < vISAs.size(); k++)
+            {
+                cpuSelectISA(vISAs[k]);
+                double fMs = bToNV12 ?
+                    timeBest([&] { cpuARGBtoNV12(&oFrames.vARGB[0], oFrames.nARGBPitch, &oFrames.vNV12Out[0], oFrames.nYUVPitch,
+                                                 width, height, oColorSpace); }) :
+                    timeBest([&] { cpuNV12toARGB(&oFrames.vNV12[0], oFrames.nYUVPitch, &oFrames.vARGB[0], oFrames.nARGBPitch,
+                                                 width, height, oColorSpace); });
+                printf(" %9.0f", fMPix / fMs * 1000.0);
+            }
+            printf("\n");
+        }
+    }
+
+    cpuSelectISA(eISA);
+    printf("convert: %s\n", bOk ? "all checks passed" : "CHECKS FAILED");
+}
+
+// The formulas NvColorMatrixQ13 rounds to Q13, in double and clamped to
+// the sample range, as the reference for -bench matrix.
+template <class CM>
+static void exactYUV2RGB(double luma, double chromaCb, double chromaCr, double *pRGB)
+{
+    double y = (luma - CM::YOffset) * CM::RGBMax / CM::YRange;
+    double u = (chromaCb - CM::CMid) * CM::RGBMax / CM::CRange;
+    double v = (chromaCr - CM::CMid) * CM::RGBMax / CM::CRange;
+    double fMax = CM::RGBMax;
+
+    pRGB[0] = y + 2.0 * (1.0 - CM::Kr) * v;
+    pRGB[1] = y - 2.0 * (1.0 - CM::Kb) * CM::Kb / CM::Kg * u - 2.0 * (1.0 - CM::Kr) * CM::Kr / CM::Kg * v;
+    pRGB[2] = y + 2.0 * (1.0 - CM::Kb) * u;
+    for (int i = 0; i < 3; i++)
+    {
+        pRGB[i] = std::min(std::max(pRGB[i], 0.0), fMax);
+    }
+}
+
+template <class CM>
+static void exactRGB2YUV(double r, double g, double b, double *pYUV)
+{
+    double l = CM::Kr * r + CM::Kg * g + CM::Kb * b;
+    double fMax = CM::RGBMax;
+
+    pYUV[0] = CM::YOffset + l * CM::YRange / CM::RGBMax;
+    pYUV[1] = CM::CMid + (b - l) / (2.0 * (1.0 - CM::Kb)) * CM::CRange / CM::RGBMax;
+    pYUV[2] = CM::CMid + (r - l) / (2.0 * (1.0 - CM::Kr)) * CM::CRange / CM::RGBMax;
+    for (int i = 0; i < 3; i++)
+    {
+        pYUV[i] = std::min(std::max(pYUV[i], 0.0), fMax);
+    }
+}
+
+struct MatrixError
+{
+    double             fToRGB;      // max |Q13 - exact| over R, G and B
+    double             fToY;
+    double             fToCbCr;
+    unsigned long long nMisses;     // results other than the nearest code
+    unsigned long long nResults;
+};
+
+static void addError(MatrixError *pError, int nQ13, double fExact, double *pMax)
+{
+    double fError = fabs(nQ13 - fExact);
+
+    *pMax = std::max(*pMax, fError);
+    pError->nMisses  += (fError > 0.5);
+    pError->nResults += 1;
+}
+
+// Every sample value at 8 bits, every nStep-th (and Max) beyond, through
+// the Q13 expressions the kernels use against the double formulas. Chroma
+// is checked on uniform quads, whose sums are 4 * R, G, B.
+template <class CM>
+static MatrixError matrixError(int nStep)
+{
+    MatrixError oError = { 0.0, 0.0, 0.0, 0, 0 };
+    std::vector<int> vValues;
+    int nMax = CM::Max;
+
+    for (int v = 0; v < nMax; v += nStep)
+    {
+        vValues.push_back(v);
+    }
+    vValues.push_back(nMax);
+
+    for (size_t i = 0; i < vValues.size(); i++)
+    {
+        for (size_t j = 0; j < vValues.size(); j++)
+        {
+            for (size_t k = 0; k < vValues.size(); k++)
+            {
+                int a = vValues[i], b = vValues[j], c = vValues[k];
+                int r, g, bl, chromaCb, chromaCr;
+                double aExact[3];
+
+                nvYUV2RGB<CM>(a, b, c, r, g, bl);
+                exactYUV2RGB<CM>(a, b, c, aExact);
+                addError(&oError, r,  aExact[0], &oError.fToRGB);
+                addError(&oError, g,  aExact[1], &oError.fToRGB);
+                addError(&oError, bl, aExact[2], &oError.fToRGB);
+
+                nvRGB2UV<CM>(4 * a, 4 * b, 4 * c, chromaCb, chromaCr);
+                exactRGB2YUV<CM>(a, b, c, aExact);
+                addError(&oError, (int)nvRGB2Y<CM>(a, b, c), aExact[0], &oError.fToY);
+                addError(&oError, chromaCb, aExact[1], &oError.fToCbCr);
+                addError(&oError, chromaCr, aExact[2], &oError.fToCbCr);
+            }
+        }
+    }
+    return oError;
+}
+
+// YCbCr -> RGB in float with the same coefficients before Q13 rounding,
+// the alternative to the integer path that -bench matrix times.
+template <class CM>
+static inline uint32 floatYUV2ARGB(int luma, int chromaCb, int chromaCr)
+{
+    const float fY  = (float)(CM::RGBMax / CM::YRange);
+    const float fRV = (float)(2.0 * (1.0 - CM::Kr) * CM::RGBMax / CM::CRange);
+    const float fGU = (float)(-2.0 * (1.0 - CM::Kb) * CM::Kb / CM::Kg * CM::RGBMax / CM::CRange);
+    const float fGV = (float)(-2.0 * (1.0 - CM::Kr) * CM::Kr / CM::Kg * CM::RGBMax / CM::CRange);
+    const float fBU = (float)(2.0 * (1.0 - CM::Kb) * CM::RGBMax / CM::CRange);
+
+    float y = (luma - CM::YOffset) * fY + 0.5f;
+    float u = (float)(chromaCb - CM::CMid);
+    float v = (float)(chromaCr - CM::CMid);
+
+    int r = nvClamp((int)(y + fRV * v), CM::Max);
+    int g = nvClamp((int)(y + fGU * u + fGV * v), CM::Max);
+    int b = nvClamp((int)(y + fBU * u), CM::Max);
+
+    return (uint32)b | ((uint32)g << 8) | ((uint32)r << 16) | 0xff000000u;
+}
+
+// Q13 and float YCbCr -> ARGB on 4:4:4 planes, one thread, Mpixel/s
+template <class CM>
+static void matrixSpeed(uint32 width, uint32 height, double *pQ13, double *pFloat)
+{
+    size_t nPixels = (size_t)width * height;
+    std::vector<uint8> vYUV(nPixels * 3);
+    std::vector<uint32> vARGB(nPixels);
+    const uint8 *pY = &vYUV[0], *pU = pY + nPixels, *pV = pU + nPixels;
+    uint32 *pARGB = &vARGB[0];
+
+    for (size_t i = 0; i < vYUV.size(); i++)
+    {
+        vYUV[i] = (uint8)(i * 2654435761u >> 13);
+    }
+
+    double fMs = timeBest([&] {
+        for (size_t i = 0; i < nPixels; i++)
+            pARGB[i] = nvYUV2ARGB<CM>(pY[i], pU[i], pV[i]);
+    });
+    *pQ13 = nPixels / fMs / 1000.0;
+
+    fMs = timeBest([&] {
+        for (size_t i = 0; i < nPixels; i++)
+            pARGB[i] = floatYUV2ARGB<CM>(pY[i], pU[i], pV[i]);
+    });
+    *pFloat = nPixels / fMs / 1000.0;
+}
+
+// The Q13 matrices of NvColorMatrix.h per colour space and bit depth: max
+// error in output codes against the double-precision formulas, and the
+// share of results that aren't the nearest code; then the integer and a
+// float YCbCr -> ARGB side by side, both compiled for the baseline ISA.
+static void benchMatrix(uint32 width, uint32 height)
+{
+    bool bOk = true;
+
+    printf("matrix: Q13 against the double-precision formulas, max |error| in output codes\n");
+    printf("%-12s %4s %11s %7s %10s %12s\n", "space", "bits", "YCbCr->RGB", "RGB->Y", "RGB->CbCr", "not nearest");
+
+#define NV_BENCH_MATRIX_ERROR(name, matrix, range)                                                  \
+    for (int nBits = 8; nBits <= 10; nBits += 2)                                                    \
+    {                                                                                               \
+        MatrixError oError = (nBits == 8) ? matrixError<NvColorMatrixQ13<matrix, range, 8> >(1) :   \
+                                            matrixError<NvColorMatrixQ13<matrix, range, 10> >(5);   \
+        double fWorst = std::max(oError.fToRGB, std::max(oError.fToY, oError.fToCbCr));             \
+        printf("%-12s %4d %11.3f %7.3f %10.3f %11.3f%%%s\n", #name, nBits,                         \
+               oError.fToRGB, oError.fToY, oError.fToCbCr, 100.0 * oError.nMisses / oError.nResults, \
+               fWorst < 1.0 ? "" : "  OFF BY A CODE OR MORE");                                     \
+        bOk = bOk && fWorst < 1.0;                                                                  \
+    }
+    NV_FOR_EACH_COLOR_SPACE(NV_BENCH_MATRIX_ERROR)
+#undef NV_BENCH_MATRIX_ERROR
+
+    printf("YCbCr 4:4:4 -> ARGB at %ux%u, 8 bits, one thread, Mpixel/s\n", width, height);
+    printf("%-12s %8s %8s\n", "space", "Q13", "float");
+
+#define NV_BENCH_MATRIX_SPEED(name, matrix, range)                                                  \
+    {                                                                                               \
+        double fQ13, fFloat;                                                                        \
+        matrixSpeed<NvColorMatrixQ13<matrix, range> >(width, height, &fQ13, &fFloat);               \
+        printf("%-12s %8.0f %8.0f\n", #name, fQ13, fFloat);                                         \
+    }
+    NV_FOR_EACH_COLOR_SPACE(NV_BENCH_MATRIX_SPEED)
+#undef NV_BENCH_MATRIX_SPEED
+
+    printf("matrix: %s\n", bOk ? "all within one code" : "CHECKS FAILED");
+}
+
+// 0..255 and back down, one code per step
+static uint32 triangle(uint32 v)
+{
+    v %= 510;
+    return v < 256 ? v : 509 - v;
+}
+
+// Smooth ARGB test card for round trips: ramps of at most one code per
+// pixel in R, G and B, so subsampled chroma loses little at any size and
+// every format should come back within a few codes.
+static void gradientARGB(std::vector<uint32> &vARGB, uint32 width, uint32 height)
+{
+    vARGB.resize((size_t)width * height);
+    for (uint32 y = 0; y < height; y++)
+    {
+        for (uint32 x = 0; x < width; x++)
+        {
+            vARGB[(size_t)y * width + x] = 0xff000000u | (triangle(x) << 16) | (triangle(y + 128) << 8) | triangle((x + y) / 2 + 64);
+        }
+    }
+}
+
+// largest difference of R, G or B between two ARGB frames
+static int maxChannelDiff(const std::vector<uint32> &vA, const std::vector<uint32> &vB)
+{
+    int nMax = 0;
+    for (size_t i = 0; i < vA.size(); i++)
+    {
+        for (int nShift = 0; nShift < 24; nShift += 8)
+        {
+            nMax = std::max(nMax, abs((int)((vA[i] >> nShift) & 0xff) - (int)((vB[i] >> nShift) & 0xff)));
+        }
+    }
+    return nMax;
+}
+
+// cpuARGBtoYUV and cpuYUVtoARGB for every pixel format. On a gradient at
+// the given size, 643x361 and 33x7 (one less in width for YUY2), each ISA
+// must match scalar in both directions, and ARGB -> format -> ARGB must
+// come back within a few codes and identical across formats that share a
+// chroma layout: NV12, I420 and YV12, then NV16 and YUY2. Then Mpixel/s per
+// format and direction, scalar and the selected ISA, one thread.
+static void benchFormats(uint32 width, uint32 height)
+{
+    static const int nMaxRoundTrip = 4;
+    const uint32 aSizes[][2] = { { width, height }, { 643, 361 }, { 33, 7 } };
+    std::vector<CpuISA> vISAs = runnableISAs();
+    CpuISA eISA = cpuSelectedISA();
+    NvColorSpace oColorSpace = { NV_COLOR_MATRIX_BT709, NV_COLOR_RANGE_LIMITED };
+    bool bOk = true;
+
+    printf("formats: round trip and ISAs against scalar, %s, max |ARGB error| per size\n", nvColorSpaceName(oColorSpace));
+    printf("%-8s", "format");
+    for (size_t i = 0; i < sizeof(aSizes) / sizeof(aSizes[0]); i++)
+    {
+        char szSize[32];
+        snprintf(szSize, sizeof(szSize), "%ux%u", aSizes[i][0], aSizes[i][1]);
+        printf(" %10s", szSize);
+    }
+    printf("\n");
+
+    std::vector<std::vector<uint32> > vRoundTrip420(sizeof(aSizes) / sizeof(aSizes[0])), vRoundTrip422(vRoundTrip420.size());
+
+    for (int f = 0; f < NV_PIXEL_FORMAT_COUNT; f++)
+    {
+        NvPixelFormat eFormat = (NvPixelFormat)f;
+        std::string sErrors;
+
+        printf("%-8s", nvPixelFormatName(eFormat));
+        for (size_t i = 0; i < sizeof(aSizes) / sizeof(aSizes[0]); i++)
+        {
+            uint32 w = (eFormat == NV_PIXEL_FORMAT_YUY2) ? aSizes[i][0] & ~1 : aSizes[i][0], h = aSizes[i][1];
+            size_t nPitch = (nvPixelFormatMinPitch(eFormat, w) + 255) & ~255;
+            std::vector<uint32> vSource, vScalarARGB;
+            std::vector<uint8> vScalarYUV;
+
+            gradientARGB(vSource, w, h);
+            for (size_t k = 0; k < vISAs.size(); k++)
+            {
+                std::vector<uint8> vYUV(nvPixelFormatFrameBytes(eFormat, nPitch, h), 0);
+                std::vector<uint32> vARGB(vSource.size(), 0);
+
+                cpuSelectISA(vISAs[k]);
+                cpuARGBtoYUV(eFormat, &vSource[0], w * 4, &vYUV[0], nPitch, w, h, oColorSpace);
+                cpuYUVtoARGB(eFormat, &vYUV[0], nPitch, &vARGB[0], w * 4, w, h, oColorSpace);
+
+                if (k == 0)
+                {
+                    vScalarYUV  = vYUV;
+                    vScalarARGB = vARGB;
+                }
+                else if (vYUV != vScalarYUV || vARGB != vScalarARGB)
+                {
+                    sErrors += std::string(" ") + cpuISAName(vISAs[k]) + " OUTPUT DIFFERS from scalar;";
+                }
+            }
+
+            int nError = maxChannelDiff(vSource, vScalarARGB);
+            printf(" %10d", nError);
+            if (nError > nMaxRoundTrip)
+            {
+                sErrors += " ROUND TRIP OFF;";
+            }
+
+            // same chroma layout, same pixels: only the sizes all of them take
+            if (eFormat == NV_PIXEL_FORMAT_NV12 || eFormat == NV_PIXEL_FORMAT_NV16 ||
+                (aSizes[i][0] & 1) == 0)
+            {
+                bool bShares420 = eFormat == NV_PIXEL_FORMAT_NV12 || eFormat == NV_PIXEL_FORMAT_I420 || eFormat == NV_PIXEL_FORMAT_YV12;
+                bool bShares422 = eFormat == NV_PIXEL_FORMAT_NV16 || eFormat == NV_PIXEL_FORMAT_YUY2;
+                std::vector<uint32> *pFirst = bShares420 ? &vRoundTrip420[i] : (bShares422 ? &vRoundTrip422[i] : NULL);
+
+                if (pFirst && pFirst->empty())
+                {
+                    *pFirst = vScalarARGB;
+                }
+                else if (pFirst && *pFirst != vScalarARGB)
+                {
+                    sErrors += std::string(" DIFFERS FROM ") + (bShares420 ? "NV12" : "NV16") + ";";
+                }
+            }
+        }
+        printf("%s\n", sErrors.c_str());
+        bOk = bOk && sErrors.empty();
+    }
+
+    printf("Mpixel/s at %ux%u, one thread\n", width, height);
+    printf("%-8s %9s %-7s %9s %-7s\n", "format", "to ARGB", "", "from", "ARGB");
+    printf("%-8s %9s %7s %9s %7s\n", "", cpuISAName(CPU_ISA_SCALAR), cpuISAName(eISA), cpuISAName(CPU_ISA_SCALAR), cpuISAName(eISA));
+
+    for (int f = 0; f < NV_PIXEL_FORMAT_COUNT; f++)
+    {
+        NvPixelFormat eFormat = (NvPixelFormat)f;
+        uint32 w = (eFormat == NV_PIXEL_FORMAT_YUY2) ? width & ~1 : width;
+        size_t nPitch = (nvPixelFormatMinPitch(eFormat, w) + 255) & ~255;
+        std::vector<uint8> vYUV(nvPixelFormatFrameBytes(eFormat, nPitch, height));
+        std::vector<uint32> vARGB;
+        double fMPix = w * (double)height / 1e6, aMPixPerS[4];
+
+        gradientARGB(vARGB, w, height);
+        for (int k = 0; k < 4; k++)
+        {
+            cpuSelectISA((k & 1) ? eISA : CPU_ISA_SCALAR);
+            double fMs = (k < 2) ?
+                timeBest([&] { cpuYUVtoARGB(eFormat, &vYUV[0], nPitch, &vARGB[0], w * 4, w, height, oColorSpace); }) :
+                timeBest([&] { cpuARGBtoYUV(eFormat, &vARGB[0], w * 4, &vYUV[0], nPitch, w, height, oColorSpace); });
+            aMPixPerS[k] = fMPix / fMs * 1000.0;
+        }
+        printf("%-8s %9.0f %7.0f %9.0f %7.0f\n", nvPixelFormatName(eFormat), aMPixPerS[0], aMPixPerS[1], aMPixPerS[2], aMPixPerS[3]);
+    }
+
+    cpuSelectISA(eISA);
+    printf("formats: %s\n", bOk ? "all checks passed" : "CHECKS FAILED");
+}
+
+// Host allocator that counts its calls, so -bench pool can tell reuse
+// from reallocation.
+class CNvCountingFrameAllocator : public CNvHostFrameAllocator
+{
+public:
+    CNvCountingFrameAllocator(): m_nAllocs(0), m_nFrees(0)
+    {
+    }
+    virtual void *Allocate(size_t nBytes, size_t nAlign)
+    {
+        m_nAllocs++;
+        return CNvHostFrameAllocator::Allocate(nBytes, nAlign);
+    }
+    virtual void Free(void *pData)
+    {
+        m_nFrees++;
+        CNvHostFrameAllocator::Free(pData);
+    }
+
+    std::atomic<unsigned int> m_nAllocs;
+    std::atomic<unsigned int> m_nFrees;
+};
+
+// a byte on every page, so fresh memory pays its page faults
+static void touchPages(void *pData, size_t nBytes, unsigned int nValue)
+{
+    for (size_t i = 0; i < nBytes; i += 4096)
+    {
+        ((volatile uint8 *)pData)[i] = (uint8)nValue;
+    }
+}
+
+// CNvFramePool on host memory at the given size, NV12 frames. The checks:
+// a frame goes back to the pool only when its last reference is dropped;
+// frames are reused, so acquiring and releasing never allocates past the
+// high water mark; with nMaxFrames held TryAcquire() fails and Acquire()
+// blocks until another thread drops one, then gets that frame, or a new
+// one when Trim() freed the dropped frame first; two threads
+// trading frames leave nothing in use. Then Acquire and release per second
+// against malloc and free of the same size.
+static void benchPool(uint32 width, uint32 height)
+{
+    const unsigned int nMaxFrames = 4;
+    const unsigned int nCycles = 100000;
+    const unsigned int nTimedCycles = 10000;
+    NvFramePoolConfig oConfig = { NV_FRAME_FORMAT_NV12, width, height, 0, nMaxFrames, 1 };
+    bool bOk = true;
+
+    {
+        CNvCountingFrameAllocator oAllocator;
+        CNvFramePool oPool;
+        NvFramePoolStats oStats;
+        oPool.Initialize(oConfig, &oAllocator);
+
+        CNvFrameRef oFrame = oPool.Acquire();
+        void *pData = oFrame.Data();
+        CNvFrameRef oCopy = oFrame;
+        int nShared = oCopy.RefCount();
+        oFrame.Reset();
+        oPool.GetStats(&oStats);
+        bool bHeld = oStats.nInUse == 1 && oCopy.Data() == pData && oCopy.RefCount() == 1;
+        oCopy.Reset();
+        oPool.GetStats(&oStats);
+
+        bool bPassed = nShared == 2 && bHeld && oStats.nInUse == 0;
+        printf("pool: %s %ux%u, %zu bytes a frame, at most %u frames\n", nvFrameFormatName(oConfig.eFormat), width, height,
+               oPool.FrameBytes(), nMaxFrames);
+        printf("  refcount            %d references, held after the first drop, free after the last: %s\n", nShared,
+               bPassed ? "ok" : "FAILED");
+        bOk = bOk && bPassed;
+    }
+
+    {
+        CNvCountingFrameAllocator oAllocator;
+        CNvFramePool oPool;
+        NvFramePoolStats oStats;
+        oPool.Initialize(oConfig, &oAllocator);
+
+        // hold 1, 2 and 3 frames in turn, releasing all of them each cycle
+        for (unsigned int i = 0; i < nCycles; i++)
+        {
+            CNvFrameRef aFrames[3];
+            for (unsigned int j = 0; j <= i % 3; j++)
+            {
+                aFrames[j] = oPool.Acquire();
+            }
+        }
+        oPool.GetStats(&oStats);
+
+        bool bPassed = oAllocator.m_nAllocs.load() == 3 && oStats.nAllocated == 3 && oStats.nHighWater == 3 && oStats.nInUse == 0;
+        printf("  reuse               %llu acquires, %u allocations for a high water mark of %u: %s\n", oStats.nAcquires,
+               oAllocator.m_nAllocs.load(), oStats.nHighWater, bPassed ? "ok" : "FAILED");
+        bOk = bOk && bPassed;
+
+        oPool.Trim();
+        oPool.GetStats(&oStats);
+        bPassed = oAllocator.m_nFrees.load() == 3 && oStats.nAllocated == 0;
+        printf("  trim                %u frames freed: %s\n", oAllocator.m_nFrees.load(), bPassed ? "ok" : "FAILED");
+        bOk = bOk && bPassed;
+    }
+
+    {
+        CNvCountingFrameAllocator oAllocator;
+        CNvFramePool oPool;
+        NvFramePoolStats oStats;
+        oPool.Initialize(oConfig, &oAllocator);
+
+        std::vector<CNvFrameRef> vHeld;
+        for (unsigned int i = 0; i < nMaxFrames; i++)
+        {
+            vHeld.push_back(oPool.Acquire());
+        }
+        bool bRefused = oPool.TryAcquire().IsNull();
+
+        std::atomic<bool> bAcquired(false);
+        void *pGot = NULL;
+        std::thread oWaiter([&]
+        {
+            CNvFrameRef oFrame = oPool.Acquire();
+            pGot = oFrame.Data();
+            bAcquired.store(true);
+        });
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        bool bBlocked = !bAcquired.load();
+        void *pReleased = vHeld.back().Data();
+        vHeld.pop_back();
+        oWaiter.join();
+        vHeld.clear();
+        oPool.GetStats(&oStats);
+
+        bool bPassed = bRefused && bBlocked && pGot == pReleased && oStats.nAcquireWaits == 1 &&
+                       oAllocator.m_nAllocs.load() == nMaxFrames;
+        printf("  exhaustion          TryAcquire %s, Acquire %s, woken with the released frame %s after %llu us: %s\n",
+               bRefused ? "refused" : "NOT REFUSED", bBlocked ? "blocked" : "DID NOT BLOCK", pGot == pReleased ? "yes" : "NO",
+               oStats.nAcquireWaitUs, bPassed ? "ok" : "FAILED");
+        bOk = bOk && bPassed;
+    }
+
+    {
+        CNvCountingFrameAllocator oAllocator;
+        CNvFramePool oPool;
+        oPool.Initialize(oConfig, &oAllocator);
+
+        std::vector<CNvFrameRef> vHeld;
+        for (unsigned int i = 0; i < nMaxFrames; i++)
+        {
+            vHeld.push_back(oPool.Acquire());
+        }
+
+        std::atomic<bool> bAcquired(false);
+        std::thread oWaiter([&]
+        {
+            CNvFrameRef oFrame = oPool.Acquire();
+            bAcquired.store(!oFrame.IsNull());
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+        // a frame comes back and Trim() frees it before the waiter runs: the
+        // waiter has to allocate a new one rather than wait for another
+        vHeld.pop_back();
+        oPool.Trim();
+        for (int i = 0; i < 100 && !bAcquired.load(); i++)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        bool bWoken = bAcquired.load();
+        vHeld.clear();      // lets a waiter that missed the wake-up finish
+        oWaiter.join();
+
+        printf("  trim at the limit   waiter %s: %s\n", bWoken ? "allocated a new frame" : "STILL BLOCKED",
+               bWoken ? "ok" : "FAILED");
+        bOk = bOk && bWoken;
+    }
+
+    {
+        CNvCountingFrameAllocator oAllocator;
+        CNvFramePool oPool;
+        NvFramePoolStats oStats;
+        oPool.Initialize(oConfig, &oAllocator);
+
+        // the producer acquires, the consumer drops the last reference
+        std::mutex oMutex;
+        std::deque<CNvFrameRef> oHandoff;
+        std::atomic<bool> bDone(false);
+        std::thread oConsumer([&]
+        {
+            for (;;)
+            {
+                CNvFrameRef oFrame;
+                {
+                    std::lock_guard<std::mutex> lock(oMutex);
+                    if (!oHandoff.empty())
+                    {
+                        oFrame = oHandoff.front();
+                        oHandoff.pop_front();
+                    }
+                }
+                if (oFrame.IsNull())
+                {
+                    if (bDone.load())
+                        break;
+                    std::this_thread::yield();
+                }
+            }
+        });
+        for (unsigned int i = 0; i < nCycles; i++)
+        {
+            CNvFrameRef oFrame = oPool.Acquire();
+            std::lock_guard<std::mutex> lock(oMutex);
+            oHandoff.push_back(oFrame);
+        }
+        bDone.store(true);
+        oConsumer.join();
+        oPool.GetStats(&oStats);
+
+        bool bPassed = oStats.nInUse == 0 && oStats.nAllocated <= nMaxFrames && oAllocator.m_nAllocs.load() == oStats.nAllocated;
+        printf("  two threads         %u frames handed over, %u allocated, %llu waits: %s\n", nCycles, oStats.nAllocated,
+               oStats.nAcquireWaits, bPassed ? "ok" : "FAILED");
+        bOk = bOk && bPassed;
+    }
+
+    {
+        CNvHostFrameAllocator oAllocator;
+        CNvFramePool oPool;
+        oPool.Initialize(oConfig, &oAllocator);
+
+        double fPoolMs = timeBest([&]
+        {
+            for (unsigned int i = 0; i < nTimedCycles; i++)
+            {
+                CNvFrameRef oFrame = oPool.Acquire();
+                touchPages(oFrame.Data(), oPool.FrameBytes(), i);
+            }
+        });
+        double fMallocMs = timeBest([&]
+        {
+            for (unsigned int i = 0; i < nTimedCycles; i++)
+            {
+                void *pData = oAllocator.Allocate(oPool.FrameBytes(), NV_FRAME_POOL_PITCH_ALIGN);
+                touchPages(pData, oPool.FrameBytes(), i);
+                oAllocator.Free(pData);
+            }
+        });
+        printf("  acquire + release   %8.0f k/s, posix_memalign + free %.0f k/s (a byte written per page)\n",
+               nTimedCycles / fPoolMs, nTimedCycles / fMallocMs);
+    }
+
+    printf("pool: %s\n", bOk ? "all checks passed" : "CHECKS FAILED");
+}
+
+// Frame sizes of a bitstream for -bench writer: 1 to 64 KB, from a fixed
+// sequence so every run writes the same bytes.
+static std::vector<size_t> bitstreamFrameSizes(size_t nTotalBytes)
+{
+    std::vector<size_t> vSizes;
+    unsigned int uSeed = 1;
+
+    for (size_t nSum = 0; nSum < nTotalBytes; )
+    {
+        uSeed = uSeed * 1103515245u + 12345u;
+        size_t nBytes = std::min((size_t)1024 + (uSeed >> 8) % (63 * 1024), nTotalBytes - nSum);
+        vSizes.push_back(nBytes);
+        nSum += nBytes;
+    }
+    return vSizes;
+}
+
+// Frame i of vSizes starts at its offset in vData; a frame that would run
+// past the end starts over at 0. Returns the offset after frame i.
+static size_t frameOffset(const std::vector<size_t> &vSizes, const std::vector<unsigned char> &vData, size_t i, size_t nOffset)
+{
+    return (nOffset + vSizes[i] > vData.size()) ? 0 : nOffset;
+}
+
+// reads back szPath frame by frame and compares it with what was written
+static bool sameFile(const char *szPath, const std::vector<size_t> &vSizes, const std::vector<unsigned char> &vData)
+{
+    std::vector<unsigned char> vFrame(64 * 1024);
+    FILE *fp = fopen(szPath, "rb");
+    bool bSame = fp != NULL;
+
+    for (size_t i = 0, nOffset = 0; bSame && i < vSizes.size(); i++)
+    {
+        nOffset = frameOffset(vSizes, vData, i, nOffset);
+        bSame = fread(&vFrame[0], 1, vSizes[i], fp) == vSizes[i] && !memcmp(&vFrame[0], &vData[nOffset], vSizes[i]);
+        nOffset += vSizes[i];
+    }
+    if (fp)
+    {
+        bSame = bSame && fgetc(fp) == EOF;
+        fclose(fp);
+    }
+    return bSame;
+}
+
+// One way of getting the frames of vSizes to a file, as the encoder thread
+// sees it: pfnWrite is called once per frame, pfnClose at the end; returns
+// the time in ms and the slowest single call in *pMaxCallMs.
+static double timeFrameWrites(const std::vector<size_t> &vSizes, const std::vector<unsigned char> &vData, double fFramesPerMs,
+                              const std::function<bool (const unsigned char *, size_t)> &pfnWrite,
+                              const std::function<bool ()> &pfnClose, double *pMaxCallMs, bool *pOk)
+{
+    std::chrono::steady_clock::time_point tStart = std::chrono::steady_clock::now();
+    size_t nOffset = 0;
+
+    *pMaxCallMs = 0.0;
+    *pOk = true;
+    for (size_t i = 0; i < vSizes.size(); i++)
+    {
+        if (fFramesPerMs > 0.0)
+        {
+            std::this_thread::sleep_until(tStart + std::chrono::microseconds((long long)(i * 1000.0 / fFramesPerMs)));
+        }
+        nOffset = frameOffset(vSizes, vData, i, nOffset);
+
+        std::chrono::steady_clock::time_point tCall = std::chrono::steady_clock::now();
+        *pOk = pfnWrite(&vData[nOffset], vSizes[i]) && *pOk;
+        *pMaxCallMs = std::max(*pMaxCallMs, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - tCall).count());
+        nOffset += vSizes[i];
+    }
+    *pOk = pfnClose() && *pOk;
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - tStart).count();
+}
+
+// write() until all of it is out, the way the writer thread resumes writev()
+static bool writeAll(int fd, const unsigned char *pData, size_t nBytes)
+{
+    while (nBytes)
+    {
+        ssize_t nWritten = write(fd, pData, nBytes);
+        if (nWritten < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        pData += nWritten;
+        nBytes -= nWritten;
+    }
+    return true;
+}
+
+// Stand-in for a slow disk: drains the FIFO szPath at nBytesPerSec, in
+// 64 KB reads, stalling nStallMs out of every second.
+static void throttledReader(const char *szPath, size_t nBytesPerSec, unsigned int nStallMs, unsigned long long *pBytes)
+{
+    std::vector<unsigned char> vBuffer(64 * 1024);
+    int fd = open(szPath, O_RDONLY);
+    std::chrono::steady_clock::time_point tStart = std::chrono::steady_clock::now();
+    unsigned long long nBytes = 0;
+
+    if (fd < 0)
+    {
+        return;
+    }
+    for (;;)
+    {
+        // no faster than the read rate, and nothing in the last nStallMs
+        // of each second
+        std::this_thread::sleep_until(tStart + std::chrono::milliseconds((long long)(nBytes * 1000.0 / nBytesPerSec)));
+        long long nNowMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - tStart).count();
+        if (nNowMs % 1000 >= 1000 - nStallMs)
+        {
+            std::this_thread::sleep_until(tStart + std::chrono::milliseconds((nNowMs / 1000 + 1) * 1000));
+        }
+
+        ssize_t nRead = read(fd, &vBuffer[0], vBuffer.size());
+        if (nRead <= 0)
+        {
+            break;
+        }
+        nBytes += nRead;
+    }
+    close(fd);
+    *pBytes = nBytes;
+}
+
+// CNvBitstreamWriter against writing each frame straight from the encoder
+// thread. On tmpfs: Mbyte/s and time per writev(), with the file read back
+// and compared. Then on a FIFO drained at 16 MB/s with 300 ms stalls every
+// second, a slow disk in miniature, with the frames paced at 8 MB/s: the
+// slowest Write() seen by the encoder thread, which the ring should keep
+// far below the stall while write() per frame waits it out.
+static void benchWriter()
+{
+    const size_t nTmpfsBytes = 256 << 20;
+    const size_t nThrottledBytes = 16 << 20;
+    const size_t nReaderBytesPerSec = 16 << 20;
+    const unsigned int nStallMs = 300;
+    const char *szDir = access("/dev/shm", W_OK) == 0 ? "/dev/shm" : "/tmp";
+    std::vector<unsigned char> vData(4 << 20);
+    char szFile[256], szFifo[256];
+    bool bOk = true;
+
+    for (size_t i = 0; i < vData.size(); i++)
+    {
+        vData[i] = (unsigned char)(i * 2654435761u >> 13);
+    }
+    std::vector<size_t> vSizes = bitstreamFrameSizes(nTmpfsBytes);
+    snprintf(szFile, sizeof(szFile), "%s/vpp-bench-writer-%d.bin", szDir, (int)getpid());
+
+    printf("writer: %zu MB in %zu frames of 1-64 KB to %s\n", nTmpfsBytes >> 20, vSizes.size(), szDir);
+    printf("  %-30s %9s %12s %s\n", "", "MB/s", "slowest call", "");
+
+    for (int nMethod = 0; nMethod < 3; nMethod++)
+    {
+        static const char *aNames[] = { "CNvBitstreamWriter (writev)", "fwrite() per frame", "write() per frame" };
+        CNvBitstreamWriter oWriter;
+        FILE *fp = NULL;
+        int fd = -1;
+        double fMaxCallMs, fMs;
+        bool bWritten;
+
+        if (nMethod == 0)
+        {
+            bWritten = oWriter.Open(szFile);
+            fMs = timeFrameWrites(vSizes, vData, 0.0,
+                                  [&](const unsigned char *p, size_t n) { return oWriter.Write(p, n); },
+                                  [&] { return oWriter.Close(); }, &fMaxCallMs, &bWritten);
+        }
+        else if (nMethod == 1)
+        {
+            fp = fopen(szFile, "wb");
+            fMs = timeFrameWrites(vSizes, vData, 0.0,
+                                  [&](const unsigned char *p, size_t n) { return fp && fwrite(p, 1, n, fp) == n; },
+                                  [&] { return fp && fclose(fp) == 0; }, &fMaxCallMs, &bWritten);
+        }
+        else
+        {
+            fd = open(szFile, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            fMs = timeFrameWrites(vSizes, vData, 0.0,
+                                  [&](const unsigned char *p, size_t n) { return fd >= 0 && writeAll(fd, p, n); },
+                                  [&] { return fd >= 0 && close(fd) == 0; }, &fMaxCallMs, &bWritten);
+        }
+
+        bool bSame = sameFile(szFile, vSizes, vData);
+        printf("  %-30s %9.0f %9.2f ms %s\n", aNames[nMethod], nTmpfsBytes / 1048576.0 / fMs * 1000.0, fMaxCallMs,
+               !bWritten ? "WRITE FAILED" : (bSame ? "" : "FILE DIFFERS"));
+        bOk = bOk && bWritten && bSame;
+
+        if (nMethod == 0)
+        {
+            NvBitstreamWriterStats oStats;
+            oWriter.GetStats(&oStats);
+            printf("  %-30s %llu writev() of %.1f MB on average, %.0f us each, %llu waits for a chunk\n", "",
+                   oStats.nWrites, oStats.nWrites ? oStats.nChunks * (double)NV_BITSTREAM_CHUNK_BYTES / oStats.nWrites / 1048576.0 : 0.0,
+                   oStats.nWrites ? oStats.nWriteUs / (double)oStats.nWrites : 0.0, oStats.nBlocked);
+        }
+    }
+    unlink(szFile);
+
+    // one writev() of a batch against one write() per chunk, same bytes
+    {
+        const unsigned int nChunks = NV_BITSTREAM_CHUNK_COUNT;
+        const unsigned int nBatches = 32;
+        std::vector<unsigned char> vChunks(NV_BITSTREAM_CHUNK_BYTES * nChunks);
+        struct iovec aIov[NV_BITSTREAM_CHUNK_COUNT];
+
+        for (unsigned int i = 0; i < nChunks; i++)
+        {
+            aIov[i].iov_base = &vChunks[i * NV_BITSTREAM_CHUNK_BYTES];
+            aIov[i].iov_len  = NV_BITSTREAM_CHUNK_BYTES;
+        }
+        for (int bWritev = 1; bWritev >= 0; bWritev--)
+        {
+            int fd = open(szFile, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            std::chrono::steady_clock::time_point tStart = std::chrono::steady_clock::now();
+            for (unsigned int n = 0; fd >= 0 && n < nBatches; n++)
+            {
+                if (bWritev)
+                {
+                    bOk = writev(fd, aIov, nChunks) == (ssize_t)vChunks.size() && bOk;
+                }
+                else
+                {
+                    for (unsigned int i = 0; i < nChunks; i++)
+                    {
+                        bOk = writeAll(fd, (const unsigned char *)aIov[i].iov_base, aIov[i].iov_len) && bOk;
+                    }
+                }
+            }
+            double fMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - tStart).count();
+            if (fd >= 0)
+            {
+                close(fd);
+            }
+            printf("  %u x 1 MB chunks, %-13s %9.0f MB/s\n", nChunks, bWritev ? "one writev()" : "8 x write()",
+                   nBatches * vChunks.size() / 1048576.0 / fMs * 1000.0);
+        }
+        unlink(szFile);
+    }
+
+    // the slow disk: a FIFO with a throttled, stalling reader
+    std::vector<size_t> vThrottledSizes = bitstreamFrameSizes(nThrottledBytes);
+    double fFramesPerMs = vThrottledSizes.size() / (nThrottledBytes / (double)(nReaderBytesPerSec / 2) * 1000.0);
+    snprintf(szFifo, sizeof(szFifo), "/tmp/vpp-bench-writer-%d.fifo", (int)getpid());
+
+    printf("writer: %zu MB at %zu MB/s into a FIFO drained at %zu MB/s, stalling %u ms a second\n",
+           nThrottledBytes >> 20, (nReaderBytesPerSec / 2) >> 20, nReaderBytesPerSec >> 20, nStallMs);
+    for (int nMethod = 0; nMethod < 2; nMethod++)
+    {
+        unsigned long long nRead = 0;
+        double fMaxCallMs = 0.0, fMs = 0.0;
+        bool bWritten = false;
+
+        if (mkfifo(szFifo, 0600) != 0)
+        {
+            printf("  cannot create %s: %s\n", szFifo, strerror(errno));
+            bOk = false;
+            break;
+        }
+        std::thread oReader(throttledReader, szFifo, nReaderBytesPerSec, nStallMs, &nRead);
+
+        if (nMethod == 0)
+        {
+            CNvBitstreamWriter oWriter;
+            bWritten = oWriter.Open(szFifo);
+            fMs = timeFrameWrites(vThrottledSizes, vData, fFramesPerMs,
+                                  [&](const unsigned char *p, size_t n) { return oWriter.Write(p, n); },
+                                  [&] { return oWriter.Close(); }, &fMaxCallMs, &bWritten);
+        }
+        else
+        {
+            int fd = open(szFifo, O_WRONLY);
+            fMs = timeFrameWrites(vThrottledSizes, vData, fFramesPerMs,
+                                  [&](const unsigned char *p, size_t n) { return fd >= 0 && writeAll(fd, p, n); },
+                                  [&] { return fd >= 0 && close(fd) == 0; }, &fMaxCallMs, &bWritten);
+        }
+        oReader.join();
+        unlink(szFifo);
+
+        bool bAll = bWritten && nRead == nThrottledBytes;
+        printf("  %-30s slowest call %7.2f ms, %.0f ms in all%s\n", nMethod ? "write() per frame" : "CNvBitstreamWriter",
+               fMaxCallMs, fMs, bAll ? "" : ", BYTES LOST");
+        bOk = bOk && bAll;
+    }
+
+    printf("writer: %s\n", bOk ? "all checks passed" : "CHECKS FAILED");
+}
+
+// Frame slot of the -bench pipeline stand-in: the buffers of one frame in
+// flight, as PipelineFrame holds them in videoDecodeMain.cpp.
+struct BenchPipelineFrame
+{
+    unsigned int        nSequence;
+    std::vector<uint32> vARGB;
+    std::vector<uint8>  vNV12;
+    std::vector<uint8>  vStaging;
+};
+
+// One run of CNvPipeline with the stages of the decode path: per stage
+// frames, busy and starved time against the wall time, and the overlap,
+// busy time of all stages over wall time (1.0 is strictly sequential).
+// Returns false if the last stage saw a frame out of order.
+static bool runBenchPipeline(const char *szCase, unsigned int nDepth, unsigned int nFrames,
+                             const std::vector<std::pair<const char *, std::function<void (BenchPipelineFrame *)> > > &vStages,
+                             uint32 width, uint32 height)
+{
+    std::vector<BenchPipelineFrame> vFrames(nDepth);
+    for (size_t i = 0; i < vFrames.size(); i++)
+    {
+        vFrames[i].vARGB.resize((size_t)width * height);
+        vFrames[i].vNV12.resize(((width + 255) & ~255) * (size_t)(height + NV_CHROMA_ROWS_420(height)));
+        vFrames[i].vStaging.resize(vFrames[i].vNV12.size());
+    }
+
+    CNvPipeline<BenchPipelineFrame> oPipeline;
+    unsigned int nExpected = 0, nOutOfOrder = 0;
+    oPipeline.Initialize(&vFrames[0], nDepth);
+    for (size_t i = 0; i < vStages.size(); i++)
+    {
+        std::function<void (BenchPipelineFrame *)> fnStage = vStages[i].second;
+        if (i + 1 == vStages.size())
+        {
+            fnStage = [&, fnStage](BenchPipelineFrame *pFrame)
+            {
+                fnStage(pFrame);
+                nOutOfOrder += (pFrame->nSequence != nExpected++);
+            };
+        }
+        oPipeline.AddStage(vStages[i].first, fnStage);
+    }
+
+    std::chrono::steady_clock::time_point tStart = std::chrono::steady_clock::now();
+    oPipeline.Start();
+    for (unsigned int i = 0; i < nFrames; i++)
+    {
+        BenchPipelineFrame *pFrame = oPipeline.Acquire();
+        pFrame->nSequence = i;
+        oPipeline.Submit(pFrame);
+    }
+    oPipeline.Stop();
+    double fWallMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - tStart).count();
+
+    double fBusyMs = 0.0;
+    printf("  %s, %u frame%s in flight: %.0f ms for %u frames, %.2f ms a frame\n", szCase, nDepth, nDepth > 1 ? "s" : "",
+           fWallMs, nFrames, fWallMs / nFrames);
+    for (unsigned int i = 0; i < oPipeline.StageCount(); i++)
+    {
+        NvPipelineStageStats oStats;
+        oPipeline.GetStageStats(i, &oStats);
+        fBusyMs += oStats.nBusyUs / 1000.0;
+        printf("    %-10s %6llu frames, busy %7.1f ms (%3.0f%% of wall), starved %7.1f ms\n", oStats.szName, oStats.nFrames,
+               oStats.nBusyUs / 1000.0, oStats.nBusyUs / 10.0 / fWallMs, oStats.nStarvedUs / 1000.0);
+    }
+    printf("    overlap    %.2fx (busy time of all stages / wall time)%s\n", fBusyMs / fWallMs,
+           (nOutOfOrder || nExpected != nFrames) ? ", FRAMES OUT OF ORDER OR LOST" : "");
+    return !nOutOfOrder && nExpected == nFrames;
+}
+
+// where the encode stand-in leaves its checksum, so the loop stays
+static volatile unsigned int s_uPipelineSink;
+
+// CNvPipeline driven by CPU stand-ins for the convert, download and encode
+// stages of videoPP, with one frame in flight (sequential) and with
+// PIPELINE_DEPTH (MAX_FRAME_COUNT). First stages that wait the way the
+// device-bound ones do, for a kernel, a copy or NVENC, and so overlap on
+// any core count; then host stages doing real work on frames of the given
+// size, which can only overlap as far as there are cores.
+static void benchPipeline(uint32 width, uint32 height)
+{
+    typedef std::vector<std::pair<const char *, std::function<void (BenchPipelineFrame *)> > > Stages;
+    NvColorSpace oColorSpace = { NV_COLOR_MATRIX_BT709, NV_COLOR_RANGE_LIMITED };
+    BenchFrames oSource(width, height);
+    bool bOk = true;
+
+    printf("pipeline: convert, download and encode stand-ins, %u hardware threads\n",
+           std::max(1u, std::thread::hardware_concurrency()));
+
+    Stages vWaiting;
+    vWaiting.push_back(std::make_pair("convert",  [](BenchPipelineFrame *) { std::this_thread::sleep_for(std::chrono::milliseconds(4)); }));
+    vWaiting.push_back(std::make_pair("download", [](BenchPipelineFrame *) { std::this_thread::sleep_for(std::chrono::milliseconds(3)); }));
+    vWaiting.push_back(std::make_pair("encode",   [](BenchPipelineFrame *) { std::this_thread::sleep_for(std::chrono::milliseconds(6)); }));
+
+    Stages vHost;
+    vHost.push_back(std::make_pair("convert", [&](BenchPipelineFrame *pFrame)
+    {
+        size_t nPitch = (width + 255) & ~255;
+        cpuNV12toARGB(&oSource.vNV12[0], oSource.nYUVPitch, &pFrame->vARGB[0], width * 4, width, height, oColorSpace);
+        cpuARGBtoNV12(&pFrame->vARGB[0], width * 4, &pFrame->vNV12[0], nPitch, width, height, oColorSpace);
+    }));
+    vHost.push_back(std::make_pair("download", [](BenchPipelineFrame *pFrame)
+    {
+        memcpy(&pFrame->vStaging[0], &pFrame->vNV12[0], pFrame->vNV12.size());
+    }));
+    vHost.push_back(std::make_pair("encode", [](BenchPipelineFrame *pFrame)
+    {
+        // reads the whole frame, as the copy into the encoder input does
+        unsigned int uSum = 0;
+        for (size_t i = 0; i < pFrame->vStaging.size(); i++)
+        {
+            uSum = uSum * 31 + pFrame->vStaging[i];
+        }
+        s_uPipelineSink = uSum;
+    }));
+
+    const unsigned int aDepths[] = { 1, MAX_FRAME_COUNT };
+    for (int i = 0; i < 2; i++)
+    {
+        bOk = runBenchPipeline("waiting 4/3/6 ms", aDepths[i], 120, vWaiting, width, height) && bOk;
+    }
+    for (int i = 0; i < 2; i++)
+    {
+        char szCase[64];
+        snprintf(szCase, sizeof(szCase), "host %ux%u", width, height);
+        bOk = runBenchPipeline(szCase, aDepths[i], 60, vHost, width, height) && bOk;
+    }
+
+    if (std::thread::hardware_concurrency() < vHost.size())
+    {
+        printf("  fewer cores than host stages: their busy time includes time sliced away to the others\n");
+    }
+    printf("pipeline: %s\n", bOk ? "all frames in order" : "CHECKS FAILED");
+}
+
+bool cpuRunBenchmark(const char *szName, uint32 width, uint32 height, CNvFilterGraph &oGraph)
+{
+    if (!strcmp(szName, "scaling"))
+    {
+        benchScaling(width, height, oGraph.HostPostprocess());
+        return true;
+    }
+    if (!strcmp(szName, "filters"))
+    {
+        benchFilters(width, height, oGraph);
+        return true;
+    }
+    if (!strcmp(szName, "blur"))
+    {
+        benchBlur(width, height);
+        return true;
+    }
+    if (!strcmp(szName, "unsharp"))
+    {
+        benchUnsharp(width, height);
+        return true;
+    }
+    if (!strcmp(szName, "median"))
+    {
+        benchMedian();
+        return true;
+    }
+    if (!strcmp(szName, "bilateral"))
+    {
+        benchBilateral();
+        return true;
+    }
+    if (!strcmp(szName, "convert"))
+    {
+        benchConvert();
+        return true;
+    }
+    if (!strcmp(szName, "matrix"))
+    {
+        benchMatrix(width, height);
+        return true;
+    }
+    if (!strcmp(szName, "formats"))
+    {
+        benchFormats(width, height);
+        return true;
+    }
+    if (!strcmp(szName, "pool"))
+    {
+        benchPool(width, height);
+        return true;
+    }
+    if (!strcmp(szName, "writer"))
+    {
+        benchWriter();
+        return true;
+    }
+    if (!strcmp(szName, "pipeline"))
+    {
+        benchPipeline(width, height);
+        return true;
+    }
+    if (!strcmp(szName, "queue"))
+    {
+        benchQueue();
+        return true;
+    }
+    return false;
+}
+
+const char *cpuBenchmarkNames()
+{
+    return "scaling, convert, matrix, formats, filters, blur, unsharp, median, bilateral, queue, pool, writer, pipeline";
+}
@@ -0,0 +1,55 @@
+/*
+ * Copyright 1993-2015 NVIDIA Corporation.  All rights reserved.
+ *
+ * Please refer to the NVIDIA end user license agreement (EULA) associated
+ * with this source code for terms and conditions that govern your use of
+ * this software. Any use, reproduction, disclosure, or distribution of
+ * this software and related documentation outside the terms of the EULA
+ * is strictly prohibited.
+ *
+ */
+
+#ifndef _CPUBENCHMARK_H_
+#define _CPUBENCHMARK_H_
+
+#include "cudaProcessFrame.h"
+
+class CNvFilterGraph;
+
+// Benchmarks and self-checks of the host code for -bench, on synthetic
+// frames of the given size; no decoder, encoder or GPU is involved. Results
+// go to stdout.
+//   scaling  conversions and the postprocess chain on 1..N threads
+//   convert  NV12 <-> ARGB on every ISA against scalar, odd sizes included,
+//            and Mpixel/s per ISA at 720p, 1080p and 4K, ARGB -> NV12 also
+//            for the float kernel it replaced
+//   matrix   Q13 colour matrices against the double-precision formulas per
+//            colour space and bit depth, and Q13 vs float YCbCr -> ARGB
+//   formats  every NvPixelFormat to ARGB and back: ISAs against scalar,
+//            round-trip error, formats of one chroma layout against each
+//            other, then Mpixel/s per format and direction
+//   filters  each filter of oGraph alone, then the chain fused, unfused and
+//            in strips, checking that all three give the same frame
+//   blur     box and Gaussian blurs over radii 1..64, scalar and SIMD
+//   unsharp  the unsharp mask over radii 1..32 in ms per megapixel
+//   median   3x3 and 5x5 medians, per channel and luma only, at 1080p and
+//            4K rather than the given size
+//   bilateral the Y-plane bilateral over radii 1..8 at 1080p, with the frame
+//            rate measured on every hardware thread and on eight threads
+//   queue    checks of the FrameQueue display queue on two threads, then
+//            ops/s of the SPSC ring, FrameQueue and a mutex queue
+//   pool     checks of CNvFramePool on host memory (reference counting,
+//            reuse, exhaustion, two threads), then acquires per second
+//   writer   CNvBitstreamWriter against fwrite() and write() per frame on
+//            tmpfs, file read back, writev() against write() per chunk, then
+//            the slowest call into a FIFO drained by a stalling reader
+//   pipeline CNvPipeline with CPU stand-ins for convert, download and encode,
+//            sequential and MAX_FRAME_COUNT deep: per-stage busy and starved
+//            time against wall time
+// Returns false for an unknown name.
+bool cpuRunBenchmark(const char *szName, uint32 width, uint32 height, CNvFilterGraph &oGraph);
+
+// names for the -bench help text
+const char *cpuBenchmarkNames();
+
+#endif
@@ -0,0 +1,985 @@
+/*
+ * Copyright 1993-2015 NVIDIA Corporation.  All rights reserved.
+ *
+ * Please refer to the NVIDIA end user license agreement (EULA) associated
+ * with this source code for terms and conditions that govern your use of
+ * this software. Any use, reproduction, disclosure, or distribution of
+ * this software and related documentation outside the terms of the EULA
+ * is strictly prohibited.
+ *
+ */
+
+#include "cpuProcessFrame.h"
+#include "cpuProcessFrameKernels.h"
+#include "NvTaskPool.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+const CpuKernels g_aCpuKernels_C[CPU_KERNEL_TABLE_SIZE] = CPU_KERNEL_TABLE(C);
+
+static const CpuKernels *kernelTableFor(CpuISA isa)
+{
+    switch (isa)
+    {
+        case CPU_ISA_SCALAR: return g_aCpuKernels_C;
+#if defined(__x86_64__) || defined(__i386__)
+        case CPU_ISA_SSE41:  return g_aCpuKernels_SSE41;
+        case CPU_ISA_AVX2:   return g_aCpuKernels_AVX2;
+        case CPU_ISA_AVX512: return g_aCpuKernels_AVX512;
+#endif
+#if defined(__aarch64__)
+        case CPU_ISA_NEON:   return g_aCpuKernels_NEON;
+#endif
+        default:             return NULL;
+    }
+}
+
+static const CpuKernels *kernelsFor(CpuISA isa, NvColorSpace oColorSpace)
+{
+    return &kernelTableFor(isa)[cpuColorSpaceIndex(oColorSpace)];
+}
+
+static CpuISA &currentISA()
+{
+    static CpuISA eISA = cpuDetectISA();
+    return eISA;
+}
+
+const CpuFilterKernels g_oCpuFilterKernels_C = { BoxBlurRow_C, BoxBlurColumns_C, UnsharpRow_C,
+                                                   cpuMedianRow<CpuMedianOps_C, 3>, cpuMedianRow<CpuMedianOps_C, 5>,
+                                                   ARGBLumaRow_C, ShiftLumaRow_C };
+
+const CpuFilterKernels &cpuFilterKernels()
+{
+    switch (currentISA())
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        case CPU_ISA_SSE41:  return g_oCpuFilterKernels_SSE41;
+        case CPU_ISA_AVX2:   return g_oCpuFilterKernels_AVX2;
+        case CPU_ISA_AVX512: return g_oCpuFilterKernels_AVX512;
+#endif
+#if defined(__aarch64__)
+        case CPU_ISA_NEON:   return g_oCpuFilterKernels_NEON;
+#endif
+        default:             return g_oCpuFilterKernels_C;
+    }
+}
+
+CpuISA cpuDetectISA()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    // cpuid plus the xgetbv check that the OS saves the wider registers
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw"))
+        return CPU_ISA_AVX512;
+    if (__builtin_cpu_supports("avx2"))
+        return CPU_ISA_AVX2;
+    if (__builtin_cpu_supports("sse4.1"))
+        return CPU_ISA_SSE41;
+    return CPU_ISA_SCALAR;
+#elif defined(__aarch64__)
+    // Advanced SIMD is mandatory on AArch64
+    return CPU_ISA_NEON;
+#else
+    return CPU_ISA_SCALAR;
+#endif
+}
+
+const char *cpuISAName(CpuISA isa)
+{
+    static const char *names[CPU_ISA_COUNT] = { "scalar", "SSE4.1", "AVX2", "AVX-512", "NEON" };
+    return (isa >= 0 && isa < CPU_ISA_COUNT) ? names[isa] : "unknown";
+}
+
+bool cpuSelectISA(CpuISA isa)
+{
+    // the x86 levels are ordered, so anything up to the detected one works
+    if (!kernelTableFor(isa) || isa > cpuDetectISA())
+    {
+        return false;
+    }
+
+    currentISA() = isa;
+    return true;
+}
+
+CpuISA cpuSelectedISA()
+{
+    return currentISA();
+}
+
+static CpuStripPlan &currentStripPlan()
+{
+    static CpuStripPlan oPlan = { 0, 1 };
+    return oPlan;
+}
+
+CNvTaskPool &cpuTaskPool()
+{
+    static CNvTaskPool oPool;
+    return oPool;
+}
+
+// Runs fnRows(yBegin, yEnd) over the scanlines of a frame: strip by strip on
+// the task pool under a strip plan, in one go on the caller without one.
+// Strips start on even scanlines, so every chroma row has one owner.
+template <class RowsFunc>
+static void forEachStrip(uint32 height, const RowsFunc &fnRows)
+{
+    uint32 nStripRows = currentStripPlan().nStripRows;
+
+    if (!nStripRows || nStripRows >= height)
+    {
+        fnRows(0, height);
+        return;
+    }
+
+    cpuTaskPool().ParallelFor((height + nStripRows - 1) / nStripRows, 1, [&](unsigned int uBegin, unsigned int uEnd)
+    {
+        fnRows(uBegin * nStripRows, std::min(height, uEnd * nStripRows));
+    });
+}
+
+// Converts scanline y of an NV12 (T = uint8) or P010 (T = uint16) frame;
+// pitches are in bytes for both.
+template <class T, class RowFunc>
+static inline void YUVtoARGBScanline(RowFunc pfnRow, const T *pSrc, size_t nSourcePitch,
+                                     uint32 *pDst, uint32 width, uint32 height, uint32 y)
+{
+    const uint8 *pSrcBytes = (const uint8 *)pSrc;
+    uint32 y_chroma = y >> 1;
+    const T *pChroma0 = (const T *)(pSrcBytes + nSourcePitch * height + y_chroma * nSourcePitch);
+    const T *pChroma1 = pChroma0;
+
+    // odd scanline: interpolate vertically except on the last chroma row
+    if ((y & 1) && y_chroma < ((height >> 1) - 1))
+    {
+        pChroma1 = (const T *)((const uint8 *)pChroma1 + nSourcePitch);
+    }
+
+    pfnRow((const T *)(pSrcBytes + y * nSourcePitch), pChroma0, pChroma1, pDst, width);
+}
+
+// scanlines [yBegin, yEnd) of the frame
+template <class T, class RowFunc>
+static void YUVtoARGBFrame(RowFunc pfnRow, const T *pSrc, size_t nSourcePitch,
+                           uint32 *pDstARGB, size_t nDestPitch, uint32 width, uint32 height,
+                           uint32 yBegin, uint32 yEnd)
+{
+    for (uint32 y = yBegin; y < yEnd; y++)
+    {
+        YUVtoARGBScanline(pfnRow, pSrc, nSourcePitch,
+                          (uint32 *)((uint8 *)pDstARGB + y * nDestPitch), width, height, y);
+    }
+}
+
+// Writes scanlines [yBegin, yEnd) of a frame of the given height; yBegin is
+// even and pSrcARGB points at ARGB scanline yBegin.
+template <class T, class RowFunc>
+static void ARGBtoYUVRows(RowFunc pfnRow, const uint32 *pSrcARGB, size_t nSourcePitch,
+                          T *pDst, size_t nDestPitch, uint32 width, uint32 height,
+                          uint32 yBegin, uint32 yEnd)
+{
+    const uint8 *pSrcBytes = (const uint8 *)pSrcARGB;
+    uint8 *pDstBytes = (uint8 *)pDst;
+    uint8 *pChromaPlane = pDstBytes + nDestPitch * height;
+
+    for (uint32 y = yBegin; y < yEnd; y += 2)
+    {
+        // an odd last row pairs with itself
+        uint32 y1 = (y + 1 < yEnd) ? y + 1 : y;
+
+        pfnRow((const uint32 *)(pSrcBytes + (y  - yBegin) * nSourcePitch),
+               (const uint32 *)(pSrcBytes + (y1 - yBegin) * nSourcePitch),
+               (T *)(pDstBytes + y * nDestPitch), (T *)(pDstBytes + y1 * nDestPitch),
+               (T *)(pChromaPlane + (y >> 1) * nDestPitch), width);
+    }
+}
+
+// scanlines [yBegin, yEnd) of the frame, yBegin even
+template <class T, class RowFunc>
+static void ARGBtoYUVFrame(RowFunc pfnRow, const uint32 *pSrcARGB, size_t nSourcePitch,
+                           T *pDst, size_t nDestPitch, uint32 width, uint32 height,
+                           uint32 yBegin, uint32 yEnd)
+{
+    ARGBtoYUVRows(pfnRow, (const uint32 *)((const uint8 *)pSrcARGB + yBegin * nSourcePitch), nSourcePitch,
+                  pDst, nDestPitch, width, height, yBegin, yEnd);
+}
+
+void cpuNV12toARGB(const uint8 *pSrcNV12, size_t nSourcePitch,
+                   uint32 *pDstARGB,      size_t nDestPitch,
+                   uint32 width,          uint32 height,
+                   NvColorSpace oColorSpace)
+{
+    NV12toARGBRowFunc pfnRow = kernelsFor(currentISA(), oColorSpace)->pfnNV12toARGBRow;
+
+    forEachStrip(height, [&](uint32 yBegin, uint32 yEnd)
+    {
+        YUVtoARGBFrame(pfnRow, pSrcNV12, nSourcePitch, pDstARGB, nDestPitch, width, height, yBegin, yEnd);
+    });
+}
+
+void cpuARGBtoNV12(const uint32 *pSrcARGB, size_t nSourcePitch,
+                   uint8 *pDstNV12,        size_t nDestPitch,
+                   uint32 width,           uint32 height,
+                   NvColorSpace oColorSpace)
+{
+    ARGBtoNV12RowFunc pfnRow = kernelsFor(currentISA(), oColorSpace)->pfnARGBtoNV12Row;
+
+    forEachStrip(height, [&](uint32 yBegin, uint32 yEnd)
+    {
+        ARGBtoYUVFrame(pfnRow, pSrcARGB, nSourcePitch, pDstNV12, nDestPitch, width, height, yBegin, yEnd);
+    });
+}
+
+// Chroma row helpers for the layouts the row kernels don't read directly:
+// planar Cb/Cr to and from NV12-order CbCr pairs, and YUY2 to and from a
+// luma row plus CbCr pairs (in YUY2 the odd bytes already are CbCr pairs).
+static void interleaveChromaRow(const uint8 *pCb, const uint8 *pCr, uint8 *pCbCr, uint32 nSamples)
+{
+    for (uint32 i = 0; i < nSamples; i++)
+    {
+        pCbCr[2 * i    ] = pCb[i];
+        pCbCr[2 * i + 1] = pCr[i];
+    }
+}
+
+static void deinterleaveChromaRow(const uint8 *pCbCr, uint8 *pCb, uint8 *pCr, uint32 nSamples)
+{
+    for (uint32 i = 0; i < nSamples; i++)
+    {
+        pCb[i] = pCbCr[2 * i    ];
+        pCr[i] = pCbCr[2 * i + 1];
+    }
+}
+
+static void unpackYUY2Row(const uint8 *pYUY2, uint8 *pLuma, uint8 *pCbCr, uint32 width)
+{
+    for (uint32 x = 0; x < width; x++)
+    {
+        pLuma[x] = pYUY2[2 * x    ];
+        pCbCr[x] = pYUY2[2 * x + 1];
+    }
+}
+
+static void packYUY2Row(const uint8 *pLuma, const uint8 *pCbCr, uint8 *pYUY2, uint32 width)
+{
+    for (uint32 x = 0; x < width; x++)
+    {
+        pYUY2[2 * x    ] = pLuma[x];
+        pYUY2[2 * x + 1] = pCbCr[x];
+    }
+}
+
+// Frame converters per pixel format, on the traits of NvPixelFormat.h. Each
+// format maps its scanlines onto the NV12 or 4:4:4 row kernels of the
+// selected ISA, so all of them run the SIMD inner loops; planar and packed
+// chroma goes through a scratch row of CbCr pairs first, which costs one
+// pass over the chroma bytes. The plane offsets are compile-time per format.
+template <NvPixelFormat F> struct CpuFormatFrame;
+
+template <> struct CpuFormatFrame<NV_PIXEL_FORMAT_NV12>
+{
+    static void toARGB(const CpuKernels *pKernels, const uint8 *pSrc, size_t nSourcePitch,
+                       uint32 *pDstARGB, size_t nDestPitch, uint32 width, uint32 height,
+                       uint32 yBegin, uint32 yEnd)
+    {
+        YUVtoARGBFrame(pKernels->pfnNV12toARGBRow, pSrc, nSourcePitch, pDstARGB, nDestPitch, width, height, yBegin, yEnd);
+    }
+
+    static void fromARGB(const CpuKernels *pKernels, const uint32 *pSrcARGB, size_t nSourcePitch,
+                         uint8 *pDst, size_t nDestPitch, uint32 width, uint32 height,
+                         uint32 yBegin, uint32 yEnd)
+    {
+        ARGBtoYUVFrame(pKernels->pfnARGBtoNV12Row, pSrcARGB, nSourcePitch, pDst, nDestPitch, width, height, yBegin, yEnd);
+    }
+};
+
+// I420 and YV12 only differ in the plane order the traits give
+template <NvPixelFormat F> struct CpuPlanar420Frame
+{
+    typedef NvPixelFormatTraits<F> Fmt;
+
+    static void toARGB(const CpuKernels *pKernels, const uint8 *pSrc, size_t nSourcePitch,
+                       uint32 *pDstARGB, size_t nDestPitch, uint32 width, uint32 height,
+                       uint32 yBegin, uint32 yEnd)
+    {
+        // two interleaved chroma rows, slot = row & 1, each filled once
+        uint32 nSamples = (width + 1) >> 1;
+        std::vector<uint8> vScratch(2 * (2 * nSamples + 16));
+        uint8 *pRow[2] = { &vScratch[0], &vScratch[2 * nSamples + 16] };
+        uint32 aRowIndex[2] = { ~0u, ~0u };
+
+        for (uint32 y = yBegin; y < yEnd; y++)
+        {
+            uint32 y_chroma[2] = { y >> 1, y >> 1 };
+
+            // odd scanline: interpolate vertically except on the last chroma row
+            if ((y & 1) && y_chroma[0] < ((height >> 1) - 1))
+            {
+                y_chroma[1]++;
+            }
+
+            for (uint32 i = 0; i < 2; i++)
+            {
+                uint32 slot = y_chroma[i] & 1;
+                if (aRowIndex[slot] != y_chroma[i])
+                {
+                    interleaveChromaRow(pSrc + Fmt::cb(nSourcePitch, height, 0, y_chroma[i]),
+                                        pSrc + Fmt::cr(nSourcePitch, height, 0, y_chroma[i]), pRow[slot], nSamples);
+                    aRowIndex[slot] = y_chroma[i];
+                }
+            }
+
+            pKernels->pfnNV12toARGBRow(pSrc + Fmt::luma(nSourcePitch, height, 0, y),
+                                       pRow[y_chroma[0] & 1], pRow[y_chroma[1] & 1],
+                                       (uint32 *)((uint8 *)pDstARGB + y * nDestPitch), width);
+        }
+    }
+
+    static void fromARGB(const CpuKernels *pKernels, const uint32 *pSrcARGB, size_t nSourcePitch,
+                         uint8 *pDst, size_t nDestPitch, uint32 width, uint32 height,
+                         uint32 yBegin, uint32 yEnd)
+    {
+        uint32 nSamples = (width + 1) >> 1;
+        std::vector<uint8> vScratch(2 * nSamples + 16);
+
+        for (uint32 y = yBegin; y < yEnd; y += 2)
+        {
+            // an odd last row pairs with itself
+            uint32 y1 = (y + 1 < yEnd) ? y + 1 : y;
+
+            pKernels->pfnARGBtoNV12Row((const uint32 *)((const uint8 *)pSrcARGB + y  * nSourcePitch),
+                                       (const uint32 *)((const uint8 *)pSrcARGB + y1 * nSourcePitch),
+                                       pDst + Fmt::luma(nDestPitch, height, 0, y),
+                                       pDst + Fmt::luma(nDestPitch, height, 0, y1), &vScratch[0], width);
+
+            deinterleaveChromaRow(&vScratch[0], pDst + Fmt::cb(nDestPitch, height, 0, y >> 1),
+                                  pDst + Fmt::cr(nDestPitch, height, 0, y >> 1), nSamples);
+        }
+    }
+};
+
+template <> struct CpuFormatFrame<NV_PIXEL_FORMAT_I420> : CpuPlanar420Frame<NV_PIXEL_FORMAT_I420> {};
+template <> struct CpuFormatFrame<NV_PIXEL_FORMAT_YV12> : CpuPlanar420Frame<NV_PIXEL_FORMAT_YV12> {};
+
+// 4:2:2 is NV12 with one chroma row per scanline: no vertical interpolation
+// on the way in, and each row paired with itself on the way out, which
+// averages the horizontal pair only.
+template <> struct CpuFormatFrame<NV_PIXEL_FORMAT_NV16>
+{
+    typedef NvPixelFormatTraits<NV_PIXEL_FORMAT_NV16> Fmt;
+
+    static void toARGB(const CpuKernels *pKernels, const uint8 *pSrc, size_t nSourcePitch,
+                       uint32 *pDstARGB, size_t nDestPitch, uint32 width, uint32 height,
+                       uint32 yBegin, uint32 yEnd)
+    {
+        for (uint32 y = yBegin; y < yEnd; y++)
+        {
+            const uint8 *pChroma = pSrc + Fmt::cb(nSourcePitch, height, 0, y);
+            pKernels->pfnNV12toARGBRow(pSrc + Fmt::luma(nSourcePitch, height, 0, y), pChroma, pChroma,
+                                       (uint32 *)((uint8 *)pDstARGB + y * nDestPitch), width);
+        }
+    }
+
+    static void fromARGB(const CpuKernels *pKernels, const uint32 *pSrcARGB, size_t nSourcePitch,
+                         uint8 *pDst, size_t nDestPitch, uint32 width, uint32 height,
+                         uint32 yBegin, uint32 yEnd)
+    {
+        for (uint32 y = yBegin; y < yEnd; y++)
+        {
+            const uint32 *pRow = (const uint32 *)((const uint8 *)pSrcARGB + y * nSourcePitch);
+            uint8 *pLuma = pDst + Fmt::luma(nDestPitch, height, 0, y);
+            pKernels->pfnARGBtoNV12Row(pRow, pRow, pLuma, pLuma, pDst + Fmt::cb(nDestPitch, height, 0, y), width);
+        }
+    }
+};
+
+template <> struct CpuFormatFrame<NV_PIXEL_FORMAT_YUV444>
+{
+    typedef NvPixelFormatTraits<NV_PIXEL_FORMAT_YUV444> Fmt;
+
+    static void toARGB(const CpuKernels *pKernels, const uint8 *pSrc, size_t nSourcePitch,
+                       uint32 *pDstARGB, size_t nDestPitch, uint32 width, uint32 height,
+                       uint32 yBegin, uint32 yEnd)
+    {
+        for (uint32 y = yBegin; y < yEnd; y++)
+        {
+            pKernels->pfnYUV444toARGBRow(pSrc + Fmt::luma(nSourcePitch, height, 0, y),
+                                         pSrc + Fmt::cb(nSourcePitch, height, 0, y),
+                                         pSrc + Fmt::cr(nSourcePitch, height, 0, y),
+                                         (uint32 *)((uint8 *)pDstARGB + y * nDestPitch), width);
+        }
+    }
+
+    static void fromARGB(const CpuKernels *pKernels, const uint32 *pSrcARGB, size_t nSourcePitch,
+                         uint8 *pDst, size_t nDestPitch, uint32 width, uint32 height,
+                         uint32 yBegin, uint32 yEnd)
+    {
+        for (uint32 y = yBegin; y < yEnd; y++)
+        {
+            pKernels->pfnARGBtoYUV444Row((const uint32 *)((const uint8 *)pSrcARGB + y * nSourcePitch),
+                                         pDst + Fmt::luma(nDestPitch, height, 0, y),
+                                         pDst + Fmt::cb(nDestPitch, height, 0, y),
+                                         pDst + Fmt::cr(nDestPitch, height, 0, y), width);
+        }
+    }
+};
+
+// YUY2 rows are split into luma and CbCr pairs and then handled as NV16
+template <> struct CpuFormatFrame<NV_PIXEL_FORMAT_YUY2>
+{
+    typedef NvPixelFormatTraits<NV_PIXEL_FORMAT_YUY2> Fmt;
+
+    static void toARGB(const CpuKernels *pKernels, const uint8 *pSrc, size_t nSourcePitch,
+                       uint32 *pDstARGB, size_t nDestPitch, uint32 width, uint32 height,
+                       uint32 yBegin, uint32 yEnd)
+    {
+        std::vector<uint8> vScratch(2 * width);
+        uint8 *pLuma = &vScratch[0], *pChroma = &vScratch[width];
+
+        for (uint32 y = yBegin; y < yEnd; y++)
+        {
+            unpackYUY2Row(pSrc + Fmt::luma(nSourcePitch, height, 0, y), pLuma, pChroma, width);
+            pKernels->pfnNV12toARGBRow(pLuma, pChroma, pChroma, (uint32 *)((uint8 *)pDstARGB + y * nDestPitch), width);
+        }
+    }
+
+    static void fromARGB(const CpuKernels *pKernels, const uint32 *pSrcARGB, size_t nSourcePitch,
+                         uint8 *pDst, size_t nDestPitch, uint32 width, uint32 height,
+                         uint32 yBegin, uint32 yEnd)
+    {
+        std::vector<uint8> vScratch(2 * width);
+        uint8 *pLuma = &vScratch[0], *pChroma = &vScratch[width];
+
+        for (uint32 y = yBegin; y < yEnd; y++)
+        {
+            const uint32 *pRow = (const uint32 *)((const uint8 *)pSrcARGB + y * nSourcePitch);
+            pKernels->pfnARGBtoNV12Row(pRow, pRow, pLuma, pLuma, pChroma, width);
+            packYUY2Row(pLuma, pChroma, pDst + Fmt::luma(nDestPitch, height, 0, y), width);
+        }
+    }
+};
+
+void cpuYUVtoARGB(NvPixelFormat eFormat,
+                  const uint8 *pSrcYUV,  size_t nSourcePitch,
+                  uint32 *pDstARGB,      size_t nDestPitch,
+                  uint32 width,          uint32 height,
+                  NvColorSpace oColorSpace)
+{
+    const CpuKernels *pKernels = kernelsFor(currentISA(), oColorSpace);
+
+    assert(eFormat != NV_PIXEL_FORMAT_YUY2 || !(width & 1));
+
+    forEachStrip(height, [&](uint32 yBegin, uint32 yEnd)
+    {
+        switch (eFormat)
+        {
+#define CPU_YUV_TO_ARGB(name, F)         case F: CpuFormatFrame<F>::toARGB(pKernels, pSrcYUV, nSourcePitch, pDstARGB, nDestPitch, width, height, yBegin, yEnd); break;
+            NV_FOR_EACH_PIXEL_FORMAT(CPU_YUV_TO_ARGB)
+#undef CPU_YUV_TO_ARGB
+            default: assert(0);
+        }
+    });
+}
+
+void cpuARGBtoYUV(NvPixelFormat eFormat,
+                  const uint32 *pSrcARGB, size_t nSourcePitch,
+                  uint8 *pDstYUV,         size_t nDestPitch,
+                  uint32 width,           uint32 height,
+                  NvColorSpace oColorSpace)
+{
+    const CpuKernels *pKernels = kernelsFor(currentISA(), oColorSpace);
+
+    assert(eFormat != NV_PIXEL_FORMAT_YUY2 || !(width & 1));
+
+    forEachStrip(height, [&](uint32 yBegin, uint32 yEnd)
+    {
+        switch (eFormat)
+        {
+#define CPU_ARGB_TO_YUV(name, F)         case F: CpuFormatFrame<F>::fromARGB(pKernels, pSrcARGB, nSourcePitch, pDstYUV, nDestPitch, width, height, yBegin, yEnd); break;
+            NV_FOR_EACH_PIXEL_FORMAT(CPU_ARGB_TO_YUV)
+#undef CPU_ARGB_TO_YUV
+            default: assert(0);
+        }
+    });
+}
+
+void cpuP010toARGB2101010(const uint16 *pSrcP010, size_t nSourcePitch,
+                          uint32 *pDstARGB,       size_t nDestPitch,
+                          uint32 width,           uint32 height,
+                          NvColorSpace oColorSpace)
+{
+    P010toARGB2101010RowFunc pfnRow = kernelsFor(currentISA(), oColorSpace)->pfnP010toARGB2101010Row;
+
+    forEachStrip(height, [&](uint32 yBegin, uint32 yEnd)
+    {
+        YUVtoARGBFrame(pfnRow, pSrcP010, nSourcePitch, pDstARGB, nDestPitch, width, height, yBegin, yEnd);
+    });
+}
+
+void cpuARGB2101010toP010(const uint32 *pSrcARGB, size_t nSourcePitch,
+                          uint16 *pDstP010,       size_t nDestPitch,
+                          uint32 width,           uint32 height,
+                          NvColorSpace oColorSpace)
+{
+    ARGB2101010toP010RowFunc pfnRow = kernelsFor(currentISA(), oColorSpace)->pfnARGB2101010toP010Row;
+
+    forEachStrip(height, [&](uint32 yBegin, uint32 yEnd)
+    {
+        ARGBtoYUVFrame(pfnRow, pSrcARGB, nSourcePitch, pDstP010, nDestPitch, width, height, yBegin, yEnd);
+    });
+}
+
+bool cpuIsFusable(const CpuPostprocess *pPostprocess)
+{
+    return !pPostprocess || pPostprocess->pfnRow;
+}
+
+bool cpuSupportsP010(const CpuPostprocess *pPostprocess)
+{
+    return !pPostprocess || pPostprocess->pfnRow2101010;
+}
+
+// The fused loop of cpuPostprocessNV12/P010 over scanlines [yBegin, yEnd),
+// yBegin even: pfnFilter (NULL = none) runs on each ARGB scanline between
+// the two conversions.
+template <class T, class ToARGBRowFunc, class FromARGBRowFunc>
+static void postprocessFused(ToARGBRowFunc pfnToARGB, FromARGBRowFunc pfnFromARGB,
+                             CpuARGBRowFilter pfnFilter, const void *pParams,
+                             const T *pSrc, size_t nSourcePitch,
+                             T *pDst,       size_t nDestPitch,
+                             uint32 width,  uint32 height,
+                             uint32 yBegin, uint32 yEnd, std::vector<uint32> &vScratch)
+{
+    // Two ARGB scanlines, 8 * width bytes: 30 KB at 3840 wide, so they stay
+    // in L1/L2 between the three steps and only NV12/P010 goes to memory.
+    uint32 nScratchPitch = (width + 15) & ~15;
+    vScratch.resize(2 * nScratchPitch);
+    uint32 *pRow[2] = { &vScratch[0], &vScratch[nScratchPitch] };
+
+    uint8 *pDstBytes = (uint8 *)pDst;
+    uint8 *pChromaPlane = pDstBytes + nDestPitch * height;
+
+    for (uint32 y = yBegin; y < yEnd; y += 2)
+    {
+        uint32 nRows = (y + 1 < yEnd) ? 2 : 1;
+
+        for (uint32 i = 0; i < nRows; i++)
+        {
+            YUVtoARGBScanline(pfnToARGB, pSrc, nSourcePitch, pRow[i], width, height, y + i);
+
+            if (pfnFilter)
+            {
+                pfnFilter(pRow[i], width, pParams);
+            }
+        }
+
+        uint32 y1 = y + nRows - 1;
+        pfnFromARGB(pRow[0], pRow[nRows - 1],
+                    (T *)(pDstBytes + y * nDestPitch), (T *)(pDstBytes + y1 * nDestPitch),
+                    (T *)(pChromaPlane + (y >> 1) * nDestPitch), width);
+    }
+}
+
+// The unfused chain over scanlines [yBegin, yEnd) through an ARGB strip in
+// vScratch instead of a full frame. A frame filter also gets nHaloRows of
+// context above and below, converted again by each strip that needs them,
+// so its output matches a run over the whole frame.
+template <class T, class ToARGBRowFunc, class FromARGBRowFunc>
+static void postprocessStrip(ToARGBRowFunc pfnToARGB, FromARGBRowFunc pfnFromARGB,
+                             CpuARGBRowFilter pfnFilter, CpuARGBFrameFilter pfnFrame,
+                             uint32 nHaloRows, const void *pParams,
+                             const T *pSrc, size_t nSourcePitch,
+                             T *pDst,       size_t nDestPitch,
+                             uint32 width,  uint32 height,
+                             uint32 yBegin, uint32 yEnd, std::vector<uint32> &vScratch)
+{
+    uint32 nScratchPitch = (width + 15) & ~15;
+    uint32 yFirst = pfnFrame ? yBegin - std::min(yBegin, nHaloRows) : yBegin;
+    uint32 yLast  = pfnFrame ? std::min(height, yEnd + nHaloRows) : yEnd;
+
+    vScratch.resize((size_t)(yLast - yFirst) * nScratchPitch);
+
+    for (uint32 y = yFirst; y < yLast; y++)
+    {
+        uint32 *pRow = &vScratch[(size_t)(y - yFirst) * nScratchPitch];
+        YUVtoARGBScanline(pfnToARGB, pSrc, nSourcePitch, pRow, width, height, y);
+
+        if (!pfnFrame && pfnFilter)
+        {
+            pfnFilter(pRow, width, pParams);
+        }
+    }
+
+    if (pfnFrame)
+    {
+        pfnFrame(&vScratch[0], nScratchPitch * sizeof(uint32), width, yLast - yFirst, pParams);
+    }
+
+    ARGBtoYUVRows(pfnFromARGB, &vScratch[(size_t)(yBegin - yFirst) * nScratchPitch], nScratchPitch * sizeof(uint32),
+                  pDst, nDestPitch, width, height, yBegin, yEnd);
+}
+
+static bool stripsPlanned(const CpuPostprocess *pPostprocess)
+{
+    if (!currentStripPlan().nStripRows)
+        return false;
+    return !(pPostprocess && pPostprocess->pfnFrame && pPostprocess->nHaloRows == CPU_HALO_WHOLE_FRAME);
+}
+
+// Strips need distinct frames: a strip reads source rows (chroma of the
+// next pair, the halo) that a neighbouring strip may already have written.
+static bool stripsApply(const CpuPostprocess *pPostprocess, const void *pSrc, const void *pDst,
+                        size_t nSourcePitch, size_t nDestPitch, uint32 height)
+{
+    const uint8 *pSrcBytes = (const uint8 *)pSrc;
+    const uint8 *pDstBytes = (const uint8 *)pDst;
+    uint32 nRows = height + NV_CHROMA_ROWS_420(height);
+
+    if (!stripsPlanned(pPostprocess))
+        return false;
+    return pSrcBytes + nSourcePitch * nRows <= pDstBytes || pDstBytes + nDestPitch * nRows <= pSrcBytes;
+}
+
+template <class T, class ToARGBRowFunc, class FromARGBRowFunc>
+static void postprocessStrips(ToARGBRowFunc pfnToARGB, FromARGBRowFunc pfnFromARGB,
+                              CpuARGBRowFilter pfnFilter, CpuARGBFrameFilter pfnFrame,
+                              uint32 nHaloRows, const void *pParams, bool bFused,
+                              const T *pSrc, size_t nSourcePitch,
+                              T *pDst,       size_t nDestPitch,
+                              uint32 width,  uint32 height)
+{
+    forEachStrip(height, [&](uint32 yBegin, uint32 yEnd)
+    {
+        // per thread, so it stays allocated and warm from frame to frame
+        static thread_local std::vector<uint32> tls_vScratch;
+
+        if (bFused)
+        {
+            postprocessFused(pfnToARGB, pfnFromARGB, pfnFilter, pParams,
+                             pSrc, nSourcePitch, pDst, nDestPitch, width, height, yBegin, yEnd, tls_vScratch);
+        }
+        else
+        {
+            postprocessStrip(pfnToARGB, pfnFromARGB, pfnFilter, pfnFrame, nHaloRows, pParams,
+                             pSrc, nSourcePitch, pDst, nDestPitch, width, height, yBegin, yEnd, tls_vScratch);
+        }
+    });
+}
+
+// The Y plane through pfnLuma, strip by strip, and the chroma copied. A
+// filter reads source rows around the ones it writes, so an in-place frame
+// works from a copy of its Y plane.
+static void postprocessLuma(const CpuPostprocess *pPostprocess,
+                            const uint8 *pSrcNV12, size_t nSourcePitch,
+                            uint8 *pDstNV12,       size_t nDestPitch,
+                            uint32 width,          uint32 height)
+{
+    static thread_local std::vector<uint8> tls_vSource;
+    const uint8 *pSrcLuma = pSrcNV12;
+    size_t nLumaPitch = nSourcePitch;
+    bool bSameFrame = pSrcNV12 == pDstNV12;
+
+    if (bSameFrame)
+    {
+        tls_vSource.resize((size_t)width * height);
+        for (uint32 y = 0; y < height; y++)
+        {
+            memcpy(&tls_vSource[(size_t)y * width], pSrcNV12 + y * nSourcePitch, width);
+        }
+        pSrcLuma = &tls_vSource[0];
+        nLumaPitch = width;
+    }
+
+    const uint8 *pSrcChroma = pSrcNV12 + nSourcePitch * height;
+    uint8 *pDstChroma = pDstNV12 + nDestPitch * height;
+    uint32 nChromaRows = NV_CHROMA_ROWS_420(height);
+
+    forEachStrip(height, [&](uint32 yBegin, uint32 yEnd)
+    {
+        pPostprocess->pfnLuma(pSrcLuma, nLumaPitch, pDstNV12, nDestPitch, width, height, yBegin, yEnd, pPostprocess->pParams);
+
+        // strips start on even rows, so each chroma row has one owner
+        for (uint32 yc = yBegin / 2; !bSameFrame && yc < std::min((yEnd + 1) / 2, nChromaRows); yc++)
+        {
+            memcpy(pDstChroma + yc * nDestPitch, pSrcChroma + yc * nSourcePitch, width);
+        }
+    });
+}
+
+bool cpuPostprocessUsesARGB(const CpuPostprocess *pPostprocess, bool bAllowFusion, bool bP010)
+{
+    if (pPostprocess && pPostprocess->pfnLuma)
+        return false;
+    if (stripsPlanned(pPostprocess))
+        return false;
+    return bP010 ? !bAllowFusion : !(bAllowFusion && cpuIsFusable(pPostprocess));
+}
+
+void cpuPostprocessNV12(const uint8 *pSrcNV12, size_t nSourcePitch,
+                        uint8 *pDstNV12,       size_t nDestPitch,
+                        uint32 *pARGB,         size_t nARGBPitch,
+                        uint32 width,          uint32 height,
+                        NvColorSpace oColorSpace,
+                        const CpuPostprocess *pPostprocess, bool bAllowFusion)
+{
+    const CpuKernels *pKernels = kernelsFor(currentISA(), oColorSpace);
+    bool bFused = bAllowFusion && cpuIsFusable(pPostprocess);
+    CpuARGBRowFilter pfnFilter = pPostprocess ? pPostprocess->pfnRow : NULL;
+
+    if (pPostprocess && pPostprocess->pfnLuma)
+    {
+        postprocessLuma(pPostprocess, pSrcNV12, nSourcePitch, pDstNV12, nDestPitch, width, height);
+        return;
+    }
+
+    if (stripsApply(pPostprocess, pSrcNV12, pDstNV12, nSourcePitch, nDestPitch, height))
+    {
+        postprocessStrips(pKernels->pfnNV12toARGBRow, pKernels->pfnARGBtoNV12Row, pfnFilter,
+                          pPostprocess ? pPostprocess->pfnFrame : NULL, pPostprocess ? pPostprocess->nHaloRows : 0,
+                          pPostprocess ? pPostprocess->pParams : NULL, bFused,
+                          pSrcNV12, nSourcePitch, pDstNV12, nDestPitch, width, height);
+        return;
+    }
+
+    if (!bFused)
+    {
+        cpuNV12toARGB(pSrcNV12, nSourcePitch, pARGB, nARGBPitch, width, height, oColorSpace);
+
+        if (pPostprocess && pPostprocess->pfnFrame)
+        {
+            pPostprocess->pfnFrame(pARGB, nARGBPitch, width, height, pPostprocess->pParams);
+        }
+        else if (pPostprocess)
+        {
+            for (uint32 y = 0; y < height; y++)
+            {
+                pPostprocess->pfnRow((uint32 *)((uint8 *)pARGB + y * nARGBPitch), width, pPostprocess->pParams);
+            }
+        }
+
+        cpuARGBtoNV12(pARGB, nARGBPitch, pDstNV12, nDestPitch, width, height, oColorSpace);
+        return;
+    }
+
+    std::vector<uint32> vScratch;
+    postprocessFused(pKernels->pfnNV12toARGBRow, pKernels->pfnARGBtoNV12Row,
+                     pfnFilter, pPostprocess ? pPostprocess->pParams : NULL,
+                     pSrcNV12, nSourcePitch, pDstNV12, nDestPitch, width, height, 0, height, vScratch);
+}
+
+void cpuPostprocessP010(const uint16 *pSrcP010, size_t nSourcePitch,
+                        uint16 *pDstP010,       size_t nDestPitch,
+                        uint32 *pARGB,          size_t nARGBPitch,
+                        uint32 width,           uint32 height,
+                        NvColorSpace oColorSpace,
+                        const CpuPostprocess *pPostprocess, bool bAllowFusion)
+{
+    const CpuKernels *pKernels = kernelsFor(currentISA(), oColorSpace);
+    CpuARGBRowFilter pfnFilter = pPostprocess ? pPostprocess->pfnRow2101010 : NULL;
+    const void *pParams = pPostprocess ? pPostprocess->pParams : NULL;
+
+    assert(cpuSupportsP010(pPostprocess));
+
+    if (stripsApply(pPostprocess, pSrcP010, pDstP010, nSourcePitch, nDestPitch, height))
+    {
+        postprocessStrips(pKernels->pfnP010toARGB2101010Row, pKernels->pfnARGB2101010toP010Row,
+                          pfnFilter, (CpuARGBFrameFilter)NULL, 0, pParams, bAllowFusion,
+                          pSrcP010, nSourcePitch, pDstP010, nDestPitch, width, height);
+        return;
+    }
+
+    if (!bAllowFusion)
+    {
+        cpuP010toARGB2101010(pSrcP010, nSourcePitch, pARGB, nARGBPitch, width, height, oColorSpace);
+
+        for (uint32 y = 0; pfnFilter && y < height; y++)
+        {
+            pfnFilter((uint32 *)((uint8 *)pARGB + y * nARGBPitch), width, pParams);
+        }
+
+        cpuARGB2101010toP010(pARGB, nARGBPitch, pDstP010, nDestPitch, width, height, oColorSpace);
+        return;
+    }
+
+    std::vector<uint32> vScratch;
+    postprocessFused(pKernels->pfnP010toARGB2101010Row, pKernels->pfnARGB2101010toP010Row, pfnFilter, pParams,
+                     pSrcP010, nSourcePitch, pDstP010, nDestPitch, width, height, 0, height, vScratch);
+}
+
+unsigned long long cpuPostprocessBytes(size_t nYUVPitch, size_t nARGBPitch, uint32 height, bool bFused)
+{
+    unsigned long long nYUVBytes  = (unsigned long long)nYUVPitch * height * 3 / 2;
+    unsigned long long nARGBBytes = (unsigned long long)nARGBPitch * height;
+
+    // NV12/P010 in and out; unfused adds the ARGB write, the filter's read
+    // and write, and the read back for the YUV conversion
+    return 2 * nYUVBytes + (bFused ? 0 : 4 * nARGBBytes);
+}
+
+void cpuSetStripPlan(CpuStripPlan oPlan)
+{
+    if (!oPlan.nThreads)
+    {
+        oPlan.nThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    // strips start on even scanlines so no chroma row is shared
+    oPlan.nStripRows = (oPlan.nStripRows + 1) & ~1u;
+
+    // the caller of each frame function works too
+    cpuTaskPool().Resize(oPlan.nStripRows ? oPlan.nThreads - 1 : 0);
+    currentStripPlan() = oPlan;
+}
+
+CpuStripPlan cpuStripPlan()
+{
+    return currentStripPlan();
+}
+
+size_t cpuL2CacheBytes()
+{
+    static size_t nBytes = 0;
+
+    if (!nBytes)
+    {
+#if defined(_SC_LEVEL2_CACHE_SIZE)
+        long nSize = sysconf(_SC_LEVEL2_CACHE_SIZE);
+        nBytes = nSize > 0 ? (size_t)nSize : 0;
+#endif
+        // glibc doesn't know it on most ARM cores; sysfs does
+        for (int i = 0; !nBytes && i < 8; i++)
+        {
+            char szPath[64];
+            unsigned int uLevel = 0;
+            unsigned long uSize = 0;
+            char cUnit = 0;
+
+            snprintf(szPath, sizeof(szPath), "/sys/devices/system/cpu/cpu0/cache/index%d/level", i);
+            FILE *fp = fopen(szPath, "r");
+            if (!fp)
+                break;
+            bool bL2 = fscanf(fp, "%u", &uLevel) == 1 && uLevel == 2;
+            fclose(fp);
+
+            snprintf(szPath, sizeof(szPath), "/sys/devices/system/cpu/cpu0/cache/index%d/size", i);
+            if (bL2 && (fp = fopen(szPath, "r")) != NULL)
+            {
+                if (fscanf(fp, "%lu%c", &uSize, &cUnit) >= 1)
+                {
+                    nBytes = uSize << (cUnit == 'K' ? 10 : cUnit == 'M' ? 20 : 0);
+                }
+                fclose(fp);
+            }
+        }
+
+        if (!nBytes)
+        {
+            nBytes = 1 << 20;
+        }
+    }
+
+    return nBytes;
+}
+
+uint32 cpuStripRowsForL2(uint32 width, uint32 nBitDepth, const CpuPostprocess *pPostprocess, bool bAllowFusion)
+{
+    size_t nBytesPerSample = nBitDepth > 8 ? 2 : 1;
+    bool bFused = bAllowFusion && (nBitDepth > 8 ? cpuSupportsP010(pPostprocess) : cpuIsFusable(pPostprocess));
+    uint32 nHaloRows = (!bFused && nBitDepth <= 8 && pPostprocess && pPostprocess->pfnFrame) ? pPostprocess->nHaloRows : 0;
+
+    bool bARGB = !bFused && !(pPostprocess && pPostprocess->pfnLuma);
+
+    // per scanline: NV12/P010 in and out, plus the ARGB strip when unfused;
+    // half of L2 is left to the kernels, the stack and the other sibling
+    size_t nRowBytes = 3 * nBytesPerSample * width + (bARGB ? 4 * (size_t)width : 0);
+    size_t nRows = cpuL2CacheBytes() / 2 / nRowBytes;
+
+    // a strip's halo is filtered twice; past L2, the strips stay at least
+    // twice as tall as both halos so that is at most half the work again
+    if (nHaloRows != CPU_HALO_WHOLE_FRAME)
+    {
+        nRows = nRows > 2 * (size_t)nHaloRows ? nRows - 2 * nHaloRows : 0;
+        nRows = std::max(nRows, 4 * (size_t)nHaloRows);
+    }
+    return std::max((uint32)nRows & ~1u, 8u);
+}
+
+CpuStripPlan cpuAutotuneStrips(uint32 width, uint32 height, uint32 nBitDepth, NvColorSpace oColorSpace,
+                               const CpuPostprocess *pPostprocess, bool bAllowFusion, uint32 nThreads)
+{
+    CpuStripPlan oBest = { 0, nThreads };
+
+    if (pPostprocess && pPostprocess->pfnFrame && pPostprocess->nHaloRows == CPU_HALO_WHOLE_FRAME)
+    {
+        cpuSetStripPlan(oBest);
+        return cpuStripPlan();
+    }
+
+    // a synthetic frame with some texture, the kernels are data independent
+    size_t nBytesPerSample = nBitDepth > 8 ? 2 : 1;
+    size_t nPitch = (width * nBytesPerSample + 255) & ~255;
+    size_t nFrameBytes = nPitch * (height + NV_CHROMA_ROWS_420(height));
+    std::vector<uint8> vSrc(nFrameBytes), vDst(nFrameBytes);
+    std::vector<uint32> vARGB((size_t)width * height);
+
+    for (size_t i = 0; i < nFrameBytes; i++)
+    {
+        vSrc[i] = (uint8)(i * 2654435761u >> 13);
+    }
+
+    uint32 nEstimate = cpuStripRowsForL2(width, nBitDepth, pPostprocess, bAllowFusion);
+    uint32 nMaxRows = (height + 1) & ~1u;
+    double fBestMs = 0.0;
+
+    for (uint32 nScale = 1; nScale <= 16; nScale *= 2)
+    {
+        // nEstimate / 4 .. nEstimate * 4
+        uint32 nRows = std::min(nMaxRows, std::max(8u, (uint32)(((unsigned long long)nEstimate * nScale / 4) & ~1u)));
+        if (nScale > 1 && nRows == cpuStripPlan().nStripRows)
+            continue;
+
+        CpuStripPlan oPlan = { nRows, nThreads };
+        cpuSetStripPlan(oPlan);
+
+        double fMs = 1e30;
+        for (int nRun = 0; nRun < 4; nRun++)
+        {
+            std::chrono::steady_clock::time_point tStart = std::chrono::steady_clock::now();
+            if (nBitDepth > 8)
+            {
+                cpuPostprocessP010((const uint16 *)&vSrc[0], nPitch, (uint16 *)&vDst[0], nPitch, &vARGB[0], width * 4,
+                                   width, height, oColorSpace, pPostprocess, bAllowFusion);
+            }
+            else
+            {
+                cpuPostprocessNV12(&vSrc[0], nPitch, &vDst[0], nPitch, &vARGB[0], width * 4,
+                                   width, height, oColorSpace, pPostprocess, bAllowFusion);
+            }
+            double fRunMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - tStart).count();
+
+            // the first run warms the caches and the scratch buffers
+            if (nRun > 0)
+            {
+                fMs = std::min(fMs, fRunMs);
+            }
+        }
+
+        if (!oBest.nStripRows || fMs < fBestMs)
+        {
+            oBest = cpuStripPlan();
+            fBestMs = fMs;
+        }
+    }
+
+    cpuSetStripPlan(oBest);
+    return oBest;
+}
@@ -0,0 +1,197 @@
+/*
+ * Copyright 1993-2015 NVIDIA Corporation.  All rights reserved.
+ *
+ * Please refer to the NVIDIA end user license agreement (EULA) associated
+ * with this source code for terms and conditions that govern your use of
+ * this software. Any use, reproduction, disclosure, or distribution of
+ * this software and related documentation outside the terms of the EULA
+ * is strictly prohibited.
+ *
+ */
+
+#ifndef _CPUPROCESSFRAME_H_
+#define _CPUPROCESSFRAME_H_
+
+#include <stddef.h>
+#include "cudaProcessFrame.h"
+#include "NvColorMatrix.h"
+#include "NvPixelFormat.h"
+
+// Host implementations of the kernels in videoPP.cu, for CPU-only nodes and
+// for validating the GPU path. Each ISA lives in its own translation unit;
+// the best one the CPU supports is picked on first use.
+typedef enum
+{
+    CPU_ISA_SCALAR = 0,
+    CPU_ISA_SSE41,
+    CPU_ISA_AVX2,
+    CPU_ISA_AVX512,
+    CPU_ISA_NEON,
+    CPU_ISA_COUNT
+} CpuISA;
+
+// best ISA supported by this CPU (and OS), from cpuid
+CpuISA cpuDetectISA();
+
+const char *cpuISAName(CpuISA isa);
+
+// Pins the kernels to one ISA, e.g. to compare it against CPU_ISA_SCALAR.
+// Fails if the CPU can't run it or it wasn't built for this target.
+bool cpuSelectISA(CpuISA isa);
+
+CpuISA cpuSelectedISA();
+
+// Same output as NV12ToARGBdrvapi for the given colour space: chroma
+// interpolated vertically on odd lines, Q13 fixed point as described in
+// NvColorMatrix.h. An odd last column is converted too, with the CbCr pair
+// at its own position (the device kernels only ever see even widths).
+void cpuNV12toARGB(const uint8 *pSrcNV12, size_t nSourcePitch,
+                   uint32 *pDstARGB,      size_t nDestPitch,
+                   uint32 width,          uint32 height,
+                   NvColorSpace oColorSpace);
+
+// Host counterpart of cudaLaunchARGBtoNV12Drv, same pitches and layout
+// (chroma plane at nDestPitch * height) and same output: luma per pixel,
+// chroma once per 2x2 quad from its average colour. Odd widths and heights
+// are covered, the chroma rows then need width + 1 bytes of pitch.
+void cpuARGBtoNV12(const uint32 *pSrcARGB, size_t nSourcePitch,
+                   uint8 *pDstNV12,        size_t nDestPitch,
+                   uint32 width,           uint32 height,
+                   NvColorSpace oColorSpace);
+
+// The 10-bit pair of the two above: P010 (16-bit samples holding the value
+// in bits 6-15, chroma plane at nPitch * height) to and from ARGB2101010
+// (A in bits 30-31, then 10 bits each of R, G and B). Same layout rules and
+// the same Q13 math with the 10-bit matrices, so nothing is rounded to 8
+// bits on the way. Pitches are in bytes.
+void cpuP010toARGB2101010(const uint16 *pSrcP010, size_t nSourcePitch,
+                          uint32 *pDstARGB,       size_t nDestPitch,
+                          uint32 width,           uint32 height,
+                          NvColorSpace oColorSpace);
+
+void cpuARGB2101010toP010(const uint32 *pSrcARGB, size_t nSourcePitch,
+                          uint16 *pDstP010,       size_t nDestPitch,
+                          uint32 width,           uint32 height,
+                          NvColorSpace oColorSpace);
+
+// Any 8-bit format of NvPixelFormat.h to ARGB and back, with the output of
+// the <format>ToARGBdrvapi / ARGBTo<format>drvapi kernels. The 4:2:0
+// formats behave as cpuNV12toARGB / cpuARGBtoNV12; 4:2:2 takes chroma from
+// each horizontal pair and 4:4:4 from every pixel. YUY2 needs an even width.
+void cpuYUVtoARGB(NvPixelFormat eFormat,
+                  const uint8 *pSrcYUV,  size_t nSourcePitch,
+                  uint32 *pDstARGB,      size_t nDestPitch,
+                  uint32 width,          uint32 height,
+                  NvColorSpace oColorSpace);
+
+void cpuARGBtoYUV(NvPixelFormat eFormat,
+                  const uint32 *pSrcARGB, size_t nSourcePitch,
+                  uint8 *pDstYUV,         size_t nDestPitch,
+                  uint32 width,           uint32 height,
+                  NvColorSpace oColorSpace);
+
+// Host postprocess on packed ARGB. Point-wise filters, where each output
+// pixel depends only on the same input pixel, set pfnRow and work in place
+// on any run of pixels. Filters that need neighbours set pfnFrame instead.
+// pfnRow2101010 is the point-wise filter on ARGB2101010 pixels for the P010
+// path; filters without one only run at 8 bits. nHaloRows is how far a frame
+// filter reaches up and down, so it can run on strips (see CpuStripPlan);
+// CPU_HALO_WHOLE_FRAME keeps it on whole frames. A filter of luma only may
+// set pfnLuma alone instead: the NV12 path then never builds ARGB, it
+// writes rows [yBegin, yEnd) of the destination Y plane from the whole
+// source one and copies the chroma.
+typedef void (*CpuARGBRowFilter)(uint32 *pARGB, uint32 width, const void *pParams);
+typedef void (*CpuARGBFrameFilter)(uint32 *pARGB, size_t nPitch, uint32 width, uint32 height, const void *pParams);
+typedef void (*CpuLumaFilter)(const uint8 *pSrc, size_t nSourcePitch, uint8 *pDst, size_t nDestPitch,
+                              uint32 width, uint32 height, uint32 yBegin, uint32 yEnd, const void *pParams);
+
+#define CPU_HALO_WHOLE_FRAME 0xffffffffu
+
+struct CpuPostprocess
+{
+    const char          *szName;
+    CpuARGBRowFilter     pfnRow;
+    CpuARGBRowFilter     pfnRow2101010;
+    CpuARGBFrameFilter   pfnFrame;
+    const void          *pParams;
+    uint32               nHaloRows;
+    CpuLumaFilter        pfnLuma;
+};
+
+// true when pPostprocess (NULL = none) can run inside the fused path
+bool cpuIsFusable(const CpuPostprocess *pPostprocess);
+
+// NV12 -> ARGB -> postprocess -> NV12. Point-wise postprocesses run fused,
+// one scanline pair at a time through a small cache-resident buffer, so the
+// ARGB frame is never written; pARGB (a full frame) is only touched on the
+// unfused path, taken for other filters or when bAllowFusion is false.
+// A pfnLuma postprocess skips ARGB altogether and ignores pARGB.
+// pSrcNV12 and pDstNV12 may be the same frame when the pitches match.
+void cpuPostprocessNV12(const uint8 *pSrcNV12, size_t nSourcePitch,
+                        uint8 *pDstNV12,       size_t nDestPitch,
+                        uint32 *pARGB,         size_t nARGBPitch,
+                        uint32 width,          uint32 height,
+                        NvColorSpace oColorSpace,
+                        const CpuPostprocess *pPostprocess, bool bAllowFusion = true);
+
+// true when pPostprocess (NULL = none) can run on the P010 path
+bool cpuSupportsP010(const CpuPostprocess *pPostprocess);
+
+// cpuPostprocessNV12() at 10 bits, through ARGB2101010; pPostprocess must
+// pass cpuSupportsP010(). P010 frames are twice the size of NV12, so the
+// fused path saves the same ARGB traffic but moves 2x the YUV bytes.
+void cpuPostprocessP010(const uint16 *pSrcP010, size_t nSourcePitch,
+                        uint16 *pDstP010,       size_t nDestPitch,
+                        uint32 *pARGB,          size_t nARGBPitch,
+                        uint32 width,           uint32 height,
+                        NvColorSpace oColorSpace,
+                        const CpuPostprocess *pPostprocess, bool bAllowFusion = true);
+
+// Strip execution of the frame functions above. The frame is cut into
+// horizontal strips of nStripRows scanlines, which become tasks of the
+// shared pool, cpuTaskPool(). cpuPostprocessNV12/P010() run the whole chain,
+// NV12 -> ARGB -> filter -> NV12, per strip; on the unfused path the ARGB
+// intermediate is then one strip in a per-thread buffer instead of a full
+// frame (33 MB at 4K), so it never leaves L2 and pARGB isn't touched.
+// nStripRows = 0 (the default) keeps whole frames on the calling thread; so
+// does a postprocess whose frames overlap, i.e. an in-place call.
+struct CpuStripPlan
+{
+    uint32 nStripRows;  // even
+    uint32 nThreads;    // pool threads plus the caller; 0 = one per hardware thread
+};
+
+// Not thread safe against running frame functions; set it up front.
+void cpuSetStripPlan(CpuStripPlan oPlan);
+
+CpuStripPlan cpuStripPlan();
+
+// Whether cpuPostprocessNV12/P010() with these settings and the current
+// plan write the full-frame pARGB, given distinct source and destination
+// frames; when false the caller may pass NULL and skip the allocation.
+bool cpuPostprocessUsesARGB(const CpuPostprocess *pPostprocess, bool bAllowFusion, bool bP010);
+
+// The work-stealing pool (NvTaskPool.h) behind the strip plan. There is one
+// per process, shared by every session calling the frame functions, and
+// sized by cpuSetStripPlan().
+class CNvTaskPool;
+CNvTaskPool &cpuTaskPool();
+
+// per-core L2 size in bytes, from sysconf or sysfs (1 MB if unknown)
+size_t cpuL2CacheBytes();
+
+// strip height whose working set takes about half of L2
+uint32 cpuStripRowsForL2(uint32 width, uint32 nBitDepth, const CpuPostprocess *pPostprocess, bool bAllowFusion);
+
+// Times the postprocess on a synthetic width x height frame for strip
+// heights from 1/4 to 4x the L2 estimate on nThreads threads, installs the
+// fastest plan and returns it. Takes a few frames' worth of time, so run it
+// once at startup.
+CpuStripPlan cpuAutotuneStrips(uint32 width, uint32 height, uint32 nBitDepth, NvColorSpace oColorSpace,
+                               const CpuPostprocess *pPostprocess, bool bAllowFusion, uint32 nThreads);
+
+// frame-sized memory traffic of cpuPostprocessNV12/P010(), fused or not;
+// nYUVPitch is the NV12 or P010 pitch in bytes
+unsigned long long cpuPostprocessBytes(size_t nYUVPitch, size_t nARGBPitch, uint32 height, bool bFused);
+
+#endif
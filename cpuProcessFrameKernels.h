@@ -0,0 +1,620 @@
+/*
+ * Copyright 1993-2015 NVIDIA Corporation.  All rights reserved.
+ *
+ * Please refer to the NVIDIA end user license agreement (EULA) associated
+ * with this source code for terms and conditions that govern your use of
+ * this software. Any use, reproduction, disclosure, or distribution of
+ * this software and related documentation outside the terms of the EULA
+ * is strictly prohibited.
+ *
+ */
+
+// Row kernels behind cpuProcessFrame.h, shared by the per-ISA files. The
+// arithmetic is the Q13 integer math of NvColorMatrix.h, so every ISA and
+// the GPU kernels agree bit for bit. Each row function is a template on the
+// matrix, instantiated for every colour space into one table per ISA.
+
+#ifndef _CPUPROCESSFRAMEKERNELS_H_
+#define _CPUPROCESSFRAMEKERNELS_H_
+
+#include "cpuProcessFrame.h"
+
+#include <algorithm>
+
+// One row of NV12 to ARGB. pChroma1 is the chroma row to average with on
+// odd lines; it equals pChroma0 when no interpolation applies, which gives
+// the same result since (c + c + 1) >> 1 == c.
+typedef void (*NV12toARGBRowFunc)(const uint8 *pLuma, const uint8 *pChroma0, const uint8 *pChroma1,
+                                  uint32 *pDst, uint32 width);
+
+// Two rows of ARGB to NV12: luma for both rows and one CbCr pair per 2x2
+// quad, from the quad's average colour. On an odd last row pSrc1/pLuma1
+// equal pSrc0/pLuma0.
+typedef void (*ARGBtoNV12RowFunc)(const uint32 *pSrc0, const uint32 *pSrc1,
+                                  uint8 *pLuma0, uint8 *pLuma1, uint8 *pChroma, uint32 width);
+
+// 4:4:4 rows: every pixel has its own Cb/Cr sample, and on the way back
+// each pixel counts as a quad of four copies of itself (nvRGB2UV of 4x its
+// colour), so the result matches the 4:2:0 math on a flat colour.
+typedef void (*YUV444toARGBRowFunc)(const uint8 *pLuma, const uint8 *pCb, const uint8 *pCr,
+                                    uint32 *pDst, uint32 width);
+
+typedef void (*ARGBtoYUV444RowFunc)(const uint32 *pSrc, uint8 *pLuma, uint8 *pCb, uint8 *pCr, uint32 width);
+
+// The same two steps at 10 bits: P010 samples (value << 6 in 16-bit words)
+// to and from ARGB2101010, same chroma handling as the 8-bit rows.
+typedef void (*P010toARGB2101010RowFunc)(const uint16 *pLuma, const uint16 *pChroma0, const uint16 *pChroma1,
+                                         uint32 *pDst, uint32 width);
+
+typedef void (*ARGB2101010toP010RowFunc)(const uint32 *pSrc0, const uint32 *pSrc1,
+                                         uint16 *pLuma0, uint16 *pLuma1, uint16 *pChroma, uint32 width);
+
+struct CpuKernels
+{
+    NV12toARGBRowFunc           pfnNV12toARGBRow;
+    ARGBtoNV12RowFunc           pfnARGBtoNV12Row;
+    YUV444toARGBRowFunc         pfnYUV444toARGBRow;
+    ARGBtoYUV444RowFunc         pfnARGBtoYUV444Row;
+    P010toARGB2101010RowFunc    pfnP010toARGB2101010Row;
+    ARGB2101010toP010RowFunc    pfnARGB2101010toP010Row;
+};
+
+// tables are indexed by matrix, then range
+static inline uint32 cpuColorSpaceIndex(NvColorSpace oColorSpace)
+{
+    return (uint32)oColorSpace.eMatrix * NV_COLOR_RANGE_COUNT + (uint32)oColorSpace.eRange;
+}
+
+#define CPU_KERNEL_ENTRY(isa, M, R) \
+    { NV12toARGBRow_##isa<NvColorMatrixQ13<M, R> >, ARGBtoNV12Row_##isa<NvColorMatrixQ13<M, R> >, \
+      YUV444toARGBRow_##isa<NvColorMatrixQ13<M, R> >, ARGBtoYUV444Row_##isa<NvColorMatrixQ13<M, R> >, \
+      P010toARGB2101010Row_##isa<NvColorMatrixQ13<M, R, 10> >, ARGB2101010toP010Row_##isa<NvColorMatrixQ13<M, R, 10> > }
+
+#define CPU_KERNEL_TABLE(isa) \
+    { CPU_KERNEL_ENTRY(isa, NV_COLOR_MATRIX_BT601,  NV_COLOR_RANGE_LIMITED), \
+      CPU_KERNEL_ENTRY(isa, NV_COLOR_MATRIX_BT601,  NV_COLOR_RANGE_FULL),    \
+      CPU_KERNEL_ENTRY(isa, NV_COLOR_MATRIX_BT709,  NV_COLOR_RANGE_LIMITED), \
+      CPU_KERNEL_ENTRY(isa, NV_COLOR_MATRIX_BT709,  NV_COLOR_RANGE_FULL),    \
+      CPU_KERNEL_ENTRY(isa, NV_COLOR_MATRIX_BT2020, NV_COLOR_RANGE_LIMITED), \
+      CPU_KERNEL_ENTRY(isa, NV_COLOR_MATRIX_BT2020, NV_COLOR_RANGE_FULL) }
+
+#define CPU_KERNEL_TABLE_SIZE (NV_COLOR_MATRIX_COUNT * NV_COLOR_RANGE_COUNT)
+
+extern const CpuKernels g_aCpuKernels_C[CPU_KERNEL_TABLE_SIZE];
+
+#if defined(__x86_64__) || defined(__i386__)
+extern const CpuKernels g_aCpuKernels_SSE41[CPU_KERNEL_TABLE_SIZE];
+extern const CpuKernels g_aCpuKernels_AVX2[CPU_KERNEL_TABLE_SIZE];
+extern const CpuKernels g_aCpuKernels_AVX512[CPU_KERNEL_TABLE_SIZE];
+#endif
+
+#if defined(__aarch64__)
+extern const CpuKernels g_aCpuKernels_NEON[CPU_KERNEL_TABLE_SIZE];
+#endif
+
+// Scalar rows, also used by the SIMD paths for the columns left over.
+template <class CM>
+void NV12toARGBRow_C(const uint8 *pLuma, const uint8 *pChroma0, const uint8 *pChroma1,
+                     uint32 *pDst, uint32 width)
+{
+    // 2 pixels share one CbCr pair
+    for (uint32 x = 0; x + 1 < width; x += 2)
+    {
+        int32 chromaCb = (pChroma0[x    ] + pChroma1[x    ] + 1) >> 1;
+        int32 chromaCr = (pChroma0[x + 1] + pChroma1[x + 1] + 1) >> 1;
+
+        pDst[x    ] = nvYUV2ARGB<CM>(pLuma[x    ], chromaCb, chromaCr);
+        pDst[x + 1] = nvYUV2ARGB<CM>(pLuma[x + 1], chromaCb, chromaCr);
+    }
+
+    // an odd last column has a CbCr pair of its own
+    if (width & 1)
+    {
+        uint32 x = width - 1;
+        int32 chromaCb = (pChroma0[x    ] + pChroma1[x    ] + 1) >> 1;
+        int32 chromaCr = (pChroma0[x + 1] + pChroma1[x + 1] + 1) >> 1;
+
+        pDst[x] = nvYUV2ARGB<CM>(pLuma[x], chromaCb, chromaCr);
+    }
+}
+
+template <class CM>
+void ARGBtoNV12Row_C(const uint32 *pSrc0, const uint32 *pSrc1,
+                     uint8 *pLuma0, uint8 *pLuma1, uint8 *pChroma, uint32 width)
+{
+    for (uint32 x = 0; x < width; x += 2)
+    {
+        // an odd last column makes a 1x2 quad
+        uint32 nColumns = (x + 1 < width) ? 2 : 1;
+        int32 sumR = 0, sumG = 0, sumB = 0;
+
+        for (uint32 i = 0; i < nColumns; i++)
+        {
+            uint32 p0 = pSrc0[x + i];
+            uint32 p1 = pSrc1[x + i];
+
+            pLuma0[x + i] = nvRGB2Y<CM>((p0 >> 16) & 0xff, (p0 >> 8) & 0xff, p0 & 0xff);
+            pLuma1[x + i] = nvRGB2Y<CM>((p1 >> 16) & 0xff, (p1 >> 8) & 0xff, p1 & 0xff);
+
+            sumR += ((p0 >> 16) & 0xff) + ((p1 >> 16) & 0xff);
+            sumG += ((p0 >>  8) & 0xff) + ((p1 >>  8) & 0xff);
+            sumB += ( p0        & 0xff) + ( p1        & 0xff);
+        }
+
+        // nvRGB2UV takes the sum of 4 samples
+        int32 scale = (nColumns == 2) ? 1 : 2;
+        nvRGB2UV<CM>(sumR * scale, sumG * scale, sumB * scale, pChroma[x], pChroma[x + 1]);
+    }
+}
+
+template <class CM>
+void YUV444toARGBRow_C(const uint8 *pLuma, const uint8 *pCb, const uint8 *pCr,
+                       uint32 *pDst, uint32 width)
+{
+    for (uint32 x = 0; x < width; x++)
+    {
+        pDst[x] = nvYUV2ARGB<CM>(pLuma[x], pCb[x], pCr[x]);
+    }
+}
+
+template <class CM>
+void ARGBtoYUV444Row_C(const uint32 *pSrc, uint8 *pLuma, uint8 *pCb, uint8 *pCr, uint32 width)
+{
+    for (uint32 x = 0; x < width; x++)
+    {
+        int32 r = (pSrc[x] >> 16) & 0xff;
+        int32 g = (pSrc[x] >>  8) & 0xff;
+        int32 b =  pSrc[x]        & 0xff;
+
+        pLuma[x] = nvRGB2Y<CM>(r, g, b);
+        nvRGB2UV<CM>(4 * r, 4 * g, 4 * b, pCb[x], pCr[x]);
+    }
+}
+
+template <class CM>
+void P010toARGB2101010Row_C(const uint16 *pLuma, const uint16 *pChroma0, const uint16 *pChroma1,
+                            uint32 *pDst, uint32 width)
+{
+    for (uint32 x = 0; x + 1 < width; x += 2)
+    {
+        int32 chromaCb = ((pChroma0[x    ] >> NV_P010_SHIFT) + (pChroma1[x    ] >> NV_P010_SHIFT) + 1) >> 1;
+        int32 chromaCr = ((pChroma0[x + 1] >> NV_P010_SHIFT) + (pChroma1[x + 1] >> NV_P010_SHIFT) + 1) >> 1;
+
+        pDst[x    ] = nvYUV2ARGB2101010<CM>(pLuma[x    ] >> NV_P010_SHIFT, chromaCb, chromaCr);
+        pDst[x + 1] = nvYUV2ARGB2101010<CM>(pLuma[x + 1] >> NV_P010_SHIFT, chromaCb, chromaCr);
+    }
+
+    if (width & 1)
+    {
+        uint32 x = width - 1;
+        int32 chromaCb = ((pChroma0[x    ] >> NV_P010_SHIFT) + (pChroma1[x    ] >> NV_P010_SHIFT) + 1) >> 1;
+        int32 chromaCr = ((pChroma0[x + 1] >> NV_P010_SHIFT) + (pChroma1[x + 1] >> NV_P010_SHIFT) + 1) >> 1;
+
+        pDst[x] = nvYUV2ARGB2101010<CM>(pLuma[x] >> NV_P010_SHIFT, chromaCb, chromaCr);
+    }
+}
+
+template <class CM>
+void ARGB2101010toP010Row_C(const uint32 *pSrc0, const uint32 *pSrc1,
+                            uint16 *pLuma0, uint16 *pLuma1, uint16 *pChroma, uint32 width)
+{
+    for (uint32 x = 0; x < width; x += 2)
+    {
+        uint32 nColumns = (x + 1 < width) ? 2 : 1;
+        int32 sumR = 0, sumG = 0, sumB = 0;
+
+        for (uint32 i = 0; i < nColumns; i++)
+        {
+            uint32 p0 = pSrc0[x + i];
+            uint32 p1 = pSrc1[x + i];
+
+            pLuma0[x + i] = (uint16)(nvRGB2Y<CM>((p0 >> 20) & 0x3ff, (p0 >> 10) & 0x3ff, p0 & 0x3ff) << NV_P010_SHIFT);
+            pLuma1[x + i] = (uint16)(nvRGB2Y<CM>((p1 >> 20) & 0x3ff, (p1 >> 10) & 0x3ff, p1 & 0x3ff) << NV_P010_SHIFT);
+
+            sumR += ((p0 >> 20) & 0x3ff) + ((p1 >> 20) & 0x3ff);
+            sumG += ((p0 >> 10) & 0x3ff) + ((p1 >> 10) & 0x3ff);
+            sumB += ( p0        & 0x3ff) + ( p1        & 0x3ff);
+        }
+
+        int32 scale = (nColumns == 2) ? 1 : 2;
+        int32 chromaCb, chromaCr;
+        nvRGB2UV<CM>(sumR * scale, sumG * scale, sumB * scale, chromaCb, chromaCr);
+
+        pChroma[x    ] = (uint16)(chromaCb << NV_P010_SHIFT);
+        pChroma[x + 1] = (uint16)(chromaCr << NV_P010_SHIFT);
+    }
+}
+
+// Kernels of the host filters (NvFilters.cpp) on 8-bit ARGB, one table per
+// ISA; none of them depends on the colour space. Window sums are kept per
+// channel in 4 uint32 per pixel, in the byte order of the pixel (B, G, R,
+// A), so a SIMD register holds whole pixels.
+
+// One row of a box blur of radius nRadius. pSrc has nRadius pixels of
+// padding before it and nRadius + 1 after it (copies of the edge pixels),
+// pDst gets width pixels; nScale is 65536 / (2 * nRadius + 1), rounded.
+typedef void (*BoxBlurRowFunc)(const uint32 *pSrc, uint32 *pDst, uint32 width, uint32 nRadius, uint32 nScale);
+
+// One step of the vertical box pass over a block of columns: pDst gets the
+// window sums in pSums scaled down, then the window moves a row on, adding
+// pAdd and subtracting pSub.
+typedef void (*BoxBlurColumnsFunc)(uint32 *pSums, const uint32 *pAdd, const uint32 *pSub, uint32 *pDst,
+                                   uint32 nPixels, uint32 nScale);
+
+// One row of an unsharp mask: the box blur of pRow is the window sums in
+// pSums scaled down, and every channel of pRow that differs from it by more
+// than nThreshold moves away from it by nAmount (Q8) of the difference; then
+// the window moves a row on, as for BoxBlurColumnsFunc.
+typedef void (*UnsharpRowFunc)(uint32 *pSums, const uint32 *pAdd, const uint32 *pSub, uint32 *pRow,
+                               uint32 width, uint32 nScale, int32 nAmount, int32 nThreshold);
+
+// One row of a median over an N x N window of bytes, N = 3 or 5: ppRows
+// are the N rows of the window, each with N / 2 * nStep bytes of padding
+// on both sides, and the neighbours of a byte are nStep bytes away, 4 for
+// ARGB (every channel on its own) and 1 for a row of luma.
+typedef void (*MedianRowFunc)(const uint8 *const *ppRows, uint8 *pDst, uint32 nBytes, uint32 nStep);
+
+// Luma of a row of ARGB, BT.709 weights in Q8: (54 R + 183 G + 19 B + 128) >> 8
+typedef void (*ARGBLumaRowFunc)(const uint32 *pARGB, uint8 *pLuma, uint32 width);
+
+// R, G and B of each pixel moved by pNew - pOld, clamped, alpha kept: a
+// change of luma that leaves the chroma
+typedef void (*ShiftLumaRowFunc)(uint32 *pARGB, const uint8 *pOld, const uint8 *pNew, uint32 width);
+
+struct CpuFilterKernels
+{
+    BoxBlurRowFunc      pfnBoxBlurRow;
+    BoxBlurColumnsFunc  pfnBoxBlurColumns;
+    UnsharpRowFunc      pfnUnsharpRow;
+    MedianRowFunc       pfnMedian3Row;
+    MedianRowFunc       pfnMedian5Row;
+    ARGBLumaRowFunc     pfnARGBLumaRow;
+    ShiftLumaRowFunc    pfnShiftLumaRow;
+};
+
+extern const CpuFilterKernels g_oCpuFilterKernels_C;
+
+#if defined(__x86_64__) || defined(__i386__)
+extern const CpuFilterKernels g_oCpuFilterKernels_SSE41;
+extern const CpuFilterKernels g_oCpuFilterKernels_AVX2;
+extern const CpuFilterKernels g_oCpuFilterKernels_AVX512;
+#endif
+
+#if defined(__aarch64__)
+extern const CpuFilterKernels g_oCpuFilterKernels_NEON;
+#endif
+
+// the table of cpuSelectedISA()
+const CpuFilterKernels &cpuFilterKernels();
+
+// (sum * nScale) / 65536, rounded, for a window sum of one channel
+static inline uint32 cpuBoxScale(uint32 nSum, uint32 nScale)
+{
+    return (nSum * nScale + 32768) >> 16;
+}
+
+static inline uint32 cpuBoxChannel(uint32 p, uint32 c)
+{
+    return (p >> (8 * c)) & 0xff;
+}
+
+inline void BoxBlurRow_C(const uint32 *pSrc, uint32 *pDst, uint32 width, uint32 nRadius, uint32 nScale)
+{
+    int32 r = (int32)nRadius;
+    uint32 s[4] = { 0, 0, 0, 0 };
+
+    for (int32 k = -r; k <= r; k++)
+    {
+        for (uint32 c = 0; c < 4; c++)
+        {
+            s[c] += cpuBoxChannel(pSrc[k], c);
+        }
+    }
+
+    for (int32 x = 0; x < (int32)width; x++)
+    {
+        uint32 p = 0;
+        for (uint32 c = 0; c < 4; c++)
+        {
+            p |= cpuBoxScale(s[c], nScale) << (8 * c);
+            s[c] += cpuBoxChannel(pSrc[x + r + 1], c) - cpuBoxChannel(pSrc[x - r], c);
+        }
+        pDst[x] = p;
+    }
+}
+
+inline void BoxBlurColumns_C(uint32 *pSums, const uint32 *pAdd, const uint32 *pSub, uint32 *pDst,
+                             uint32 nPixels, uint32 nScale)
+{
+    for (uint32 x = 0; x < nPixels; x++)
+    {
+        uint32 *s = pSums + 4 * x;
+        uint32 uAdd = pAdd[x], uSub = pSub[x];
+        uint32 p = 0;
+
+        for (uint32 c = 0; c < 4; c++)
+        {
+            p |= cpuBoxScale(s[c], nScale) << (8 * c);
+            s[c] += cpuBoxChannel(uAdd, c) - cpuBoxChannel(uSub, c);
+        }
+        pDst[x] = p;
+    }
+}
+
+// a channel of the original and its blur through the unsharp mask
+static inline uint32 cpuUnsharp(int32 nOriginal, int32 nBlur, int32 nAmount, int32 nThreshold)
+{
+    int32 d = nOriginal - nBlur;
+    int32 v = (d > nThreshold || -d > nThreshold) ? nOriginal + ((d * nAmount + 128) >> 8) : nOriginal;
+    return (uint32)nvClamp(v, 255);
+}
+
+inline void UnsharpRow_C(uint32 *pSums, const uint32 *pAdd, const uint32 *pSub, uint32 *pRow,
+                         uint32 width, uint32 nScale, int32 nAmount, int32 nThreshold)
+{
+    for (uint32 x = 0; x < width; x++)
+    {
+        uint32 *s = pSums + 4 * x;
+        uint32 uAdd = pAdd[x], uSub = pSub[x];
+        uint32 p = 0;
+
+        for (uint32 c = 0; c < 4; c++)
+        {
+            p |= cpuUnsharp((int32)cpuBoxChannel(pRow[x], c), (int32)cpuBoxScale(s[c], nScale), nAmount, nThreshold) << (8 * c);
+            s[c] += cpuBoxChannel(uAdd, c) - cpuBoxChannel(uSub, c);
+        }
+        pRow[x] = p;
+    }
+}
+
+inline void ARGBLumaRow_C(const uint32 *pARGB, uint8 *pLuma, uint32 width)
+{
+    for (uint32 x = 0; x < width; x++)
+    {
+        uint32 p = pARGB[x];
+        pLuma[x] = (uint8)((54 * ((p >> 16) & 0xff) + 183 * ((p >> 8) & 0xff) + 19 * (p & 0xff) + 128) >> 8);
+    }
+}
+
+inline void ShiftLumaRow_C(uint32 *pARGB, const uint8 *pOld, const uint8 *pNew, uint32 width)
+{
+    for (uint32 x = 0; x < width; x++)
+    {
+        int32 nDelta = (int32)pNew[x] - (int32)pOld[x];
+        uint32 p = pARGB[x] & 0xff000000;
+
+        for (uint32 c = 0; c < 3; c++)
+        {
+            p |= (uint32)nvClamp((int32)cpuBoxChannel(pARGB[x], c) + nDelta, 255) << (8 * c);
+        }
+        pARGB[x] = p;
+    }
+}
+
+// The medians are min/max networks with no branches, written once on an
+// OPS type per ISA: V a vector of BYTES bytes, Load/Store unaligned, and
+// Min/Max per byte. Each column of the window is sorted once, into a chunk
+// of CPU_MEDIAN_CHUNK_BYTES that stays in L1, and its sort is shared by
+// the N outputs whose window has it.
+#define CPU_MEDIAN_CHUNK_BYTES 1024
+
+struct CpuMedianOps_C
+{
+    typedef uint8 V;
+    enum { BYTES = 1 };
+
+    static V Load(const uint8 *p)     { return *p; }
+    static void Store(uint8 *p, V v)  { *p = v; }
+    static V Min(V a, V b)            { return a < b ? a : b; }
+    static V Max(V a, V b)            { return a < b ? b : a; }
+};
+
+template <class OPS>
+static inline void cpuMedianSort(typename OPS::V &a, typename OPS::V &b)
+{
+    typename OPS::V t = OPS::Min(a, b);
+    b = OPS::Max(a, b);
+    a = t;
+}
+
+template <class OPS>
+static inline typename OPS::V cpuMedianOf3(typename OPS::V a, typename OPS::V b, typename OPS::V c)
+{
+    return OPS::Max(OPS::Min(a, b), OPS::Min(OPS::Max(a, b), c));
+}
+
+// Columns() sorts the N values of a column, Window() takes the N sorted
+// columns of a window in v[N * column + rank] and returns the median.
+template <class OPS, int N>
+struct CpuMedianNetwork;
+
+template <class OPS>
+struct CpuMedianNetwork<OPS, 3>
+{
+    typedef typename OPS::V V;
+
+    static inline void Columns(V *c)
+    {
+        cpuMedianSort<OPS>(c[0], c[1]);
+        cpuMedianSort<OPS>(c[1], c[2]);
+        cpuMedianSort<OPS>(c[0], c[1]);
+    }
+
+    // the median of the maximum of the minima, the median of the medians
+    // and the minimum of the maxima
+    static inline V Window(V *v)
+    {
+        V lo = OPS::Max(OPS::Max(v[0], v[3]), v[6]);
+        V hi = OPS::Min(OPS::Min(v[2], v[5]), v[8]);
+        return cpuMedianOf3<OPS>(lo, cpuMedianOf3<OPS>(v[1], v[4], v[7]), hi);
+    }
+};
+
+template <class OPS>
+struct CpuMedianNetwork<OPS, 5>
+{
+    typedef typename OPS::V V;
+
+    static inline void Columns(V *c)
+    {
+        cpuMedianSort<OPS>(c[0], c[1]);
+        cpuMedianSort<OPS>(c[3], c[4]);
+        cpuMedianSort<OPS>(c[2], c[4]);
+        cpuMedianSort<OPS>(c[2], c[3]);
+        cpuMedianSort<OPS>(c[1], c[4]);
+        cpuMedianSort<OPS>(c[0], c[3]);
+        cpuMedianSort<OPS>(c[0], c[2]);
+        cpuMedianSort<OPS>(c[1], c[3]);
+        cpuMedianSort<OPS>(c[1], c[2]);
+    }
+
+    // With the columns sorted, the ranks across the columns are sorted as
+    // well, which leaves 13 values that can be the median, 6 known to be
+    // below it and 6 above; a Batcher sort of those 13, with every
+    // comparison that can't swap on such input or doesn't lead to the
+    // middle one dropped, gives it in 70 steps.
+    static inline V Window(V *v)
+    {
+        cpuMedianSort<OPS>(v[0], v[5]);
+        cpuMedianSort<OPS>(v[15], v[20]);
+        cpuMedianSort<OPS>(v[10], v[20]);
+        v[15] = OPS::Max(v[10], v[15]);
+        cpuMedianSort<OPS>(v[5], v[20]);
+        v[15] = OPS::Max(v[0], v[15]);
+        v[15] = OPS::Max(v[5], v[15]);
+        cpuMedianSort<OPS>(v[1], v[6]);
+        cpuMedianSort<OPS>(v[16], v[21]);
+        cpuMedianSort<OPS>(v[11], v[21]);
+        cpuMedianSort<OPS>(v[11], v[16]);
+        cpuMedianSort<OPS>(v[6], v[21]);
+        cpuMedianSort<OPS>(v[1], v[16]);
+        v[11] = OPS::Max(v[1], v[11]);
+        cpuMedianSort<OPS>(v[6], v[16]);
+        v[11] = OPS::Max(v[6], v[11]);
+        cpuMedianSort<OPS>(v[2], v[7]);
+        cpuMedianSort<OPS>(v[17], v[22]);
+        cpuMedianSort<OPS>(v[12], v[22]);
+        cpuMedianSort<OPS>(v[12], v[17]);
+        v[7] = OPS::Min(v[7], v[22]);
+        cpuMedianSort<OPS>(v[2], v[17]);
+        v[12] = OPS::Max(v[2], v[12]);
+        cpuMedianSort<OPS>(v[7], v[17]);
+        cpuMedianSort<OPS>(v[7], v[12]);
+        cpuMedianSort<OPS>(v[3], v[8]);
+        cpuMedianSort<OPS>(v[18], v[23]);
+        cpuMedianSort<OPS>(v[13], v[23]);
+        cpuMedianSort<OPS>(v[13], v[18]);
+        v[8] = OPS::Min(v[8], v[23]);
+        cpuMedianSort<OPS>(v[3], v[18]);
+        cpuMedianSort<OPS>(v[3], v[13]);
+        v[8] = OPS::Min(v[8], v[18]);
+        cpuMedianSort<OPS>(v[8], v[13]);
+        cpuMedianSort<OPS>(v[4], v[9]);
+        cpuMedianSort<OPS>(v[19], v[24]);
+        cpuMedianSort<OPS>(v[14], v[24]);
+        cpuMedianSort<OPS>(v[14], v[19]);
+        v[9] = OPS::Min(v[9], v[24]);
+        cpuMedianSort<OPS>(v[4], v[19]);
+        cpuMedianSort<OPS>(v[4], v[14]);
+        v[9] = OPS::Min(v[9], v[19]);
+        v[9] = OPS::Min(v[9], v[14]);
+        cpuMedianSort<OPS>(v[15], v[11]);
+        cpuMedianSort<OPS>(v[20], v[16]);
+        cpuMedianSort<OPS>(v[20], v[11]);
+        cpuMedianSort<OPS>(v[21], v[7]);
+        v[7] = OPS::Min(v[7], v[17]);
+        cpuMedianSort<OPS>(v[7], v[12]);
+        cpuMedianSort<OPS>(v[15], v[21]);
+        cpuMedianSort<OPS>(v[11], v[21]);
+        cpuMedianSort<OPS>(v[20], v[7]);
+        cpuMedianSort<OPS>(v[16], v[7]);
+        cpuMedianSort<OPS>(v[20], v[11]);
+        cpuMedianSort<OPS>(v[16], v[21]);
+        cpuMedianSort<OPS>(v[7], v[12]);
+        cpuMedianSort<OPS>(v[13], v[4]);
+        cpuMedianSort<OPS>(v[8], v[13]);
+        cpuMedianSort<OPS>(v[4], v[9]);
+        v[3] = OPS::Max(v[15], v[3]);
+        v[21] = OPS::Min(v[21], v[9]);
+        v[3] = OPS::Max(v[21], v[3]);
+        v[13] = OPS::Max(v[11], v[13]);
+        v[12] = OPS::Min(v[12], v[13]);
+        v[12] = OPS::Min(v[12], v[3]);
+        v[8] = OPS::Max(v[20], v[8]);
+        v[7] = OPS::Min(v[7], v[8]);
+        v[16] = OPS::Min(v[16], v[4]);
+        v[7] = OPS::Max(v[16], v[7]);
+        v[12] = OPS::Max(v[7], v[12]);
+        return v[12];
+    }
+};
+
+template <class OPS, int N>
+void cpuMedianRow(const uint8 *const *ppRows, uint8 *pDst, uint32 nBytes, uint32 nStep)
+{
+    typedef typename OPS::V V;
+    const uint32 nHalo = N / 2 * nStep;
+
+    // too short for one vector
+    if (nBytes < (uint32)OPS::BYTES)
+    {
+        cpuMedianRow<CpuMedianOps_C, N>(ppRows, pDst, nBytes, nStep);
+        return;
+    }
+
+    // rank r of the column nHalo bytes before byte i of the chunk at aSorted[r][i]
+    uint8 aSorted[N][CPU_MEDIAN_CHUNK_BYTES + 16];
+
+    for (uint32 x0 = 0; x0 < nBytes; x0 += CPU_MEDIAN_CHUNK_BYTES)
+    {
+        // the last vector of a chunk steps back over bytes already done
+        // rather than past its end, so the last chunk has at least one
+        uint32 nChunk = std::min((uint32)CPU_MEDIAN_CHUNK_BYTES, nBytes - x0);
+        if (nChunk < (uint32)OPS::BYTES)
+        {
+            x0 = nBytes - OPS::BYTES;
+            nChunk = OPS::BYTES;
+        }
+        uint32 nColumns = nChunk + 2 * nHalo;
+
+        for (uint32 i = 0; i < nColumns; i += OPS::BYTES)
+        {
+            uint32 j = std::min(i, nColumns - OPS::BYTES);
+            V c[N];
+
+            for (int r = 0; r < N; r++)
+            {
+                c[r] = OPS::Load(ppRows[r] - nHalo + x0 + j);
+            }
+            CpuMedianNetwork<OPS, N>::Columns(c);
+            for (int r = 0; r < N; r++)
+            {
+                OPS::Store(aSorted[r] + j, c[r]);
+            }
+        }
+
+        for (uint32 i = 0; i < nChunk; i += OPS::BYTES)
+        {
+            uint32 j = std::min(i, nChunk - OPS::BYTES);
+            V v[N * N];
+
+            for (int k = 0; k < N; k++)
+            {
+                for (int r = 0; r < N; r++)
+                {
+                    v[N * k + r] = OPS::Load(aSorted[r] + j + k * nStep);
+                }
+            }
+            OPS::Store(pDst + x0 + j, CpuMedianNetwork<OPS, N>::Window(v));
+        }
+    }
+}
+
+// Coefficient pair (lo, hi) for pmaddwd-style multiplies on int32 lanes
+// holding two int16 values: lo * lane[15:0] + hi * lane[31:16].
+static inline int32 cpuCoeffPair(int32 lo, int32 hi)
+{
+    return (int32)(((uint32)hi << 16) | ((uint32)lo & 0xffff));
+}
+
+#endif
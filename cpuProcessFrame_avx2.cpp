@@ -0,0 +1,464 @@
+/*
+ * Copyright 1993-2015 NVIDIA Corporation.  All rights reserved.
+ *
+ * Please refer to the NVIDIA end user license agreement (EULA) associated
+ * with this source code for terms and conditions that govern your use of
+ * this software. Any use, reproduction, disclosure, or distribution of
+ * this software and related documentation outside the terms of the EULA
+ * is strictly prohibited.
+ *
+ */
+
+// Built with -mavx2; only called after cpuDetectISA() has seen AVX2.
+// Same lane layout as the SSE4.1 file, 8 pixels per vector.
+
+#include "cpuProcessFrameKernels.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#include <immintrin.h>
+
+static inline __m256i pair16(__m256i lo, __m256i hi)
+{
+    return _mm256_or_si256(_mm256_and_si256(lo, _mm256_set1_epi32(0xffff)), _mm256_slli_epi32(hi, 16));
+}
+
+static inline __m128i clampMax(__m128i x, int32 max)
+{
+    return _mm_min_epi32(_mm_max_epi32(x, _mm_setzero_si128()), _mm_set1_epi32(max));
+}
+
+static inline __m256i clampMax(__m256i x, int32 max)
+{
+    return _mm256_min_epi32(_mm256_max_epi32(x, _mm256_setzero_si256()), _mm256_set1_epi32(max));
+}
+
+// The packs work within each 128-bit lane, which keeps pixels 0-3 in the
+// low lane and 4-7 in the high one, so no cross-lane fixup is needed.
+static inline __m256i packARGB8(__m256i r, __m256i g, __m256i b)
+{
+    const __m256i shufARGB = _mm256_setr_epi8(0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15,
+                                              0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15);
+
+    __m256i bgra = _mm256_packus_epi16(_mm256_packs_epi32(b, g), _mm256_packs_epi32(r, _mm256_set1_epi32(255)));
+    return _mm256_shuffle_epi8(bgra, shufARGB);
+}
+
+// 8 pixels of luma and chroma, as int32 lanes, to unclamped R, G, B
+template <class CM>
+static inline void yuv2rgb8(__m256i luma, __m256i cb, __m256i cr, __m256i &r, __m256i &g, __m256i &b)
+{
+    const __m256i round = _mm256_set1_epi32(1 << (NV_COLOR_Q - 1));
+
+    __m256i y = _mm256_sub_epi32(luma, _mm256_set1_epi32(CM::YOffset));
+    __m256i u = _mm256_sub_epi32(cb, _mm256_set1_epi32(CM::CMid));
+    __m256i v = _mm256_sub_epi32(cr, _mm256_set1_epi32(CM::CMid));
+
+    __m256i yu = pair16(y, u);
+    __m256i yv = pair16(y, v);
+    __m256i v1 = pair16(v, _mm256_set1_epi32(1));
+
+    r = _mm256_add_epi32(_mm256_madd_epi16(yv, _mm256_set1_epi32(cpuCoeffPair(CM::Y, CM::RV))), round);
+    g = _mm256_add_epi32(_mm256_madd_epi16(yu, _mm256_set1_epi32(cpuCoeffPair(CM::Y, CM::GU))),
+                         _mm256_madd_epi16(v1, _mm256_set1_epi32(cpuCoeffPair(CM::GV, 1 << (NV_COLOR_Q - 1)))));
+    b = _mm256_add_epi32(_mm256_madd_epi16(yu, _mm256_set1_epi32(cpuCoeffPair(CM::Y, CM::BU))), round);
+
+    r = _mm256_srai_epi32(r, NV_COLOR_Q);
+    g = _mm256_srai_epi32(g, NV_COLOR_Q);
+    b = _mm256_srai_epi32(b, NV_COLOR_Q);
+}
+
+template <class CM>
+void NV12toARGBRow_AVX2(const uint8 *pLuma, const uint8 *pChroma0, const uint8 *pChroma1,
+                        uint32 *pDst, uint32 width)
+{
+    // replicate each Cb (even byte) and Cr (odd byte) to its 2 pixels
+    const __m128i shufCb = _mm_setr_epi8(0, 0, 2, 2, 4, 4, 6, 6, -1, -1, -1, -1, -1, -1, -1, -1);
+    const __m128i shufCr = _mm_setr_epi8(1, 1, 3, 3, 5, 5, 7, 7, -1, -1, -1, -1, -1, -1, -1, -1);
+
+    uint32 x = 0;
+    for (; x + 8 <= width; x += 8)
+    {
+        __m128i y8 = _mm_loadl_epi64((const __m128i *)(pLuma + x));
+        __m128i c8 = _mm_avg_epu8(_mm_loadl_epi64((const __m128i *)(pChroma0 + x)),
+                                  _mm_loadl_epi64((const __m128i *)(pChroma1 + x)));
+
+        __m256i r, g, b;
+        yuv2rgb8<CM>(_mm256_cvtepu8_epi32(y8), _mm256_cvtepu8_epi32(_mm_shuffle_epi8(c8, shufCb)),
+                     _mm256_cvtepu8_epi32(_mm_shuffle_epi8(c8, shufCr)), r, g, b);
+
+        _mm256_storeu_si256((__m256i *)(pDst + x), packARGB8(r, g, b));
+    }
+
+    NV12toARGBRow_C<CM>(pLuma + x, pChroma0 + x, pChroma1 + x, pDst + x, width - x);
+}
+
+// unclamped luma of 8 pixels from (b, r) pairs and g
+template <class CM>
+static inline __m256i rgb2y8(__m256i br, __m256i g)
+{
+    const __m256i bias = _mm256_set1_epi32((CM::YOffset << NV_COLOR_Q) + (1 << (NV_COLOR_Q - 1)));
+
+    __m256i y = _mm256_add_epi32(_mm256_madd_epi16(br, _mm256_set1_epi32(cpuCoeffPair(CM::YB, CM::YR))),
+                                 _mm256_madd_epi16(g, _mm256_set1_epi32(cpuCoeffPair(CM::YG, 0))));
+    return _mm256_srai_epi32(_mm256_add_epi32(y, bias), NV_COLOR_Q);
+}
+
+// 8 int32 lanes stored as bytes; the packs saturate to [0, 255]
+static inline void storeBytes8(uint8 *pDst, __m256i y)
+{
+    __m128i y16 = _mm_packs_epi32(_mm256_castsi256_si128(y), _mm256_extracti128_si256(y, 1));
+    _mm_storel_epi64((__m128i *)pDst, _mm_packus_epi16(y16, y16));
+}
+
+// one chroma component from quad sums of (b, r) pairs and of g
+template <class CM>
+static inline __m128i rgb2c4(__m128i sbr, __m128i sg, int32 kb, int32 kr, int32 kg)
+{
+    const __m128i bias = _mm_set1_epi32((CM::CMid << (NV_COLOR_Q + 2)) + (1 << (NV_COLOR_Q + 1)));
+
+    __m128i c = _mm_add_epi32(_mm_madd_epi16(sbr, _mm_set1_epi32(cpuCoeffPair(kb, kr))),
+                              _mm_madd_epi16(sg, _mm_set1_epi32(cpuCoeffPair(kg, 0))));
+    return clampMax(_mm_srai_epi32(_mm_add_epi32(c, bias), NV_COLOR_Q + 2), CM::Max);
+}
+
+template <class CM>
+static inline __m256i rgb2c8(__m256i sbr, __m256i sg, int32 kb, int32 kr, int32 kg)
+{
+    const __m256i bias = _mm256_set1_epi32((CM::CMid << (NV_COLOR_Q + 2)) + (1 << (NV_COLOR_Q + 1)));
+
+    __m256i c = _mm256_add_epi32(_mm256_madd_epi16(sbr, _mm256_set1_epi32(cpuCoeffPair(kb, kr))),
+                                 _mm256_madd_epi16(sg, _mm256_set1_epi32(cpuCoeffPair(kg, 0))));
+    return clampMax(_mm256_srai_epi32(_mm256_add_epi32(c, bias), NV_COLOR_Q + 2), CM::Max);
+}
+
+// 8 pixels per row to 4 int32 quad sums
+static inline __m128i quadSum4(__m256i c0, __m256i c1)
+{
+    __m256i h = _mm256_hadd_epi32(_mm256_add_epi32(c0, c1), _mm256_setzero_si256());
+    return _mm256_castsi256_si128(_mm256_permute4x64_epi64(h, _MM_SHUFFLE(3, 1, 2, 0)));
+}
+
+template <class CM>
+void ARGBtoNV12Row_AVX2(const uint32 *pSrc0, const uint32 *pSrc1,
+                        uint8 *pLuma0, uint8 *pLuma1, uint8 *pChroma, uint32 width)
+{
+    const __m256i maskBR = _mm256_set1_epi32(0x00ff00ff);
+    const __m256i maskG  = _mm256_set1_epi32(0xff);
+
+    uint32 x = 0;
+    for (; x + 8 <= width; x += 8)
+    {
+        __m256i p0 = _mm256_loadu_si256((const __m256i *)(pSrc0 + x));
+        __m256i p1 = _mm256_loadu_si256((const __m256i *)(pSrc1 + x));
+
+        __m256i br0 = _mm256_and_si256(p0, maskBR);
+        __m256i g0  = _mm256_and_si256(_mm256_srli_epi32(p0, 8), maskG);
+        __m256i br1 = _mm256_and_si256(p1, maskBR);
+        __m256i g1  = _mm256_and_si256(_mm256_srli_epi32(p1, 8), maskG);
+
+        storeBytes8(pLuma0 + x, rgb2y8<CM>(br0, g0));
+        storeBytes8(pLuma1 + x, rgb2y8<CM>(br1, g1));
+
+        // sums over the 4 quads
+        __m128i sbr = quadSum4(br0, br1);
+        __m128i sg  = quadSum4(g0, g1);
+
+        __m128i cb = rgb2c4<CM>(sbr, sg, CM::UB, CM::UR, CM::UG);
+        __m128i cr = rgb2c4<CM>(sbr, sg, CM::VB, CM::VR, CM::VG);
+
+        // CbCr byte pairs
+        __m128i cbcr = _mm_or_si128(cb, _mm_slli_epi32(cr, 8));
+        _mm_storel_epi64((__m128i *)(pChroma + x), _mm_packus_epi32(cbcr, cbcr));
+    }
+
+    ARGBtoNV12Row_C<CM>(pSrc0 + x, pSrc1 + x, pLuma0 + x, pLuma1 + x, pChroma + x, width - x);
+}
+
+template <class CM>
+void YUV444toARGBRow_AVX2(const uint8 *pLuma, const uint8 *pCb, const uint8 *pCr,
+                          uint32 *pDst, uint32 width)
+{
+    uint32 x = 0;
+    for (; x + 8 <= width; x += 8)
+    {
+        __m256i r, g, b;
+        yuv2rgb8<CM>(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(pLuma + x))),
+                     _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(pCb + x))),
+                     _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(pCr + x))), r, g, b);
+
+        _mm256_storeu_si256((__m256i *)(pDst + x), packARGB8(r, g, b));
+    }
+
+    YUV444toARGBRow_C<CM>(pLuma + x, pCb + x, pCr + x, pDst + x, width - x);
+}
+
+template <class CM>
+void ARGBtoYUV444Row_AVX2(const uint32 *pSrc, uint8 *pLuma, uint8 *pCb, uint8 *pCr, uint32 width)
+{
+    const __m256i maskBR = _mm256_set1_epi32(0x00ff00ff);
+    const __m256i maskG  = _mm256_set1_epi32(0xff);
+
+    uint32 x = 0;
+    for (; x + 8 <= width; x += 8)
+    {
+        __m256i p = _mm256_loadu_si256((const __m256i *)(pSrc + x));
+
+        __m256i br = _mm256_and_si256(p, maskBR);
+        __m256i g  = _mm256_and_si256(_mm256_srli_epi32(p, 8), maskG);
+
+        storeBytes8(pLuma + x, rgb2y8<CM>(br, g));
+
+        // the quad sum of a lone pixel is 4x its colour
+        __m256i sbr = _mm256_slli_epi32(br, 2);
+        __m256i sg  = _mm256_slli_epi32(g, 2);
+
+        storeBytes8(pCb + x, rgb2c8<CM>(sbr, sg, CM::UB, CM::UR, CM::UG));
+        storeBytes8(pCr + x, rgb2c8<CM>(sbr, sg, CM::VB, CM::VR, CM::VG));
+    }
+
+    ARGBtoYUV444Row_C<CM>(pSrc + x, pLuma + x, pCb + x, pCr + x, width - x);
+}
+
+template <class CM>
+void P010toARGB2101010Row_AVX2(const uint16 *pLuma, const uint16 *pChroma0, const uint16 *pChroma1,
+                               uint32 *pDst, uint32 width)
+{
+    // replicate each 16-bit Cb (words 0, 2, ..) and Cr (words 1, 3, ..) to its 2 pixels
+    const __m128i shufCb = _mm_setr_epi8(0, 1, 0, 1, 4, 5, 4, 5, 8, 9, 8, 9, 12, 13, 12, 13);
+    const __m128i shufCr = _mm_setr_epi8(2, 3, 2, 3, 6, 7, 6, 7, 10, 11, 10, 11, 14, 15, 14, 15);
+
+    uint32 x = 0;
+    for (; x + 8 <= width; x += 8)
+    {
+        __m128i y8 = _mm_srli_epi16(_mm_loadu_si128((const __m128i *)(pLuma + x)), NV_P010_SHIFT);
+        __m128i c8 = _mm_avg_epu16(_mm_srli_epi16(_mm_loadu_si128((const __m128i *)(pChroma0 + x)), NV_P010_SHIFT),
+                                   _mm_srli_epi16(_mm_loadu_si128((const __m128i *)(pChroma1 + x)), NV_P010_SHIFT));
+
+        __m256i r, g, b;
+        yuv2rgb8<CM>(_mm256_cvtepu16_epi32(y8), _mm256_cvtepu16_epi32(_mm_shuffle_epi8(c8, shufCb)),
+                     _mm256_cvtepu16_epi32(_mm_shuffle_epi8(c8, shufCr)), r, g, b);
+
+        __m256i argb = _mm256_or_si256(_mm256_or_si256(_mm256_slli_epi32(clampMax(r, CM::Max), 20),
+                                                       _mm256_slli_epi32(clampMax(g, CM::Max), 10)),
+                                       _mm256_or_si256(clampMax(b, CM::Max), _mm256_set1_epi32((int32)0xc0000000)));
+
+        _mm256_storeu_si256((__m256i *)(pDst + x), argb);
+    }
+
+    P010toARGB2101010Row_C<CM>(pLuma + x, pChroma0 + x, pChroma1 + x, pDst + x, width - x);
+}
+
+// 8 10-bit luma values stored as P010 words
+static inline void storeLuma8x10(uint16 *pDst, __m256i y)
+{
+    y = _mm256_slli_epi32(clampMax(y, 1023), NV_P010_SHIFT);
+    _mm_storeu_si128((__m128i *)pDst, _mm_packus_epi32(_mm256_castsi256_si128(y), _mm256_extracti128_si256(y, 1)));
+}
+
+template <class CM>
+void ARGB2101010toP010Row_AVX2(const uint32 *pSrc0, const uint32 *pSrc1,
+                               uint16 *pLuma0, uint16 *pLuma1, uint16 *pChroma, uint32 width)
+{
+    const __m256i maskB = _mm256_set1_epi32(0x3ff);
+    const __m256i maskR = _mm256_set1_epi32(0x3ff0000);
+
+    uint32 x = 0;
+    for (; x + 8 <= width; x += 8)
+    {
+        __m256i p0 = _mm256_loadu_si256((const __m256i *)(pSrc0 + x));
+        __m256i p1 = _mm256_loadu_si256((const __m256i *)(pSrc1 + x));
+
+        // R moves from bit 20 to the upper int16 half, B stays in the lower
+        __m256i br0 = _mm256_or_si256(_mm256_and_si256(p0, maskB), _mm256_and_si256(_mm256_srli_epi32(p0, 4), maskR));
+        __m256i g0  = _mm256_and_si256(_mm256_srli_epi32(p0, 10), maskB);
+        __m256i br1 = _mm256_or_si256(_mm256_and_si256(p1, maskB), _mm256_and_si256(_mm256_srli_epi32(p1, 4), maskR));
+        __m256i g1  = _mm256_and_si256(_mm256_srli_epi32(p1, 10), maskB);
+
+        storeLuma8x10(pLuma0 + x, rgb2y8<CM>(br0, g0));
+        storeLuma8x10(pLuma1 + x, rgb2y8<CM>(br1, g1));
+
+        __m128i sbr = quadSum4(br0, br1);
+        __m128i sg  = quadSum4(g0, g1);
+
+        __m128i cb = rgb2c4<CM>(sbr, sg, CM::UB, CM::UR, CM::UG);
+        __m128i cr = rgb2c4<CM>(sbr, sg, CM::VB, CM::VR, CM::VG);
+
+        // CbCr word pairs
+        __m128i cbcr = _mm_or_si128(_mm_slli_epi32(cb, NV_P010_SHIFT), _mm_slli_epi32(cr, 16 + NV_P010_SHIFT));
+        _mm_storeu_si128((__m128i *)(pChroma + x), cbcr);
+    }
+
+    ARGB2101010toP010Row_C<CM>(pSrc0 + x, pSrc1 + x, pLuma0 + x, pLuma1 + x, pChroma + x, width - x);
+}
+
+const CpuKernels g_aCpuKernels_AVX2[CPU_KERNEL_TABLE_SIZE] = CPU_KERNEL_TABLE(AVX2);
+
+// Box blur rows as in the SSE4.1 file, one pixel per 128-bit sum; the
+// column step takes 2 pixels per 256-bit sum, 8 per iteration.
+static inline __m128i expandPixel(uint32 p)
+{
+    return _mm_cvtepu8_epi32(_mm_cvtsi32_si128((int)p));
+}
+
+static void BoxBlurRow_AVX2(const uint32 *pSrc, uint32 *pDst, uint32 width, uint32 nRadius, uint32 nScale)
+{
+    int32 r = (int32)nRadius;
+    __m128i scale = _mm_set1_epi32((int)nScale);
+    __m128i round = _mm_set1_epi32(32768);
+    __m128i s = _mm_setzero_si128();
+
+    for (int32 k = -r; k <= r; k++)
+    {
+        s = _mm_add_epi32(s, expandPixel(pSrc[k]));
+    }
+
+    for (int32 x = 0; x < (int32)width; x++)
+    {
+        __m128i v = _mm_srli_epi32(_mm_add_epi32(_mm_mullo_epi32(s, scale), round), 16);
+        v = _mm_packus_epi16(_mm_packus_epi32(v, v), v);
+        pDst[x] = (uint32)_mm_cvtsi128_si32(v);
+
+        s = _mm_add_epi32(s, _mm_sub_epi32(expandPixel(pSrc[x + r + 1]), expandPixel(pSrc[x - r])));
+    }
+}
+
+// pixels 2I and 2I + 1 of 8 join their window sums; returns the scaled
+// sums from before
+template <int I>
+static inline __m256i boxColumns2(uint32 *pSums, const uint32 *pAdd, const uint32 *pSub, __m256i scale)
+{
+    __m256i s = _mm256_loadu_si256((const __m256i *)(pSums + 8 * I));
+    __m256i a = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(pAdd + 2 * I)));
+    __m256i b = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(pSub + 2 * I)));
+
+    _mm256_storeu_si256((__m256i *)(pSums + 8 * I), _mm256_add_epi32(s, _mm256_sub_epi32(a, b)));
+    return _mm256_srli_epi32(_mm256_add_epi32(_mm256_mullo_epi32(s, scale), _mm256_set1_epi32(32768)), 16);
+}
+
+static void BoxBlurColumns_AVX2(uint32 *pSums, const uint32 *pAdd, const uint32 *pSub, uint32 *pDst,
+                                uint32 nPixels, uint32 nScale)
+{
+    __m256i scale = _mm256_set1_epi32((int)nScale);
+    // the packs work within 128-bit lanes and leave pixels 0 2 4 6 | 1 3 5 7
+    __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+    uint32 x = 0;
+
+    for (; x + 8 <= nPixels; x += 8)
+    {
+        uint32 *s = pSums + 4 * x;
+        __m256i o0 = boxColumns2<0>(s, pAdd + x, pSub + x, scale);
+        __m256i o1 = boxColumns2<1>(s, pAdd + x, pSub + x, scale);
+        __m256i o2 = boxColumns2<2>(s, pAdd + x, pSub + x, scale);
+        __m256i o3 = boxColumns2<3>(s, pAdd + x, pSub + x, scale);
+
+        __m256i o = _mm256_packus_epi16(_mm256_packus_epi32(o0, o1), _mm256_packus_epi32(o2, o3));
+        _mm256_storeu_si256((__m256i *)(pDst + x), _mm256_permutevar8x32_epi32(o, order));
+    }
+
+    BoxBlurColumns_C(pSums + 4 * x, pAdd + x, pSub + x, pDst + x, nPixels - x, nScale);
+}
+
+// Unsharp mask on pixels 2I and 2I + 1 of 8: sharpened int32 channels, and
+// the window sums moved on
+template <int I>
+static inline __m256i unsharpPixels2(uint32 *pSums, const uint32 *pAdd, const uint32 *pSub, const uint32 *pRow,
+                                     __m256i scale, __m256i amount, __m256i threshold)
+{
+    __m256i o = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(pRow + 2 * I)));
+    __m256i d = _mm256_sub_epi32(o, boxColumns2<I>(pSums, pAdd, pSub, scale));
+    __m256i m = _mm256_cmpgt_epi32(_mm256_abs_epi32(d), threshold);
+    __m256i v = _mm256_srai_epi32(_mm256_add_epi32(_mm256_mullo_epi32(d, amount), _mm256_set1_epi32(128)), 8);
+
+    return _mm256_add_epi32(o, _mm256_and_si256(v, m));
+}
+
+static void UnsharpRow_AVX2(uint32 *pSums, const uint32 *pAdd, const uint32 *pSub, uint32 *pRow,
+                            uint32 width, uint32 nScale, int32 nAmount, int32 nThreshold)
+{
+    __m256i scale = _mm256_set1_epi32((int)nScale);
+    __m256i amount = _mm256_set1_epi32(nAmount);
+    __m256i threshold = _mm256_set1_epi32(nThreshold);
+    __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+    uint32 x = 0;
+
+    for (; x + 8 <= width; x += 8)
+    {
+        uint32 *s = pSums + 4 * x;
+        __m256i o0 = unsharpPixels2<0>(s, pAdd + x, pSub + x, pRow + x, scale, amount, threshold);
+        __m256i o1 = unsharpPixels2<1>(s, pAdd + x, pSub + x, pRow + x, scale, amount, threshold);
+        __m256i o2 = unsharpPixels2<2>(s, pAdd + x, pSub + x, pRow + x, scale, amount, threshold);
+        __m256i o3 = unsharpPixels2<3>(s, pAdd + x, pSub + x, pRow + x, scale, amount, threshold);
+
+        __m256i o = _mm256_packus_epi16(_mm256_packus_epi32(o0, o1), _mm256_packus_epi32(o2, o3));
+        _mm256_storeu_si256((__m256i *)(pRow + x), _mm256_permutevar8x32_epi32(o, order));
+    }
+
+    UnsharpRow_C(pSums + 4 * x, pAdd + x, pSub + x, pRow + x, width - x, nScale, nAmount, nThreshold);
+}
+
+// Luma of 8 ARGB pixels in the low byte of each int32 lane
+static inline __m256i lumaPixels(__m256i p)
+{
+    __m256i m = _mm256_set1_epi32(0xff);
+    __m256i y = _mm256_mullo_epi32(_mm256_and_si256(_mm256_srli_epi32(p, 16), m), _mm256_set1_epi32(54));
+    y = _mm256_add_epi32(y, _mm256_mullo_epi32(_mm256_and_si256(_mm256_srli_epi32(p, 8), m), _mm256_set1_epi32(183)));
+    y = _mm256_add_epi32(y, _mm256_mullo_epi32(_mm256_and_si256(p, m), _mm256_set1_epi32(19)));
+    return _mm256_srli_epi32(_mm256_add_epi32(y, _mm256_set1_epi32(128)), 8);
+}
+
+static void ARGBLumaRow_AVX2(const uint32 *pARGB, uint8 *pLuma, uint32 width)
+{
+    // after the packs dwords 0, 1, 4 and 5 hold pixels 0-3, 8-11, 4-7, 12-15
+    __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+    uint32 x = 0;
+
+    for (; x + 16 <= width; x += 16)
+    {
+        __m256i y0 = lumaPixels(_mm256_loadu_si256((const __m256i *)(pARGB + x)));
+        __m256i y1 = lumaPixels(_mm256_loadu_si256((const __m256i *)(pARGB + x + 8)));
+        __m256i y = _mm256_packus_epi32(y0, y1);
+        y = _mm256_permutevar8x32_epi32(_mm256_packus_epi16(y, y), order);
+        _mm_storeu_si128((__m128i *)(pLuma + x), _mm256_castsi256_si128(y));
+    }
+
+    ARGBLumaRow_C(pARGB + x, pLuma + x, width - x);
+}
+
+// as ShiftLumaRow_SSE41, 8 pixels at a time
+static void ShiftLumaRow_AVX2(uint32 *pARGB, const uint8 *pOld, const uint8 *pNew, uint32 width)
+{
+    __m256i spread = _mm256_set1_epi32(0x010101);
+    uint32 x = 0;
+
+    for (; x + 8 <= width; x += 8)
+    {
+        __m128i o = _mm_loadl_epi64((const __m128i *)(pOld + x));
+        __m128i n = _mm_loadl_epi64((const __m128i *)(pNew + x));
+        __m256i up = _mm256_mullo_epi32(_mm256_cvtepu8_epi32(_mm_subs_epu8(n, o)), spread);
+        __m256i down = _mm256_mullo_epi32(_mm256_cvtepu8_epi32(_mm_subs_epu8(o, n)), spread);
+        __m256i p = _mm256_loadu_si256((const __m256i *)(pARGB + x));
+
+        _mm256_storeu_si256((__m256i *)(pARGB + x), _mm256_subs_epu8(_mm256_adds_epu8(p, up), down));
+    }
+
+    ShiftLumaRow_C(pARGB + x, pOld + x, pNew + x, width - x);
+}
+
+// the medians of cpuProcessFrameKernels.h on 32 bytes at a time
+struct MedianOps_AVX2
+{
+    typedef __m256i V;
+    enum { BYTES = 32 };
+
+    static V Load(const uint8 *p)     { return _mm256_loadu_si256((const __m256i *)p); }
+    static void Store(uint8 *p, V v)  { _mm256_storeu_si256((__m256i *)p, v); }
+    static V Min(V a, V b)            { return _mm256_min_epu8(a, b); }
+    static V Max(V a, V b)            { return _mm256_max_epu8(a, b); }
+};
+
+const CpuFilterKernels g_oCpuFilterKernels_AVX2 = { BoxBlurRow_AVX2, BoxBlurColumns_AVX2, UnsharpRow_AVX2,
+                                                    cpuMedianRow<MedianOps_AVX2, 3>, cpuMedianRow<MedianOps_AVX2, 5>,
+                                                    ARGBLumaRow_AVX2, ShiftLumaRow_AVX2 };
+
+#endif
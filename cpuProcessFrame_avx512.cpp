@@ -0,0 +1,440 @@
+/*
+ * Copyright 1993-2015 NVIDIA Corporation.  All rights reserved.
+ *
+ * Please refer to the NVIDIA end user license agreement (EULA) associated
+ * with this source code for terms and conditions that govern your use of
+ * this software. Any use, reproduction, disclosure, or distribution of
+ * this software and related documentation outside the terms of the EULA
+ * is strictly prohibited.
+ *
+ */
+
+// Built with -mavx512f -mavx512bw; only called after cpuDetectISA() has
+// seen both. The int16 multiplies and packs need BW, which every AVX-512
+// part except Xeon Phi has. Same lane layout as the SSE4.1 file, 16 pixels
+// per vector.
+
+#include "cpuProcessFrameKernels.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#include <immintrin.h>
+
+static inline __m512i pair16(__m512i lo, __m512i hi)
+{
+    return _mm512_or_si512(_mm512_and_si512(lo, _mm512_set1_epi32(0xffff)), _mm512_slli_epi32(hi, 16));
+}
+
+static inline __m256i clampMax(__m256i x, int32 max)
+{
+    return _mm256_min_epi32(_mm256_max_epi32(x, _mm256_setzero_si256()), _mm256_set1_epi32(max));
+}
+
+static inline __m512i clampMax(__m512i x, int32 max)
+{
+    return _mm512_min_epi32(_mm512_max_epi32(x, _mm512_setzero_si512()), _mm512_set1_epi32(max));
+}
+
+// packs and shuffle stay within 128-bit lanes, see packARGB8 in the AVX2 file
+static inline __m512i packARGB16(__m512i r, __m512i g, __m512i b)
+{
+    const __m512i shufARGB = _mm512_broadcast_i32x4(_mm_setr_epi8(0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15));
+
+    __m512i bgra = _mm512_packus_epi16(_mm512_packs_epi32(b, g), _mm512_packs_epi32(r, _mm512_set1_epi32(255)));
+    return _mm512_shuffle_epi8(bgra, shufARGB);
+}
+
+// 16 pixels of luma and chroma, as int32 lanes, to unclamped R, G, B
+template <class CM>
+static inline void yuv2rgb16(__m512i luma, __m512i cb, __m512i cr, __m512i &r, __m512i &g, __m512i &b)
+{
+    const __m512i round = _mm512_set1_epi32(1 << (NV_COLOR_Q - 1));
+
+    __m512i y = _mm512_sub_epi32(luma, _mm512_set1_epi32(CM::YOffset));
+    __m512i u = _mm512_sub_epi32(cb, _mm512_set1_epi32(CM::CMid));
+    __m512i v = _mm512_sub_epi32(cr, _mm512_set1_epi32(CM::CMid));
+
+    __m512i yu = pair16(y, u);
+    __m512i yv = pair16(y, v);
+    __m512i v1 = pair16(v, _mm512_set1_epi32(1));
+
+    r = _mm512_add_epi32(_mm512_madd_epi16(yv, _mm512_set1_epi32(cpuCoeffPair(CM::Y, CM::RV))), round);
+    g = _mm512_add_epi32(_mm512_madd_epi16(yu, _mm512_set1_epi32(cpuCoeffPair(CM::Y, CM::GU))),
+                         _mm512_madd_epi16(v1, _mm512_set1_epi32(cpuCoeffPair(CM::GV, 1 << (NV_COLOR_Q - 1)))));
+    b = _mm512_add_epi32(_mm512_madd_epi16(yu, _mm512_set1_epi32(cpuCoeffPair(CM::Y, CM::BU))), round);
+
+    r = _mm512_srai_epi32(r, NV_COLOR_Q);
+    g = _mm512_srai_epi32(g, NV_COLOR_Q);
+    b = _mm512_srai_epi32(b, NV_COLOR_Q);
+}
+
+template <class CM>
+void NV12toARGBRow_AVX512(const uint8 *pLuma, const uint8 *pChroma0, const uint8 *pChroma1,
+                          uint32 *pDst, uint32 width)
+{
+    // replicate each Cb (even byte) and Cr (odd byte) to its 2 pixels
+    const __m128i shufCb = _mm_setr_epi8(0, 0, 2, 2, 4, 4, 6, 6, 8, 8, 10, 10, 12, 12, 14, 14);
+    const __m128i shufCr = _mm_setr_epi8(1, 1, 3, 3, 5, 5, 7, 7, 9, 9, 11, 11, 13, 13, 15, 15);
+
+    uint32 x = 0;
+    for (; x + 16 <= width; x += 16)
+    {
+        __m128i y16 = _mm_loadu_si128((const __m128i *)(pLuma + x));
+        __m128i c16 = _mm_avg_epu8(_mm_loadu_si128((const __m128i *)(pChroma0 + x)),
+                                   _mm_loadu_si128((const __m128i *)(pChroma1 + x)));
+
+        __m512i r, g, b;
+        yuv2rgb16<CM>(_mm512_cvtepu8_epi32(y16), _mm512_cvtepu8_epi32(_mm_shuffle_epi8(c16, shufCb)),
+                      _mm512_cvtepu8_epi32(_mm_shuffle_epi8(c16, shufCr)), r, g, b);
+
+        _mm512_storeu_si512((void *)(pDst + x), packARGB16(r, g, b));
+    }
+
+    NV12toARGBRow_C<CM>(pLuma + x, pChroma0 + x, pChroma1 + x, pDst + x, width - x);
+}
+
+// unclamped luma of 16 pixels from (b, r) pairs and g; never negative
+template <class CM>
+static inline __m512i rgb2y16(__m512i br, __m512i g)
+{
+    const __m512i bias = _mm512_set1_epi32((CM::YOffset << NV_COLOR_Q) + (1 << (NV_COLOR_Q - 1)));
+
+    __m512i y = _mm512_add_epi32(_mm512_madd_epi16(br, _mm512_set1_epi32(cpuCoeffPair(CM::YB, CM::YR))),
+                                 _mm512_madd_epi16(g, _mm512_set1_epi32(cpuCoeffPair(CM::YG, 0))));
+    return _mm512_srai_epi32(_mm512_add_epi32(y, bias), NV_COLOR_Q);
+}
+
+// one chroma component from quad sums of (b, r) pairs and of g
+template <class CM>
+static inline __m256i rgb2c8(__m256i sbr, __m256i sg, int32 kb, int32 kr, int32 kg)
+{
+    const __m256i bias = _mm256_set1_epi32((CM::CMid << (NV_COLOR_Q + 2)) + (1 << (NV_COLOR_Q + 1)));
+
+    __m256i c = _mm256_add_epi32(_mm256_madd_epi16(sbr, _mm256_set1_epi32(cpuCoeffPair(kb, kr))),
+                                 _mm256_madd_epi16(sg, _mm256_set1_epi32(cpuCoeffPair(kg, 0))));
+    return clampMax(_mm256_srai_epi32(_mm256_add_epi32(c, bias), NV_COLOR_Q + 2), CM::Max);
+}
+
+template <class CM>
+static inline __m512i rgb2c16(__m512i sbr, __m512i sg, int32 kb, int32 kr, int32 kg)
+{
+    const __m512i bias = _mm512_set1_epi32((CM::CMid << (NV_COLOR_Q + 2)) + (1 << (NV_COLOR_Q + 1)));
+
+    __m512i c = _mm512_add_epi32(_mm512_madd_epi16(sbr, _mm512_set1_epi32(cpuCoeffPair(kb, kr))),
+                                 _mm512_madd_epi16(sg, _mm512_set1_epi32(cpuCoeffPair(kg, 0))));
+    return clampMax(_mm512_srai_epi32(_mm512_add_epi32(c, bias), NV_COLOR_Q + 2), CM::Max);
+}
+
+// 16 pixels per row to 8 int32 quad sums
+static inline __m256i quadSum8(__m512i c0, __m512i c1)
+{
+    __m512i s = _mm512_add_epi32(c0, c1);
+    return _mm512_cvtepi64_epi32(_mm512_add_epi64(s, _mm512_srli_epi64(s, 32)));
+}
+
+template <class CM>
+void ARGBtoNV12Row_AVX512(const uint32 *pSrc0, const uint32 *pSrc1,
+                          uint8 *pLuma0, uint8 *pLuma1, uint8 *pChroma, uint32 width)
+{
+    const __m512i maskBR = _mm512_set1_epi32(0x00ff00ff);
+    const __m512i maskG  = _mm512_set1_epi32(0xff);
+
+    uint32 x = 0;
+    for (; x + 16 <= width; x += 16)
+    {
+        __m512i p0 = _mm512_loadu_si512((const void *)(pSrc0 + x));
+        __m512i p1 = _mm512_loadu_si512((const void *)(pSrc1 + x));
+
+        __m512i br0 = _mm512_and_si512(p0, maskBR);
+        __m512i g0  = _mm512_and_si512(_mm512_srli_epi32(p0, 8), maskG);
+        __m512i br1 = _mm512_and_si512(p1, maskBR);
+        __m512i g1  = _mm512_and_si512(_mm512_srli_epi32(p1, 8), maskG);
+
+        // luma is never negative, so unsigned saturation is the clamp
+        _mm_storeu_si128((__m128i *)(pLuma0 + x), _mm512_cvtusepi32_epi8(rgb2y16<CM>(br0, g0)));
+        _mm_storeu_si128((__m128i *)(pLuma1 + x), _mm512_cvtusepi32_epi8(rgb2y16<CM>(br1, g1)));
+
+        // sums over the 8 quads
+        __m256i sbr = quadSum8(br0, br1);
+        __m256i sg  = quadSum8(g0, g1);
+
+        __m256i cb = rgb2c8<CM>(sbr, sg, CM::UB, CM::UR, CM::UG);
+        __m256i cr = rgb2c8<CM>(sbr, sg, CM::VB, CM::VR, CM::VG);
+
+        // CbCr byte pairs
+        __m256i cbcr = _mm256_or_si256(cb, _mm256_slli_epi32(cr, 8));
+        _mm_storeu_si128((__m128i *)(pChroma + x),
+                         _mm_packus_epi32(_mm256_castsi256_si128(cbcr), _mm256_extracti128_si256(cbcr, 1)));
+    }
+
+    ARGBtoNV12Row_C<CM>(pSrc0 + x, pSrc1 + x, pLuma0 + x, pLuma1 + x, pChroma + x, width - x);
+}
+
+template <class CM>
+void YUV444toARGBRow_AVX512(const uint8 *pLuma, const uint8 *pCb, const uint8 *pCr,
+                            uint32 *pDst, uint32 width)
+{
+    uint32 x = 0;
+    for (; x + 16 <= width; x += 16)
+    {
+        __m512i r, g, b;
+        yuv2rgb16<CM>(_mm512_cvtepu8_epi32(_mm_loadu_si128((const __m128i *)(pLuma + x))),
+                      _mm512_cvtepu8_epi32(_mm_loadu_si128((const __m128i *)(pCb + x))),
+                      _mm512_cvtepu8_epi32(_mm_loadu_si128((const __m128i *)(pCr + x))), r, g, b);
+
+        _mm512_storeu_si512((void *)(pDst + x), packARGB16(r, g, b));
+    }
+
+    YUV444toARGBRow_C<CM>(pLuma + x, pCb + x, pCr + x, pDst + x, width - x);
+}
+
+template <class CM>
+void ARGBtoYUV444Row_AVX512(const uint32 *pSrc, uint8 *pLuma, uint8 *pCb, uint8 *pCr, uint32 width)
+{
+    const __m512i maskBR = _mm512_set1_epi32(0x00ff00ff);
+    const __m512i maskG  = _mm512_set1_epi32(0xff);
+
+    uint32 x = 0;
+    for (; x + 16 <= width; x += 16)
+    {
+        __m512i p = _mm512_loadu_si512((const void *)(pSrc + x));
+
+        __m512i br = _mm512_and_si512(p, maskBR);
+        __m512i g  = _mm512_and_si512(_mm512_srli_epi32(p, 8), maskG);
+
+        _mm_storeu_si128((__m128i *)(pLuma + x), _mm512_cvtusepi32_epi8(rgb2y16<CM>(br, g)));
+
+        // the quad sum of a lone pixel is 4x its colour
+        __m512i sbr = _mm512_slli_epi32(br, 2);
+        __m512i sg  = _mm512_slli_epi32(g, 2);
+
+        _mm_storeu_si128((__m128i *)(pCb + x), _mm512_cvtusepi32_epi8(rgb2c16<CM>(sbr, sg, CM::UB, CM::UR, CM::UG)));
+        _mm_storeu_si128((__m128i *)(pCr + x), _mm512_cvtusepi32_epi8(rgb2c16<CM>(sbr, sg, CM::VB, CM::VR, CM::VG)));
+    }
+
+    ARGBtoYUV444Row_C<CM>(pSrc + x, pLuma + x, pCb + x, pCr + x, width - x);
+}
+
+template <class CM>
+void P010toARGB2101010Row_AVX512(const uint16 *pLuma, const uint16 *pChroma0, const uint16 *pChroma1,
+                                 uint32 *pDst, uint32 width)
+{
+    // replicate each 16-bit Cb (words 0, 2, ..) and Cr (words 1, 3, ..) to
+    // its 2 pixels; pairs never straddle the 128-bit lanes
+    const __m256i shufCb = _mm256_broadcastsi128_si256(_mm_setr_epi8(0, 1, 0, 1, 4, 5, 4, 5, 8, 9, 8, 9, 12, 13, 12, 13));
+    const __m256i shufCr = _mm256_broadcastsi128_si256(_mm_setr_epi8(2, 3, 2, 3, 6, 7, 6, 7, 10, 11, 10, 11, 14, 15, 14, 15));
+
+    uint32 x = 0;
+    for (; x + 16 <= width; x += 16)
+    {
+        __m256i y16 = _mm256_srli_epi16(_mm256_loadu_si256((const __m256i *)(pLuma + x)), NV_P010_SHIFT);
+        __m256i c16 = _mm256_avg_epu16(_mm256_srli_epi16(_mm256_loadu_si256((const __m256i *)(pChroma0 + x)), NV_P010_SHIFT),
+                                       _mm256_srli_epi16(_mm256_loadu_si256((const __m256i *)(pChroma1 + x)), NV_P010_SHIFT));
+
+        __m512i r, g, b;
+        yuv2rgb16<CM>(_mm512_cvtepu16_epi32(y16), _mm512_cvtepu16_epi32(_mm256_shuffle_epi8(c16, shufCb)),
+                      _mm512_cvtepu16_epi32(_mm256_shuffle_epi8(c16, shufCr)), r, g, b);
+
+        __m512i argb = _mm512_or_si512(_mm512_or_si512(_mm512_slli_epi32(clampMax(r, CM::Max), 20),
+                                                       _mm512_slli_epi32(clampMax(g, CM::Max), 10)),
+                                       _mm512_or_si512(clampMax(b, CM::Max), _mm512_set1_epi32((int32)0xc0000000)));
+
+        _mm512_storeu_si512((void *)(pDst + x), argb);
+    }
+
+    P010toARGB2101010Row_C<CM>(pLuma + x, pChroma0 + x, pChroma1 + x, pDst + x, width - x);
+}
+
+template <class CM>
+void ARGB2101010toP010Row_AVX512(const uint32 *pSrc0, const uint32 *pSrc1,
+                                 uint16 *pLuma0, uint16 *pLuma1, uint16 *pChroma, uint32 width)
+{
+    const __m512i maskB = _mm512_set1_epi32(0x3ff);
+    const __m512i maskR = _mm512_set1_epi32(0x3ff0000);
+
+    uint32 x = 0;
+    for (; x + 16 <= width; x += 16)
+    {
+        __m512i p0 = _mm512_loadu_si512((const void *)(pSrc0 + x));
+        __m512i p1 = _mm512_loadu_si512((const void *)(pSrc1 + x));
+
+        // R moves from bit 20 to the upper int16 half, B stays in the lower
+        __m512i br0 = _mm512_or_si512(_mm512_and_si512(p0, maskB), _mm512_and_si512(_mm512_srli_epi32(p0, 4), maskR));
+        __m512i g0  = _mm512_and_si512(_mm512_srli_epi32(p0, 10), maskB);
+        __m512i br1 = _mm512_or_si512(_mm512_and_si512(p1, maskB), _mm512_and_si512(_mm512_srli_epi32(p1, 4), maskR));
+        __m512i g1  = _mm512_and_si512(_mm512_srli_epi32(p1, 10), maskB);
+
+        __m512i y0 = _mm512_slli_epi32(_mm512_min_epi32(rgb2y16<CM>(br0, g0), _mm512_set1_epi32(CM::Max)), NV_P010_SHIFT);
+        __m512i y1 = _mm512_slli_epi32(_mm512_min_epi32(rgb2y16<CM>(br1, g1), _mm512_set1_epi32(CM::Max)), NV_P010_SHIFT);
+        _mm256_storeu_si256((__m256i *)(pLuma0 + x), _mm512_cvtepi32_epi16(y0));
+        _mm256_storeu_si256((__m256i *)(pLuma1 + x), _mm512_cvtepi32_epi16(y1));
+
+        __m256i sbr = quadSum8(br0, br1);
+        __m256i sg  = quadSum8(g0, g1);
+
+        __m256i cb = rgb2c8<CM>(sbr, sg, CM::UB, CM::UR, CM::UG);
+        __m256i cr = rgb2c8<CM>(sbr, sg, CM::VB, CM::VR, CM::VG);
+
+        // CbCr word pairs
+        __m256i cbcr = _mm256_or_si256(_mm256_slli_epi32(cb, NV_P010_SHIFT), _mm256_slli_epi32(cr, 16 + NV_P010_SHIFT));
+        _mm256_storeu_si256((__m256i *)(pChroma + x), cbcr);
+    }
+
+    ARGB2101010toP010Row_C<CM>(pSrc0 + x, pSrc1 + x, pLuma0 + x, pLuma1 + x, pChroma + x, width - x);
+}
+
+const CpuKernels g_aCpuKernels_AVX512[CPU_KERNEL_TABLE_SIZE] = CPU_KERNEL_TABLE(AVX512);
+
+// Box blur: rows keep one pixel per 128-bit sum as in the SSE4.1 file; the
+// column step takes 4 pixels per 512-bit sum, 16 per iteration, and
+// narrows each sum straight back to 4 ARGB pixels with vpmovusdb.
+static inline __m128i expandPixel(uint32 p)
+{
+    return _mm_cvtepu8_epi32(_mm_cvtsi32_si128((int)p));
+}
+
+static void BoxBlurRow_AVX512(const uint32 *pSrc, uint32 *pDst, uint32 width, uint32 nRadius, uint32 nScale)
+{
+    int32 r = (int32)nRadius;
+    __m128i scale = _mm_set1_epi32((int)nScale);
+    __m128i round = _mm_set1_epi32(32768);
+    __m128i s = _mm_setzero_si128();
+
+    for (int32 k = -r; k <= r; k++)
+    {
+        s = _mm_add_epi32(s, expandPixel(pSrc[k]));
+    }
+
+    for (int32 x = 0; x < (int32)width; x++)
+    {
+        __m128i v = _mm_srli_epi32(_mm_add_epi32(_mm_mullo_epi32(s, scale), round), 16);
+        v = _mm_packus_epi16(_mm_packus_epi32(v, v), v);
+        pDst[x] = (uint32)_mm_cvtsi128_si32(v);
+
+        s = _mm_add_epi32(s, _mm_sub_epi32(expandPixel(pSrc[x + r + 1]), expandPixel(pSrc[x - r])));
+    }
+}
+
+static inline void boxColumns4(uint32 *pSums, const uint32 *pAdd, const uint32 *pSub, uint32 *pDst, __m512i scale)
+{
+    __m512i s = _mm512_loadu_si512((const void *)pSums);
+    __m512i a = _mm512_cvtepu8_epi32(_mm_loadu_si128((const __m128i *)pAdd));
+    __m512i b = _mm512_cvtepu8_epi32(_mm_loadu_si128((const __m128i *)pSub));
+    __m512i o = _mm512_srli_epi32(_mm512_add_epi32(_mm512_mullo_epi32(s, scale), _mm512_set1_epi32(32768)), 16);
+
+    _mm512_storeu_si512((void *)pSums, _mm512_add_epi32(s, _mm512_sub_epi32(a, b)));
+    _mm_storeu_si128((__m128i *)pDst, _mm512_cvtusepi32_epi8(o));
+}
+
+static void BoxBlurColumns_AVX512(uint32 *pSums, const uint32 *pAdd, const uint32 *pSub, uint32 *pDst,
+                                  uint32 nPixels, uint32 nScale)
+{
+    __m512i scale = _mm512_set1_epi32((int)nScale);
+    uint32 x = 0;
+
+    // the sums of a pixel group are read before its output is stored, so
+    // pAdd may be pDst on the last row
+    for (; x + 16 <= nPixels; x += 16)
+    {
+        boxColumns4(pSums + 4 * x,      pAdd + x,      pSub + x,      pDst + x,      scale);
+        boxColumns4(pSums + 4 * x + 16, pAdd + x + 4,  pSub + x + 4,  pDst + x + 4,  scale);
+        boxColumns4(pSums + 4 * x + 32, pAdd + x + 8,  pSub + x + 8,  pDst + x + 8,  scale);
+        boxColumns4(pSums + 4 * x + 48, pAdd + x + 12, pSub + x + 12, pDst + x + 12, scale);
+    }
+    for (; x + 4 <= nPixels; x += 4)
+    {
+        boxColumns4(pSums + 4 * x, pAdd + x, pSub + x, pDst + x, scale);
+    }
+
+    BoxBlurColumns_C(pSums + 4 * x, pAdd + x, pSub + x, pDst + x, nPixels - x, nScale);
+}
+
+static inline void unsharpPixels4(uint32 *pSums, const uint32 *pAdd, const uint32 *pSub, uint32 *pRow,
+                                  __m512i scale, __m512i amount, __m512i threshold)
+{
+    __m512i s = _mm512_loadu_si512((const void *)pSums);
+    __m512i a = _mm512_cvtepu8_epi32(_mm_loadu_si128((const __m128i *)pAdd));
+    __m512i b = _mm512_cvtepu8_epi32(_mm_loadu_si128((const __m128i *)pSub));
+    __m512i o = _mm512_cvtepu8_epi32(_mm_loadu_si128((const __m128i *)pRow));
+    __m512i blur = _mm512_srli_epi32(_mm512_add_epi32(_mm512_mullo_epi32(s, scale), _mm512_set1_epi32(32768)), 16);
+    __m512i d = _mm512_sub_epi32(o, blur);
+    __mmask16 m = _mm512_cmpgt_epi32_mask(_mm512_abs_epi32(d), threshold);
+    __m512i v = _mm512_srai_epi32(_mm512_add_epi32(_mm512_mullo_epi32(d, amount), _mm512_set1_epi32(128)), 8);
+
+    // clamped at 0 here, vpmovusdb saturates at 255
+    v = _mm512_max_epi32(_mm512_mask_add_epi32(o, m, o, v), _mm512_setzero_si512());
+    _mm512_storeu_si512((void *)pSums, _mm512_add_epi32(s, _mm512_sub_epi32(a, b)));
+    _mm_storeu_si128((__m128i *)pRow, _mm512_cvtusepi32_epi8(v));
+}
+
+static void UnsharpRow_AVX512(uint32 *pSums, const uint32 *pAdd, const uint32 *pSub, uint32 *pRow,
+                              uint32 width, uint32 nScale, int32 nAmount, int32 nThreshold)
+{
+    __m512i scale = _mm512_set1_epi32((int)nScale);
+    __m512i amount = _mm512_set1_epi32(nAmount);
+    __m512i threshold = _mm512_set1_epi32(nThreshold);
+    uint32 x = 0;
+
+    for (; x + 4 <= width; x += 4)
+    {
+        unsharpPixels4(pSums + 4 * x, pAdd + x, pSub + x, pRow + x, scale, amount, threshold);
+    }
+
+    UnsharpRow_C(pSums + 4 * x, pAdd + x, pSub + x, pRow + x, width - x, nScale, nAmount, nThreshold);
+}
+
+static void ARGBLumaRow_AVX512(const uint32 *pARGB, uint8 *pLuma, uint32 width)
+{
+    __m512i m = _mm512_set1_epi32(0xff);
+    uint32 x = 0;
+
+    for (; x + 16 <= width; x += 16)
+    {
+        __m512i p = _mm512_loadu_si512((const void *)(pARGB + x));
+        __m512i y = _mm512_mullo_epi32(_mm512_and_si512(_mm512_srli_epi32(p, 16), m), _mm512_set1_epi32(54));
+        y = _mm512_add_epi32(y, _mm512_mullo_epi32(_mm512_and_si512(_mm512_srli_epi32(p, 8), m), _mm512_set1_epi32(183)));
+        y = _mm512_add_epi32(y, _mm512_mullo_epi32(_mm512_and_si512(p, m), _mm512_set1_epi32(19)));
+        y = _mm512_srli_epi32(_mm512_add_epi32(y, _mm512_set1_epi32(128)), 8);
+        _mm_storeu_si128((__m128i *)(pLuma + x), _mm512_cvtepi32_epi8(y));
+    }
+
+    ARGBLumaRow_C(pARGB + x, pLuma + x, width - x);
+}
+
+// as ShiftLumaRow_SSE41, 16 pixels at a time
+static void ShiftLumaRow_AVX512(uint32 *pARGB, const uint8 *pOld, const uint8 *pNew, uint32 width)
+{
+    __m512i spread = _mm512_set1_epi32(0x010101);
+    uint32 x = 0;
+
+    for (; x + 16 <= width; x += 16)
+    {
+        __m128i o = _mm_loadu_si128((const __m128i *)(pOld + x));
+        __m128i n = _mm_loadu_si128((const __m128i *)(pNew + x));
+        __m512i up = _mm512_mullo_epi32(_mm512_cvtepu8_epi32(_mm_subs_epu8(n, o)), spread);
+        __m512i down = _mm512_mullo_epi32(_mm512_cvtepu8_epi32(_mm_subs_epu8(o, n)), spread);
+        __m512i p = _mm512_loadu_si512((const void *)(pARGB + x));
+
+        _mm512_storeu_si512((void *)(pARGB + x), _mm512_subs_epu8(_mm512_adds_epu8(p, up), down));
+    }
+
+    ShiftLumaRow_C(pARGB + x, pOld + x, pNew + x, width - x);
+}
+
+// the medians of cpuProcessFrameKernels.h on 64 bytes at a time
+struct MedianOps_AVX512
+{
+    typedef __m512i V;
+    enum { BYTES = 64 };
+
+    static V Load(const uint8 *p)     { return _mm512_loadu_si512((const void *)p); }
+    static void Store(uint8 *p, V v)  { _mm512_storeu_si512((void *)p, v); }
+    static V Min(V a, V b)            { return _mm512_min_epu8(a, b); }
+    static V Max(V a, V b)            { return _mm512_max_epu8(a, b); }
+};
+
+const CpuFilterKernels g_oCpuFilterKernels_AVX512 = { BoxBlurRow_AVX512, BoxBlurColumns_AVX512, UnsharpRow_AVX512,
+                                                      cpuMedianRow<MedianOps_AVX512, 3>, cpuMedianRow<MedianOps_AVX512, 5>,
+                                                      ARGBLumaRow_AVX512, ShiftLumaRow_AVX512 };
+
+#endif
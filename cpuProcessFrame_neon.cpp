@@ -0,0 +1,461 @@
+/*
+ * Copyright 1993-2015 NVIDIA Corporation.  All rights reserved.
+ *
+ * Please refer to the NVIDIA end user license agreement (EULA) associated
+ * with this source code for terms and conditions that govern your use of
+ * this software. Any use, reproduction, disclosure, or distribution of
+ * this software and related documentation outside the terms of the EULA
+ * is strictly prohibited.
+ *
+ */
+
+// AArch64 Advanced SIMD. The Q13 terms are int16 x int16 widening
+// multiply-accumulates; the saturating narrows double as the clamps.
+
+#include "cpuProcessFrameKernels.h"
+
+#if defined(__aarch64__)
+
+#include <arm_neon.h>
+
+// y, u, v are 4 signed 8-bit-range samples; returns the clamped channel
+// (y*ky + u*ku + v*kv + round) >> 13 as int16
+static inline int16x4_t channel4(int32x4_t yTerm, int16x4_t u, int16x4_t v, int16_t ku, int16_t kv)
+{
+    int32x4_t acc = yTerm;
+    if (ku)
+        acc = vmlal_n_s16(acc, u, ku);
+    if (kv)
+        acc = vmlal_n_s16(acc, v, kv);
+    return vqshrn_n_s32(acc, NV_COLOR_Q);
+}
+
+static inline int16x8_t channel8(int32x4_t yLo, int32x4_t yHi, int16x8_t u, int16x8_t v, int16_t ku, int16_t kv)
+{
+    return vcombine_s16(channel4(yLo, vget_low_s16(u), vget_low_s16(v), ku, kv),
+                        channel4(yHi, vget_high_s16(u), vget_high_s16(v), ku, kv));
+}
+
+// clamps 8 int16 lanes to [0, max]
+static inline uint16x8_t clampMax(int16x8_t x, int16_t max)
+{
+    return vreinterpretq_u16_s16(vminq_s16(vmaxq_s16(x, vdupq_n_s16(0)), vdupq_n_s16(max)));
+}
+
+// 8 pixels, one Cb/Cr sample each, stored as ARGB
+template <class CM>
+static inline void yuv2argb8(uint8x8_t y8, uint8x8_t cb8, uint8x8_t cr8, uint32 *pDst)
+{
+    int16x8_t y = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(y8)), vdupq_n_s16(CM::YOffset));
+    int16x8_t u = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(cb8)), vdupq_n_s16(128));
+    int16x8_t v = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(cr8)), vdupq_n_s16(128));
+
+    // Y*y + round, shared by the three channels
+    int32x4_t yLo = vmlal_n_s16(vdupq_n_s32(1 << (NV_COLOR_Q - 1)), vget_low_s16(y), CM::Y);
+    int32x4_t yHi = vmlal_n_s16(vdupq_n_s32(1 << (NV_COLOR_Q - 1)), vget_high_s16(y), CM::Y);
+
+    uint8x8x4_t argb;
+    argb.val[0] = vqmovun_s16(channel8(yLo, yHi, u, v, CM::BU, 0));
+    argb.val[1] = vqmovun_s16(channel8(yLo, yHi, u, v, CM::GU, CM::GV));
+    argb.val[2] = vqmovun_s16(channel8(yLo, yHi, u, v, 0, CM::RV));
+    argb.val[3] = vdup_n_u8(0xff);
+
+    vst4_u8((uint8 *)pDst, argb);
+}
+
+template <class CM>
+void NV12toARGBRow_NEON(const uint8 *pLuma, const uint8 *pChroma0, const uint8 *pChroma1,
+                        uint32 *pDst, uint32 width)
+{
+    uint32 x = 0;
+    for (; x + 8 <= width; x += 8)
+    {
+        uint8x8_t c8 = vrhadd_u8(vld1_u8(pChroma0 + x), vld1_u8(pChroma1 + x));
+
+        // split Cb (even bytes) from Cr (odd bytes), then give each pixel its own copy
+        uint8x8x2_t uv = vuzp_u8(c8, c8);
+        uint8x8_t cb8 = vzip_u8(uv.val[0], uv.val[0]).val[0];
+        uint8x8_t cr8 = vzip_u8(uv.val[1], uv.val[1]).val[0];
+
+        yuv2argb8<CM>(vld1_u8(pLuma + x), cb8, cr8, pDst + x);
+    }
+
+    NV12toARGBRow_C<CM>(pLuma + x, pChroma0 + x, pChroma1 + x, pDst + x, width - x);
+}
+
+template <class CM>
+void YUV444toARGBRow_NEON(const uint8 *pLuma, const uint8 *pCb, const uint8 *pCr,
+                          uint32 *pDst, uint32 width)
+{
+    uint32 x = 0;
+    for (; x + 8 <= width; x += 8)
+    {
+        yuv2argb8<CM>(vld1_u8(pLuma + x), vld1_u8(pCb + x), vld1_u8(pCr + x), pDst + x);
+    }
+
+    YUV444toARGBRow_C<CM>(pLuma + x, pCb + x, pCr + x, pDst + x, width - x);
+}
+
+// kr*r + kg*g + kb*b + bias on 4 int16 lanes, >> shift with saturation
+template <int shift>
+static inline int16x4_t dot4(int16x4_t r, int16x4_t g, int16x4_t b, int16_t kr, int16_t kg, int16_t kb, int32 bias)
+{
+    int32x4_t acc = vmlal_n_s16(vdupq_n_s32(bias), r, kr);
+    acc = vmlal_n_s16(acc, g, kg);
+    acc = vmlal_n_s16(acc, b, kb);
+    return vqshrn_n_s32(acc, shift);
+}
+
+// luma of 8 pixels, stored as 8 bytes
+template <class CM>
+static inline void rgb2y8(uint8x8_t r8, uint8x8_t g8, uint8x8_t b8, uint8 *pDst)
+{
+    const int32 bias = (CM::YOffset << NV_COLOR_Q) + (1 << (NV_COLOR_Q - 1));
+
+    int16x8_t r = vreinterpretq_s16_u16(vmovl_u8(r8));
+    int16x8_t g = vreinterpretq_s16_u16(vmovl_u8(g8));
+    int16x8_t b = vreinterpretq_s16_u16(vmovl_u8(b8));
+
+    int16x4_t lo = dot4<NV_COLOR_Q>(vget_low_s16(r), vget_low_s16(g), vget_low_s16(b), CM::YR, CM::YG, CM::YB, bias);
+    int16x4_t hi = dot4<NV_COLOR_Q>(vget_high_s16(r), vget_high_s16(g), vget_high_s16(b), CM::YR, CM::YG, CM::YB, bias);
+
+    vst1_u8(pDst, vqmovun_s16(vcombine_s16(lo, hi)));
+}
+
+// 8 pixels per row to 4 quad sums
+static inline int16x4_t quadSum4(uint8x8_t c0, uint8x8_t c1)
+{
+    return vreinterpret_s16_u16(vadd_u16(vpaddl_u8(c0), vpaddl_u8(c1)));
+}
+
+template <class CM>
+void ARGBtoNV12Row_NEON(const uint32 *pSrc0, const uint32 *pSrc1,
+                        uint8 *pLuma0, uint8 *pLuma1, uint8 *pChroma, uint32 width)
+{
+    const int32 bias = (CM::CMid << (NV_COLOR_Q + 2)) + (1 << (NV_COLOR_Q + 1));
+
+    uint32 x = 0;
+    for (; x + 8 <= width; x += 8)
+    {
+        // B, G, R, A planes
+        uint8x8x4_t p0 = vld4_u8((const uint8 *)(pSrc0 + x));
+        uint8x8x4_t p1 = vld4_u8((const uint8 *)(pSrc1 + x));
+
+        rgb2y8<CM>(p0.val[2], p0.val[1], p0.val[0], pLuma0 + x);
+        rgb2y8<CM>(p1.val[2], p1.val[1], p1.val[0], pLuma1 + x);
+
+        // sums over the 4 quads
+        int16x4_t sr = quadSum4(p0.val[2], p1.val[2]);
+        int16x4_t sg = quadSum4(p0.val[1], p1.val[1]);
+        int16x4_t sb = quadSum4(p0.val[0], p1.val[0]);
+
+        int16x4_t cb = dot4<NV_COLOR_Q + 2>(sr, sg, sb, CM::UR, CM::UG, CM::UB, bias);
+        int16x4_t cr = dot4<NV_COLOR_Q + 2>(sr, sg, sb, CM::VR, CM::VG, CM::VB, bias);
+
+        // clamp, then CbCr byte pairs
+        uint16x8_t c = vmovl_u8(vqmovun_s16(vcombine_s16(cb, cr)));
+        uint16x4_t cbcr = vorr_u16(vget_low_u16(c), vshl_n_u16(vget_high_u16(c), 8));
+        vst1_u8(pChroma + x, vreinterpret_u8_u16(cbcr));
+    }
+
+    ARGBtoNV12Row_C<CM>(pSrc0 + x, pSrc1 + x, pLuma0 + x, pLuma1 + x, pChroma + x, width - x);
+}
+
+template <class CM>
+void ARGBtoYUV444Row_NEON(const uint32 *pSrc, uint8 *pLuma, uint8 *pCb, uint8 *pCr, uint32 width)
+{
+    const int32 bias = (CM::CMid << (NV_COLOR_Q + 2)) + (1 << (NV_COLOR_Q + 1));
+
+    uint32 x = 0;
+    for (; x + 8 <= width; x += 8)
+    {
+        uint8x8x4_t p = vld4_u8((const uint8 *)(pSrc + x));
+
+        rgb2y8<CM>(p.val[2], p.val[1], p.val[0], pLuma + x);
+
+        // the quad sum of a lone pixel is 4x its colour
+        int16x8_t sr = vreinterpretq_s16_u16(vshll_n_u8(p.val[2], 2));
+        int16x8_t sg = vreinterpretq_s16_u16(vshll_n_u8(p.val[1], 2));
+        int16x8_t sb = vreinterpretq_s16_u16(vshll_n_u8(p.val[0], 2));
+
+        int16x4_t cbLo = dot4<NV_COLOR_Q + 2>(vget_low_s16(sr), vget_low_s16(sg), vget_low_s16(sb), CM::UR, CM::UG, CM::UB, bias);
+        int16x4_t cbHi = dot4<NV_COLOR_Q + 2>(vget_high_s16(sr), vget_high_s16(sg), vget_high_s16(sb), CM::UR, CM::UG, CM::UB, bias);
+        int16x4_t crLo = dot4<NV_COLOR_Q + 2>(vget_low_s16(sr), vget_low_s16(sg), vget_low_s16(sb), CM::VR, CM::VG, CM::VB, bias);
+        int16x4_t crHi = dot4<NV_COLOR_Q + 2>(vget_high_s16(sr), vget_high_s16(sg), vget_high_s16(sb), CM::VR, CM::VG, CM::VB, bias);
+
+        vst1_u8(pCb + x, vqmovun_s16(vcombine_s16(cbLo, cbHi)));
+        vst1_u8(pCr + x, vqmovun_s16(vcombine_s16(crLo, crHi)));
+    }
+
+    ARGBtoYUV444Row_C<CM>(pSrc + x, pLuma + x, pCb + x, pCr + x, width - x);
+}
+
+template <class CM>
+void P010toARGB2101010Row_NEON(const uint16 *pLuma, const uint16 *pChroma0, const uint16 *pChroma1,
+                               uint32 *pDst, uint32 width)
+{
+    uint32 x = 0;
+    for (; x + 8 <= width; x += 8)
+    {
+        uint16x8_t y16 = vshrq_n_u16(vld1q_u16(pLuma + x), NV_P010_SHIFT);
+        uint16x8_t c16 = vrhaddq_u16(vshrq_n_u16(vld1q_u16(pChroma0 + x), NV_P010_SHIFT),
+                                     vshrq_n_u16(vld1q_u16(pChroma1 + x), NV_P010_SHIFT));
+
+        // split Cb (even words) from Cr (odd words), then give each pixel its own copy
+        uint16x8x2_t uv = vuzpq_u16(c16, c16);
+        uint16x8_t cb16 = vzipq_u16(uv.val[0], uv.val[0]).val[0];
+        uint16x8_t cr16 = vzipq_u16(uv.val[1], uv.val[1]).val[0];
+
+        int16x8_t y = vsubq_s16(vreinterpretq_s16_u16(y16), vdupq_n_s16(CM::YOffset));
+        int16x8_t u = vsubq_s16(vreinterpretq_s16_u16(cb16), vdupq_n_s16(CM::CMid));
+        int16x8_t v = vsubq_s16(vreinterpretq_s16_u16(cr16), vdupq_n_s16(CM::CMid));
+
+        int32x4_t yLo = vmlal_n_s16(vdupq_n_s32(1 << (NV_COLOR_Q - 1)), vget_low_s16(y), CM::Y);
+        int32x4_t yHi = vmlal_n_s16(vdupq_n_s32(1 << (NV_COLOR_Q - 1)), vget_high_s16(y), CM::Y);
+
+        uint16x8_t b = clampMax(channel8(yLo, yHi, u, v, CM::BU, 0), CM::Max);
+        uint16x8_t g = clampMax(channel8(yLo, yHi, u, v, CM::GU, CM::GV), CM::Max);
+        uint16x8_t r = clampMax(channel8(yLo, yHi, u, v, 0, CM::RV), CM::Max);
+
+        const uint32x4_t alpha = vdupq_n_u32(0xc0000000);
+        uint32x4_t lo = vorrq_u32(vorrq_u32(vshlq_n_u32(vmovl_u16(vget_low_u16(r)), 20),
+                                            vshlq_n_u32(vmovl_u16(vget_low_u16(g)), 10)),
+                                  vorrq_u32(vmovl_u16(vget_low_u16(b)), alpha));
+        uint32x4_t hi = vorrq_u32(vorrq_u32(vshlq_n_u32(vmovl_u16(vget_high_u16(r)), 20),
+                                            vshlq_n_u32(vmovl_u16(vget_high_u16(g)), 10)),
+                                  vorrq_u32(vmovl_u16(vget_high_u16(b)), alpha));
+
+        vst1q_u32(pDst + x, lo);
+        vst1q_u32(pDst + x + 4, hi);
+    }
+
+    P010toARGB2101010Row_C<CM>(pLuma + x, pChroma0 + x, pChroma1 + x, pDst + x, width - x);
+}
+
+// one 10-bit channel of 8 ARGB2101010 pixels, as int16
+static inline int16x8_t channel10(uint32x4_t lo, uint32x4_t hi, int shift)
+{
+    const uint32x4_t mask = vdupq_n_u32(0x3ff);
+    int32x4_t vShift = vdupq_n_s32(-shift);
+
+    return vreinterpretq_s16_u16(vcombine_u16(vmovn_u32(vandq_u32(vshlq_u32(lo, vShift), mask)),
+                                              vmovn_u32(vandq_u32(vshlq_u32(hi, vShift), mask))));
+}
+
+// luma of 8 pixels as P010 words
+template <class CM>
+static inline void rgb2y8x10(int16x8_t r, int16x8_t g, int16x8_t b, uint16 *pDst)
+{
+    const int32 bias = (CM::YOffset << NV_COLOR_Q) + (1 << (NV_COLOR_Q - 1));
+
+    int16x4_t lo = dot4<NV_COLOR_Q>(vget_low_s16(r), vget_low_s16(g), vget_low_s16(b), CM::YR, CM::YG, CM::YB, bias);
+    int16x4_t hi = dot4<NV_COLOR_Q>(vget_high_s16(r), vget_high_s16(g), vget_high_s16(b), CM::YR, CM::YG, CM::YB, bias);
+
+    vst1q_u16(pDst, vshlq_n_u16(clampMax(vcombine_s16(lo, hi), CM::Max), NV_P010_SHIFT));
+}
+
+// 8 pixels per row to 4 quad sums
+static inline int16x4_t quadSum4(int16x8_t c0, int16x8_t c1)
+{
+    return vmovn_s32(vpaddlq_s16(vaddq_s16(c0, c1)));
+}
+
+template <class CM>
+void ARGB2101010toP010Row_NEON(const uint32 *pSrc0, const uint32 *pSrc1,
+                               uint16 *pLuma0, uint16 *pLuma1, uint16 *pChroma, uint32 width)
+{
+    const int32 bias = (CM::CMid << (NV_COLOR_Q + 2)) + (1 << (NV_COLOR_Q + 1));
+
+    uint32 x = 0;
+    for (; x + 8 <= width; x += 8)
+    {
+        uint32x4_t p0lo = vld1q_u32(pSrc0 + x), p0hi = vld1q_u32(pSrc0 + x + 4);
+        uint32x4_t p1lo = vld1q_u32(pSrc1 + x), p1hi = vld1q_u32(pSrc1 + x + 4);
+
+        int16x8_t r0 = channel10(p0lo, p0hi, 20), g0 = channel10(p0lo, p0hi, 10), b0 = channel10(p0lo, p0hi, 0);
+        int16x8_t r1 = channel10(p1lo, p1hi, 20), g1 = channel10(p1lo, p1hi, 10), b1 = channel10(p1lo, p1hi, 0);
+
+        rgb2y8x10<CM>(r0, g0, b0, pLuma0 + x);
+        rgb2y8x10<CM>(r1, g1, b1, pLuma1 + x);
+
+        // sums over the 4 quads, at most 4 * 1023
+        int16x4_t sr = quadSum4(r0, r1);
+        int16x4_t sg = quadSum4(g0, g1);
+        int16x4_t sb = quadSum4(b0, b1);
+
+        int16x4_t cb = dot4<NV_COLOR_Q + 2>(sr, sg, sb, CM::UR, CM::UG, CM::UB, bias);
+        int16x4_t cr = dot4<NV_COLOR_Q + 2>(sr, sg, sb, CM::VR, CM::VG, CM::VB, bias);
+
+        // clamp, then CbCr word pairs
+        uint16x8_t c = vshlq_n_u16(clampMax(vcombine_s16(cb, cr), CM::Max), NV_P010_SHIFT);
+        uint16x4x2_t cbcr = { { vget_low_u16(c), vget_high_u16(c) } };
+        vst2_u16(pChroma + x, cbcr);
+    }
+
+    ARGB2101010toP010Row_C<CM>(pSrc0 + x, pSrc1 + x, pLuma0 + x, pLuma1 + x, pChroma + x, width - x);
+}
+
+const CpuKernels g_aCpuKernels_NEON[CPU_KERNEL_TABLE_SIZE] = CPU_KERNEL_TABLE(NEON);
+
+// Box blur: the four channels of a pixel are the four uint32 lanes of the
+// window sum; the column step widens 4 pixels at a time with vaddw/vsubw.
+static inline uint32x4_t expandPixel(uint32 p)
+{
+    return vmovl_u16(vget_low_u16(vmovl_u8(vreinterpret_u8_u32(vdup_n_u32(p)))));
+}
+
+static inline uint16x4_t boxScale(uint32x4_t s, uint32 nScale)
+{
+    return vmovn_u32(vshrq_n_u32(vmlaq_n_u32(vdupq_n_u32(32768), s, nScale), 16));
+}
+
+static void BoxBlurRow_NEON(const uint32 *pSrc, uint32 *pDst, uint32 width, uint32 nRadius, uint32 nScale)
+{
+    int32 r = (int32)nRadius;
+    uint32x4_t s = vdupq_n_u32(0);
+
+    for (int32 k = -r; k <= r; k++)
+    {
+        s = vaddq_u32(s, expandPixel(pSrc[k]));
+    }
+
+    for (int32 x = 0; x < (int32)width; x++)
+    {
+        uint16x4_t v = boxScale(s, nScale);
+        pDst[x] = vget_lane_u32(vreinterpret_u32_u8(vmovn_u16(vcombine_u16(v, v))), 0);
+
+        s = vsubq_u32(vaddq_u32(s, expandPixel(pSrc[x + r + 1])), expandPixel(pSrc[x - r]));
+    }
+}
+
+// a pixel's window sum takes in add and gives up sub (its 4 channels
+// widened to 16 bits); returns the scaled sum from before
+static inline uint16x4_t boxColumn(uint32 *pSums, uint16x4_t add, uint16x4_t sub, uint32 nScale)
+{
+    uint32x4_t s = vld1q_u32(pSums);
+    vst1q_u32(pSums, vsubw_u16(vaddw_u16(s, add), sub));
+    return boxScale(s, nScale);
+}
+
+static void BoxBlurColumns_NEON(uint32 *pSums, const uint32 *pAdd, const uint32 *pSub, uint32 *pDst,
+                                uint32 nPixels, uint32 nScale)
+{
+    uint32 x = 0;
+
+    for (; x + 4 <= nPixels; x += 4)
+    {
+        uint8x16_t add = vld1q_u8((const uint8 *)(pAdd + x));
+        uint8x16_t sub = vld1q_u8((const uint8 *)(pSub + x));
+        uint16x8_t add01 = vmovl_u8(vget_low_u8(add)), add23 = vmovl_u8(vget_high_u8(add));
+        uint16x8_t sub01 = vmovl_u8(vget_low_u8(sub)), sub23 = vmovl_u8(vget_high_u8(sub));
+        uint32 *s = pSums + 4 * x;
+
+        uint16x8_t o01 = vcombine_u16(boxColumn(s,      vget_low_u16(add01),  vget_low_u16(sub01),  nScale),
+                                      boxColumn(s + 4,  vget_high_u16(add01), vget_high_u16(sub01), nScale));
+        uint16x8_t o23 = vcombine_u16(boxColumn(s + 8,  vget_low_u16(add23),  vget_low_u16(sub23),  nScale),
+                                      boxColumn(s + 12, vget_high_u16(add23), vget_high_u16(sub23), nScale));
+        vst1q_u8((uint8 *)(pDst + x), vcombine_u8(vmovn_u16(o01), vmovn_u16(o23)));
+    }
+
+    BoxBlurColumns_C(pSums + 4 * x, pAdd + x, pSub + x, pDst + x, nPixels - x, nScale);
+}
+
+// Unsharp mask on one pixel, its channels widened to 16 bits: sharpened
+// channels saturated to 16 bits, and the window sum moved on
+static inline uint16x4_t unsharpPixel(uint32 *pSums, uint16x4_t add, uint16x4_t sub, uint16x4_t orig,
+                                      uint32 nScale, int32 nAmount, int32 nThreshold)
+{
+    int32x4_t o = vreinterpretq_s32_u32(vmovl_u16(orig));
+    int32x4_t d = vsubq_s32(o, vreinterpretq_s32_u32(vmovl_u16(boxColumn(pSums, add, sub, nScale))));
+    uint32x4_t m = vcgtq_s32(vabsq_s32(d), vdupq_n_s32(nThreshold));
+    int32x4_t v = vshrq_n_s32(vmlaq_n_s32(vdupq_n_s32(128), d, nAmount), 8);
+
+    return vqmovun_s32(vaddq_s32(o, vreinterpretq_s32_u32(vandq_u32(vreinterpretq_u32_s32(v), m))));
+}
+
+static void UnsharpRow_NEON(uint32 *pSums, const uint32 *pAdd, const uint32 *pSub, uint32 *pRow,
+                            uint32 width, uint32 nScale, int32 nAmount, int32 nThreshold)
+{
+    uint32 x = 0;
+
+    for (; x + 4 <= width; x += 4)
+    {
+        uint8x16_t add = vld1q_u8((const uint8 *)(pAdd + x));
+        uint8x16_t sub = vld1q_u8((const uint8 *)(pSub + x));
+        uint8x16_t orig = vld1q_u8((const uint8 *)(pRow + x));
+        uint16x8_t add01 = vmovl_u8(vget_low_u8(add)), add23 = vmovl_u8(vget_high_u8(add));
+        uint16x8_t sub01 = vmovl_u8(vget_low_u8(sub)), sub23 = vmovl_u8(vget_high_u8(sub));
+        uint16x8_t org01 = vmovl_u8(vget_low_u8(orig)), org23 = vmovl_u8(vget_high_u8(orig));
+        uint32 *s = pSums + 4 * x;
+
+        uint16x8_t o01 = vcombine_u16(
+            unsharpPixel(s,      vget_low_u16(add01),  vget_low_u16(sub01),  vget_low_u16(org01),  nScale, nAmount, nThreshold),
+            unsharpPixel(s + 4,  vget_high_u16(add01), vget_high_u16(sub01), vget_high_u16(org01), nScale, nAmount, nThreshold));
+        uint16x8_t o23 = vcombine_u16(
+            unsharpPixel(s + 8,  vget_low_u16(add23),  vget_low_u16(sub23),  vget_low_u16(org23),  nScale, nAmount, nThreshold),
+            unsharpPixel(s + 12, vget_high_u16(add23), vget_high_u16(sub23), vget_high_u16(org23), nScale, nAmount, nThreshold));
+        vst1q_u8((uint8 *)(pRow + x), vcombine_u8(vqmovn_u16(o01), vqmovn_u16(o23)));
+    }
+
+    UnsharpRow_C(pSums + 4 * x, pAdd + x, pSub + x, pRow + x, width - x, nScale, nAmount, nThreshold);
+}
+
+// vld4 splits 16 ARGB pixels into B, G, R and A planes
+static void ARGBLumaRow_NEON(const uint32 *pARGB, uint8 *pLuma, uint32 width)
+{
+    uint32 x = 0;
+
+    for (; x + 16 <= width; x += 16)
+    {
+        uint8x16x4_t p = vld4q_u8((const uint8 *)(pARGB + x));
+        uint16x8_t lo = vmull_u8(vget_low_u8(p.val[2]), vdup_n_u8(54));
+        uint16x8_t hi = vmull_u8(vget_high_u8(p.val[2]), vdup_n_u8(54));
+        lo = vmlal_u8(lo, vget_low_u8(p.val[1]), vdup_n_u8(183));
+        hi = vmlal_u8(hi, vget_high_u8(p.val[1]), vdup_n_u8(183));
+        lo = vmlal_u8(lo, vget_low_u8(p.val[0]), vdup_n_u8(19));
+        hi = vmlal_u8(hi, vget_high_u8(p.val[0]), vdup_n_u8(19));
+        vst1q_u8(pLuma + x, vcombine_u8(vrshrn_n_u16(lo, 8), vrshrn_n_u16(hi, 8)));
+    }
+
+    ARGBLumaRow_C(pARGB + x, pLuma + x, width - x);
+}
+
+static void ShiftLumaRow_NEON(uint32 *pARGB, const uint8 *pOld, const uint8 *pNew, uint32 width)
+{
+    uint32 x = 0;
+
+    for (; x + 16 <= width; x += 16)
+    {
+        uint8x16_t o = vld1q_u8(pOld + x);
+        uint8x16_t n = vld1q_u8(pNew + x);
+        uint8x16_t up = vqsubq_u8(n, o);
+        uint8x16_t down = vqsubq_u8(o, n);
+        uint8x16x4_t p = vld4q_u8((const uint8 *)(pARGB + x));
+
+        for (int c = 0; c < 3; c++)
+        {
+            p.val[c] = vqsubq_u8(vqaddq_u8(p.val[c], up), down);
+        }
+        vst4q_u8((uint8 *)(pARGB + x), p);
+    }
+
+    ShiftLumaRow_C(pARGB + x, pOld + x, pNew + x, width - x);
+}
+
+// the medians of cpuProcessFrameKernels.h on 16 bytes at a time
+struct MedianOps_NEON
+{
+    typedef uint8x16_t V;
+    enum { BYTES = 16 };
+
+    static V Load(const uint8 *p)     { return vld1q_u8(p); }
+    static void Store(uint8 *p, V v)  { vst1q_u8(p, v); }
+    static V Min(V a, V b)            { return vminq_u8(a, b); }
+    static V Max(V a, V b)            { return vmaxq_u8(a, b); }
+};
+
+const CpuFilterKernels g_oCpuFilterKernels_NEON = { BoxBlurRow_NEON, BoxBlurColumns_NEON, UnsharpRow_NEON,
+                                                    cpuMedianRow<MedianOps_NEON, 3>, cpuMedianRow<MedianOps_NEON, 5>,
+                                                    ARGBLumaRow_NEON, ShiftLumaRow_NEON };
+
+#endif
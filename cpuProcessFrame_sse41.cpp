@@ -0,0 +1,476 @@
+/*
+ * Copyright 1993-2015 NVIDIA Corporation.  All rights reserved.
+ *
+ * Please refer to the NVIDIA end user license agreement (EULA) associated
+ * with this source code for terms and conditions that govern your use of
+ * this software. Any use, reproduction, disclosure, or distribution of
+ * this software and related documentation outside the terms of the EULA
+ * is strictly prohibited.
+ *
+ */
+
+// Built with -msse4.1; only called after cpuDetectISA() has seen SSE4.1.
+//
+// One pixel per int32 lane. Two int16 operands are packed into each lane so
+// that pmaddwd evaluates a whole Q13 term pair (e.g. Y*y + RV*v) at once.
+
+#include "cpuProcessFrameKernels.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#include <smmintrin.h>
+#include <string.h>
+
+static inline __m128i pair16(__m128i lo, __m128i hi)
+{
+    return _mm_or_si128(_mm_and_si128(lo, _mm_set1_epi32(0xffff)), _mm_slli_epi32(hi, 16));
+}
+
+static inline __m128i clampMax(__m128i x, int32 max)
+{
+    return _mm_min_epi32(_mm_max_epi32(x, _mm_setzero_si128()), _mm_set1_epi32(max));
+}
+
+// b, g, r as int32 lanes to 4 ARGB pixels; the packs saturate to [0, 255]
+static inline __m128i packARGB4(__m128i r, __m128i g, __m128i b)
+{
+    const __m128i shufARGB = _mm_setr_epi8(0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15);
+
+    __m128i bgra = _mm_packus_epi16(_mm_packs_epi32(b, g), _mm_packs_epi32(r, _mm_set1_epi32(255)));
+    return _mm_shuffle_epi8(bgra, shufARGB);
+}
+
+// 4 pixels of luma and chroma, as int32 lanes, to unclamped R, G, B
+template <class CM>
+static inline void yuv2rgb4(__m128i luma, __m128i cb, __m128i cr, __m128i &r, __m128i &g, __m128i &b)
+{
+    const __m128i round = _mm_set1_epi32(1 << (NV_COLOR_Q - 1));
+
+    __m128i y = _mm_sub_epi32(luma, _mm_set1_epi32(CM::YOffset));
+    __m128i u = _mm_sub_epi32(cb, _mm_set1_epi32(CM::CMid));
+    __m128i v = _mm_sub_epi32(cr, _mm_set1_epi32(CM::CMid));
+
+    __m128i yu = pair16(y, u);
+    __m128i yv = pair16(y, v);
+    __m128i v1 = pair16(v, _mm_set1_epi32(1));
+
+    r = _mm_add_epi32(_mm_madd_epi16(yv, _mm_set1_epi32(cpuCoeffPair(CM::Y, CM::RV))), round);
+    g = _mm_add_epi32(_mm_madd_epi16(yu, _mm_set1_epi32(cpuCoeffPair(CM::Y, CM::GU))),
+                      _mm_madd_epi16(v1, _mm_set1_epi32(cpuCoeffPair(CM::GV, 1 << (NV_COLOR_Q - 1)))));
+    b = _mm_add_epi32(_mm_madd_epi16(yu, _mm_set1_epi32(cpuCoeffPair(CM::Y, CM::BU))), round);
+
+    r = _mm_srai_epi32(r, NV_COLOR_Q);
+    g = _mm_srai_epi32(g, NV_COLOR_Q);
+    b = _mm_srai_epi32(b, NV_COLOR_Q);
+}
+
+template <class CM>
+static inline __m128i yuv2argb4(__m128i luma, __m128i cb, __m128i cr)
+{
+    __m128i r, g, b;
+    yuv2rgb4<CM>(luma, cb, cr, r, g, b);
+    return packARGB4(r, g, b);
+}
+
+template <class CM>
+void NV12toARGBRow_SSE41(const uint8 *pLuma, const uint8 *pChroma0, const uint8 *pChroma1,
+                         uint32 *pDst, uint32 width)
+{
+    // replicate each Cb (even byte) and Cr (odd byte) to its 2 pixels
+    const __m128i shufCb = _mm_setr_epi8(0, 0, 2, 2, 4, 4, 6, 6, -1, -1, -1, -1, -1, -1, -1, -1);
+    const __m128i shufCr = _mm_setr_epi8(1, 1, 3, 3, 5, 5, 7, 7, -1, -1, -1, -1, -1, -1, -1, -1);
+
+    uint32 x = 0;
+    for (; x + 8 <= width; x += 8)
+    {
+        __m128i y8 = _mm_loadl_epi64((const __m128i *)(pLuma + x));
+        __m128i c8 = _mm_avg_epu8(_mm_loadl_epi64((const __m128i *)(pChroma0 + x)),
+                                  _mm_loadl_epi64((const __m128i *)(pChroma1 + x)));
+        __m128i cb8 = _mm_shuffle_epi8(c8, shufCb);
+        __m128i cr8 = _mm_shuffle_epi8(c8, shufCr);
+
+        __m128i argb0 = yuv2argb4<CM>(_mm_cvtepu8_epi32(y8), _mm_cvtepu8_epi32(cb8), _mm_cvtepu8_epi32(cr8));
+        __m128i argb1 = yuv2argb4<CM>(_mm_cvtepu8_epi32(_mm_srli_si128(y8, 4)),
+                                      _mm_cvtepu8_epi32(_mm_srli_si128(cb8, 4)),
+                                      _mm_cvtepu8_epi32(_mm_srli_si128(cr8, 4)));
+
+        _mm_storeu_si128((__m128i *)(pDst + x), argb0);
+        _mm_storeu_si128((__m128i *)(pDst + x + 4), argb1);
+    }
+
+    NV12toARGBRow_C<CM>(pLuma + x, pChroma0 + x, pChroma1 + x, pDst + x, width - x);
+}
+
+// luma of 4 ARGB pixels; br holds (b, r) pairs and g the green samples
+template <class CM>
+static inline __m128i rgb2y4(__m128i br, __m128i g)
+{
+    const __m128i bias = _mm_set1_epi32((CM::YOffset << NV_COLOR_Q) + (1 << (NV_COLOR_Q - 1)));
+
+    __m128i y = _mm_add_epi32(_mm_madd_epi16(br, _mm_set1_epi32(cpuCoeffPair(CM::YB, CM::YR))),
+                              _mm_madd_epi16(g, _mm_set1_epi32(cpuCoeffPair(CM::YG, 0))));
+    return _mm_srai_epi32(_mm_add_epi32(y, bias), NV_COLOR_Q);
+}
+
+// one chroma component from quad sums of (b, r) pairs and of g
+template <class CM>
+static inline __m128i rgb2c(__m128i sbr, __m128i sg, int32 kb, int32 kr, int32 kg)
+{
+    const __m128i bias = _mm_set1_epi32((CM::CMid << (NV_COLOR_Q + 2)) + (1 << (NV_COLOR_Q + 1)));
+
+    __m128i c = _mm_add_epi32(_mm_madd_epi16(sbr, _mm_set1_epi32(cpuCoeffPair(kb, kr))),
+                              _mm_madd_epi16(sg, _mm_set1_epi32(cpuCoeffPair(kg, 0))));
+    return clampMax(_mm_srai_epi32(_mm_add_epi32(c, bias), NV_COLOR_Q + 2), CM::Max);
+}
+
+// 4 int32 lanes stored as bytes, saturated to [0, 255]
+static inline void storeBytes4(uint8 *pDst, __m128i y)
+{
+    y = _mm_packus_epi16(_mm_packs_epi32(y, y), y);
+    int v = _mm_cvtsi128_si32(y);
+    memcpy(pDst, &v, 4);
+}
+
+template <class CM>
+void ARGBtoNV12Row_SSE41(const uint32 *pSrc0, const uint32 *pSrc1,
+                         uint8 *pLuma0, uint8 *pLuma1, uint8 *pChroma, uint32 width)
+{
+    const __m128i maskBR = _mm_set1_epi32(0x00ff00ff);
+    const __m128i maskG  = _mm_set1_epi32(0xff);
+
+    uint32 x = 0;
+    for (; x + 4 <= width; x += 4)
+    {
+        __m128i p0 = _mm_loadu_si128((const __m128i *)(pSrc0 + x));
+        __m128i p1 = _mm_loadu_si128((const __m128i *)(pSrc1 + x));
+
+        // B and R already sit in the two int16 halves of each pixel
+        __m128i br0 = _mm_and_si128(p0, maskBR);
+        __m128i g0  = _mm_and_si128(_mm_srli_epi32(p0, 8), maskG);
+        __m128i br1 = _mm_and_si128(p1, maskBR);
+        __m128i g1  = _mm_and_si128(_mm_srli_epi32(p1, 8), maskG);
+
+        storeBytes4(pLuma0 + x, rgb2y4<CM>(br0, g0));
+        storeBytes4(pLuma1 + x, rgb2y4<CM>(br1, g1));
+
+        // sums over the 2 quads; 4 * 255 can't carry from B into R
+        __m128i sbr = _mm_hadd_epi32(_mm_add_epi32(br0, br1), _mm_setzero_si128());
+        __m128i sg  = _mm_hadd_epi32(_mm_add_epi32(g0, g1), _mm_setzero_si128());
+
+        __m128i cb = rgb2c<CM>(sbr, sg, CM::UB, CM::UR, CM::UG);
+        __m128i cr = rgb2c<CM>(sbr, sg, CM::VB, CM::VR, CM::VG);
+
+        // CbCr byte pairs
+        __m128i uv = _mm_or_si128(cb, _mm_slli_epi32(cr, 8));
+        int v = _mm_cvtsi128_si32(_mm_packus_epi32(uv, uv));
+        memcpy(pChroma + x, &v, 4);
+    }
+
+    ARGBtoNV12Row_C<CM>(pSrc0 + x, pSrc1 + x, pLuma0 + x, pLuma1 + x, pChroma + x, width - x);
+}
+
+template <class CM>
+void YUV444toARGBRow_SSE41(const uint8 *pLuma, const uint8 *pCb, const uint8 *pCr,
+                           uint32 *pDst, uint32 width)
+{
+    uint32 x = 0;
+    for (; x + 8 <= width; x += 8)
+    {
+        __m128i y8  = _mm_loadl_epi64((const __m128i *)(pLuma + x));
+        __m128i cb8 = _mm_loadl_epi64((const __m128i *)(pCb + x));
+        __m128i cr8 = _mm_loadl_epi64((const __m128i *)(pCr + x));
+
+        __m128i argb0 = yuv2argb4<CM>(_mm_cvtepu8_epi32(y8), _mm_cvtepu8_epi32(cb8), _mm_cvtepu8_epi32(cr8));
+        __m128i argb1 = yuv2argb4<CM>(_mm_cvtepu8_epi32(_mm_srli_si128(y8, 4)),
+                                      _mm_cvtepu8_epi32(_mm_srli_si128(cb8, 4)),
+                                      _mm_cvtepu8_epi32(_mm_srli_si128(cr8, 4)));
+
+        _mm_storeu_si128((__m128i *)(pDst + x), argb0);
+        _mm_storeu_si128((__m128i *)(pDst + x + 4), argb1);
+    }
+
+    YUV444toARGBRow_C<CM>(pLuma + x, pCb + x, pCr + x, pDst + x, width - x);
+}
+
+template <class CM>
+void ARGBtoYUV444Row_SSE41(const uint32 *pSrc, uint8 *pLuma, uint8 *pCb, uint8 *pCr, uint32 width)
+{
+    const __m128i maskBR = _mm_set1_epi32(0x00ff00ff);
+    const __m128i maskG  = _mm_set1_epi32(0xff);
+
+    uint32 x = 0;
+    for (; x + 4 <= width; x += 4)
+    {
+        __m128i p = _mm_loadu_si128((const __m128i *)(pSrc + x));
+
+        __m128i br = _mm_and_si128(p, maskBR);
+        __m128i g  = _mm_and_si128(_mm_srli_epi32(p, 8), maskG);
+
+        storeBytes4(pLuma + x, rgb2y4<CM>(br, g));
+
+        // the quad sum of a lone pixel is 4x its colour
+        __m128i sbr = _mm_slli_epi32(br, 2);
+        __m128i sg  = _mm_slli_epi32(g, 2);
+
+        storeBytes4(pCb + x, rgb2c<CM>(sbr, sg, CM::UB, CM::UR, CM::UG));
+        storeBytes4(pCr + x, rgb2c<CM>(sbr, sg, CM::VB, CM::VR, CM::VG));
+    }
+
+    ARGBtoYUV444Row_C<CM>(pSrc + x, pLuma + x, pCb + x, pCr + x, width - x);
+}
+
+// 4 pixels of 10-bit luma and chroma to ARGB2101010
+template <class CM>
+static inline __m128i yuv2argb2101010x4(__m128i luma, __m128i cb, __m128i cr)
+{
+    __m128i r, g, b;
+    yuv2rgb4<CM>(luma, cb, cr, r, g, b);
+
+    r = clampMax(r, CM::Max);
+    g = clampMax(g, CM::Max);
+    b = clampMax(b, CM::Max);
+
+    return _mm_or_si128(_mm_or_si128(_mm_slli_epi32(r, 20), _mm_slli_epi32(g, 10)),
+                        _mm_or_si128(b, _mm_set1_epi32((int32)0xc0000000)));
+}
+
+template <class CM>
+void P010toARGB2101010Row_SSE41(const uint16 *pLuma, const uint16 *pChroma0, const uint16 *pChroma1,
+                                uint32 *pDst, uint32 width)
+{
+    // each 16-bit Cb (words 0, 2, ..) and Cr (words 1, 3, ..) zero-extended
+    // into the int32 lanes of its 2 pixels
+    const __m128i shufCb0 = _mm_setr_epi8(0, 1, -1, -1, 0, 1, -1, -1, 4, 5, -1, -1, 4, 5, -1, -1);
+    const __m128i shufCr0 = _mm_setr_epi8(2, 3, -1, -1, 2, 3, -1, -1, 6, 7, -1, -1, 6, 7, -1, -1);
+    const __m128i shufCb1 = _mm_setr_epi8(8, 9, -1, -1, 8, 9, -1, -1, 12, 13, -1, -1, 12, 13, -1, -1);
+    const __m128i shufCr1 = _mm_setr_epi8(10, 11, -1, -1, 10, 11, -1, -1, 14, 15, -1, -1, 14, 15, -1, -1);
+
+    uint32 x = 0;
+    for (; x + 8 <= width; x += 8)
+    {
+        __m128i y8 = _mm_srli_epi16(_mm_loadu_si128((const __m128i *)(pLuma + x)), NV_P010_SHIFT);
+        __m128i c8 = _mm_avg_epu16(_mm_srli_epi16(_mm_loadu_si128((const __m128i *)(pChroma0 + x)), NV_P010_SHIFT),
+                                   _mm_srli_epi16(_mm_loadu_si128((const __m128i *)(pChroma1 + x)), NV_P010_SHIFT));
+
+        __m128i argb0 = yuv2argb2101010x4<CM>(_mm_cvtepu16_epi32(y8),
+                                              _mm_shuffle_epi8(c8, shufCb0), _mm_shuffle_epi8(c8, shufCr0));
+        __m128i argb1 = yuv2argb2101010x4<CM>(_mm_cvtepu16_epi32(_mm_srli_si128(y8, 8)),
+                                              _mm_shuffle_epi8(c8, shufCb1), _mm_shuffle_epi8(c8, shufCr1));
+
+        _mm_storeu_si128((__m128i *)(pDst + x), argb0);
+        _mm_storeu_si128((__m128i *)(pDst + x + 4), argb1);
+    }
+
+    P010toARGB2101010Row_C<CM>(pLuma + x, pChroma0 + x, pChroma1 + x, pDst + x, width - x);
+}
+
+template <class CM>
+void ARGB2101010toP010Row_SSE41(const uint32 *pSrc0, const uint32 *pSrc1,
+                                uint16 *pLuma0, uint16 *pLuma1, uint16 *pChroma, uint32 width)
+{
+    const __m128i maskB = _mm_set1_epi32(0x3ff);
+    const __m128i maskR = _mm_set1_epi32(0x3ff0000);
+
+    uint32 x = 0;
+    for (; x + 4 <= width; x += 4)
+    {
+        __m128i p0 = _mm_loadu_si128((const __m128i *)(pSrc0 + x));
+        __m128i p1 = _mm_loadu_si128((const __m128i *)(pSrc1 + x));
+
+        // R moves from bit 20 to the upper int16 half, B stays in the lower
+        __m128i br0 = _mm_or_si128(_mm_and_si128(p0, maskB), _mm_and_si128(_mm_srli_epi32(p0, 4), maskR));
+        __m128i g0  = _mm_and_si128(_mm_srli_epi32(p0, 10), maskB);
+        __m128i br1 = _mm_or_si128(_mm_and_si128(p1, maskB), _mm_and_si128(_mm_srli_epi32(p1, 4), maskR));
+        __m128i g1  = _mm_and_si128(_mm_srli_epi32(p1, 10), maskB);
+
+        __m128i y0 = _mm_slli_epi32(clampMax(rgb2y4<CM>(br0, g0), CM::Max), NV_P010_SHIFT);
+        __m128i y1 = _mm_slli_epi32(clampMax(rgb2y4<CM>(br1, g1), CM::Max), NV_P010_SHIFT);
+        _mm_storel_epi64((__m128i *)(pLuma0 + x), _mm_packus_epi32(y0, y0));
+        _mm_storel_epi64((__m128i *)(pLuma1 + x), _mm_packus_epi32(y1, y1));
+
+        // sums over the 2 quads; 4 * 1023 still can't carry from B into R
+        __m128i sbr = _mm_hadd_epi32(_mm_add_epi32(br0, br1), _mm_setzero_si128());
+        __m128i sg  = _mm_hadd_epi32(_mm_add_epi32(g0, g1), _mm_setzero_si128());
+
+        __m128i cb = rgb2c<CM>(sbr, sg, CM::UB, CM::UR, CM::UG);
+        __m128i cr = rgb2c<CM>(sbr, sg, CM::VB, CM::VR, CM::VG);
+
+        // CbCr word pairs
+        __m128i cbcr = _mm_or_si128(_mm_slli_epi32(cb, NV_P010_SHIFT), _mm_slli_epi32(cr, 16 + NV_P010_SHIFT));
+        _mm_storel_epi64((__m128i *)(pChroma + x), cbcr);
+    }
+
+    ARGB2101010toP010Row_C<CM>(pSrc0 + x, pSrc1 + x, pLuma0 + x, pLuma1 + x, pChroma + x, width - x);
+}
+
+const CpuKernels g_aCpuKernels_SSE41[CPU_KERNEL_TABLE_SIZE] = CPU_KERNEL_TABLE(SSE41);
+
+// Box blur: the four channels of a pixel are the four int32 lanes of the
+// window sum, so the running sum is one add and one subtract per pixel.
+static inline __m128i expandPixel(uint32 p)
+{
+    return _mm_cvtepu8_epi32(_mm_cvtsi32_si128((int)p));
+}
+
+static inline __m128i boxScale(__m128i s, __m128i scale)
+{
+    return _mm_srli_epi32(_mm_add_epi32(_mm_mullo_epi32(s, scale), _mm_set1_epi32(32768)), 16);
+}
+
+static void BoxBlurRow_SSE41(const uint32 *pSrc, uint32 *pDst, uint32 width, uint32 nRadius, uint32 nScale)
+{
+    int32 r = (int32)nRadius;
+    __m128i scale = _mm_set1_epi32((int)nScale);
+    __m128i s = _mm_setzero_si128();
+
+    for (int32 k = -r; k <= r; k++)
+    {
+        s = _mm_add_epi32(s, expandPixel(pSrc[k]));
+    }
+
+    for (int32 x = 0; x < (int32)width; x++)
+    {
+        __m128i v = boxScale(s, scale);
+        v = _mm_packus_epi16(_mm_packus_epi32(v, v), v);
+        pDst[x] = (uint32)_mm_cvtsi128_si32(v);
+
+        s = _mm_add_epi32(s, _mm_sub_epi32(expandPixel(pSrc[x + r + 1]), expandPixel(pSrc[x - r])));
+    }
+}
+
+// pixel I of 4 in add / sub joins its window sum; returns the scaled sum
+// from before
+template <int I>
+static inline __m128i boxColumn(uint32 *pSums, __m128i add, __m128i sub, __m128i scale)
+{
+    __m128i s = _mm_loadu_si128((const __m128i *)(pSums + 4 * I));
+    __m128i a = _mm_cvtepu8_epi32(_mm_srli_si128(add, 4 * I));
+    __m128i b = _mm_cvtepu8_epi32(_mm_srli_si128(sub, 4 * I));
+
+    _mm_storeu_si128((__m128i *)(pSums + 4 * I), _mm_add_epi32(s, _mm_sub_epi32(a, b)));
+    return boxScale(s, scale);
+}
+
+static void BoxBlurColumns_SSE41(uint32 *pSums, const uint32 *pAdd, const uint32 *pSub, uint32 *pDst,
+                                 uint32 nPixels, uint32 nScale)
+{
+    __m128i scale = _mm_set1_epi32((int)nScale);
+    uint32 x = 0;
+
+    for (; x + 4 <= nPixels; x += 4)
+    {
+        __m128i add = _mm_loadu_si128((const __m128i *)(pAdd + x));
+        __m128i sub = _mm_loadu_si128((const __m128i *)(pSub + x));
+        uint32 *s = pSums + 4 * x;
+
+        __m128i o01 = _mm_packus_epi32(boxColumn<0>(s, add, sub, scale), boxColumn<1>(s, add, sub, scale));
+        __m128i o23 = _mm_packus_epi32(boxColumn<2>(s, add, sub, scale), boxColumn<3>(s, add, sub, scale));
+        _mm_storeu_si128((__m128i *)(pDst + x), _mm_packus_epi16(o01, o23));
+    }
+
+    BoxBlurColumns_C(pSums + 4 * x, pAdd + x, pSub + x, pDst + x, nPixels - x, nScale);
+}
+
+// Unsharp mask on pixel I of 4 in add / sub / orig: sharpened int32
+// channels, and the window sum moved on
+template <int I>
+static inline __m128i unsharpPixel(uint32 *pSums, __m128i add, __m128i sub, __m128i orig, __m128i scale,
+                                   __m128i amount, __m128i threshold)
+{
+    __m128i o = _mm_cvtepu8_epi32(_mm_srli_si128(orig, 4 * I));
+    __m128i d = _mm_sub_epi32(o, boxColumn<I>(pSums, add, sub, scale));
+    __m128i m = _mm_cmpgt_epi32(_mm_abs_epi32(d), threshold);
+    __m128i v = _mm_srai_epi32(_mm_add_epi32(_mm_mullo_epi32(d, amount), _mm_set1_epi32(128)), 8);
+
+    return _mm_add_epi32(o, _mm_and_si128(v, m));
+}
+
+static void UnsharpRow_SSE41(uint32 *pSums, const uint32 *pAdd, const uint32 *pSub, uint32 *pRow,
+                             uint32 width, uint32 nScale, int32 nAmount, int32 nThreshold)
+{
+    __m128i scale = _mm_set1_epi32((int)nScale);
+    __m128i amount = _mm_set1_epi32(nAmount);
+    __m128i threshold = _mm_set1_epi32(nThreshold);
+    uint32 x = 0;
+
+    for (; x + 4 <= width; x += 4)
+    {
+        __m128i add = _mm_loadu_si128((const __m128i *)(pAdd + x));
+        __m128i sub = _mm_loadu_si128((const __m128i *)(pSub + x));
+        __m128i orig = _mm_loadu_si128((const __m128i *)(pRow + x));
+        uint32 *s = pSums + 4 * x;
+
+        __m128i o01 = _mm_packus_epi32(unsharpPixel<0>(s, add, sub, orig, scale, amount, threshold),
+                                       unsharpPixel<1>(s, add, sub, orig, scale, amount, threshold));
+        __m128i o23 = _mm_packus_epi32(unsharpPixel<2>(s, add, sub, orig, scale, amount, threshold),
+                                       unsharpPixel<3>(s, add, sub, orig, scale, amount, threshold));
+        _mm_storeu_si128((__m128i *)(pRow + x), _mm_packus_epi16(o01, o23));
+    }
+
+    UnsharpRow_C(pSums + 4 * x, pAdd + x, pSub + x, pRow + x, width - x, nScale, nAmount, nThreshold);
+}
+
+// Luma of 4 ARGB pixels in the low byte of each int32 lane
+static inline __m128i lumaPixels(__m128i p)
+{
+    __m128i m = _mm_set1_epi32(0xff);
+    __m128i y = _mm_mullo_epi32(_mm_and_si128(_mm_srli_epi32(p, 16), m), _mm_set1_epi32(54));
+    y = _mm_add_epi32(y, _mm_mullo_epi32(_mm_and_si128(_mm_srli_epi32(p, 8), m), _mm_set1_epi32(183)));
+    y = _mm_add_epi32(y, _mm_mullo_epi32(_mm_and_si128(p, m), _mm_set1_epi32(19)));
+    return _mm_srli_epi32(_mm_add_epi32(y, _mm_set1_epi32(128)), 8);
+}
+
+static void ARGBLumaRow_SSE41(const uint32 *pARGB, uint8 *pLuma, uint32 width)
+{
+    uint32 x = 0;
+
+    for (; x + 8 <= width; x += 8)
+    {
+        __m128i y0 = lumaPixels(_mm_loadu_si128((const __m128i *)(pARGB + x)));
+        __m128i y1 = lumaPixels(_mm_loadu_si128((const __m128i *)(pARGB + x + 4)));
+        __m128i y = _mm_packus_epi32(y0, y1);
+        _mm_storel_epi64((__m128i *)(pLuma + x), _mm_packus_epi16(y, y));
+    }
+
+    ARGBLumaRow_C(pARGB + x, pLuma + x, width - x);
+}
+
+// The change of luma as one saturating add and one saturating subtract on
+// the bytes: the per-pixel amounts, widened to a lane each, times 0x010101
+// reach B, G and R but not alpha.
+static void ShiftLumaRow_SSE41(uint32 *pARGB, const uint8 *pOld, const uint8 *pNew, uint32 width)
+{
+    __m128i spread = _mm_set1_epi32(0x010101);
+    uint32 x = 0;
+
+    for (; x + 4 <= width; x += 4)
+    {
+        __m128i o = _mm_cvtsi32_si128(*(const int *)(pOld + x));
+        __m128i n = _mm_cvtsi32_si128(*(const int *)(pNew + x));
+        __m128i up = _mm_mullo_epi32(_mm_cvtepu8_epi32(_mm_subs_epu8(n, o)), spread);
+        __m128i down = _mm_mullo_epi32(_mm_cvtepu8_epi32(_mm_subs_epu8(o, n)), spread);
+        __m128i p = _mm_loadu_si128((const __m128i *)(pARGB + x));
+
+        _mm_storeu_si128((__m128i *)(pARGB + x), _mm_subs_epu8(_mm_adds_epu8(p, up), down));
+    }
+
+    ShiftLumaRow_C(pARGB + x, pOld + x, pNew + x, width - x);
+}
+
+// the medians of cpuProcessFrameKernels.h on 16 bytes at a time
+struct MedianOps_SSE41
+{
+    typedef __m128i V;
+    enum { BYTES = 16 };
+
+    static V Load(const uint8 *p)     { return _mm_loadu_si128((const __m128i *)p); }
+    static void Store(uint8 *p, V v)  { _mm_storeu_si128((__m128i *)p, v); }
+    static V Min(V a, V b)            { return _mm_min_epu8(a, b); }
+    static V Max(V a, V b)            { return _mm_max_epu8(a, b); }
+};
+
+const CpuFilterKernels g_oCpuFilterKernels_SSE41 = { BoxBlurRow_SSE41, BoxBlurColumns_SSE41, UnsharpRow_SSE41,
+                                                     cpuMedianRow<MedianOps_SSE41, 3>, cpuMedianRow<MedianOps_SSE41, 5>,
+                                                     ARGBLumaRow_SSE41, ShiftLumaRow_SSE41 };
+
+#endif
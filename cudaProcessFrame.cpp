@@ -24,74 +24,196 @@
 #include <cuda.h>
 #include <builtin_types.h>
 
-static CUfunction         g_kernelNV12toARGB         = 0;
-static CUfunction         g_kernelARGBtoNV12         = 0;
-static CUfunction         g_kernelARGBpostprocess    = 0;
+// one instance of each conversion kernel per pixel format, matrix and range
+static CUfunction         g_kernelYUVtoARGB[NV_PIXEL_FORMAT_COUNT][NV_COLOR_MATRIX_COUNT][NV_COLOR_RANGE_COUNT];
+static CUfunction         g_kernelARGBtoYUV[NV_PIXEL_FORMAT_COUNT][NV_COLOR_MATRIX_COUNT][NV_COLOR_RANGE_COUNT];
+static CUfunction         g_kernelP010toARGB2101010[NV_COLOR_MATRIX_COUNT][NV_COLOR_RANGE_COUNT];
+static CUfunction         g_kernelARGB2101010toP010[NV_COLOR_MATRIX_COUNT][NV_COLOR_RANGE_COUNT];
+static CUfunction         g_kernelARGBcurves         = 0;
+static CUfunction         g_kernelARGB2101010curves  = 0;
 
 CUresult loadCUDAModules()
 {
     CUmodule cuModule_;
     checkCudaErrors(cuModuleLoad(&cuModule_, "videoPP64.ptx"));
-    checkCudaErrors(cuModuleGetFunction(&g_kernelNV12toARGB, cuModule_, "NV12ToARGBdrvapi"));
-    checkCudaErrors(cuModuleGetFunction(&g_kernelARGBtoNV12, cuModule_, "ARGBToNv12drvapi"));
-    checkCudaErrors(cuModuleGetFunction(&g_kernelARGBpostprocess, cuModule_, "ARGBpostprocess"));
+
+    for (int m = 0; m < NV_COLOR_MATRIX_COUNT; m++)
+    {
+        for (int r = 0; r < NV_COLOR_RANGE_COUNT; r++)
+        {
+            NvColorSpace oColorSpace = { (NvColorMatrix)m, (NvColorRange)r };
+            char szName[64];
+
+            for (int f = 0; f < NV_PIXEL_FORMAT_COUNT; f++)
+            {
+                const char *szFormat = nvPixelFormatName((NvPixelFormat)f);
+
+                sprintf(szName, "%sToARGBdrvapi_%s", szFormat, nvColorSpaceName(oColorSpace));
+                checkCudaErrors(cuModuleGetFunction(&g_kernelYUVtoARGB[f][m][r], cuModule_, szName));
+                sprintf(szName, "ARGBTo%sdrvapi_%s", szFormat, nvColorSpaceName(oColorSpace));
+                checkCudaErrors(cuModuleGetFunction(&g_kernelARGBtoYUV[f][m][r], cuModule_, szName));
+            }
+
+            sprintf(szName, "P010ToARGB2101010drvapi_%s", nvColorSpaceName(oColorSpace));
+            checkCudaErrors(cuModuleGetFunction(&g_kernelP010toARGB2101010[m][r], cuModule_, szName));
+            sprintf(szName, "ARGB2101010ToP010drvapi_%s", nvColorSpaceName(oColorSpace));
+            checkCudaErrors(cuModuleGetFunction(&g_kernelARGB2101010toP010[m][r], cuModule_, szName));
+        }
+    }
+
+    checkCudaErrors(cuModuleGetFunction(&g_kernelARGBcurves, cuModule_, "ARGBcurves"));
+    checkCudaErrors(cuModuleGetFunction(&g_kernelARGB2101010curves, cuModule_, "ARGB2101010curves"));
+
+    return CUDA_SUCCESS;
 }
 
-CUresult  cudaLaunchNV12toARGBDrv(CUdeviceptr d_srcNV12, size_t nSourcePitch,
-                                  CUdeviceptr d_dstARGB, size_t nDestPitch,
-                                  uint32 width,          uint32 height,
-                                  CUstream streamID)
+CUresult cudaLaunchYUVtoARGBDrv(NvPixelFormat eFormat,
+                                CUdeviceptr d_srcYUV,   size_t nSourcePitch,
+                                CUdeviceptr d_dstARGB,  size_t nDestPitch,
+                                uint32 width,           uint32 height,
+                                NvColorSpace oColorSpace,
+                                CUstream streamID)
 {
     // Each thread will output 2 pixels at a time.
     dim3 block(32,16,1);
     dim3 grid((width+(2*block.x-1))/(2*block.x), (height+(block.y-1))/block.y, 1);
 
-    void *args[] = { &d_srcNV12, &nSourcePitch,
+    void *args[] = { &d_srcYUV, &nSourcePitch,
                      &d_dstARGB, &nDestPitch,
                      &width, &height
                    };
 
-    checkCudaErrors(cuLaunchKernel(g_kernelNV12toARGB, grid.x, grid.y, grid.z,
+    checkCudaErrors(cuLaunchKernel(g_kernelYUVtoARGB[eFormat][oColorSpace.eMatrix][oColorSpace.eRange], grid.x, grid.y, grid.z,
+                            block.x, block.y, block.z,
+                            0, streamID,
+                            args, NULL));
+
+    return CUDA_SUCCESS;
+}
+
+CUresult cudaLaunchARGBtoYUVDrv(NvPixelFormat eFormat,
+                                CUdeviceptr d_srcARGB,  size_t nSourcePitch,
+                                CUdeviceptr d_dstYUV,   size_t nDestPitch,
+                                uint32 width,           uint32 height,
+                                NvColorSpace oColorSpace,
+                                CUstream streamID)
+{
+    // Each thread will output 2 pixels at a time.
+    dim3 block(32,16,1);
+    dim3 grid((width+(2*block.x-1))/(2*block.x), (height+(block.y-1))/block.y, 1);
+
+    void *args[] = { &d_srcARGB, &nSourcePitch,
+                     &d_dstYUV, &nDestPitch,
+                     &width, &height
+                   };
+
+    checkCudaErrors(cuLaunchKernel(g_kernelARGBtoYUV[eFormat][oColorSpace.eMatrix][oColorSpace.eRange], grid.x, grid.y, grid.z,
                             block.x, block.y, block.z,
                             0, streamID,
                             args, NULL));
 
+    return CUDA_SUCCESS;
+}
 
+CUresult  cudaLaunchNV12toARGBDrv(CUdeviceptr d_srcNV12, size_t nSourcePitch,
+                                  CUdeviceptr d_dstARGB, size_t nDestPitch,
+                                  uint32 width,          uint32 height,
+                                  NvColorSpace oColorSpace,
+                                  CUstream streamID)
+{
+    return cudaLaunchYUVtoARGBDrv(NV_PIXEL_FORMAT_NV12, d_srcNV12, nSourcePitch, d_dstARGB, nDestPitch,
+                                  width, height, oColorSpace, streamID);
 }
 
 CUresult cudaLaunchARGBtoNV12Drv(CUdeviceptr d_srcARGB,   size_t nSourcePitch,
                                  CUdeviceptr d_dstNV12,  size_t nDestPitch,
                                  uint32 width,           uint32 height,
+                                 NvColorSpace oColorSpace,
                                  CUstream streamID)
+{
+    return cudaLaunchARGBtoYUVDrv(NV_PIXEL_FORMAT_NV12, d_srcARGB, nSourcePitch, d_dstNV12, nDestPitch,
+                                  width, height, oColorSpace, streamID);
+}
+
+CUresult cudaLaunchARGBcurves(CUdeviceptr d_srcARGB,   size_t nSourcePitch,
+                              uint32 width,           uint32 height,
+                              CUdeviceptr d_curves,
+                              CUstream streamID)
+{
+
+    dim3 block(32,32,1);
+    dim3 grid((width+(block.x-1))/(block.x), (height+(block.y-1))/block.y, 1);
+
+    void *args[] = { &d_srcARGB, &nSourcePitch, &width, &height, &d_curves };
+
+    checkCudaErrors(cuLaunchKernel(g_kernelARGBcurves, grid.x, grid.y, grid.z,
+                            block.x, block.y, block.z,
+                            0, streamID,
+                            args, NULL));
+
+    return CUDA_SUCCESS;
+}
+
+CUresult cudaLaunchP010toARGB2101010Drv(CUdeviceptr d_srcP010,  size_t nSourcePitch,
+                                        CUdeviceptr d_dstARGB,  size_t nDestPitch,
+                                        uint32 width,           uint32 height,
+                                        NvColorSpace oColorSpace,
+                                        CUstream streamID)
 {
     // Each thread will output 2 pixels at a time.
     dim3 block(32,16,1);
     dim3 grid((width+(2*block.x-1))/(2*block.x), (height+(block.y-1))/block.y, 1);
 
-    void *args[] = { &d_srcARGB, &nSourcePitch,
-                     &d_dstNV12, &nDestPitch,
+    void *args[] = { &d_srcP010, &nSourcePitch,
+                     &d_dstARGB, &nDestPitch,
                      &width, &height
                    };
 
-    checkCudaErrors(cuLaunchKernel(g_kernelARGBtoNV12, grid.x, grid.y, grid.z,
+    checkCudaErrors(cuLaunchKernel(g_kernelP010toARGB2101010[oColorSpace.eMatrix][oColorSpace.eRange], grid.x, grid.y, grid.z,
                             block.x, block.y, block.z,
                             0, streamID,
                             args, NULL));
+
+    return CUDA_SUCCESS;
 }
 
-CUresult cudaLaunchARGBpostprocess(CUdeviceptr d_srcARGB,   size_t nSourcePitch,
-                                   uint32 width,           uint32 height,
-                                   CUstream streamID)
+CUresult cudaLaunchARGB2101010toP010Drv(CUdeviceptr d_srcARGB,  size_t nSourcePitch,
+                                        CUdeviceptr d_dstP010,  size_t nDestPitch,
+                                        uint32 width,           uint32 height,
+                                        NvColorSpace oColorSpace,
+                                        CUstream streamID)
 {
+    // Each thread will output 2 pixels at a time.
+    dim3 block(32,16,1);
+    dim3 grid((width+(2*block.x-1))/(2*block.x), (height+(block.y-1))/block.y, 1);
+
+    void *args[] = { &d_srcARGB, &nSourcePitch,
+                     &d_dstP010, &nDestPitch,
+                     &width, &height
+                   };
 
+    checkCudaErrors(cuLaunchKernel(g_kernelARGB2101010toP010[oColorSpace.eMatrix][oColorSpace.eRange], grid.x, grid.y, grid.z,
+                            block.x, block.y, block.z,
+                            0, streamID,
+                            args, NULL));
+
+    return CUDA_SUCCESS;
+}
+
+CUresult cudaLaunchARGB2101010curves(CUdeviceptr d_srcARGB,  size_t nSourcePitch,
+                                     uint32 width,           uint32 height,
+                                     CUdeviceptr d_curves,
+                                     CUstream streamID)
+{
     dim3 block(32,32,1);
     dim3 grid((width+(block.x-1))/(block.x), (height+(block.y-1))/block.y, 1);
 
-    void *args[] = { &d_srcARGB, &nSourcePitch, &width, &height };
+    void *args[] = { &d_srcARGB, &nSourcePitch, &width, &height, &d_curves };
 
-    checkCudaErrors(cuLaunchKernel(g_kernelARGBpostprocess, grid.x, grid.y, grid.z,
+    checkCudaErrors(cuLaunchKernel(g_kernelARGB2101010curves, grid.x, grid.y, grid.z,
                             block.x, block.y, block.z,
                             0, streamID,
                             args, NULL));
-}
 
+    return CUDA_SUCCESS;
+}
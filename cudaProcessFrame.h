@@ -14,27 +14,72 @@
 
 #include <cuda.h>
 #include <vector_types.h>
+#include "NvColorMatrix.h"
+#include "NvPixelFormat.h"
 
 typedef unsigned char   uint8;
+typedef unsigned short  uint16;
 typedef unsigned int    uint32;
 typedef int             int32;
 
 
+// loads the conversion kernels of every pixel format in NvPixelFormat.h
+// and colour space in NvColorMatrix.h
 CUresult loadCUDAModules();
 
+// Any 8-bit format of NvPixelFormat.h to ARGB and back; nSourcePitch /
+// nDestPitch on the YUV side is the luma (or packed row) pitch. Pixels are
+// converted in pairs, so width should be even.
+CUresult cudaLaunchYUVtoARGBDrv(NvPixelFormat eFormat,
+                                CUdeviceptr d_srcYUV,   size_t nSourcePitch,
+                                CUdeviceptr d_dstARGB,  size_t nDestPitch,
+                                uint32 width,           uint32 height,
+                                NvColorSpace oColorSpace,
+                                CUstream streamID);
+
+CUresult cudaLaunchARGBtoYUVDrv(NvPixelFormat eFormat,
+                                CUdeviceptr d_srcARGB,  size_t nSourcePitch,
+                                CUdeviceptr d_dstYUV,   size_t nDestPitch,
+                                uint32 width,           uint32 height,
+                                NvColorSpace oColorSpace,
+                                CUstream streamID);
+
 CUresult cudaLaunchNV12toARGBDrv(CUdeviceptr d_srcNV12,   size_t nSourcePitch,
                                  CUdeviceptr d_dstARGB,  size_t nDestPitch,
                                  uint32 width,           uint32 height,
+                                 NvColorSpace oColorSpace,
                                  CUstream streamID);
 
-CUresult cudaLaunchARGBpostprocess(CUdeviceptr d_srcARGB,   size_t nSourcePitch,
-                                   uint32 width,           uint32 height,
-                                   CUstream streamID);
+// The point-wise filters of a CNvFilterGraph, in place: d_curves holds
+// the graph's composed lookup tables (CNvFilterGraph::Curves(8)).
+CUresult cudaLaunchARGBcurves(CUdeviceptr d_srcARGB,   size_t nSourcePitch,
+                              uint32 width,           uint32 height,
+                              CUdeviceptr d_curves,
+                              CUstream streamID);
 
 CUresult cudaLaunchARGBtoNV12Drv(CUdeviceptr d_srcARGB,   size_t nSourcePitch,
                                  CUdeviceptr d_dstNV12,  size_t nDestPitch,
                                  uint32 width,           uint32 height,
+                                 NvColorSpace oColorSpace,
                                  CUstream streamID);
 
+// The 10-bit path: P010 decoder output to ARGB2101010 and back, with the
+// filters working on the full 10 bits per channel (Curves(10)).
+CUresult cudaLaunchP010toARGB2101010Drv(CUdeviceptr d_srcP010,  size_t nSourcePitch,
+                                        CUdeviceptr d_dstARGB,  size_t nDestPitch,
+                                        uint32 width,           uint32 height,
+                                        NvColorSpace oColorSpace,
+                                        CUstream streamID);
+
+CUresult cudaLaunchARGB2101010curves(CUdeviceptr d_srcARGB,  size_t nSourcePitch,
+                                     uint32 width,           uint32 height,
+                                     CUdeviceptr d_curves,
+                                     CUstream streamID);
+
+CUresult cudaLaunchARGB2101010toP010Drv(CUdeviceptr d_srcARGB,  size_t nSourcePitch,
+                                        CUdeviceptr d_dstP010,  size_t nDestPitch,
+                                        uint32 width,           uint32 height,
+                                        NvColorSpace oColorSpace,
+                                        CUstream streamID);
 
 #endif
@@ -17,6 +17,8 @@
 #include <memory>
 #include <iostream>
 #include <cassert>
+#include <thread>
+#include <sys/resource.h>
 
 #include "helper_timer.h"
 #include "helper_cuda_drvapi.h"
@@ -24,6 +26,15 @@
 #include "NvHWDecoder.h"
 #include "NvHWEncoder.h"
 #include "cudaProcessFrame.h"
+#include "NvCudaLoader.h"
+#include "cpuProcessFrame.h"
+#include "NvPipeline.h"
+#include "NvFramePool.h"
+#include "NvMp4Parser.h"
+#include "NvSWDecoder.h"
+#include "NvSWEncoder.h"
+#include "cpuBenchmark.h"
+#include "NvFilterGraph.h"
 
 const char *sAppFilename = "videoPP";
 
@@ -34,6 +45,45 @@ StopWatchInterface *frame_timer = NULL;
 StopWatchInterface *global_timer = NULL;
 float total_time = 0.0f;
 
+// -sw runs CNvSWDecoder/CNvSWEncoder instead of nvcuvid/NVENC, so the
+// threading and pipeline code can be exercised without a GPU.
+bool                g_bSoftware   = false;
+const char         *g_sInputFile  = VIDEO_SOURCE_FILE;
+const char         *g_sOutputFile = VIDEO_TARGET_FILE;
+NvSWDecoderConfig   g_oSWConfig   = { 1280, 720, 300, 0, { NV_COLOR_MATRIX_BT601, NV_COLOR_RANGE_LIMITED }, 8, false };
+unsigned int        g_uSWEncodeLatencyUs = 0;
+
+// -filters: the postprocess chain on the ARGB frame. With -sw it runs on
+// the host, chains of point-wise filters fused unless -nofuse; the GPU runs
+// its curves from g_dFilterCurves (8 and 10 bits).
+const char         *g_szFilters = "keepred";
+CNvFilterGraph      g_oFilterGraph;
+CUdeviceptr         g_dFilterCurves[2] = { 0, 0 };
+bool                g_bHostFusion = true;
+
+// -zerocopy: the host conversion writes the locked encoder input surface
+bool                g_bZeroCopy = false;
+
+// -strips: 0 = whole frames, ~0u = autotune at startup; -threads 0 = all
+unsigned int        g_uStripRows    = 0;
+unsigned int        g_uStripThreads = 0;
+
+// -bench: run a host kernel benchmark at -size and exit
+const char         *g_szBenchmark = NULL;
+
+// -fragment: frames per MP4 fragment, ~0u = the encoder's default (1 s);
+// -checkmp4: check an MP4 file and exit
+unsigned int        g_uMp4FragmentFrames = ~0u;
+const char         *g_szCheckMp4 = NULL;
+
+// -segment: seconds per CMAF segment for .m3u8/.mpd output, 0 = the
+// encoder's default (2 s); -segwindow: segments kept listed, 0 = all
+double              g_fSegmentSeconds = 0.0;
+unsigned int        g_uSegmentWindow = 0;
+
+// matrix for every conversion, from the decoder's signal description
+NvColorSpace        g_oColorSpace = { NV_COLOR_MATRIX_BT601, NV_COLOR_RANGE_LIMITED };
+
 bool                g_bDone       = false;
 bool                g_bIsProgressive = true; 
 
@@ -41,10 +91,104 @@ CUcontext          g_oDecContext = 0;
 CUcontext          g_oEncContext = 0;
 
 FrameQueue    *g_pFrameQueue   = 0;
-CNvHWDecoder  *g_pNvHWDecoder  = 0;
+INvVideoDecoder *g_pVideoDecoder = 0;
+
+// Audio of the source (-audio: synthesized by -sw), passed through into
+// MP4 and CMAF output; raw Annex-B output has no place for it. The first
+// frame's timestamp is time 0 of the output.
+CNvAudioQueue      g_oAudioQueue;
+long long          g_nVideoOrigin = 0;
 
-CUdeviceptr    g_pRGBAFrame[2] = { 0, 0 }; 
-void*          g_pNV12Frame[2] = { 0, 0 }; 
+// Frames in flight between the render loop and the encoder. Every one of
+// them can hold a mapped decoder output surface, so the decoder is created
+// with as many output surfaces.
+#define PIPELINE_DEPTH MAX_FRAME_COUNT
+
+struct PipelineFrame
+{
+    CUVIDPARSERDISPINFO oDisplayInfo;
+    CUVIDPROCPARAMS     oProcParams;
+    bool                bLastField;     // release the picture once this field is unmapped
+    CUdeviceptr         pDecodedFrame;
+    unsigned int        nDecodedPitch;
+    CNvFrameRef         oARGB;          // intermediate, until converted back; unused by fused host paths
+    CNvFrameRef         oOutput;        // NV12 or P010 for the encoder, until it is copied in
+    EncodeBuffer       *pEncodeBuffer;  // -zerocopy: the frame is already in its input surface
+    CUstream            hStream;
+    CUevent             hConverted;
+};
+
+PipelineFrame              g_aPipelineFrames[PIPELINE_DEPTH];
+CNvPipeline<PipelineFrame> g_oPipeline;
+
+// Frame memory behind oARGB and oOutput. Device memory and pinned host
+// memory come from the decoder context; the output is mapped into the
+// device address space, so the kernels write it and the encoder reads it
+// without a download. With -sw both are plain host memory.
+class CNvCudaFrameAllocator : public INvFrameAllocator
+{
+public:
+    CNvCudaFrameAllocator(bool bPinnedHost): m_bPinnedHost(bPinnedHost)
+    {
+    }
+
+    virtual void *Allocate(size_t nBytes, size_t nAlign)
+    {
+        void *pData = NULL;
+
+        checkCudaErrors(cuCtxPushCurrent(g_oDecContext));
+        if (m_bPinnedHost)
+        {
+            if (cuMemHostAlloc(&pData, nBytes, CU_MEMHOSTALLOC_PORTABLE|CU_MEMHOSTALLOC_DEVICEMAP) == CUDA_SUCCESS)
+            {
+                CUdeviceptr pinDevPtr = 0;
+                checkCudaErrors(cuMemHostGetDevicePointer(&pinDevPtr, pData, 0));
+                assert(pinDevPtr == (CUdeviceptr)pData);
+            }
+        }
+        else
+        {
+            CUdeviceptr pDevice = 0;
+            if (cuMemAlloc(&pDevice, nBytes) == CUDA_SUCCESS)
+            {
+                pData = (void *)pDevice;
+            }
+        }
+        checkCudaErrors(cuCtxPopCurrent(NULL));
+
+        // both are at least 256-byte aligned
+        assert(((size_t)pData & (nAlign - 1)) == 0);
+        return pData;
+    }
+
+    virtual void Free(void *pData)
+    {
+        checkCudaErrors(cuCtxPushCurrent(g_oDecContext));
+        if (m_bPinnedHost)
+        {
+            checkCudaErrors(cuMemFreeHost(pData));
+        }
+        else
+        {
+            checkCudaErrors(cuMemFree((CUdeviceptr)pData));
+        }
+        checkCudaErrors(cuCtxPopCurrent(NULL));
+    }
+
+    virtual const char *Name() const
+    {
+        return m_bPinnedHost ? "pinned host" : "device";
+    }
+
+private:
+    bool m_bPinnedHost;
+};
+
+CNvHostFrameAllocator g_oHostFrameAllocator;
+CNvCudaFrameAllocator g_oDeviceFrameAllocator(false);
+CNvCudaFrameAllocator g_oPinnedFrameAllocator(true);
+CNvFramePool          g_oARGBPool;
+CNvFramePool          g_oOutputPool;
 
 
 unsigned int g_FrameCount = 0;
@@ -52,14 +196,24 @@ unsigned int g_DecodeFrameCount = 0;
 unsigned int g_fpsCount = 0;      // FPS count for averaging
 unsigned int g_fpsLimit = 16;     // FPS limit for sampling timer;
 
+struct rusage g_oStartUsage;      // process CPU time when decoding started
+
 #include  "NvHWEncoder.h"
 
 #define MAX_ENCODE_QUEUE 32
 #define BITSTREAM_BUFFER_SIZE 2 * 1024 * 1024
-CNvHWEncoder                                        *m_pNvHWEncoder;
+INvVideoEncoder                                     *m_pVideoEncoder;
 uint32                                               m_uEncodeBufferCount = 4; // min buffers is numb + 1 + 3 pipelining
 EncodeBuffer                                         m_stEncodeBuffer[MAX_ENCODE_QUEUE];
-CNvQueue<EncodeBuffer>                               m_EncodeBufferQueue;
+CNvConcurrentQueue<EncodeBuffer>                     m_EncodeBufferQueue;
+std::thread                                          m_EncodeOutputThread;
+
+// frames copied into encoder input surfaces, on the encode stage
+unsigned long long                                   m_nEncodeInputCopies = 0;
+unsigned long long                                   m_nEncodeInputCopyBytes = 0;
+
+// frames submitted to the encoder, in display order
+unsigned long long                                   m_nEncodeFrames = 0;
 
 void printStatistics()
 {
@@ -68,6 +222,15 @@ void printStatistics()
     float present_fps = 1.f / (total_time / (g_FrameCount * 1000.f));
     float decoded_fps = 1.f / (total_time / (g_DecodeFrameCount * 1000.f));
 
+    // CPU time of every thread in this session (render, parser callbacks,
+    // bitstream output) against wall time; 100% means one full core.
+    struct rusage oEndUsage;
+    getrusage(RUSAGE_SELF, &oEndUsage);
+    double cpu_ms = (oEndUsage.ru_utime.tv_sec  - g_oStartUsage.ru_utime.tv_sec)  * 1000.0 +
+                    (oEndUsage.ru_utime.tv_usec - g_oStartUsage.ru_utime.tv_usec) / 1000.0 +
+                    (oEndUsage.ru_stime.tv_sec  - g_oStartUsage.ru_stime.tv_sec)  * 1000.0 +
+                    (oEndUsage.ru_stime.tv_usec - g_oStartUsage.ru_stime.tv_usec) / 1000.0;
+
     msec = ((int)total_time % 1000);
     ss   = (int)(total_time/1000) % 60;
     mm   = (int)(total_time/(1000*60)) % 60;
@@ -81,6 +244,127 @@ void printStatistics()
 
     printf("\t Frames Decoded   (hardware)    = %d\n", g_DecodeFrameCount);
     printf("\t Average Rate of Decoding (fps) = %4.2f\n", decoded_fps);
+    printf("\t CPU Time (user+sys)       (ms) = %.1f\n", cpu_ms);
+    printf("\t CPU Utilization (1 core = 100%%) = %4.1f%%\n", total_time > 0.f ? 100.0 * cpu_ms / total_time : 0.0);
+
+    if (g_pFrameQueue)
+    {
+        FrameQueueStats oQueueStats;
+        g_pFrameQueue->getStatistics(&oQueueStats);
+
+        printf("\t Queue Full Waits (decoder)     = %llu (%.3f ms)\n",
+               oQueueStats.nProducerWaits, oQueueStats.nProducerWaitUs / 1000.0);
+        printf("\t Surface Busy Waits (decoder)   = %llu (%.3f ms)\n",
+               oQueueStats.nSurfaceWaits, oQueueStats.nSurfaceWaitUs / 1000.0);
+        printf("\t Queue Empty Waits (render)     = %llu (%.3f ms)\n",
+               oQueueStats.nConsumerWaits, oQueueStats.nConsumerWaitUs / 1000.0);
+    }
+
+    NvQueueStats oEncodeStats;
+    m_EncodeBufferQueue.GetStats(&oEncodeStats);
+
+    printf("\t Encode Buffers In Flight (avg) = %4.2f of %u (max %u)\n",
+           oEncodeStats.nSubmitted ? (double)oEncodeStats.nOccupancySum / oEncodeStats.nSubmitted : 0.0,
+           m_uEncodeBufferCount, oEncodeStats.uMaxOccupancy);
+    printf("\t Encode Submit Waits            = %llu (%.3f ms)\n",
+           oEncodeStats.nAvailableWaits, oEncodeStats.nAvailableWaitUs / 1000.0);
+    printf("\t Bitstream Retrieve Waits       = %llu (%.3f ms)\n",
+           oEncodeStats.nPendingWaits, oEncodeStats.nPendingWaitUs / 1000.0);
+    NvBitstreamWriterStats oWriterStats;
+    m_pVideoEncoder->GetOutput()->GetStats(&oWriterStats);
+
+    printf("\t Bitstream Writer Queue         = %4.2f of %u chunks avg (max %u), %llu writes of %.1f KB avg\n",
+           oWriterStats.nHandoffs ? (double)oWriterStats.nQueuedSum / oWriterStats.nHandoffs : 0.0, NV_BITSTREAM_CHUNK_COUNT,
+           oWriterStats.uMaxQueued, oWriterStats.nWrites,
+           oWriterStats.nWrites ? oWriterStats.nBytes / 1024.0 / oWriterStats.nWrites : 0.0);
+    printf("\t Bitstream Writer Blocked       = %llu (%.3f ms), %.3f ms writing\n",
+           oWriterStats.nBlocked, oWriterStats.nBlockedUs / 1000.0, oWriterStats.nWriteUs / 1000.0);
+    printf("\t Encode Input Copies            = %llu (%.2f MB)\n",
+           m_nEncodeInputCopies, m_nEncodeInputCopyBytes / 1048576.0);
+
+    if (m_pVideoEncoder->GetMuxer())
+    {
+        NvMp4MuxerStats oMuxerStats;
+        m_pVideoEncoder->GetMuxer()->GetStats(&oMuxerStats);
+
+        printf("\t MP4 Fragments                  = %llu of %s, max %u frames / %.2f MB buffered, %.2f%% container overhead\n",
+               oMuxerStats.nFragments, m_pVideoEncoder->GetMuxer()->CodecString().c_str(),
+               oMuxerStats.uMaxFragmentFrames, oMuxerStats.nMaxFragmentBytes / 1048576.0,
+               oMuxerStats.nMediaBytes ? 100.0 * oMuxerStats.nHeaderBytes / oMuxerStats.nMediaBytes : 0.0);
+
+        NvAudioQueueStats oAudioStats;
+        g_oAudioQueue.GetStats(&oAudioStats);
+        if (oAudioStats.nPackets)
+        {
+            printf("\t MP4 Audio                      = %llu frames of %s, %llu dropped, %llu gaps (%llu packets, %llu bytes skipped, %llu overflowed)\n",
+                   oMuxerStats.nAudioFrames, m_pVideoEncoder->GetMuxer()->HasAudio() ? m_pVideoEncoder->GetMuxer()->AudioCodecString().c_str() : "none",
+                   oMuxerStats.nAudioDropped, oMuxerStats.nAudioGaps,
+                   oAudioStats.nPackets, oAudioStats.nSkippedBytes, oAudioStats.nOverflowBytes);
+        }
+    }
+
+    if (m_pVideoEncoder->GetSegmenter())
+    {
+        NvCmafSegmenterStats oSegmenterStats;
+        m_pVideoEncoder->GetSegmenter()->GetStats(&oSegmenterStats);
+
+        printf("\t CMAF Segments                  = %llu of %u frames (max %.2f MB), %llu removed, %llu list updates\n",
+               oSegmenterStats.nSegments, m_pVideoEncoder->GetSegmenter()->SegmentFrames(),
+               oSegmenterStats.nMaxSegmentBytes / 1048576.0, oSegmenterStats.nRemoved, oSegmenterStats.nPlaylistUpdates);
+        printf("\t CMAF Segment Switch            = %.3f ms avg (max %.3f ms)\n",
+               oSegmenterStats.nSegments > 1 ? oSegmenterStats.nSwitchUs / 1000.0 / (oSegmenterStats.nSegments - 1) : 0.0,
+               oSegmenterStats.nMaxSwitchUs / 1000.0);
+    }
+
+    if (g_bSoftware && m_pVideoEncoder)
+    {
+        NvSWEncoderStats oSWStats;
+        ((CNvSWEncoder *)m_pVideoEncoder)->GetStats(&oSWStats);
+
+        printf("\t Encoder Surface Locks / Frames = %llu / %llu, %llu stale\n",
+               oSWStats.nLocks, oSWStats.nFrames, oSWStats.nStaleFrames);
+    }
+
+    if (g_bSoftware && g_pVideoDecoder)
+    {
+        // strips keep the ARGB intermediate in L2 just like fusion does
+        bool bFused = g_bHostFusion && cpuIsFusable(g_oFilterGraph.HostPostprocess());
+        bool bStrips = cpuStripPlan().nStripRows != 0;
+        bool bInCache = bFused || bStrips;
+        size_t nYUVPitch  = g_aPipelineFrames[0].nDecodedPitch;
+        size_t nRGBAPitch = g_oARGBPool.Pitch();
+        uint32 height     = g_pVideoDecoder->targetHeight();
+
+        printf("\t Host Postprocess (%s, %s, %s%s) = %.2f MB/frame moved (%s: %.2f MB)\n",
+               g_oFilterGraph.Empty() ? "none" : g_oFilterGraph.Description().c_str(),
+               g_pVideoDecoder->bitDepth() > 8 ? "P010" : "NV12", bFused ? "fused" : "unfused", bStrips ? ", strips" : "",
+               cpuPostprocessBytes(nYUVPitch, nRGBAPitch, height, bInCache) / 1048576.0,
+               bInCache ? "whole frames, unfused" : "fused",
+               cpuPostprocessBytes(nYUVPitch, nRGBAPitch, height, !bInCache) / 1048576.0);
+    }
+
+    CNvFramePool *apPools[2] = { &g_oOutputPool, &g_oARGBPool };
+    for (int i = 0; i < 2; i++)
+    {
+        NvFramePoolStats oPoolStats;
+        apPools[i]->GetStats(&oPoolStats);
+
+        printf("\t Frame Pool %-4s high water      = %u of %u (%u allocated x %.2f MB), %llu waits (%.3f ms)\n",
+               nvFrameFormatName(apPools[i]->Config().eFormat), oPoolStats.nHighWater, apPools[i]->Config().nMaxFrames,
+               oPoolStats.nAllocated, oPoolStats.nFrameBytes / 1048576.0,
+               oPoolStats.nAcquireWaits, oPoolStats.nAcquireWaitUs / 1000.0);
+    }
+
+    for (unsigned int i = 0; i < g_oPipeline.StageCount(); i++)
+    {
+        NvPipelineStageStats oStageStats;
+        g_oPipeline.GetStageStats(i, &oStageStats);
+
+        printf("\t Stage %-8s busy / starved  = %.1f ms (%4.1f%%) / %.1f ms, %llu frames\n",
+               oStageStats.szName, oStageStats.nBusyUs / 1000.0,
+               total_time > 0.f ? oStageStats.nBusyUs / (10.0 * total_time) : 0.0,
+               oStageStats.nStarvedUs / 1000.0, oStageStats.nFrames);
+    }
 }
 
 void computeFPS()
@@ -134,43 +418,116 @@ void releaseIOBuffers()
 {
     for (uint32_t i = 0; i < m_uEncodeBufferCount; i++)
     {
-        m_pNvHWEncoder->NvEncDestroyInputBuffer(m_stEncodeBuffer[i].stInputBfr.hInputSurface);
+        m_pVideoEncoder->NvEncDestroyInputBuffer(m_stEncodeBuffer[i].stInputBfr.hInputSurface);
         m_stEncodeBuffer[i].stInputBfr.hInputSurface = NULL;
 
-        m_pNvHWEncoder->NvEncDestroyBitstreamBuffer(m_stEncodeBuffer[i].stOutputBfr.hBitstreamBuffer);
+        m_pVideoEncoder->NvEncDestroyBitstreamBuffer(m_stEncodeBuffer[i].stOutputBfr.hBitstreamBuffer);
         m_stEncodeBuffer[i].stOutputBfr.hBitstreamBuffer = NULL;
     }
 }
 
-void AllocateIOBuffers(uint32_t uInputWidth, uint32_t uInputHeight)
+void AllocateIOBuffers(uint32_t uInputWidth, uint32_t uInputHeight, NV_ENC_BUFFER_FORMAT inputFormat)
 {
     m_EncodeBufferQueue.Initialize(m_stEncodeBuffer, m_uEncodeBufferCount);
     for (uint32_t i = 0; i < m_uEncodeBufferCount; i++)
     {
-        checkNvEncErrors(m_pNvHWEncoder->NvEncCreateInputBuffer(uInputWidth, uInputHeight, &m_stEncodeBuffer[i].stInputBfr.hInputSurface));
+        checkNvEncErrors(m_pVideoEncoder->NvEncCreateInputBuffer(uInputWidth, uInputHeight, inputFormat, &m_stEncodeBuffer[i].stInputBfr.hInputSurface));
 
-        m_stEncodeBuffer[i].stInputBfr.bufferFmt = NV_ENC_BUFFER_FORMAT_NV12_PL;
+        m_stEncodeBuffer[i].stInputBfr.bufferFmt = inputFormat;
         m_stEncodeBuffer[i].stInputBfr.dwWidth = uInputWidth;
         m_stEncodeBuffer[i].stInputBfr.dwHeight = uInputHeight;
 
-        checkNvEncErrors(m_pNvHWEncoder->NvEncCreateBitstreamBuffer(BITSTREAM_BUFFER_SIZE, &m_stEncodeBuffer[i].stOutputBfr.hBitstreamBuffer));
+        checkNvEncErrors(m_pVideoEncoder->NvEncCreateBitstreamBuffer(BITSTREAM_BUFFER_SIZE, &m_stEncodeBuffer[i].stOutputBfr.hBitstreamBuffer));
         m_stEncodeBuffer[i].stOutputBfr.dwBitstreamBufferSize = BITSTREAM_BUFFER_SIZE;
         m_stEncodeBuffer[i].stOutputBfr.hOutputEvent = NULL;
     }
 }
 
+// Moves the audio demuxed so far into the muxer. The track is added with
+// the first frame found, unless the first fragment is out by then, and
+// the audio is discarded; so is audio from before the first video frame.
+void FeedAudio(CNvMp4Muxer *pMuxer)
+{
+    NvAudioFrame oFrame;
+    NvAudioFormat oFormat;
+    while (g_oAudioQueue.Pop(&oFrame))
+    {
+        g_oAudioQueue.GetFormat(&oFormat);
+        if (!pMuxer->HasAudio() && !pMuxer->SetAudioFormat(oFormat))
+            continue;
+        if (oFrame.nTimestamp < g_nVideoOrigin)
+            continue;
+
+        pMuxer->WriteAudioFrame(&oFrame.vData[0], oFrame.vData.size(),
+                                (oFrame.nTimestamp - g_nVideoOrigin) * oFormat.uSampleRate / NV_AUDIO_CLOCK_RATE);
+    }
+}
+
+// Drains encoded frames in submission order so bitstream locking and file
+// output overlap with frame submission on the render thread.
+void EncodeOutputThread()
+{
+    CNvMp4Muxer *pMuxer = m_pVideoEncoder->GetMuxer();
+
+    EncodeBuffer *pEncodeBuffer = m_EncodeBufferQueue.GetPending();
+    while (pEncodeBuffer)
+    {
+        m_pVideoEncoder->ProcessOutput(pEncodeBuffer);
+        m_EncodeBufferQueue.ReleasePending(pEncodeBuffer);
+        if (pMuxer){
+            FeedAudio(pMuxer);
+        }
+        pEncodeBuffer = m_EncodeBufferQueue.GetPending();
+    }
+
+    // the last fragment and the index; this is the thread the muxer runs on
+    if (pMuxer){
+        FeedAudio(pMuxer);
+    }
+    if (pMuxer && !pMuxer->Close()){
+        printf("EncodeOutputThread: muxing %s failed\n", g_sOutputFile);
+    }
+
+    // the file is complete once the writer thread has caught up; the
+    // segmenter has already closed the last segment
+    if (!m_pVideoEncoder->GetSegmenter() && !m_pVideoEncoder->GetOutput()->Flush()){
+        printf("EncodeOutputThread: writing %s failed\n", g_sOutputFile);
+    }
+}
+
 bool openOutputVideo(int width, int height)
 {
     uint32_t numBytesRead = 0;
     int numFramesEncoded = 0;
 
-    m_pNvHWEncoder = new CNvHWEncoder;
+    if (g_bSoftware){
+        m_pVideoEncoder = new CNvSWEncoder(g_uSWEncodeLatencyUs);
+    } else {
+        m_pVideoEncoder = new CNvHWEncoder;
+    }
 
-    checkNvEncErrors(m_pNvHWEncoder->Initialize(g_oEncContext, NV_ENC_DEVICE_TYPE_CUDA));
+    checkNvEncErrors(m_pVideoEncoder->Initialize(g_oEncContext, NV_ENC_DEVICE_TYPE_CUDA));
 
-    checkNvEncErrors(m_pNvHWEncoder->CreateEncoder(VIDEO_TARGET_FILE, NV_ENC_H264, width, height, 30, 5000000));
+    checkNvEncErrors(m_pVideoEncoder->CreateEncoder(g_sOutputFile, NV_ENC_H264, width, height, 30, 5000000));
+    if (m_pVideoEncoder->GetMuxer() && g_uMp4FragmentFrames != ~0u){
+        m_pVideoEncoder->GetMuxer()->SetFragmentFrames(g_uMp4FragmentFrames);
+    }
+    if (m_pVideoEncoder->GetSegmenter()){
+        CNvMp4Muxer *pMuxer = m_pVideoEncoder->GetMuxer();
+        if (g_fSegmentSeconds > 0.0){
+            m_pVideoEncoder->GetSegmenter()->SetSegmentFrames(
+                (unsigned int)(g_fSegmentSeconds * pMuxer->Timescale() / pMuxer->FrameDuration() + 0.5));
+        }
+        m_pVideoEncoder->GetSegmenter()->SetWindow(g_uSegmentWindow);
+    }
+    if (m_pVideoEncoder->GetMuxer()){
+        g_pVideoDecoder->setAudioQueue(&g_oAudioQueue);
+    }
 
-    AllocateIOBuffers(width, height);
+    // the decoder's surface format goes straight through to the encoder
+    AllocateIOBuffers(width, height, g_pVideoDecoder->bitDepth() > 8 ? NV_ENC_BUFFER_FORMAT_P010_PL : NV_ENC_BUFFER_FORMAT_NV12_PL);
+
+    m_EncodeOutputThread = std::thread(EncodeOutputThread);
 
     return 0;
 }
@@ -178,21 +535,89 @@ bool openOutputVideo(int width, int height)
 bool loadVideoSource(const char *video_file, unsigned int &width, unsigned int &height)
 {
     g_pFrameQueue  = new FrameQueue;
-    g_pNvHWDecoder = new CNvHWDecoder(video_file, g_pFrameQueue, g_oDecContext);
+    if (g_bSoftware){
+        g_pVideoDecoder = new CNvSWDecoder(video_file ? video_file : "", g_pFrameQueue, g_oSWConfig);
+    } else {
+        g_pVideoDecoder = new CNvHWDecoder(video_file, g_pFrameQueue, g_oDecContext);
+    }
 
-    width = g_pNvHWDecoder->sourceWidth();
-    height = g_pNvHWDecoder->sourceHeight();
+    width = g_pVideoDecoder->sourceWidth();
+    height = g_pVideoDecoder->sourceHeight();
+
+    g_oColorSpace = g_pVideoDecoder->colorSpace();
+    printf("> Color space %s\n", nvColorSpaceName(g_oColorSpace));
 
     bool IsProgressive = 0;
-    g_pNvHWDecoder->getProgressive(IsProgressive);
+    g_pVideoDecoder->getProgressive(IsProgressive);
     return IsProgressive;
 }
 
 
+// One output frame per pipeline slot at most, and as many ARGB frames;
+// nPrealloc of each are allocated now, the rest when first needed.
+bool initFramePools(INvFrameAllocator *pARGBAllocator, INvFrameAllocator *pOutputAllocator, unsigned int nPrealloc)
+{
+    NvFramePoolConfig oConfig;
+    oConfig.eFormat     = g_pVideoDecoder->bitDepth() > 8 ? NV_FRAME_FORMAT_P010 : NV_FRAME_FORMAT_NV12;
+    oConfig.width       = g_pVideoDecoder->targetWidth();
+    oConfig.height      = g_pVideoDecoder->targetHeight();
+    oConfig.nPitchAlign = NV_FRAME_POOL_PITCH_ALIGN;
+    oConfig.nMaxFrames  = PIPELINE_DEPTH;
+    oConfig.nPrealloc   = nPrealloc;
+    if (!g_oOutputPool.Initialize(oConfig, pOutputAllocator)){
+        return false;
+    }
+
+    oConfig.eFormat = NV_FRAME_FORMAT_ARGB;
+    return g_oARGBPool.Initialize(oConfig, pARGBAllocator);
+}
+
+// Host-only setup for -sw: no contexts, kernels, streams or events; the
+// frames come from host memory pools.
+bool initHostResources()
+{
+    printf("\n> Using software decoder/encoder, %s host kernels\n", cpuISAName(cpuSelectedISA()));
+    printf("> Filters: %s\n", g_oFilterGraph.Empty() ? "none" : g_oFilterGraph.Description().c_str());
+
+    unsigned int videoWidth  = 0;
+    unsigned int videoHeight = 0;
+    g_bIsProgressive = loadVideoSource(g_sInputFile, videoWidth, videoHeight);
+
+    if (g_uStripRows == ~0u){
+        cpuAutotuneStrips(g_pVideoDecoder->targetWidth(), g_pVideoDecoder->targetHeight(), g_pVideoDecoder->bitDepth(),
+                          g_oColorSpace, g_oFilterGraph.HostPostprocess(), g_bHostFusion, g_uStripThreads);
+        // the tuning runs went through the temporal filters too
+        g_oFilterGraph.Reset();
+    } else if (g_uStripRows){
+        CpuStripPlan oPlan = { g_uStripRows, g_uStripThreads };
+        cpuSetStripPlan(oPlan);
+    }
+    if (cpuStripPlan().nStripRows){
+        printf("> Host postprocess in %u-row strips on %u threads (L2 %zu KB)\n",
+               cpuStripPlan().nStripRows, cpuStripPlan().nThreads, cpuL2CacheBytes() >> 10);
+    }
+
+    // nothing up front: fused and strip paths never take an ARGB frame
+    if (!initFramePools(&g_oHostFrameAllocator, &g_oHostFrameAllocator, 0)){
+        assert(0);
+        return false;
+    }
+
+    openOutputVideo(videoWidth, videoHeight);
+
+    return true;
+}
+
 bool initCudaResources()
 {
     printf("\n");
 
+    // the driver libraries are opened here, not at startup (NvCudaLoader.h)
+    if (!nvCudaLoad()){
+        printf("> No CUDA driver found; -sw runs without one\n");
+        exit(EXIT_FAILURE);
+    }
+
     cuInit(0);
     CUdevice g_oDecDevice  = 0;
     CUdevice g_oEncDevice  = 0;
@@ -210,24 +635,33 @@ bool initCudaResources()
     checkCudaErrors(cuCtxCreate(&g_oDecContext, CU_CTX_BLOCKING_SYNC, g_oDecDevice));
     loadCUDAModules();
 
+    for (int i = 0; i < 2 && !g_oFilterGraph.Empty(); i++)
+    {
+        size_t nBytes = (3u << (i ? 10 : 8)) * sizeof(uint16);
+        checkCudaErrors(cuMemAlloc(&g_dFilterCurves[i], nBytes));
+        checkCudaErrors(cuMemcpyHtoD(g_dFilterCurves[i], g_oFilterGraph.Curves(i ? 10 : 8), nBytes));
+    }
+
     // load video source
     unsigned int videoWidth  = 0;
     unsigned int videoHeight = 0;
-    g_bIsProgressive = loadVideoSource(VIDEO_SOURCE_FILE, videoWidth, videoHeight);
+    g_bIsProgressive = loadVideoSource(g_sInputFile, videoWidth, videoHeight);
 
 
-    // RGBA uint32
-    checkCudaErrors(cuMemAlloc(&g_pRGBAFrame[0], g_pNvHWDecoder->targetWidth() * g_pNvHWDecoder->targetHeight() * 4));
-    checkCudaErrors(cuMemAlloc(&g_pRGBAFrame[1], g_pNvHWDecoder->targetWidth() * g_pNvHWDecoder->targetHeight() * 4));
+    // Two of each up front, one being converted and one being encoded; the
+    // pinned allocations are slow enough to show up mid-stream.
+    if (!initFramePools(&g_oDeviceFrameAllocator, &g_oPinnedFrameAllocator, 2)){
+        assert(0);
+        return false;
+    }
+
+    for (int i = 0; i < PIPELINE_DEPTH; i++)
+    {
+        PipelineFrame *pFrame = &g_aPipelineFrames[i];
 
-    // should be encode_width_align*3/2
-    checkCudaErrors(cuMemHostAlloc(&g_pNV12Frame[0], g_pNvHWDecoder->targetWidth() * g_pNvHWDecoder->targetHeight() * 4, CU_MEMHOSTALLOC_PORTABLE|CU_MEMHOSTALLOC_DEVICEMAP));
-    checkCudaErrors(cuMemHostAlloc(&g_pNV12Frame[1], g_pNvHWDecoder->targetWidth() * g_pNvHWDecoder->targetHeight() * 4, CU_MEMHOSTALLOC_PORTABLE|CU_MEMHOSTALLOC_DEVICEMAP));
-    CUdeviceptr pinDevPtr = NULL;
-    checkCudaErrors(cuMemHostGetDevicePointer(&pinDevPtr, g_pNV12Frame[0], 0));
-    assert(pinDevPtr == (CUdeviceptr)g_pNV12Frame[0]);
-    checkCudaErrors(cuMemHostGetDevicePointer(&pinDevPtr, g_pNV12Frame[1], 0));
-    assert(pinDevPtr == (CUdeviceptr)g_pNV12Frame[1]);
+        checkCudaErrors(cuStreamCreate(&pFrame->hStream, CU_STREAM_NON_BLOCKING));
+        checkCudaErrors(cuEventCreate(&pFrame->hConverted, CU_EVENT_DISABLE_TIMING));
+    }
 
     CUcontext cuCurrent = NULL;
     CUresult result = cuCtxPopCurrent(&cuCurrent);
@@ -253,15 +687,17 @@ bool initCudaResources()
 
 void freeCudaResources(bool bDestroyContext)
 {
-    if (g_pNvHWDecoder){
-        delete g_pNvHWDecoder;
+    if (g_pVideoDecoder){
+        delete g_pVideoDecoder;
     }
 
     if (g_pFrameQueue){
         delete g_pFrameQueue;
     }
 
-    if (bDestroyContext){
+    if (bDestroyContext && !g_bSoftware){
+        // the context takes its allocations along
+        g_dFilterCurves[0] = g_dFilterCurves[1] = 0;
         checkCudaErrors(cuCtxDestroy(g_oDecContext));
         g_oDecContext= NULL;
 
@@ -274,129 +710,306 @@ void freeCudaResources(bool bDestroyContext)
 
 void FlushEncoder()
 {
-    checkNvEncErrors(m_pNvHWEncoder->NvEncFlushEncoderQueue(NULL));
+    checkNvEncErrors(m_pVideoEncoder->NvEncFlushEncoderQueue(NULL));
 
-    EncodeBuffer *pEncodeBufer = m_EncodeBufferQueue.GetPending();
-    while (pEncodeBufer)
+    // the output thread drains whatever is still pending, then exits
+    m_EncodeBufferQueue.Shutdown();
+    if (m_EncodeOutputThread.joinable())
     {
-        m_pNvHWEncoder->ProcessOutput(pEncodeBufer);
-        pEncodeBufer = m_EncodeBufferQueue.GetPending();
+        m_EncodeOutputThread.join();
     }
 }
 
-void EncodeHostFrame(void* ppNV12Frame, size_t nDecodedPitch)
+// Submits an input surface that holds a complete frame, unlocked. For
+// segmented output every segment starts with a forced IDR, so the segmenter
+// can cut there.
+void SubmitEncodeBuffer(EncodeBuffer *pEncodeBuffer)
+{
+    uint32 width  = g_pVideoDecoder->targetWidth();
+    uint32 height = g_pVideoDecoder->targetHeight();
+
+    NvEncPictureCommand oPicCommand;
+    memset(&oPicCommand, 0, sizeof(oPicCommand));
+    CNvCmafSegmenter *pSegmenter = m_pVideoEncoder->GetSegmenter();
+    oPicCommand.bForceIDR = pSegmenter && m_nEncodeFrames % pSegmenter->SegmentFrames() == 0;
+    m_nEncodeFrames++;
+
+    checkNvEncErrors(m_pVideoEncoder->NvEncEncodeFrame(pEncodeBuffer, oPicCommand.bForceIDR ? &oPicCommand : NULL,
+                                                       width, height, NV_ENC_PIC_STRUCT_FRAME));
+    m_EncodeBufferQueue.PushPending(pEncodeBuffer);
+}
+
+void EncodeHostFrame(void* ppNV12Frame, size_t nFramePitch)
 {
-    uint32 width  = g_pNvHWDecoder->targetWidth();
-    uint32 height = g_pNvHWDecoder->targetHeight();
+    uint32 width  = g_pVideoDecoder->targetWidth();
+    uint32 height = g_pVideoDecoder->targetHeight();
     EncodeBuffer *pEncodeBuffer = m_EncodeBufferQueue.GetAvailable();
     if(!pEncodeBuffer){
-        m_pNvHWEncoder->ProcessOutput(m_EncodeBufferQueue.GetPending());
-        pEncodeBuffer = m_EncodeBufferQueue.GetAvailable();
+        printf("EncodeHostFrame: no free encode buffer, frame dropped\n");
+        assert(0);
+        return;
     }
 
     unsigned char *pInputSurface = NULL;
     uint32_t lockedPitch = 0;
-    checkNvEncErrors(m_pNvHWEncoder->NvEncLockInputBuffer(pEncodeBuffer->stInputBfr.hInputSurface, (void**)&pInputSurface, &lockedPitch));
-    assert(lockedPitch == nDecodedPitch);
+    checkNvEncErrors(m_pVideoEncoder->NvEncLockInputBuffer(pEncodeBuffer->stInputBfr.hInputSurface, (void**)&pInputSurface, &lockedPitch));
 
-    memcpy(pInputSurface, (void*)ppNV12Frame, lockedPitch*height*3/2);
+    if (lockedPitch == nFramePitch)
+    {
+        memcpy(pInputSurface, (void*)ppNV12Frame, lockedPitch*height*3/2);
+    }
+    else
+    {
+        // backends don't have to agree on pitch alignment
+        uint32 rowBytes = g_pVideoDecoder->bitDepth() > 8 ? width * 2 : width;
+        for (uint32 y = 0; y < height*3/2; y++)
+        {
+            memcpy(pInputSurface + y*lockedPitch, (unsigned char*)ppNV12Frame + y*nFramePitch, rowBytes);
+        }
+    }
+    m_nEncodeInputCopies++;
+    m_nEncodeInputCopyBytes += (unsigned long long)(g_pVideoDecoder->bitDepth() > 8 ? width * 2 : width) * height * 3 / 2;
 
-    checkNvEncErrors(m_pNvHWEncoder->NvEncUnlockInputBuffer(pEncodeBuffer->stInputBfr.hInputSurface));
+    checkNvEncErrors(m_pVideoEncoder->NvEncUnlockInputBuffer(pEncodeBuffer->stInputBfr.hInputSurface));
 
-    checkNvEncErrors(m_pNvHWEncoder->NvEncEncodeFrame(pEncodeBuffer, NULL, width, height, NV_ENC_PIC_STRUCT_FRAME));
+    SubmitEncodeBuffer(pEncodeBuffer);
 }
 
 void EncodeDevFrame(CUdeviceptr ppNV12Frame, size_t nDecodedPitch)
 {
-    uint32 width  = g_pNvHWDecoder->targetWidth();
-    uint32 height = g_pNvHWDecoder->targetHeight();
+    uint32 height = g_pVideoDecoder->targetHeight();
     EncodeBuffer *pEncodeBuffer = m_EncodeBufferQueue.GetAvailable();
     if(!pEncodeBuffer){
-        m_pNvHWEncoder->ProcessOutput(m_EncodeBufferQueue.GetPending());
-        pEncodeBuffer = m_EncodeBufferQueue.GetAvailable();
+        printf("EncodeDevFrame: no free encode buffer, frame dropped\n");
+        assert(0);
+        return;
     }
 
     unsigned char *pInputSurface = NULL;
     uint32_t lockedPitch = 0;
-    checkNvEncErrors(m_pNvHWEncoder->NvEncLockInputBuffer(pEncodeBuffer->stInputBfr.hInputSurface, (void**)&pInputSurface, &lockedPitch));
+    checkNvEncErrors(m_pVideoEncoder->NvEncLockInputBuffer(pEncodeBuffer->stInputBfr.hInputSurface, (void**)&pInputSurface, &lockedPitch));
     assert(lockedPitch == nDecodedPitch);
 
     checkCudaErrors(cuMemcpyDtoH(pInputSurface, ppNV12Frame, lockedPitch*height*3/2));
 
-    checkNvEncErrors(m_pNvHWEncoder->NvEncUnlockInputBuffer(pEncodeBuffer->stInputBfr.hInputSurface));
+    checkNvEncErrors(m_pVideoEncoder->NvEncUnlockInputBuffer(pEncodeBuffer->stInputBfr.hInputSurface));
 
-    checkNvEncErrors(m_pNvHWEncoder->NvEncEncodeFrame(pEncodeBuffer, NULL, width, height, NV_ENC_PIC_STRUCT_FRAME));
+    SubmitEncodeBuffer(pEncodeBuffer);
 }
 
 
-void DecodeFrame(CUdeviceptr ppDecodedFrame, size_t nDecodedPitch,
-                        CUdeviceptr ppRGBAFrame, size_t nRGBAPitch,
-                        CUdeviceptr ppNV12Frame)
+// Pipeline stage 1: map the decoded surface and queue the conversion and
+// postprocess kernels on the frame's own stream.
+void ConvertStage(PipelineFrame *pFrame)
 {
-    uint32 width  = g_pNvHWDecoder->targetWidth();
-    uint32 height = g_pNvHWDecoder->targetHeight();
+    uint32 width  = g_pVideoDecoder->targetWidth();
+    uint32 height = g_pVideoDecoder->targetHeight();
 
-    // Push the current CUDA context 
-    CCtxAutoLock lck(g_pNvHWDecoder->getCtxLock());
-    checkCudaErrors(cuCtxPushCurrent(g_oDecContext));
+    // map decoded video frame to CUDA surface
+    g_pVideoDecoder->mapFrame(pFrame->oDisplayInfo.picture_index, &pFrame->pDecodedFrame, &pFrame->nDecodedPitch, &pFrame->oProcParams);
 
+    // before the lock: waiting for a frame means waiting on later stages
+    pFrame->oARGB   = g_oARGBPool.Acquire();
+    pFrame->oOutput = g_oOutputPool.Acquire();
+    if (pFrame->oARGB.IsNull() || pFrame->oOutput.IsNull()){
+        printf("ConvertStage: out of frame memory\n");
+        assert(0);
+        return;
+    }
+    CUdeviceptr pARGBFrame   = (CUdeviceptr)pFrame->oARGB.Data();
+    size_t      nARGBPitch   = pFrame->oARGB.Pitch();
+    CUdeviceptr pOutputFrame = (CUdeviceptr)pFrame->oOutput.Data();
+    size_t      nOutputPitch = pFrame->oOutput.Pitch();
 
-    checkCudaErrors(cudaLaunchNV12toARGBDrv(ppDecodedFrame, nDecodedPitch,
-                                      ppRGBAFrame, nRGBAPitch,
-                                      width, height, 0));
+    // Push the current CUDA context 
+    CCtxAutoLock lck(g_pVideoDecoder->getCtxLock());
+    checkCudaErrors(cuCtxPushCurrent(g_oDecContext));
 
+    if (g_pVideoDecoder->bitDepth() > 8)
+    {
+        checkCudaErrors(cudaLaunchP010toARGB2101010Drv(pFrame->pDecodedFrame, pFrame->nDecodedPitch,
+                                      pARGBFrame, nARGBPitch,
+                                      width, height, g_oColorSpace, pFrame->hStream));
 
-    checkCudaErrors(cudaLaunchARGBpostprocess(ppRGBAFrame, nRGBAPitch, width, height, 0));
+        if (g_dFilterCurves[1]){
+            checkCudaErrors(cudaLaunchARGB2101010curves(pARGBFrame, nARGBPitch, width, height, g_dFilterCurves[1], pFrame->hStream));
+        }
 
-    checkCudaErrors(cudaLaunchARGBtoNV12Drv(ppRGBAFrame, nRGBAPitch,
-                                      ppNV12Frame, nDecodedPitch,
-                                      width, height, 0));
+        checkCudaErrors(cudaLaunchARGB2101010toP010Drv(pARGBFrame, nARGBPitch,
+                                      pOutputFrame, nOutputPitch,
+                                      width, height, g_oColorSpace, pFrame->hStream));
+    }
+    else
+    {
+        checkCudaErrors(cudaLaunchNV12toARGBDrv(pFrame->pDecodedFrame, pFrame->nDecodedPitch,
+                                      pARGBFrame, nARGBPitch,
+                                      width, height, g_oColorSpace, pFrame->hStream));
 
+        if (g_dFilterCurves[0]){
+            checkCudaErrors(cudaLaunchARGBcurves(pARGBFrame, nARGBPitch, width, height, g_dFilterCurves[0], pFrame->hStream));
+        }
 
-    checkCudaErrors(cuCtxSynchronize());
+        checkCudaErrors(cudaLaunchARGBtoNV12Drv(pARGBFrame, nARGBPitch,
+                                      pOutputFrame, nOutputPitch,
+                                      width, height, g_oColorSpace, pFrame->hStream));
+    }
 
-    // EncodeDevFrame(ppDecodedFrame, nDecodedPitch);
+    checkCudaErrors(cuEventRecord(pFrame->hConverted, pFrame->hStream));
 
     // Detach from the Current thread
     checkCudaErrors(cuCtxPopCurrent(NULL));
 }
 
+// Pipeline stage 1 with -sw: the decoded picture already sits in host
+// memory, so the conversions run on the CPU.
+void HostConvertStage(PipelineFrame *pFrame)
+{
+    uint32 width  = g_pVideoDecoder->targetWidth();
+    uint32 height = g_pVideoDecoder->targetHeight();
+
+    g_pVideoDecoder->mapFrame(pFrame->oDisplayInfo.picture_index, &pFrame->pDecodedFrame, &pFrame->nDecodedPitch, &pFrame->oProcParams);
+
+    // With -zerocopy the destination is the encoder's own input surface,
+    // taken here and submitted by the encode stage; frames stay in order
+    // through the pipeline, so the surfaces do too.
+    void  *pOutput = NULL;
+    size_t nOutputPitch = 0;
+    pFrame->pEncodeBuffer = NULL;
+    if (g_bZeroCopy)
+    {
+        pFrame->pEncodeBuffer = m_EncodeBufferQueue.GetAvailable();
+        if (!pFrame->pEncodeBuffer){
+            printf("HostConvertStage: no free encode buffer, frame dropped\n");
+            assert(0);
+            return;
+        }
+        uint32_t lockedPitch = 0;
+        checkNvEncErrors(m_pVideoEncoder->NvEncLockInputBuffer(pFrame->pEncodeBuffer->stInputBfr.hInputSurface, &pOutput, &lockedPitch));
+        nOutputPitch = lockedPitch;
+    }
+    else
+    {
+        pFrame->oOutput = g_oOutputPool.Acquire();
+        pOutput      = pFrame->oOutput.Data();
+        nOutputPitch = pFrame->oOutput.Pitch();
+    }
+
+    bool bP010 = g_pVideoDecoder->bitDepth() > 8;
+    bool bUsesARGB = cpuPostprocessUsesARGB(g_oFilterGraph.HostPostprocess(), g_bHostFusion, bP010);
+    if (bUsesARGB){
+        pFrame->oARGB = g_oARGBPool.Acquire();
+    }
+    if (!pOutput || (bUsesARGB && pFrame->oARGB.IsNull())){
+        printf("HostConvertStage: out of frame memory\n");
+        if (pFrame->pEncodeBuffer){
+            checkNvEncErrors(m_pVideoEncoder->NvEncUnlockInputBuffer(pFrame->pEncodeBuffer->stInputBfr.hInputSurface));
+        }
+        assert(0);
+        return;
+    }
+
+    if (bP010)
+    {
+        cpuPostprocessP010((const uint16 *)pFrame->pDecodedFrame, pFrame->nDecodedPitch,
+                           (uint16 *)pOutput, nOutputPitch,
+                           (uint32 *)pFrame->oARGB.Data(), pFrame->oARGB.Pitch(),
+                           width, height, g_oColorSpace, g_oFilterGraph.HostPostprocess(), g_bHostFusion);
+    }
+    else
+    {
+        cpuPostprocessNV12((const uint8 *)pFrame->pDecodedFrame, pFrame->nDecodedPitch,
+                           (uint8 *)pOutput, nOutputPitch,
+                           (uint32 *)pFrame->oARGB.Data(), pFrame->oARGB.Pitch(),
+                           width, height, g_oColorSpace, g_oFilterGraph.HostPostprocess(), g_bHostFusion);
+    }
+
+    pFrame->oARGB.Reset();
+    if (pFrame->pEncodeBuffer){
+        checkNvEncErrors(m_pVideoEncoder->NvEncUnlockInputBuffer(pFrame->pEncodeBuffer->stInputBfr.hInputSurface));
+    }
+}
+
+// Pipeline stage 2: wait for the kernels. The NV12 result lands directly in
+// the pinned host buffer, so once the event fires the surface can go back
+// to the decoder.
+void DownloadStage(PipelineFrame *pFrame)
+{
+    if (pFrame->hConverted)
+    {
+        checkCudaErrors(cuCtxPushCurrent(g_oDecContext));
+        checkCudaErrors(cuEventSynchronize(pFrame->hConverted));
+        checkCudaErrors(cuCtxPopCurrent(NULL));
+    }
+    pFrame->oARGB.Reset();
+
+    // unmap video frame
+    g_pVideoDecoder->unmapFrame(pFrame->pDecodedFrame);
+    pFrame->pDecodedFrame = 0;
+
+    if (pFrame->bLastField)
+    {
+        g_pFrameQueue->releaseFrame(&pFrame->oDisplayInfo);
+    }
+}
+
+// Pipeline stage 3: hand the frame to the encoder; bitstream retrieval runs
+// behind it on the encode output thread.
+void EncodeStage(PipelineFrame *pFrame)
+{
+    if (pFrame->pEncodeBuffer)
+    {
+        SubmitEncodeBuffer(pFrame->pEncodeBuffer);
+        pFrame->pEncodeBuffer = NULL;
+    }
+    else if (!pFrame->oOutput.IsNull())
+    {
+        EncodeHostFrame(pFrame->oOutput.Data(), pFrame->oOutput.Pitch());
+        pFrame->oOutput.Reset();
+    }
+}
+
+void startPipeline()
+{
+    g_oPipeline.Initialize(g_aPipelineFrames, PIPELINE_DEPTH);
+    g_oPipeline.AddStage("convert", g_bSoftware ? HostConvertStage : ConvertStage);
+    g_oPipeline.AddStage("download", DownloadStage);
+    g_oPipeline.AddStage("encode", EncodeStage);
+    g_oPipeline.Start();
+}
+
 bool processFrame()
 {
     CUVIDPARSERDISPINFO oDisplayInfo;
 
-    if (g_pFrameQueue->dequeue(&oDisplayInfo))
+    // Sleeps until the parser queues a frame or signals end of stream.
+    if (g_pFrameQueue->dequeue(&oDisplayInfo, FrameQueue::cnInfinite))
     {
         int num_fields = (oDisplayInfo.progressive_frame ? (1) : (2+oDisplayInfo.repeat_first_field));
+        if (g_DecodeFrameCount == 0){
+            g_nVideoOrigin = oDisplayInfo.timestamp;
+        }
         g_bIsProgressive = oDisplayInfo.progressive_frame ? true : false;
 
         for (int active_field=0; active_field<num_fields; active_field++)
         {
-            CUVIDPROCPARAMS oVideoProcessingParameters;
+            // blocks while PIPELINE_DEPTH fields are still being processed
+            PipelineFrame *pFrame = g_oPipeline.Acquire();
+
+            CUVIDPROCPARAMS &oVideoProcessingParameters = pFrame->oProcParams;
             memset(&oVideoProcessingParameters, 0, sizeof(CUVIDPROCPARAMS));
             oVideoProcessingParameters.progressive_frame = oDisplayInfo.progressive_frame;
             oVideoProcessingParameters.second_field      = active_field;
             oVideoProcessingParameters.top_field_first   = oDisplayInfo.top_field_first;
             oVideoProcessingParameters.unpaired_field    = (num_fields == 1);
 
-
-            // map decoded video frame to CUDA surface
-            CUdeviceptr  pDecodedFrame = 0;
-            unsigned int nDecodedPitch = 0;
-            g_pNvHWDecoder->mapFrame(oDisplayInfo.picture_index, &pDecodedFrame, &nDecodedPitch, &oVideoProcessingParameters);
+            pFrame->oDisplayInfo = oDisplayInfo;
+            pFrame->bLastField   = (active_field == num_fields - 1);
 
             printf("%s = %02d, PicIndex = %02d, OutputPTS = %08d\n",
                    (oDisplayInfo.progressive_frame ? "Frame" : "Field"),
                    g_DecodeFrameCount, oDisplayInfo.picture_index, oDisplayInfo.timestamp);
-            
-            size_t RGBPitch = g_pNvHWDecoder->targetWidth()*4;
-            DecodeFrame(pDecodedFrame, nDecodedPitch, g_pRGBAFrame[active_field], RGBPitch, (CUdeviceptr)g_pNV12Frame[active_field]);
 
-            // unmap video frame
-            g_pNvHWDecoder->unmapFrame(pDecodedFrame);
-            g_pFrameQueue->releaseFrame(&oDisplayInfo);
-
-            EncodeHostFrame((void*)(CUdeviceptr)g_pNV12Frame[active_field], nDecodedPitch);
+            g_oPipeline.Submit(pFrame);
 
             g_DecodeFrameCount++;
         }
@@ -404,7 +1017,7 @@ bool processFrame()
     }
     else
     {
-        // Frame Queue has no frames, we don't compute FPS until we start
+        // Frame Queue is drained and decoding has ended
         return false;
     }
 
@@ -440,33 +1053,30 @@ bool renderVideoFrame()
 // Release all previously initd objects
 bool cleanup(bool bDestroyContext)
 {
-    if (bDestroyContext)
+    // the pipeline has stopped, so every frame is back in its pool
+    g_oARGBPool.Deinitialize();
+    g_oOutputPool.Deinitialize();
+
+    if (!g_bSoftware && bDestroyContext)
     {
         // Attach the CUDA Context (so we may properly free memroy)
-        checkCudaErrors(cuCtxPushCurrent(g_oEncContext));
-
-        if (g_pRGBAFrame[0])
-        {
-            checkCudaErrors(cuMemFree(g_pRGBAFrame[0]));
-            g_pRGBAFrame[0] = 0;
-        }
+        checkCudaErrors(cuCtxPushCurrent(g_oDecContext));
 
-        if (g_pRGBAFrame[1])
+        for (int i = 0; i < PIPELINE_DEPTH; i++)
         {
-            checkCudaErrors(cuMemFree(g_pRGBAFrame[1]));
-            g_pRGBAFrame[1] = 0;
-        }
-
-        if (g_pNV12Frame[0])
-        {
-            checkCudaErrors(cuMemFreeHost(g_pNV12Frame[0]));
-            g_pNV12Frame[0] = 0;
-        }
-
-        if (g_pNV12Frame[1])
-        {
-            checkCudaErrors(cuMemFreeHost(g_pNV12Frame[1]));
-            g_pNV12Frame[1] = 0;
+            PipelineFrame *pFrame = &g_aPipelineFrames[i];
+
+            if (pFrame->hConverted)
+            {
+                checkCudaErrors(cuEventDestroy(pFrame->hConverted));
+                pFrame->hConverted = 0;
+            }
+
+            if (pFrame->hStream)
+            {
+                checkCudaErrors(cuStreamDestroy(pFrame->hStream));
+                pFrame->hStream = 0;
+            }
         }
 
         // Detach from the Current thread
@@ -474,15 +1084,208 @@ bool cleanup(bool bDestroyContext)
     }
 
     releaseIOBuffers();
-    m_pNvHWEncoder->NvEncDestroyEncoder();
+    m_pVideoEncoder->NvEncDestroyEncoder();
 
     freeCudaResources(bDestroyContext);
 
     return true;
 }
 
+void printHelp()
+{
+    printf("Usage: %s [options]\n", sAppFilename);
+    printf("  -i <file>        input video (raw NV12 or P010 with -sw, default %s)\n", VIDEO_SOURCE_FILE);
+    printf("  -o <file>        output file (default %s): fragmented MP4 for .mp4/.m4v, CMAF segments\n"
+           "                   with HLS and DASH lists for .m3u8/.mpd, Annex-B otherwise\n", VIDEO_TARGET_FILE);
+    printf("  -fragment N      frames per MP4 fragment besides the keyframes, 0 = keyframes only (default 30)\n");
+    printf("  -segment S       seconds per CMAF segment for .m3u8/.mpd output (default 2)\n");
+    printf("  -segwindow N     segments kept in the live playlists, 0 = all (default)\n");
+    printf("  -checkmp4 <file> parse a fragmented MP4 on the CPU, check its structure and exit\n");
+    printf("  -sw              use the CPU decoder/encoder backends, no GPU needed\n");
+    printf("  -size WxH        -sw frame size (default 1280x720)\n");
+    printf("  -frames N        -sw frames to synthesize when there is no input (default 300)\n");
+    printf("  -latency D,E     -sw simulated decode and encode time per frame in us\n");
+    printf("  -filters CHAIN   postprocess filters, name[:key=value...],... or none (default keepred);\n"
+           "                   -filters help lists them: %s\n", nvFilterNames());
+    printf("  -nofuse          -sw: run the host postprocess through a full ARGB frame\n");
+    printf("  -zerocopy        -sw: convert straight into the locked encoder input surfaces\n");
+    printf("  -p010            -sw: 10-bit P010 input and output, ARGB2101010 postprocess\n");
+    printf("  -audio           -sw: synthesize a silent MP3 track, muxed into .mp4/.m3u8/.mpd output\n");
+    printf("  -strips N|auto   -sw: run the host postprocess in strips of N rows, or tune N at startup\n");
+    printf("  -threads N       -sw: threads working on the strips of a frame (default: all cores)\n");
+    printf("  -bench NAME      benchmark the host kernels at -size and exit: %s\n", cpuBenchmarkNames());
+    printf("  -colorspace M[,full]\n");
+    printf("                   -sw input matrix: 601 (default), 709 or 2020, limited range unless ,full\n");
+}
+
+void printFilterHelp()
+{
+    size_t nFilters = 0;
+    const NvFilterInfo *pFilters = nvFilterRegistry(&nFilters);
+
+    printf("Filters for -filters name[:key=value...],...; adjacent point-wise ones run as one pass:\n");
+    for (size_t i = 0; i < nFilters; i++)
+    {
+        printf("  %-12s %-30s %s\n", pFilters[i].szName, pFilters[i].szOptions, pFilters[i].szDescription);
+    }
+}
+
+bool parseColorSpace(const char *szArg, NvColorSpace &oColorSpace)
+{
+    unsigned int uMatrix = 0;
+    char szRange[8] = "";
+
+    if (sscanf(szArg, "%u,%7s", &uMatrix, szRange) < 1){
+        return false;
+    }
+
+    switch (uMatrix)
+    {
+        case 601:  oColorSpace.eMatrix = NV_COLOR_MATRIX_BT601;  break;
+        case 709:  oColorSpace.eMatrix = NV_COLOR_MATRIX_BT709;  break;
+        case 2020: oColorSpace.eMatrix = NV_COLOR_MATRIX_BT2020; break;
+        default:   return false;
+    }
+
+    if (szRange[0] && strcmp(szRange, "full")){
+        return false;
+    }
+    oColorSpace.eRange = szRange[0] ? NV_COLOR_RANGE_FULL : NV_COLOR_RANGE_LIMITED;
+    return true;
+}
+
+bool parseArguments(int argc, char *argv[])
+{
+    bool bInputGiven = false;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-sw")){
+            g_bSoftware = true;
+        } else if (!strcmp(argv[i], "-p010")){
+            g_oSWConfig.nBitDepth = 10;
+        } else if (!strcmp(argv[i], "-audio")){
+            g_oSWConfig.bAudio = true;
+        } else if (!strcmp(argv[i], "-filters") && i + 1 < argc){
+            g_szFilters = argv[++i];
+        } else if (!strcmp(argv[i], "-nofuse")){
+            g_bHostFusion = false;
+        } else if (!strcmp(argv[i], "-zerocopy")){
+            g_bZeroCopy = true;
+        } else if (!strcmp(argv[i], "-strips") && i + 1 < argc){
+            if (!strcmp(argv[++i], "auto")){
+                g_uStripRows = ~0u;
+            } else if (sscanf(argv[i], "%u", &g_uStripRows) != 1 || g_uStripRows == 0){
+                return false;
+            }
+        } else if (!strcmp(argv[i], "-threads") && i + 1 < argc){
+            g_uStripThreads = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-bench") && i + 1 < argc){
+            g_szBenchmark = argv[++i];
+        } else if (!strcmp(argv[i], "-checkmp4") && i + 1 < argc){
+            g_szCheckMp4 = argv[++i];
+        } else if (!strcmp(argv[i], "-fragment") && i + 1 < argc){
+            if (sscanf(argv[++i], "%u", &g_uMp4FragmentFrames) != 1){
+                return false;
+            }
+        } else if (!strcmp(argv[i], "-segment") && i + 1 < argc){
+            if (sscanf(argv[++i], "%lf", &g_fSegmentSeconds) != 1 || !(g_fSegmentSeconds > 0.0)){
+                return false;
+            }
+        } else if (!strcmp(argv[i], "-segwindow") && i + 1 < argc){
+            if (sscanf(argv[++i], "%u", &g_uSegmentWindow) != 1){
+                return false;
+            }
+        } else if (!strcmp(argv[i], "-i") && i + 1 < argc){
+            g_sInputFile = argv[++i];
+            bInputGiven = true;
+        } else if (!strcmp(argv[i], "-o") && i + 1 < argc){
+            g_sOutputFile = argv[++i];
+        } else if (!strcmp(argv[i], "-size") && i + 1 < argc){
+            if (sscanf(argv[++i], "%ux%u", &g_oSWConfig.nWidth, &g_oSWConfig.nHeight) != 2){
+                return false;
+            }
+        } else if (!strcmp(argv[i], "-frames") && i + 1 < argc){
+            g_oSWConfig.nFrameCount = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-colorspace") && i + 1 < argc){
+            if (!parseColorSpace(argv[++i], g_oSWConfig.oColorSpace)){
+                return false;
+            }
+        } else if (!strcmp(argv[i], "-latency") && i + 1 < argc){
+            if (sscanf(argv[++i], "%u,%u", &g_oSWConfig.nLatencyUs, &g_uSWEncodeLatencyUs) < 1){
+                return false;
+            }
+        } else {
+            return false;
+        }
+    }
+
+    // the default source is an MPEG-2 stream, which the software decoder
+    // can't read; synthesize frames instead
+    if (g_bSoftware && !bInputGiven){
+        g_sInputFile = NULL;
+    }
+
+    if (!strcmp(g_szFilters, "help")){
+        return true;
+    }
+    if (!g_oFilterGraph.Parse(g_szFilters)){
+        return false;
+    }
+    // the GPU path has the lookup kernels only; every filter runs on the host
+    if (!g_bSoftware && !g_szBenchmark && !g_oFilterGraph.CurvesOnly()){
+        printf("-filters %s: only curves run on the GPU, use -sw\n", g_szFilters);
+        return false;
+    }
+
+    // nvcuvid and NVENC in this SDK only handle 8-bit surfaces
+    if (g_oSWConfig.nBitDepth > 8 && (!g_bSoftware || !cpuSupportsP010(g_oFilterGraph.HostPostprocess()))){
+        return false;
+    }
+
+    // the encoders want even sizes; the host kernels behind -bench take any
+    if (g_oSWConfig.nWidth == 0 || g_oSWConfig.nHeight == 0 ||
+        (!g_szBenchmark && ((g_oSWConfig.nWidth & 1) || (g_oSWConfig.nHeight & 1)))){
+        return false;
+    }
+
+    return true;
+}
+
 int main(int argc, char *argv[])
 {
+    if (!parseArguments(argc, argv)){
+        printHelp();
+        return 1;
+    }
+
+    if (!strcmp(g_szFilters, "help")){
+        printFilterHelp();
+        return 0;
+    }
+
+    if (g_szBenchmark){
+        if (!cpuRunBenchmark(g_szBenchmark, g_oSWConfig.nWidth, g_oSWConfig.nHeight, g_oFilterGraph)){
+            printHelp();
+            return 1;
+        }
+        return 0;
+    }
+
+    if (g_szCheckMp4){
+        NvMp4FileInfo oInfo;
+        bool bOk = nvMp4Check(g_szCheckMp4, &oInfo);
+        printf("%s: %s %ux%u, %llu frames (%llu keyframes) in %llu fragments, %.3f s, %llu index entries: %s\n",
+               g_szCheckMp4, oInfo.sCodec.c_str(), oInfo.width, oInfo.height, oInfo.nFrames, oInfo.nKeyframes,
+               oInfo.nFragments, oInfo.uTimescale ? (double)oInfo.nDuration / oInfo.uTimescale : 0.0,
+               oInfo.nIndexEntries, bOk ? "OK" : "FAILED");
+        if (!oInfo.sAudioCodec.empty()){
+            printf("%s: %s %u Hz, %llu audio frames\n",
+                   g_szCheckMp4, oInfo.sAudioCodec.c_str(), oInfo.uAudioSampleRate, oInfo.nAudioFrames);
+        }
+        return bOk ? 0 : 1;
+    }
+
     // timer
     sdkCreateTimer(&frame_timer);
     sdkResetTimer(&frame_timer);
@@ -490,29 +1293,39 @@ int main(int argc, char *argv[])
     sdkResetTimer(&global_timer);
 
     // cuda rc
-    initCudaResources();
+    if (g_bSoftware){
+        initHostResources();
+    } else {
+        initCudaResources();
+    }
+    startPipeline();
 
-    g_pNvHWDecoder->start();
+    g_pVideoDecoder->start();
 
     // start timer
     sdkStartTimer(&global_timer);
     sdkResetTimer(&global_timer);
+    getrusage(RUSAGE_SELF, &g_oStartUsage);
 
     bool bQuit = false;
     while (!bQuit)
     {
         bQuit = renderVideoFrame();
     }
+    // let the fields still in flight reach the encoder
+    g_oPipeline.Stop();
     FlushEncoder();
 
     g_pFrameQueue->endDecode();
-    g_pNvHWDecoder->stop();
+    g_pVideoDecoder->stop();
 
     computeFPS();
     printStatistics();
 
     cleanup(true);
-    cuProfilerStop();
+    if (!g_bSoftware){
+        cuProfilerStop();
+    }
 
     return 0;
 }
@@ -13,182 +13,230 @@
 #include <stdlib.h>
 #include <string.h>
 #include "cudaProcessFrame.h"
+#include "NvColorMatrix.h"
+#include "NvPixelFormat.h"
 
-#define MUL(x,y)    (x*y)
-
-__device__ void YUV2RGB(uint32 *yuvi, float *rgb)
+// ARGB2101010 keeps all 10 bits, so the 10-bit path needs no rounding here
+__device__ uint32 RGBAPACK_2101010(uint32* irgb)
 {
-    float luma, chromaCb, chromaCr;
-
-    luma     = (float)yuvi[0];
-    chromaCb = (float)((int32)yuvi[1] - 512.0f);
-    chromaCr = (float)((int32)yuvi[2] - 512.0f);
-
-    
-    rgb[0] = MUL(luma,     1.1644) +
-            MUL(chromaCb, 0) +
-            MUL(chromaCr, 1.5960);
-    rgb[1] = MUL(luma,     1.1644) +
-            MUL(chromaCb, -0.3918) +
-            MUL(chromaCr, -0.8130);
-    rgb[2] = MUL(luma,    1.1644) +
-            MUL(chromaCb, 2.0172) +
-            MUL(chromaCr, 0);
+    return min(irgb[2], 1023u) | (min(irgb[1], 1023u) << 10) | (min(irgb[0], 1023u) << 20) | 0xc0000000u;
 }
 
-__device__ void RGB2YUV(uint32 *rgb, float *yuv)
+__device__ void RGBAUNPACK_2101010(uint32 pixel, uint32* rgb)
 {
-
-    float r = (float)rgb[0];
-    float g = (float)rgb[1];
-    float b = (float)rgb[2];
-
-    yuv[0]  = MUL(r, 0.2568) +
-            MUL(g, 0.5041) +
-            MUL(b, 0.0979);
-    yuv[1]= MUL(r, -0.1482) +
-            MUL(g, -0.2910) +
-            MUL(b, 0.4392) + 512;
-    yuv[2] = MUL(r, 0.4392) +
-            MUL(g, -0.3678) +
-            MUL(b, -0.0714) + 512;
+    rgb[2] = pixel & 0x3ff;
+    rgb[1] = (pixel >> 10) & 0x3ff;
+    rgb[0] = (pixel >> 20) & 0x3ff;
 }
 
-__device__ uint32 RGBAPACK_10bit(uint32* irgb)
+// The colour conversions are templates on the pixel format traits of
+// NvPixelFormat.h and the Q13 matrix of NvColorMatrix.h, instantiated below
+// as <format>ToARGBdrvapi_<name> / ARGBTo<format>drvapi_<name> for every
+// format and colour space. cpuProcessFrame.cpp evaluates the same integer
+// math, so host and device output match exactly.
+template <class Fmt, class CM>
+__device__ void YUVToARGB(uint32 *srcImage,     size_t nSourcePitch,
+                          uint32 *dstImage,     size_t nDestPitch,
+                          uint32 width,         uint32 height)
 {
-    float rgb[3];
-    uint32 ARGBpixel = 0;
+    // process 2 pixels per thread
+    int32 x = blockIdx.x * (blockDim.x << 1) + (threadIdx.x << 1);
+    int32 y = blockIdx.y *  blockDim.y       +  threadIdx.y;
+    if (x+1 >= width || y >= height)
+        return; 
+
+    uint32 dstImagePitch   = nDestPitch >> 2;
+    uint8 *srcImageU8      = (uint8 *)srcImage;
 
-    rgb[0] = min(max((float)irgb[0], 0.0f), 1023.f);
-    rgb[1] = min(max((float)irgb[1], 0.0f), 1023.f);
-    rgb[2] = min(max((float)irgb[2], 0.0f), 1023.f);
+    int32 x_chroma = x >> Fmt::ChromaShiftX;
+    int32 y_chroma = y >> Fmt::ChromaShiftY;
 
-    ARGBpixel = (((uint32)rgb[2]  >> 2) |
-                 (((uint32)rgb[1] >> 2) << 8)  |
-                 (((uint32)rgb[0]   >> 2) << 16) | ((uint32)0xff<< 24));
+    uint32 chromaCb = srcImageU8[Fmt::cb(nSourcePitch, height, x_chroma, y_chroma)];
+    uint32 chromaCr = srcImageU8[Fmt::cr(nSourcePitch, height, x_chroma, y_chroma)];
 
-    return  ARGBpixel;
-}
+    // 4:2:0 odd scanline: interpolate vertically except on the last chroma row
+    if (Fmt::ChromaShiftY && (y & 1) && y_chroma < ((height >> 1) - 1))
+    {
+        chromaCb = (chromaCb + srcImageU8[Fmt::cb(nSourcePitch, height, x_chroma, y_chroma + 1)] + 1) >> 1;
+        chromaCr = (chromaCr + srcImageU8[Fmt::cr(nSourcePitch, height, x_chroma, y_chroma + 1)] + 1) >> 1;
+    }
 
+    // 4:4:4 has a sample of its own for the second pixel
+    uint32 chromaCb1 = chromaCb;
+    uint32 chromaCr1 = chromaCr;
+    if (!Fmt::ChromaShiftX)
+    {
+        chromaCb1 = srcImageU8[Fmt::cb(nSourcePitch, height, x + 1, y_chroma)];
+        chromaCr1 = srcImageU8[Fmt::cr(nSourcePitch, height, x + 1, y_chroma)];
+    }
 
-__device__ uint32 RGBAPACK_10bit(float* rgb)
+    // save to dest
+    dstImage[y * dstImagePitch + x     ] = nvYUV2ARGB<CM>(srcImageU8[Fmt::luma(nSourcePitch, height, x,     y)], chromaCb,  chromaCr);
+    dstImage[y * dstImagePitch + x + 1 ] = nvYUV2ARGB<CM>(srcImageU8[Fmt::luma(nSourcePitch, height, x + 1, y)], chromaCb1, chromaCr1);
+}
+
+template <class Fmt, class CM>
+__device__ void ARGBToYUV(uint32 *srcImage,     size_t nSourcePitch,
+                          uint32 *dstImage,     size_t nDestPitch,
+                          uint32 width,         uint32 height)
 {
-    uint32 ARGBpixel = 0;
+    int32 x = blockIdx.x * (blockDim.x << 1) + (threadIdx.x << 1);
+    int32 y = blockIdx.y *  blockDim.y       +  threadIdx.y;
+    if (x+1 >= width || y >= height)
+        return; 
 
-    rgb[0] = min(max(rgb[0], 0.0f), 1023.f);
-    rgb[1] = min(max(rgb[1], 0.0f), 1023.f);
-    rgb[2] = min(max(rgb[2], 0.0f), 1023.f);
+    uint32 processingPitch = nSourcePitch>>2;
+    uint8 *dstImageU8      = (uint8 *)dstImage;
 
-    ARGBpixel = (((uint32)rgb[2]  >> 2) |
-                 (((uint32)rgb[1] >> 2) << 8)  |
-                 (((uint32)rgb[0]   >> 2) << 16) | ((uint32)0xff<< 24));
+    uint32 p0 = srcImage[y * processingPitch + x    ];
+    uint32 p1 = srcImage[y * processingPitch + x + 1];
 
-    return  ARGBpixel;
-}
+    dstImageU8[Fmt::luma(nDestPitch, height, x,     y)] = nvRGB2Y<CM>((p0 >> 16) & 0xff, (p0 >> 8) & 0xff, p0 & 0xff);
+    dstImageU8[Fmt::luma(nDestPitch, height, x + 1, y)] = nvRGB2Y<CM>((p1 >> 16) & 0xff, (p1 >> 8) & 0xff, p1 & 0xff);
 
-__device__ void RGBAUNPACK_10bit(uint32 pixel, uint32* rgb)
-{
-    rgb[2] = (pixel & 0xFF) << 2;
-    rgb[1] = ((pixel>>8) & 0xFF) << 2;
-    rgb[0] = ((pixel>>16) & 0xFF) << 2;
+    int32 x_chroma = x >> Fmt::ChromaShiftX;
+    int32 y_chroma = y >> Fmt::ChromaShiftY;
+
+    if (!Fmt::ChromaShiftX)
+    {
+        // 4:4:4: each pixel counts as a whole quad of itself
+        nvRGB2UV<CM>(((p0 >> 16) & 0xff) * 4, ((p0 >> 8) & 0xff) * 4, (p0 & 0xff) * 4,
+                     dstImageU8[Fmt::cb(nDestPitch, height, x, y_chroma)],
+                     dstImageU8[Fmt::cr(nDestPitch, height, x, y_chroma)]);
+        nvRGB2UV<CM>(((p1 >> 16) & 0xff) * 4, ((p1 >> 8) & 0xff) * 4, (p1 & 0xff) * 4,
+                     dstImageU8[Fmt::cb(nDestPitch, height, x + 1, y_chroma)],
+                     dstImageU8[Fmt::cr(nDestPitch, height, x + 1, y_chroma)]);
+    }
+    else if (!Fmt::ChromaShiftY || !(y & 1))
+    {
+        // chroma from the whole 2x2 quad; an odd last row, and every row of
+        // the 4:2:2 formats, pairs with itself
+        int32 y1 = (Fmt::ChromaShiftY && y + 1 < height) ? y + 1 : y;
+        uint32 p2 = srcImage[y1 * processingPitch + x    ];
+        uint32 p3 = srcImage[y1 * processingPitch + x + 1];
+
+        int32 sumR = ((p0 >> 16) & 0xff) + ((p1 >> 16) & 0xff) + ((p2 >> 16) & 0xff) + ((p3 >> 16) & 0xff);
+        int32 sumG = ((p0 >>  8) & 0xff) + ((p1 >>  8) & 0xff) + ((p2 >>  8) & 0xff) + ((p3 >>  8) & 0xff);
+        int32 sumB = ( p0        & 0xff) + ( p1        & 0xff) + ( p2        & 0xff) + ( p3        & 0xff);
+
+        nvRGB2UV<CM>(sumR, sumG, sumB,
+                     dstImageU8[Fmt::cb(nDestPitch, height, x_chroma, y_chroma)],
+                     dstImageU8[Fmt::cr(nDestPitch, height, x_chroma, y_chroma)]);
+    }
 }
 
-extern "C" __global__ void NV12ToARGBdrvapi(uint32 *srcImage,     size_t nSourcePitch,
+// NV12ToARGB at 10 bits: P010 words in, ARGB2101010 out
+template <class CM>
+__device__ void P010ToARGB2101010(uint32 *srcImage,     size_t nSourcePitch,
                                   uint32 *dstImage,     size_t nDestPitch,
                                   uint32 width,         uint32 height)
 {
-    // process 2 pixels per thread
     int32 x = blockIdx.x * (blockDim.x << 1) + (threadIdx.x << 1);
     int32 y = blockIdx.y *  blockDim.y       +  threadIdx.y;
     if (x+1 >= width || y >= height)
-        return; 
+        return;
 
-    uint32 processingPitch = nSourcePitch;
+    uint32 processingPitch = nSourcePitch >> 1;
     uint32 dstImagePitch   = nDestPitch >> 2;
-    uint8 *srcImageU8     = (uint8 *)srcImage;
-
-    // Read 2 Y components at a time
-    uint32 yuvi[6];
-    yuvi[0] = (srcImageU8[y * processingPitch + x    ]) << 2;
-    yuvi[3] = (srcImageU8[y * processingPitch + x + 1]) << 2;
+    uint16 *srcImageU16    = (uint16 *)srcImage;
 
     uint32 chromaOffset    = processingPitch * height;
     int32 y_chroma = y >> 1;
 
-    if (y & 1)  // odd scanline 
-    {
-        uint32 chromaCb = srcImageU8[chromaOffset + y_chroma * processingPitch + x    ];
-        uint32 chromaCr = srcImageU8[chromaOffset + y_chroma * processingPitch + x + 1];
-
-        if (y_chroma < ((height >> 1) - 1)) // interpolate vertically
-        {
-            chromaCb = (chromaCb + srcImageU8[chromaOffset + (y_chroma + 1) * processingPitch + x    ] + 1) >> 1;
-            chromaCr = (chromaCr + srcImageU8[chromaOffset + (y_chroma + 1) * processingPitch + x + 1] + 1) >> 1;
-        }
+    uint32 chromaCb = srcImageU16[chromaOffset + y_chroma * processingPitch + x    ] >> NV_P010_SHIFT;
+    uint32 chromaCr = srcImageU16[chromaOffset + y_chroma * processingPitch + x + 1] >> NV_P010_SHIFT;
 
-        yuvi[1] = yuvi[4] = chromaCb << 2;
-        yuvi[2] = yuvi[5] = chromaCr << 2;
-    }
-    else
+    if ((y & 1) && y_chroma < ((height >> 1) - 1))
     {
-        yuvi[1] = yuvi[4] = (uint32)srcImageU8[chromaOffset + y_chroma * processingPitch + x    ] << 2;
-        yuvi[2] = yuvi[5] = (uint32)srcImageU8[chromaOffset + y_chroma * processingPitch + x + 1] << 2;
+        chromaCb = (chromaCb + (srcImageU16[chromaOffset + (y_chroma + 1) * processingPitch + x    ] >> NV_P010_SHIFT) + 1) >> 1;
+        chromaCr = (chromaCr + (srcImageU16[chromaOffset + (y_chroma + 1) * processingPitch + x + 1] >> NV_P010_SHIFT) + 1) >> 1;
     }
 
-    // YUV to RGB Transformation conversion
-    float rgb[6];
-    YUV2RGB(&yuvi[0], &rgb[0]);
-    YUV2RGB(&yuvi[3], &rgb[3]);
-
-    // save to dest
-    dstImage[y * dstImagePitch + x     ] = RGBAPACK_10bit(&rgb[0]);
-    dstImage[y * dstImagePitch + x + 1 ] = RGBAPACK_10bit(&rgb[3]);
+    dstImage[y * dstImagePitch + x    ] = nvYUV2ARGB2101010<CM>(srcImageU16[y * processingPitch + x    ] >> NV_P010_SHIFT, chromaCb, chromaCr);
+    dstImage[y * dstImagePitch + x + 1] = nvYUV2ARGB2101010<CM>(srcImageU16[y * processingPitch + x + 1] >> NV_P010_SHIFT, chromaCb, chromaCr);
 }
 
-extern "C" __global__ void ARGBToNv12drvapi(uint32 *srcImage,     size_t nSourcePitch,
+template <class CM>
+__device__ void ARGB2101010ToP010(uint32 *srcImage,     size_t nSourcePitch,
                                   uint32 *dstImage,     size_t nDestPitch,
                                   uint32 width,         uint32 height)
 {
     int32 x = blockIdx.x * (blockDim.x << 1) + (threadIdx.x << 1);
     int32 y = blockIdx.y *  blockDim.y       +  threadIdx.y;
     if (x+1 >= width || y >= height)
-        return; 
+        return;
 
-    uint32 processingPitch = nSourcePitch>>2;
-    uint8 *dstImageU8     = (uint8 *)dstImage;
-
-    uint32 rgb[6];
-    float yuv[6];
-
-    // Clamp the results to RGBA
-    RGBAUNPACK_10bit(srcImage[y * processingPitch + x     ], &rgb[0]);
-    RGBAUNPACK_10bit(srcImage[y * processingPitch + x + 1 ], &rgb[3]);
-
-    // YUV to RGB Transformation conversion
-    RGB2YUV(&rgb[0], &yuv[0]);
-    RGB2YUV(&rgb[3], &yuv[3]);
-
-    yuv[0]   = min(max(yuv[0]/4,   0.0f), 255.f);
-    yuv[1]   = min(max((yuv[1])/4,   0.0f), 255.f);
-    yuv[2]   = min(max((yuv[2])/4,   0.0f), 255.f);
-    yuv[3]   = min(max(yuv[3]/4,   0.0f), 255.f);
-    yuv[4]   = min(max((yuv[4])/4,   0.0f), 255.f);
-    yuv[5]   = min(max((yuv[5])/4,   0.0f), 255.f);
-
-    uint32 dstImagePitch   = nDestPitch;
-    dstImageU8[y * dstImagePitch + x] = ((uint32)yuv[0]);
-    dstImageU8[y * dstImagePitch + x + 1] = ((uint32)yuv[3]);
-
-    if (y & 1){
-    } else {
-        int32 y_chroma = y >> 1;
-        uint32 chromaOffset    = dstImagePitch* height;
-        dstImageU8[chromaOffset + y_chroma * dstImagePitch + x] =  (uint8)((uint32)yuv[1]);
-        dstImageU8[chromaOffset + y_chroma * dstImagePitch + x+1] =  (uint8)((uint32)yuv[2]);
+    uint32 processingPitch = nSourcePitch >> 2;
+    uint16 *dstImageU16    = (uint16 *)dstImage;
+    uint32 dstImagePitch   = nDestPitch >> 1;
+
+    uint32 p0 = srcImage[y * processingPitch + x    ];
+    uint32 p1 = srcImage[y * processingPitch + x + 1];
+
+    dstImageU16[y * dstImagePitch + x    ] = nvRGB2Y<CM>((p0 >> 20) & 0x3ff, (p0 >> 10) & 0x3ff, p0 & 0x3ff) << NV_P010_SHIFT;
+    dstImageU16[y * dstImagePitch + x + 1] = nvRGB2Y<CM>((p1 >> 20) & 0x3ff, (p1 >> 10) & 0x3ff, p1 & 0x3ff) << NV_P010_SHIFT;
+
+    if (!(y & 1))
+    {
+        int32 y1 = (y + 1 < height) ? y + 1 : y;
+        uint32 p2 = srcImage[y1 * processingPitch + x    ];
+        uint32 p3 = srcImage[y1 * processingPitch + x + 1];
+
+        int32 sumR = ((p0 >> 20) & 0x3ff) + ((p1 >> 20) & 0x3ff) + ((p2 >> 20) & 0x3ff) + ((p3 >> 20) & 0x3ff);
+        int32 sumG = ((p0 >> 10) & 0x3ff) + ((p1 >> 10) & 0x3ff) + ((p2 >> 10) & 0x3ff) + ((p3 >> 10) & 0x3ff);
+        int32 sumB = ( p0        & 0x3ff) + ( p1        & 0x3ff) + ( p2        & 0x3ff) + ( p3        & 0x3ff);
+
+        int32 chromaCb, chromaCr;
+        nvRGB2UV<CM>(sumR, sumG, sumB, chromaCb, chromaCr);
+
+        uint32 chromaOffset = dstImagePitch * height + (y >> 1) * dstImagePitch;
+        dstImageU16[chromaOffset + x    ] = chromaCb << NV_P010_SHIFT;
+        dstImageU16[chromaOffset + x + 1] = chromaCr << NV_P010_SHIFT;
     }
 }
 
-extern "C" __global__ void ARGBpostprocess(uint32 *srcImage, size_t pitch, uint32 width, uint32 height)
+#define NV_FORMAT_KERNELS(fmt, name, M, R)                                                          \
+extern "C" __global__ void fmt##ToARGBdrvapi_##name(uint32 *srcImage,     size_t nSourcePitch,     \
+                                                    uint32 *dstImage,     size_t nDestPitch,       \
+                                                    uint32 width,         uint32 height)           \
+{                                                                                                   \
+    YUVToARGB<NvPixelFormatTraits<NV_PIXEL_FORMAT_##fmt>, NvColorMatrixQ13<M, R> >(                \
+        srcImage, nSourcePitch, dstImage, nDestPitch, width, height);                               \
+}                                                                                                   \
+extern "C" __global__ void ARGBTo##fmt##drvapi_##name(uint32 *srcImage,     size_t nSourcePitch,   \
+                                                      uint32 *dstImage,     size_t nDestPitch,     \
+                                                      uint32 width,         uint32 height)         \
+{                                                                                                   \
+    ARGBToYUV<NvPixelFormatTraits<NV_PIXEL_FORMAT_##fmt>, NvColorMatrixQ13<M, R> >(                \
+        srcImage, nSourcePitch, dstImage, nDestPitch, width, height);                               \
+}
+
+#define NV_COLOR_KERNELS(name, M, R)                                                                \
+NV_FORMAT_KERNELS(NV12,   name, M, R)                                                               \
+NV_FORMAT_KERNELS(I420,   name, M, R)                                                               \
+NV_FORMAT_KERNELS(YV12,   name, M, R)                                                               \
+NV_FORMAT_KERNELS(NV16,   name, M, R)                                                               \
+NV_FORMAT_KERNELS(YUV444, name, M, R)                                                               \
+NV_FORMAT_KERNELS(YUY2,   name, M, R)                                                               \
+extern "C" __global__ void P010ToARGB2101010drvapi_##name(uint32 *srcImage, size_t nSourcePitch,   \
+                                                          uint32 *dstImage, size_t nDestPitch,     \
+                                                          uint32 width,     uint32 height)         \
+{                                                                                                   \
+    P010ToARGB2101010<NvColorMatrixQ13<M, R, 10> >(srcImage, nSourcePitch, dstImage, nDestPitch, width, height); \
+}                                                                                                   \
+extern "C" __global__ void ARGB2101010ToP010drvapi_##name(uint32 *srcImage, size_t nSourcePitch,   \
+                                                          uint32 *dstImage, size_t nDestPitch,     \
+                                                          uint32 width,     uint32 height)         \
+{                                                                                                   \
+    ARGB2101010ToP010<NvColorMatrixQ13<M, R, 10> >(srcImage, nSourcePitch, dstImage, nDestPitch, width, height); \
+}
+
+NV_FOR_EACH_COLOR_SPACE(NV_COLOR_KERNELS)
+
+// The point-wise filters of a CNvFilterGraph (NvFilterGraph.h), composed
+// into one lookup table per channel on the host: curves holds R, then G,
+// then B, 256 entries each here and 1024 for ARGB2101010.
+extern "C" __global__ void ARGBcurves(uint32 *srcImage, size_t pitch, uint32 width, uint32 height, const uint16 *curves)
 {
     int32 x = blockIdx.x *  blockDim.x + threadIdx.x;
     int32 y = blockIdx.y *  blockDim.y + threadIdx.y;
@@ -196,13 +244,27 @@ extern "C" __global__ void ARGBpostprocess(uint32 *srcImage, size_t pitch, uint3
         return; 
 
     uint32 processingPitch = pitch>>2;
-    uint32 rgb[3];
-    RGBAUNPACK_10bit(srcImage[y*processingPitch + x], rgb);
+    uint32 pixel = srcImage[y*processingPitch + x];
 
-    //todo
-    rgb[1] = rgb[2] = 0;
-    
-    srcImage[y*processingPitch + x] = RGBAPACK_10bit(rgb);
+    srcImage[y*processingPitch + x] = ((uint32)curves[(pixel >> 16) & 0xff] << 16) |
+                                      ((uint32)curves[256 + ((pixel >> 8) & 0xff)] << 8) |
+                                      curves[512 + (pixel & 0xff)] | 0xff000000u;
 }
 
+extern "C" __global__ void ARGB2101010curves(uint32 *srcImage, size_t pitch, uint32 width, uint32 height, const uint16 *curves)
+{
+    int32 x = blockIdx.x *  blockDim.x + threadIdx.x;
+    int32 y = blockIdx.y *  blockDim.y + threadIdx.y;
+    if (x >= width || y >= height)
+        return;
 
+    uint32 processingPitch = pitch>>2;
+    uint32 rgb[3];
+    RGBAUNPACK_2101010(srcImage[y*processingPitch + x], rgb);
+
+    rgb[0] = curves[rgb[0]];
+    rgb[1] = curves[1024 + rgb[1]];
+    rgb[2] = curves[2048 + rgb[2]];
+
+    srcImage[y*processingPitch + x] = RGBAPACK_2101010(rgb);
+}